@@ -0,0 +1,114 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "block-reader.h"
+#include "hash-helper.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+#include <openssl/evp.h>
+#include <vector>
+
+INIT_LOGGER ("Benchmark.BlockReader");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(BenchmarkBlockReader)
+
+static const fs::path ROOT = fs::path ("bench-block-reader");
+
+static const size_t BENCHMARK_FILE_SIZE = 256 * 1024 * 1024;
+
+// the way Hash::FromFileContent used to read files
+static HashPtr
+hashWithStream (const fs::path &filename)
+{
+  EVP_MD_CTX *hash_context = EVP_MD_CTX_create ();
+  EVP_DigestInit_ex (hash_context, EVP_sha256 (), 0);
+
+  fs::ifstream iff (filename, std::ios::in | std::ios::binary);
+  while (iff.good ())
+    {
+      char buf[1024];
+      iff.read (buf, 1024);
+      EVP_DigestUpdate (hash_context, buf, iff.gcount ());
+    }
+
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  EVP_DigestFinal_ex (hash_context, digest, &length);
+  EVP_MD_CTX_destroy (hash_context);
+
+  return boost::make_shared<Hash> (digest, length);
+}
+
+static double
+elapsed (const posix_time::ptime &start)
+{
+  return (posix_time::microsec_clock::universal_time () - start).total_microseconds () / 1000000.0;
+}
+
+BOOST_AUTO_TEST_CASE (HashBenchmark)
+{
+  fs::remove_all (ROOT);
+  fs::create_directories (ROOT);
+
+  fs::path file = ROOT / "large";
+  {
+    vector<char> chunk (1024 * 1024);
+    for (size_t i = 0; i < chunk.size (); i++)
+      chunk[i] = static_cast<char> (i * 31);
+
+    fs::ofstream out (file, fs::ofstream::binary);
+    for (size_t written = 0; written < BENCHMARK_FILE_SIZE; written += chunk.size ())
+      out.write (&chunk[0], chunk.size ());
+  }
+
+  // first pass warms up the page cache, so all variants below hash from memory
+  HashPtr reference = hashWithStream (file);
+
+  posix_time::ptime start = posix_time::microsec_clock::universal_time ();
+  HashPtr stream = hashWithStream (file);
+  double streamTime = elapsed (start);
+
+  start = posix_time::microsec_clock::universal_time ();
+  HashPtr blocks = Hash::FromFileContent (file);
+  double blockTime = elapsed (start);
+
+  BOOST_CHECK_EQUAL (*reference, *stream);
+  BOOST_CHECK_EQUAL (*reference, *blocks);
+
+  double gb = BENCHMARK_FILE_SIZE / 1000000000.0;
+  BOOST_TEST_MESSAGE ("Hashing of a " << (BENCHMARK_FILE_SIZE >> 20) << " MiB file: "
+                      << "1 KiB stream reads " << gb / streamTime << " GB/s, "
+                      << "1 MiB double-buffered reads " << gb / blockTime << " GB/s"
+                      << (BlockReader::IsUringSupported () ? " (io_uring)" : " (reader thread)"));
+
+  fs::remove_all (ROOT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
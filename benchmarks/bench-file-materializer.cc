@@ -0,0 +1,122 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "file-materializer.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+INIT_LOGGER ("Benchmark.FileMaterializer");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(BenchmarkFileMaterializer)
+
+static const fs::path ROOT = "bench-file-materializer";
+
+// Materialization of many small files, as after a fetch of a source tree
+static const int BENCHMARK_FILES = 10000;
+static const size_t BENCHMARK_FILE_SIZE = 4096;
+static const size_t BENCHMARK_WRITE_SIZE = 1024; // segment-sized writes
+
+static double
+elapsed (const posix_time::ptime &start)
+{
+  return (posix_time::microsec_clock::universal_time () - start).total_microseconds () / 1000000.0;
+}
+
+BOOST_AUTO_TEST_CASE (MaterializeBenchmark)
+{
+  fs::remove_all (ROOT);
+  vector<uint8_t> content (BENCHMARK_FILE_SIZE, 'z');
+
+  // not durable at all: plain stream, file is visible while being written
+  fs::create_directories (ROOT / "naive");
+  posix_time::ptime start = posix_time::microsec_clock::universal_time ();
+  for (int i = 0; i < BENCHMARK_FILES; i++)
+    {
+      fs::ofstream out (ROOT / "naive" / lexical_cast<string> (i), fs::ofstream::binary);
+      for (size_t offset = 0; offset < content.size (); offset += BENCHMARK_WRITE_SIZE)
+        out.write (reinterpret_cast<const char*> (&content[offset]), BENCHMARK_WRITE_SIZE);
+    }
+  double naive = elapsed (start);
+
+  // durable, every file is synced and renamed separately
+  fs::create_directories (ROOT / "per-file");
+  start = posix_time::microsec_clock::universal_time ();
+  for (int i = 0; i < BENCHMARK_FILES; i++)
+    {
+      fs::path file = ROOT / "per-file" / lexical_cast<string> (i);
+      fs::path temp = FileMaterializer::TempPath (file);
+      int fd = open (temp.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      BOOST_REQUIRE (fd >= 0);
+      for (size_t offset = 0; offset < content.size (); offset += BENCHMARK_WRITE_SIZE)
+        BOOST_REQUIRE (write (fd, &content[offset], BENCHMARK_WRITE_SIZE) == static_cast<ssize_t> (BENCHMARK_WRITE_SIZE));
+      fsync (fd);
+      close (fd);
+      fs::rename (temp, file);
+
+      int dir = open ((ROOT / "per-file").c_str (), O_RDONLY);
+      fsync (dir);
+      close (dir);
+    }
+  double perFile = elapsed (start);
+
+  // durable, batched
+  start = posix_time::microsec_clock::universal_time ();
+  {
+    FileMaterializer materializer;
+    for (int i = 0; i < BENCHMARK_FILES; i++)
+      {
+        BOOST_REQUIRE (materializer.Begin (ROOT / "batched" / lexical_cast<string> (i), content.size ()));
+        for (size_t offset = 0; offset < content.size (); offset += BENCHMARK_WRITE_SIZE)
+          materializer.Write (&content[offset], BENCHMARK_WRITE_SIZE);
+        BOOST_REQUIRE (materializer.End ());
+
+        if (materializer.IsBatchFull ())
+          BOOST_REQUIRE (materializer.Commit ());
+      }
+    BOOST_REQUIRE (materializer.Commit ());
+  }
+  double batched = elapsed (start);
+
+  BOOST_CHECK_EQUAL (fs::file_size (ROOT / "batched" / lexical_cast<string> (BENCHMARK_FILES - 1)), BENCHMARK_FILE_SIZE);
+
+  BOOST_TEST_MESSAGE ("Materialization of " << BENCHMARK_FILES << " files of " << BENCHMARK_FILE_SIZE << " bytes: "
+                      << "naive " << naive << "s, "
+                      << "per-file sync " << perFile << "s, "
+                      << "batched sync " << batched << "s");
+
+  fs::remove_all (ROOT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
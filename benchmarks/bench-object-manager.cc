@@ -0,0 +1,97 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "object-manager.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+INIT_LOGGER ("Benchmark.ObjectManager");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(BenchmarkObjectManager)
+
+static const size_t BENCHMARK_FILE_SIZE = 1024 * 1024 * 1024;
+static const size_t BENCHMARK_SIGNED_SEGMENTS_SIZE = 32 * 1024 * 1024; // signing every segment of 1 GiB takes minutes
+
+static double
+elapsed (const posix_time::ptime &start)
+{
+  return (posix_time::microsec_clock::universal_time () - start).total_microseconds () / 1000000.0;
+}
+
+static double
+publish (ObjectManager &manager, const fs::path &file)
+{
+  posix_time::ptime start = posix_time::microsec_clock::universal_time ();
+  manager.localFileToObjects (file, ndn::Name ("/device"));
+  return elapsed (start);
+}
+
+BOOST_AUTO_TEST_CASE (PublishBenchmark)
+{
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+  fs::create_directories (tmpdir);
+
+  fs::path large = tmpdir / "large";
+  fs::path small = tmpdir / "small";
+  {
+    vector<char> chunk (1024 * 1024);
+    for (size_t i = 0; i < chunk.size (); i++)
+      chunk[i] = static_cast<char> (i * 31 + i / 1021);
+
+    fs::ofstream out (large, fs::ofstream::binary);
+    for (size_t written = 0; written < BENCHMARK_FILE_SIZE; written += chunk.size ())
+      out.write (&chunk[0], chunk.size ());
+
+    chunk[0] ++; // different content, so it is published into a separate database
+    fs::ofstream outSmall (small, fs::ofstream::binary);
+    for (size_t written = 0; written < BENCHMARK_SIGNED_SEGMENTS_SIZE; written += chunk.size ())
+      outSmall.write (&chunk[0], chunk.size ());
+  }
+
+  ObjectManager manager (tmpdir / "manifest", "test-chronoshare");
+  double manifestTime = publish (manager, large);
+
+  ObjectManager signing (tmpdir / "segments", "test-chronoshare");
+  signing.SetSigningMode (ObjectManager::SIGN_SEGMENTS);
+  double segmentsTime = publish (signing, small);
+
+  BOOST_TEST_MESSAGE ("Publishing of a " << (BENCHMARK_FILE_SIZE >> 20) << " MiB file: "
+                      << "signed manifest " << BENCHMARK_FILE_SIZE / manifestTime / 1000000.0 << " MB/s ("
+                      << manifestTime << "s); "
+                      << "every segment signed " << BENCHMARK_SIGNED_SEGMENTS_SIZE / segmentsTime / 1000000.0 << " MB/s "
+                      << "(measured on " << (BENCHMARK_SIGNED_SEGMENTS_SIZE >> 20) << " MiB, "
+                      << BENCHMARK_FILE_SIZE / (BENCHMARK_SIGNED_SEGMENTS_SIZE / segmentsTime) << "s for the whole file)");
+
+  remove_all (tmpdir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
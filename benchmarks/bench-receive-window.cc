@@ -0,0 +1,89 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include <boost/test/unit_test.hpp>
+#include "receive-window.h"
+
+#include "logging.h"
+
+#include <set>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+INIT_LOGGER ("Benchmark.ReceiveWindow");
+
+using namespace boost;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(BenchmarkReceiveWindow)
+
+// Segment bookkeeping with 10k segments in flight, each window delivered in reverse order
+// (worst case for the old std::set-based bookkeeping)
+BOOST_AUTO_TEST_CASE (ReceiveWindowBenchmark)
+{
+  const int64_t WINDOW = 10000;
+  const int64_t SEGMENTS = 100 * WINDOW;
+
+  posix_time::ptime start = posix_time::microsec_clock::universal_time ();
+  {
+    ReceiveWindow window (0, WINDOW);
+    for (int64_t base = 0; base < SEGMENTS; base += WINDOW)
+      {
+        for (int64_t i = base; i < base + WINDOW; i++)
+          window.SetInFlight (i, true);
+        for (int64_t i = base + WINDOW - 1; i >= base; i--)
+          window.MarkReceived (i);
+      }
+    BOOST_CHECK_EQUAL (window.GetBase (), SEGMENTS);
+  }
+  posix_time::time_duration bitmap = posix_time::microsec_clock::universal_time () - start;
+
+  start = posix_time::microsec_clock::universal_time ();
+  {
+    set<int64_t> outOfOrder;
+    set<int64_t> inFlight;
+    int64_t maxInOrder = -1;
+    for (int64_t base = 0; base < SEGMENTS; base += WINDOW)
+      {
+        for (int64_t i = base; i < base + WINDOW; i++)
+          inFlight.insert (i);
+        for (int64_t i = base + WINDOW - 1; i >= base; i--)
+          {
+            outOfOrder.insert (i);
+            inFlight.erase (i);
+
+            set<int64_t>::iterator inOrder = outOfOrder.begin ();
+            for (; inOrder != outOfOrder.end () && *inOrder == maxInOrder + 1; inOrder++)
+              maxInOrder = *inOrder;
+            outOfOrder.erase (outOfOrder.begin (), inOrder);
+          }
+      }
+    BOOST_CHECK_EQUAL (maxInOrder + 1, SEGMENTS);
+  }
+  posix_time::time_duration sets = posix_time::microsec_clock::universal_time () - start;
+
+  BOOST_TEST_MESSAGE ("Bookkeeping of " << SEGMENTS << " segments with " << WINDOW << "-segment window: "
+                      << "bitmap " << bitmap.total_milliseconds () << "ms, "
+                      << "std::set " << sets.total_milliseconds () << "ms");
+  _LOG_DEBUG ("bitmap: " << bitmap << ", std::set: " << sets);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
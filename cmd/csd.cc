@@ -24,36 +24,249 @@
 #include "fs-watcher.h"
 #include "logging.h"
 #include "ccnx-wrapper.h"
+#include "digest.h"
 
 #include <boost/make_shared.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <iostream>
+#include <sstream>
+#include <vector>
 
 using namespace boost;
 using namespace std;
 using namespace Ccnx;
 
+static void
+usage ()
+{
+  cerr << "Usage: ./csd [--pin <folder>]... [--digest sha256|blake3] [--verify]" << endl
+       << "             [--upload-limit <limit>]... [--download-limit <limit>]..." << endl
+       << "             [--min-fetches <count>] [--max-fetches <count>]" << endl
+       << "             <username> <shared-folder> <path>" << endl
+       << endl
+       << "  --pin <folder>            fetch files in <folder> (relative to the shared folder) first" << endl
+       << "  --digest <name>           digest algorithm for new content (sha256 by default)" << endl
+       << "  --verify                  verify signatures of received data" << endl
+       << "  --upload-limit <limit>    limit bandwidth used to serve other devices" << endl
+       << "  --download-limit <limit>  limit bandwidth used to fetch from other devices" << endl
+       << "  --min-fetches <count>     fetch at least <count> files in parallel ("
+       << FetchManager::DEFAULT_MIN_PARALLEL_FETCHES << " by default)" << endl
+       << "  --max-fetches <count>     fetch at most <count> files in parallel ("
+       << FetchManager::DEFAULT_MAX_PARALLEL_FETCHES << " by default)" << endl
+       << endl
+       << "Limits (rates in KiB/s, unlimited by default):" << endl
+       << "  <rate>                    for all devices together" << endl
+       << "  HH:MM-HH:MM=<rate>        for all devices together during the time of day" << endl
+       << "  *=<rate>                  for every device" << endl
+       << "  /<device>=<rate>          for the specific device" << endl
+       << endl
+       << "Commands accepted on standard input:" << endl
+       << "  pin <folder>         fetch files in <folder> first" << endl
+       << "  unpin <folder>       stop fetching files in <folder> first" << endl
+       << "  fetch <file>         fetch <file> before any other file" << endl
+       << "  fetches <min> <max>  fetch from <min> to <max> files in parallel" << endl;
+}
+
+// positive number of fetches
+static bool
+parseCount (const string &text, uint32_t &count)
+{
+  if (text.empty () || text.find_first_not_of ("0123456789") != string::npos)
+    return false;
+
+  try
+    {
+      count = lexical_cast<uint32_t> (text);
+    }
+  catch (bad_lexical_cast &)
+    {
+      return false;
+    }
+  return count > 0;
+}
+
+// dispatcher used by the command reader, which can outlive it (it may be blocked on standard input)
+struct CommandTarget
+{
+  CommandTarget (Dispatcher *dispatcher) : m_dispatcher (dispatcher) { }
+
+  boost::mutex m_mutex;
+  Dispatcher *m_dispatcher; // null once the dispatcher is about to be destroyed
+};
+
+typedef boost::shared_ptr<CommandTarget> CommandTargetPtr;
+
+// reads commands from standard input until it is closed or the dispatcher is gone
+static void
+processCommands (CommandTargetPtr target)
+{
+  string line;
+  while (getline (cin, line))
+    {
+      boost::mutex::scoped_lock lock (target->m_mutex);
+      Dispatcher *dispatcher = target->m_dispatcher;
+      if (dispatcher == 0)
+        return;
+
+      size_t space = line.find (' ');
+      string command = line.substr (0, space);
+      string argument = (space == string::npos) ? "" : line.substr (space + 1);
+
+      if (command == "pin" && !argument.empty ())
+        {
+          dispatcher->PinFolder (argument);
+        }
+      else if (command == "unpin" && !argument.empty ())
+        {
+          dispatcher->PinFolder (argument, false);
+        }
+      else if (command == "fetch" && !argument.empty ())
+        {
+          dispatcher->FetchNow (argument);
+        }
+      else if (command == "fetches")
+        {
+          istringstream counts (argument);
+          string minText, maxText, rest;
+          uint32_t minFetches, maxFetches;
+          if (counts >> minText >> maxText && !(counts >> rest) &&
+              parseCount (minText, minFetches) && parseCount (maxText, maxFetches) && minFetches <= maxFetches)
+            {
+              dispatcher->SetFileFetchConcurrency (minFetches, maxFetches);
+            }
+          else
+            {
+              cerr << "Invalid number of fetches: " << line << endl;
+            }
+        }
+      else if (!command.empty ())
+        {
+          cerr << "Unknown command: " << line << endl;
+        }
+    }
+}
+
 int main(int argc, char *argv[])
 {
   INIT_LOGGERS ();
 
   QCoreApplication app(argc, argv);
 
-  if (argc != 4)
+  vector<string> pinnedFolders;
+  bool verify = false;
+  vector<string> uploadLimits;
+  vector<string> downloadLimits;
+  uint32_t minFetches = FetchManager::DEFAULT_MIN_PARALLEL_FETCHES;
+  uint32_t maxFetches = FetchManager::DEFAULT_MAX_PARALLEL_FETCHES;
+  bool setFetches = false;
+  vector<string> args;
+  for (int i = 1; i < argc; i++)
     {
-      cerr << "Usage: ./csd <username> <shared-folder> <path>" << endl;
+      string arg = argv[i];
+      if (arg == "--pin" && i + 1 < argc)
+        {
+          pinnedFolders.push_back (argv[++i]);
+        }
+      else if (arg == "--digest" && i + 1 < argc)
+        {
+          Digest::Algorithm algorithm;
+          if (!Digest::FromName (argv[++i], algorithm))
+            {
+              usage ();
+              return 1;
+            }
+          if (!Digest::SetDefaultAlgorithm (algorithm))
+            {
+              cerr << "Digest algorithm " << argv[i] << " is not available" << endl;
+              return 1;
+            }
+        }
+      else if (arg == "--verify")
+        {
+          verify = true;
+        }
+      else if ((arg == "--upload-limit" || arg == "--download-limit") && i + 1 < argc)
+        {
+          string limit = argv[++i];
+          RateLimiter check;
+          if (!check.SetLimit (limit))
+            {
+              cerr << "Invalid limit: " << limit << endl;
+              usage ();
+              return 1;
+            }
+          (arg == "--upload-limit" ? uploadLimits : downloadLimits).push_back (limit);
+        }
+      else if ((arg == "--min-fetches" || arg == "--max-fetches") && i + 1 < argc)
+        {
+          if (!parseCount (argv[++i], arg == "--min-fetches" ? minFetches : maxFetches))
+            {
+              usage ();
+              return 1;
+            }
+          setFetches = true;
+        }
+      else if (arg.compare (0, 2, "--") == 0)
+        {
+          usage ();
+          return 1;
+        }
+      else
+        {
+          args.push_back (arg);
+        }
+    }
+
+  if (args.size () != 3 || minFetches > maxFetches)
+    {
+      usage ();
       return 1;
     }
 
-  string username = argv[1];
-  string sharedFolder = argv[2];
-  string path = argv[3];
+  string username = args[0];
+  string sharedFolder = args[1];
+  string path = args[2];
 
   cout << "Starting ChronoShare for [" << username << "] shared-folder [" << sharedFolder << "] at [" << path << "]" << endl;
 
   Dispatcher dispatcher (username, sharedFolder, path, make_shared<CcnxWrapper> ());
+  for (vector<string>::iterator folder = pinnedFolders.begin (); folder != pinnedFolders.end (); folder++)
+    {
+      dispatcher.PinFolder (*folder);
+    }
+  dispatcher.SetVerification (verify);
+  if (setFetches)
+    {
+      dispatcher.SetFileFetchConcurrency (minFetches, maxFetches);
+    }
+  for (vector<string>::iterator limit = uploadLimits.begin (); limit != uploadLimits.end (); limit++)
+    {
+      dispatcher.GetUploadRateLimiter ()->SetLimit (*limit);
+    }
+  for (vector<string>::iterator limit = downloadLimits.begin (); limit != downloadLimits.end (); limit++)
+    {
+      dispatcher.GetDownloadRateLimiter ()->SetLimit (*limit);
+    }
 
   FsWatcher watcher (path.c_str (),
                      bind (&Dispatcher::Did_LocalFile_AddOrModify, &dispatcher, _1),
-                     bind (&Dispatcher::Did_LocalFile_Delete,      &dispatcher, _1));
+                     bind (&Dispatcher::Did_LocalFile_Delete,      &dispatcher, _1),
+                     bind (&Dispatcher::Did_LocalFiles_AddOrModify, &dispatcher, _1));
+
+  // PinFolder is thread-safe and FetchNow only posts to the dispatcher's executor
+  CommandTargetPtr commandTarget = boost::make_shared<CommandTarget> (&dispatcher);
+  boost::thread commands (bind (processCommands, commandTarget));
+  commands.detach ();
+
+  int status = app.exec ();
+
+  // waits for the command being executed, the reader stops at the next one
+  {
+    boost::mutex::scoped_lock lock (commandTarget->m_mutex);
+    commandTarget->m_dispatcher = 0;
+  }
 
-  return app.exec ();
+  return status;
 }
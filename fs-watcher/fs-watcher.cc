@@ -21,48 +21,116 @@
  */
 
 #include "fs-watcher.h"
+#include "inotify-watcher.h"
 #include "db-helper.h"
+#include "db-upgrade.h"
+#include "simple-interval-generator.h"
 #include "logging.h"
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <map>
 
 #include <QDirIterator>
 #include <QRegExp>
+#include <QSocketNotifier>
 
 using namespace std;
 using namespace boost;
 
 INIT_LOGGER ("FsWatcher");
 
+// exclude working only on last component, not the full path
+static bool
+isExcludedName (const QString &name)
+{
+  QRegExp exclude ("^(\\.|\\.\\.|\\.chronoshare|.*~|.*\\.swp)$");
+  return exclude.exactMatch (name);
+}
+
+// hidden files and directories are not scanned either
+static bool
+isExcludedPath (const filesystem::path &relativePath)
+{
+  for (filesystem::path::iterator component = relativePath.begin (); component != relativePath.end (); component++)
+    {
+      string name = component->string ();
+      if (name == "/")
+        continue;
+
+      if ((!name.empty () && name[0] == '.') || isExcludedName (QString::fromStdString (name)))
+        return true;
+    }
+  return false;
+}
+
+// report scan progress every so many files
+static const size_t SCAN_PROGRESS_STEP = 10000;
+
+// file is reported when it is closed after writing or did not change for WRITE_SETTLE_TIME,
+// but not later than WRITE_MAX_DEFERRAL after the first event
+static const double WRITE_SETTLE_TIME = 1.0;
+static const double WRITE_MAX_DEFERRAL = 300.0;
+static const double SETTLE_CHECK_INTERVAL = 0.5;
+
 FsWatcher::FsWatcher (QString dirPath,
                       LocalFile_Change_Callback onChange, LocalFile_Change_Callback onDelete,
+                      LocalFiles_Change_Callback onBulkChange,
                       QObject* parent)
   : QObject(parent)
   , m_watcher (new QFileSystemWatcher())
+  , m_inotify (0)
+  , m_inotifyNotifier (0)
   , m_scheduler (new Scheduler ())
   , m_dirPath (dirPath)
   , m_onChange (onChange)
   , m_onDelete (onDelete)
+  , m_onBulkChange (onBulkChange)
+  , m_lastReportedProgress (0)
+  , m_settler (WRITE_SETTLE_TIME, WRITE_MAX_DEFERRAL)
+  , m_ignoreRules (dirPath.toStdString ())
 {
   _LOG_DEBUG ("Monitor dir: " << m_dirPath.toStdString ());
   // add main directory to monitor
 
   initFileStateDb();
 
-  m_watcher->addPath (m_dirPath);
+#ifdef HAVE_INOTIFY
+  try
+    {
+      m_inotify = new InotifyWatcher ();
+      m_inotifyNotifier = new QSocketNotifier (m_inotify->GetFd (), QSocketNotifier::Read, this);
+      connect (m_inotifyNotifier, SIGNAL (activated (int)), this, SLOT (DidInotifyEvent ()));
+    }
+  catch (Error::InotifyWatcher &error)
+    {
+      _LOG_ERROR ("inotify is not available, falling back to QFileSystemWatcher");
+      m_inotify = 0;
+    }
+#endif
 
-  // register signals (callback functions)
-  connect (m_watcher, SIGNAL (directoryChanged (QString)), this, SLOT (DidDirectoryChanged (QString)));
-  connect (m_watcher, SIGNAL (fileChanged (QString)),      this, SLOT (DidFileChanged (QString)));
+  watchPath (m_dirPath, true);
+
+  if (m_inotify == 0)
+    {
+      // register signals (callback functions)
+      connect (m_watcher, SIGNAL (directoryChanged (QString)), this, SLOT (DidDirectoryChanged (QString)));
+      connect (m_watcher, SIGNAL (fileChanged (QString)),      this, SLOT (DidFileChanged (QString)));
+    }
 
   m_scheduler->start ();
 
+  Scheduler::schedulePeriodicTask (m_scheduler,
+                                   boost::make_shared<SimpleIntervalGenerator> (SETTLE_CHECK_INTERVAL),
+                                   bind (&FsWatcher::checkSettledFiles, this), "settle-check");
+
   Scheduler::scheduleOneTimeTask (m_scheduler, 0,
-                                  bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, m_dirPath),
+                                  bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, m_dirPath, true),
                                   "rescan-r-" + m_dirPath.toStdString ()); // only one task will be scheduled per directory
 
   Scheduler::scheduleOneTimeTask (m_scheduler, 0,
-                                  bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, m_dirPath),
+                                  bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, m_dirPath, true),
                                   "rescan-" +m_dirPath.toStdString ()); // only one task will be scheduled per directory
 }
 
@@ -70,6 +138,42 @@ FsWatcher::~FsWatcher()
 {
   m_scheduler->shutdown ();
   sqlite3_close(m_db);
+
+  delete m_inotifyNotifier;
+#ifdef HAVE_INOTIFY
+  delete m_inotify;
+#endif
+}
+
+void
+FsWatcher::watchPath (const QString &absPath, bool isDirectory)
+{
+#ifdef HAVE_INOTIFY
+  if (m_inotify != 0)
+    {
+      if (isDirectory)
+        {
+          m_inotify->AddDirectory (absPath.toStdString ());
+        }
+      return;
+    }
+#endif
+
+  m_watcher->removePath (absPath);
+  m_watcher->addPath (absPath);
+}
+
+bool
+FsWatcher::isWatchedDirectory (const QString &absPath)
+{
+#ifdef HAVE_INOTIFY
+  if (m_inotify != 0)
+    {
+      return m_inotify->IsWatched (absPath.toStdString ());
+    }
+#endif
+
+  return m_watcher->directories ().contains (absPath);
 }
 
 void
@@ -81,29 +185,36 @@ FsWatcher::DidDirectoryChanged (QString dirPath)
   if (!filesystem::exists (filesystem::path (absPathTriggeredDir)))
     {
       Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
-                                      bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, dirPath),
+                                      bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, dirPath, true),
                                       "r-" + dirPath.toStdString ()); // only one task will be scheduled per directory
     }
   else
     {
-      // m_executor.execute (bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, dirPath));
+      // rule file could have changed (hidden files are not watched)
+      m_ignoreRules.Invalidate (filesystem::path (dirPath.mid (m_dirPath.size ()).toStdString ()).relative_path ());
+
+      // only entries of the changed directory itself need to be checked (and new subdirectories)
       Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
-                                      bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, dirPath),
+                                      bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, dirPath, false),
                                       dirPath.toStdString ()); // only one task will be scheduled per directory
 
-      // m_executor.execute (bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, dirPath));
+      Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
+                                      bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, dirPath, false),
+                                      "r-" + dirPath.toStdString ()); // only one task will be scheduled per directory
+
+      // in case some events were missed
       Scheduler::scheduleOneTimeTask (m_scheduler, 300,
-                                      bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, dirPath),
+                                      bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, dirPath, false),
                                       "rescan-"+dirPath.toStdString ()); // only one task will be scheduled per directory
 
       Scheduler::scheduleOneTimeTask (m_scheduler, 300,
-                                      bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, m_dirPath),
-                                      "rescan-r-" + m_dirPath.toStdString ()); // only one task will be scheduled per directory
+                                      bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, dirPath, false),
+                                      "rescan-r-" + dirPath.toStdString ()); // only one task will be scheduled per directory
     }
 }
 
 void
-FsWatcher::DidFileChanged (QString filePath)
+FsWatcher::DidFileChanged (QString filePath, bool closed/* = false*/)
 {
   if (!filePath.startsWith (m_dirPath))
     {
@@ -116,24 +227,43 @@ FsWatcher::DidFileChanged (QString filePath)
   filePath.remove (0, m_dirPath.size ());
 
   filesystem::path triggeredFile (filePath.toStdString ());
-  if (filesystem::exists (filesystem::path (absPathTriggeredFile)))
+  FileFingerprint fingerprint;
+  if (getFingerprint (absPathTriggeredFile, fingerprint))
     {
+      FileFingerprint known;
+      if (!m_settler.IsPending (triggeredFile.relative_path ()) &&
+          lookupFile (triggeredFile.relative_path (), known) && known == fingerprint)
+        {
+          // e.g., directory notification, or file was written with the same content
+          _LOG_TRACE ("File did not change: " << triggeredFile.relative_path ().generic_string ());
+          return;
+        }
+
       _LOG_DEBUG ("Triggered UPDATE of file:  " << triggeredFile.relative_path ().generic_string ());
       // m_onChange (triggeredFile.relative_path ());
 
-      m_watcher->removePath (absFilePath);
-      m_watcher->addPath (absFilePath);
+      watchPath (absFilePath, false);
 
-      Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
-                                      bind (m_onChange, triggeredFile.relative_path ()),
-                                      triggeredFile.relative_path ().string());
+      // reported (and recorded) by checkSettledFiles, when file is no longer being written
+      m_settler.Changed (triggeredFile.relative_path (), fingerprint, closed,
+                         posix_time::microsec_clock::universal_time ());
     }
   else
     {
       _LOG_DEBUG ("Triggered DELETE of file: " << triggeredFile.relative_path ().generic_string ());
       // m_onDelete (triggeredFile.relative_path ());
 
-      m_watcher->removePath (absFilePath);
+      if (m_inotify == 0)
+        {
+          m_watcher->removePath (absFilePath);
+        }
+
+      FileFingerprint known;
+      if (m_settler.Cancel (triggeredFile.relative_path ()) && !lookupFile (triggeredFile.relative_path (), known))
+        {
+          _LOG_DEBUG ("File removed before it was reported: " << triggeredFile.relative_path ().generic_string ());
+          return;
+        }
 
       deleteFile(triggeredFile.relative_path());
       Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
@@ -143,18 +273,150 @@ FsWatcher::DidFileChanged (QString filePath)
 }
 
 void
-FsWatcher::ScanDirectory_NotifyUpdates_Execute (QString dirPath)
+FsWatcher::checkSettledFiles ()
+{
+  if (m_settler.GetPendingCount () == 0)
+    return;
+
+  posix_time::ptime now = posix_time::microsec_clock::universal_time ();
+
+  // files that are not reported by close-write need to be checked if they are still growing
+  vector<filesystem::path> pending = m_settler.GetPending ();
+  for (vector<filesystem::path>::iterator file = pending.begin (); file != pending.end (); file++)
+    {
+      FileFingerprint fingerprint;
+      if (getFingerprint (filesystem::path (m_dirPath.toStdString ()) / *file, fingerprint))
+        {
+          m_settler.Observe (*file, fingerprint, now);
+        }
+      // removal is processed by DidFileChanged
+    }
+
+  WriteSettler::SettledFiles settled = m_settler.TakeSettled (now);
+  for (WriteSettler::SettledFiles::iterator file = settled.begin (); file != settled.end (); file++)
+    {
+      addFile (file->m_path, file->m_fingerprint);
+      m_onChange (file->m_path);
+    }
+
+  if (!settled.empty ())
+    {
+      WriteSettler::Counters counters = m_settler.GetCounters ();
+      _LOG_DEBUG ("Reported " << settled.size () << " settled files (events: " << counters.m_events
+                  << ", coalesced: " << counters.m_coalesced
+                  << ", settled: " << counters.m_settled
+                  << ", forced: " << counters.m_forced
+                  << ", cancelled: " << counters.m_cancelled << ")");
+    }
+}
+
+void
+FsWatcher::DidInotifyEvent ()
+{
+#ifdef HAVE_INOTIFY
+  InotifyWatcher::Events events = m_inotify->ReadEvents ();
+  for (InotifyWatcher::Events::iterator event = events.begin (); event != events.end (); event++)
+    {
+      switch (event->m_type)
+        {
+        case InotifyWatcher::Event::CHANGED:
+          notifyInotifyChange (event->m_path, event->m_isDirectory, event->m_closed);
+          break;
+
+        case InotifyWatcher::Event::REMOVED:
+          notifyInotifyRemoval (event->m_path, event->m_isDirectory);
+          break;
+
+        case InotifyWatcher::Event::MOVED:
+          // reported as removal and addition, Dispatcher pairs them back
+          notifyInotifyRemoval (event->m_oldPath, event->m_isDirectory);
+          notifyInotifyChange (event->m_path, event->m_isDirectory, event->m_closed);
+          break;
+
+        case InotifyWatcher::Event::OVERFLOW:
+          Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
+                                          bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, m_dirPath, true),
+                                          "overflow-r-" + m_dirPath.toStdString ());
+          Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
+                                          bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, m_dirPath, true),
+                                          "overflow-" + m_dirPath.toStdString ());
+          break;
+        }
+    }
+#endif
+}
+
+void
+FsWatcher::notifyInotifyChange (const filesystem::path &absPath, bool isDirectory, bool closed)
+{
+  QString absFilePath = QString::fromStdString (absPath.string ());
+  filesystem::path relativePath (absFilePath.mid (m_dirPath.size ()).toStdString ());
+  if (!isDirectory && didIgnoreRulesChange (relativePath.relative_path ()))
+    return;
+
+  if (isIgnored (relativePath.relative_path (), isDirectory))
+    return;
+
+  if (isDirectory)
+    {
+      // files could be created before the watch is added, they are found by the scan
+      watchPath (absFilePath, true);
+      Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
+                                      bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, absFilePath, true),
+                                      absFilePath.toStdString ()); // only one task will be scheduled per directory
+    }
+  else
+    {
+      DidFileChanged (absFilePath, closed);
+    }
+}
+
+void
+FsWatcher::notifyInotifyRemoval (const filesystem::path &absPath, bool isDirectory)
+{
+  QString absFilePath = QString::fromStdString (absPath.string ());
+  filesystem::path relativePath (absFilePath.mid (m_dirPath.size ()).toStdString ());
+  if (!isDirectory && didIgnoreRulesChange (relativePath.relative_path ()))
+    return;
+
+  if (isIgnored (relativePath.relative_path (), isDirectory))
+    return;
+
+  if (isDirectory)
+    {
+      Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
+                                      bind (&FsWatcher::ScanDirectory_NotifyRemovals_Execute, this, absFilePath, true),
+                                      "r-" + absFilePath.toStdString ()); // only one task will be scheduled per directory
+    }
+  else
+    {
+      DidFileChanged (absFilePath);
+    }
+}
+
+void
+FsWatcher::ScanDirectory_NotifyUpdates_Execute (QString dirPath, bool recursive)
 {
   _LOG_TRACE (" >> ScanDirectory_NotifyUpdates_Execute");
 
-  // exclude working only on last component, not the full path; iterating through all directories, even excluded from monitoring
-  QRegExp exclude ("^(\\.|\\.\\.|\\.chronoshare|.*~|.*\\.swp)$");
+  if (recursive)
+    {
+      // whole subtree (e.g., initial import), directories are walked by several threads
+      filesystem::path absRoot (dirPath.toStdString ());
+      m_lastReportedProgress = 0;
+      filesystem::path relativeRoot (dirPath.mid (m_dirPath.size ()).toStdString ());
+      m_scanner.Scan (absRoot, bind (&FsWatcher::isIgnoredScanEntry, this, relativeRoot.relative_path (), _1, _2),
+                      bind (&FsWatcher::didScanBatch, this, absRoot, _1),
+                      bind (&FsWatcher::didScanProgress, this, dirPath, _1, _2));
+      return;
+    }
 
+  // iterating through all directories, even excluded from monitoring
   QDirIterator dirIterator (dirPath,
                             QDir::Dirs | QDir::Files | /*QDir::Hidden |*/ QDir::NoSymLinks | QDir::NoDotAndDotDot,
-                            QDirIterator::Subdirectories); // directory iterator (recursive)
+                            QDirIterator::NoIteratorFlags);
 
-  // iterate through directory recursively
+  // iterate through entries of this directory only
   while (dirIterator.hasNext ())
     {
       dirIterator.next ();
@@ -165,28 +427,29 @@ FsWatcher::ScanDirectory_NotifyUpdates_Execute (QString dirPath)
       QString name = fileInfo.fileName ();
       _LOG_DEBUG ("+++ Scanning: " <<  name.toStdString ());
 
-      if (!exclude.exactMatch (name))
+      QString absFilePath = fileInfo.absoluteFilePath ();
+      filesystem::path relativePath (absFilePath.mid (m_dirPath.size ()).toStdString ());
+      if (!isExcludedName (name) && !m_ignoreRules.IsIgnoredEntry (relativePath.relative_path (), fileInfo.isDir ()))
         {
           _LOG_DEBUG ("Not excluded file/dir: " << fileInfo.absoluteFilePath ().toStdString ());
-          QString absFilePath = fileInfo.absoluteFilePath ();
 
-          // _LOG_DEBUG ("Attempt to add path to watcher: " << absFilePath.toStdString ());
-          m_watcher->removePath (absFilePath);
-          m_watcher->addPath (absFilePath);
-
-          if (fileInfo.isFile ())
+          if (fileInfo.isDir ())
             {
-              QString relFile = absFilePath;
-              relFile.remove (0, m_dirPath.size ());
-              filesystem::path aFile (relFile.toStdString ());
-
-              if (
-                  //!m_fileState->LookupFile (aFile.relative_path ().generic_string ()) /* file does not exist there, but exists locally: added */)
-                  !fileExists(aFile.relative_path())  /*file does not exist in db, but exists in fs: add */)
+              if (!isWatchedDirectory (absFilePath))
                 {
-                  addFile(aFile.relative_path());
-                  DidFileChanged (absFilePath);
+                  // new directory (e.g., moved in), its content is not known yet
+                  watchPath (absFilePath, true);
+                  ScanDirectory_NotifyUpdates_Execute (absFilePath, true);
                 }
+              else
+                {
+                  watchPath (absFilePath, true);
+                }
+            }
+          else if (fileInfo.isFile ())
+            {
+              // notifies only if fingerprint differs from the recorded one
+              DidFileChanged (absFilePath);
             }
         }
       else
@@ -197,39 +460,138 @@ FsWatcher::ScanDirectory_NotifyUpdates_Execute (QString dirPath)
 }
 
 
-void
-FsWatcher::ScanDirectory_NotifyRemovals_Execute (QString dirPath)
+bool
+FsWatcher::isIgnored (const filesystem::path &relativePath, bool isDirectory)
 {
-  _LOG_DEBUG ("Triggered DirPath: " << dirPath.toStdString ());
+  return isExcludedPath (relativePath) || m_ignoreRules.IsIgnored (relativePath, isDirectory);
+}
 
-  filesystem::path absPathTriggeredDir (dirPath.toStdString ());
-  dirPath.remove (0, m_dirPath.size ());
+bool
+FsWatcher::isIgnoredScanEntry (const filesystem::path &relativeRoot, const filesystem::path &path, bool isDirectory)
+{
+  // hidden entries are not listed by the scan (same as QDirIterator without QDir::Hidden)
+  string name = path.filename ().string ();
+  if ((!name.empty () && name[0] == '.') || isExcludedName (QString::fromStdString (name)))
+    return true;
 
-  filesystem::path triggeredDir (dirPath.toStdString ());
+  // parent directories were checked before the scan descended into them
+  return m_ignoreRules.IsIgnoredEntry (relativeRoot / path, isDirectory);
+}
+
+bool
+FsWatcher::didIgnoreRulesChange (const filesystem::path &relativePath)
+{
+  if (relativePath.filename ().string () != IgnoreRules::FILE_NAME)
+    return false;
 
-  /*
-  FileItemsPtr files = m_fileState->LookupFilesInFolderRecursively (triggeredDir.relative_path ().generic_string ());
-  for (std::list<FileItem>::iterator file = files->begin (); file != files->end (); file ++)
+  filesystem::path dir = relativePath.parent_path ();
+  _LOG_DEBUG ("Ignore rules changed in [" << dir << "]");
+  m_ignoreRules.Invalidate (dir);
+
+  if (!isIgnored (dir, true))
     {
-      filesystem::path testFile = filesystem::path (m_dirPath.toStdString ()) / file->filename ();
-      _LOG_DEBUG ("Check file for deletion [" << testFile.generic_string () << "]");
+      // entries that are no longer excluded need to be found (and watched)
+      QString absDirPath = QString::fromStdString ((filesystem::path (m_dirPath.toStdString ()) / dir).string ());
+      Scheduler::scheduleOneTimeTask (m_scheduler, 0.5,
+                                      bind (&FsWatcher::ScanDirectory_NotifyUpdates_Execute, this, absDirPath, true),
+                                      "ignore-" + absDirPath.toStdString ());
+    }
+  return true;
+}
 
-      if (!filesystem::exists (testFile))
+void
+FsWatcher::didScanBatch (const filesystem::path &absRoot, const ParallelScanner::Entries &entries)
+{
+  vector<filesystem::path> changed;
+
+  sqlite3_exec (m_db, "BEGIN TRANSACTION;", 0,0,0);
+  for (ParallelScanner::Entries::const_iterator entry = entries.begin (); entry != entries.end (); entry++)
+    {
+      filesystem::path absPath = absRoot / entry->m_path;
+      QString absFilePath = QString::fromStdString (absPath.string ());
+      watchPath (absFilePath, entry->m_isDirectory);
+
+      if (entry->m_isDirectory)
+        continue;
+
+      filesystem::path relativePath (absFilePath.mid (m_dirPath.size ()).toStdString ());
+      relativePath = relativePath.relative_path ();
+
+      FileFingerprint known;
+      if (lookupFile (relativePath, known) && known == entry->m_fingerprint)
+        continue;
+
+      addFile (relativePath, entry->m_fingerprint);
+      changed.push_back (relativePath);
+    }
+  sqlite3_exec (m_db, "END TRANSACTION;", 0,0,0);
+
+  if (changed.empty ())
+    return;
+
+  _LOG_DEBUG ("Scan found " << changed.size () << " new or changed files");
+  if (!m_onBulkChange.empty ())
+    {
+      m_onBulkChange (changed);
+    }
+  else
+    {
+      for (vector<filesystem::path>::iterator file = changed.begin (); file != changed.end (); file++)
         {
-          if (removeIncomplete || file->is_complete ())
-            {
-              _LOG_DEBUG ("Notifying about removed file [" << file->filename () << "]");
-              m_onDelete (file->filename ());
-            }
+          m_onChange (*file);
         }
     }
-    */
+}
+
+void
+FsWatcher::didScanProgress (const QString &dirPath, size_t directories, size_t files)
+{
+  if (files >= m_lastReportedProgress + SCAN_PROGRESS_STEP)
+    {
+      m_lastReportedProgress = files;
+      _LOG_DEBUG ("Scanning [" << dirPath.toStdString () << "]: " << directories << " directories, "
+                  << files << " files so far");
+    }
+}
+
+void
+FsWatcher::ScanDirectory_NotifyRemovals_Execute (QString dirPath, bool recursive)
+{
+  _LOG_DEBUG ("Triggered DirPath: " << dirPath.toStdString ());
+
+  filesystem::path absPathTriggeredDir (dirPath.toStdString ());
+  dirPath.remove (0, m_dirPath.size ());
+
+  filesystem::path triggeredDir (dirPath.toStdString ());
+  filesystem::path relativeDir = triggeredDir.relative_path ();
+
+  // subdirectories are checked once, not once for each file inside them
+  map<string, bool> subdirExists;
 
   vector<string> files;
-  getFilesInDir(triggeredDir.relative_path(), files);
+  getFilesInDir(relativeDir, files);
   for (vector<string>::iterator file = files.begin(); file != files.end(); file++)
   {
     filesystem::path targetFile = filesystem::path (m_dirPath.toStdString()) / *file;
+
+    if (!recursive)
+      {
+        string rest = file->substr (relativeDir.empty () ? 0 : relativeDir.string ().size () + 1);
+        size_t slash = rest.find ('/');
+        if (slash != string::npos)
+          {
+            // nested files are checked by the scan of their own directory, unless whole subdirectory is gone
+            string subdir = rest.substr (0, slash);
+            map<string, bool>::iterator known = subdirExists.find (subdir);
+            if (known == subdirExists.end ())
+              {
+                known = subdirExists.insert (make_pair (subdir, filesystem::is_directory (absPathTriggeredDir / subdir))).first;
+              }
+            if (known->second)
+              continue;
+          }
+      }
+
     if (!filesystem::exists (targetFile))
     {
       deleteFile(*file);
@@ -242,11 +604,22 @@ const string INIT_DATABASE = "\
 CREATE TABLE IF NOT EXISTS                                      \n\
     Files(                                                      \n\
     filename      TEXT NOT NULL,                                \n\
+    size          INTEGER,                                      \n\
+    mtime_ns      INTEGER,                                      \n\
+    inode         INTEGER,                                      \n\
+    ctime_ns      INTEGER,                                      \n\
     PRIMARY KEY (filename)                                      \n\
 );                                                              \n\
 CREATE INDEX filename_index ON Files (filename);                \n\
 ";
 
+static const ColumnUpgrade UPGRADE_COLUMNS[] = {
+  { "Files", "size", "INTEGER" },
+  { "Files", "mtime_ns", "INTEGER" },
+  { "Files", "inode", "INTEGER" },
+  { "Files", "ctime_ns", "INTEGER" },
+};
+
 void
 FsWatcher::initFileStateDb()
 {
@@ -267,17 +640,37 @@ FsWatcher::initFileStateDb()
       cout << "FS-Watcher DB error: " << errmsg << endl;
       sqlite3_free (errmsg);
   }
+
+  if (!AddMissingColumns (m_db, UPGRADE_COLUMNS))
+    {
+      _LOG_ERROR ("Cannot upgrade fs_watcher database: " << sqlite3_errmsg (m_db));
+    }
+}
+
+bool
+FsWatcher::getFingerprint (const filesystem::path &absPath, FileFingerprint &fingerprint)
+{
+  struct stat info;
+  if (::stat (absPath.c_str (), &info) != 0 || !S_ISREG (info.st_mode))
+    return false;
+
+  fingerprint = FileFingerprint (info);
+  return true;
 }
 
 bool
-FsWatcher::fileExists(const filesystem::path &filename)
+FsWatcher::lookupFile (const filesystem::path &filename, FileFingerprint &fingerprint)
 {
   sqlite3_stmt *stmt;
-  sqlite3_prepare_v2(m_db, "SELECT * FROM Files WHERE filename = ?;", -1, &stmt, 0);
+  sqlite3_prepare_v2(m_db, "SELECT size, mtime_ns, inode, ctime_ns FROM Files WHERE filename = ?;", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
   bool retval = false;
   if (sqlite3_step (stmt) == SQLITE_ROW)
   {
+    fingerprint.m_size = sqlite3_column_int64 (stmt, 0);
+    fingerprint.m_mtimeNs = sqlite3_column_int64 (stmt, 1);
+    fingerprint.m_inode = sqlite3_column_int64 (stmt, 2);
+    fingerprint.m_ctimeNs = sqlite3_column_int64 (stmt, 3);
     retval = true;
   }
   sqlite3_finalize(stmt);
@@ -286,11 +679,15 @@ FsWatcher::fileExists(const filesystem::path &filename)
 }
 
 void
-FsWatcher::addFile(const filesystem::path &filename)
+FsWatcher::addFile (const filesystem::path &filename, const FileFingerprint &fingerprint)
 {
   sqlite3_stmt *stmt;
-  sqlite3_prepare_v2(m_db, "INSERT OR IGNORE INTO Files (filename) VALUES (?);", -1, &stmt, 0);
+  sqlite3_prepare_v2(m_db, "INSERT OR REPLACE INTO Files (filename, size, mtime_ns, inode, ctime_ns) VALUES (?, ?, ?, ?, ?);", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, fingerprint.m_size);
+  sqlite3_bind_int64(stmt, 3, fingerprint.m_mtimeNs);
+  sqlite3_bind_int64(stmt, 4, fingerprint.m_inode);
+  sqlite3_bind_int64(stmt, 5, fingerprint.m_ctimeNs);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 }
@@ -320,7 +717,9 @@ FsWatcher::getFilesInDir(const filesystem::path &dir, vector<string> &files)
       else
         escapedDir << *ch;
     }
-  escapedDir << "/" << "%";
+  if (!dirStr.empty ())
+    escapedDir << "/";
+  escapedDir << "%";
   string escapedDirStr = escapedDir.str ();
   sqlite3_bind_text (stmt, 1, escapedDirStr.c_str (), escapedDirStr.size (), SQLITE_STATIC);
 
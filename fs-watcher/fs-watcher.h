@@ -28,17 +28,37 @@
 #include <sqlite3.h>
 
 #include "scheduler.h"
+#include "parallel-scanner.h"
+#include "write-settler.h"
+#include "ignore-rules.h"
 
+class InotifyWatcher;
+class QSocketNotifier;
+
+/**
+ * @brief Watches the shared folder and reports added/changed and removed files
+ *
+ * On Linux inotify is used directly (one watch per directory, precise per-file events).
+ * Elsewhere, or if inotify cannot be initialized, QFileSystemWatcher is used, which needs
+ * one watch per file and rescans the whole directory on every change.
+ */
 class FsWatcher : public QObject
 {
   Q_OBJECT
 
 public:
   typedef boost::function<void (const boost::filesystem::path &)> LocalFile_Change_Callback;
+  typedef boost::function<void (const std::vector<boost::filesystem::path> &)> LocalFiles_Change_Callback;
 
-  // constructor
+  /**
+   * @brief Constructor
+   *
+   * If onBulkChange is set, files found by the full scans (on start, or if events were lost)
+   * are reported through it in batches, instead of calling onChange for every file
+   */
   FsWatcher (QString dirPath,
              LocalFile_Change_Callback onChange, LocalFile_Change_Callback onDelete,
+             LocalFiles_Change_Callback onBulkChange = LocalFiles_Change_Callback (),
              QObject* parent = 0);
 
   // destructor
@@ -52,27 +72,76 @@ private slots:
   /**
    * @brief This even will be triggered either by actual file change or via directory change event
    * (i.e., can happen twice in a row, as well as trigger false alarm)
+   *
+   * Changes are not reported right away, but only after the file has settled (see WriteSettler)
+   * @param closed the file is known to be completely written (e.g., close-write from inotify)
    */
   void
-  DidFileChanged (QString filePath);
+  DidFileChanged (QString filePath, bool closed = false);
+
+  /**
+   * @brief inotify descriptor is readable (Linux backend only)
+   */
+  void
+  DidInotifyEvent ();
 
 private:
   // handle callback from the watcher
   // scan directory and notify callback about any file changes
+  // (if not recursive, only direct entries and not yet watched subdirectories are scanned)
+  void
+  ScanDirectory_NotifyUpdates_Execute (QString dirPath, bool recursive);
+
   void
-  ScanDirectory_NotifyUpdates_Execute (QString dirPath);
+  ScanDirectory_NotifyRemovals_Execute (QString dirPath, bool recursive);
+
+  // process the files/directories found by the parallel (recursive) scan
+  void
+  didScanBatch (const boost::filesystem::path &absRoot, const ParallelScanner::Entries &entries);
+
+  void
+  didScanProgress (const QString &dirPath, size_t directories, size_t files);
+
+  /**
+   * @brief Check built-in exclusions and user rules (.chronoshareignore) for the path and its parents
+   */
+  bool
+  isIgnored (const boost::filesystem::path &relativePath, bool isDirectory);
+
+  // exclusion check for the parallel scan, path is relative to relativeRoot
+  bool
+  isIgnoredScanEntry (const boost::filesystem::path &relativeRoot, const boost::filesystem::path &path, bool isDirectory);
 
+  /**
+   * @brief If the path is a rule file, reload the rules and rescan its directory
+   * @returns true if the path is a rule file
+   */
+  bool
+  didIgnoreRulesChange (const boost::filesystem::path &relativePath);
+
+  // periodically report files that are no longer being written
   void
-  ScanDirectory_NotifyRemovals_Execute (QString dirPath);
+  checkSettledFiles ();
 
   void
   initFileStateDb();
 
+  /**
+   * @brief Get fingerprint of the file from the filesystem
+   * @returns false if file does not exist (or is not a regular file)
+   */
+  static bool
+  getFingerprint (const boost::filesystem::path &absPath, FileFingerprint &fingerprint);
+
+  /**
+   * @brief Get recorded fingerprint of the file
+   * @returns false if file is not known
+   */
   bool
-  fileExists(const boost::filesystem::path &filename);
+  lookupFile (const boost::filesystem::path &filename, FileFingerprint &fingerprint);
 
   void
-  addFile(const boost::filesystem::path &filename);
+  addFile (const boost::filesystem::path &filename, const FileFingerprint &fingerprint);
 
   void
   deleteFile(const boost::filesystem::path &filename);
@@ -80,14 +149,38 @@ private:
   void
   getFilesInDir(const boost::filesystem::path &dir, std::vector<std::string> &files);
 
+  /**
+   * @brief Start watching the path (with inotify, only directories are watched)
+   */
+  void
+  watchPath (const QString &absPath, bool isDirectory);
+
+  bool
+  isWatchedDirectory (const QString &absPath);
+
+  void
+  notifyInotifyChange (const boost::filesystem::path &absPath, bool isDirectory, bool closed);
+
+  void
+  notifyInotifyRemoval (const boost::filesystem::path &absPath, bool isDirectory);
+
 private:
   QFileSystemWatcher* m_watcher; // filesystem watcher
+  InotifyWatcher* m_inotify; // used instead of m_watcher when available
+  QSocketNotifier* m_inotifyNotifier;
   SchedulerPtr m_scheduler;
 
   QString m_dirPath; // monitored path
 
   LocalFile_Change_Callback m_onChange;
   LocalFile_Change_Callback m_onDelete;
+  LocalFiles_Change_Callback m_onBulkChange;
+
+  ParallelScanner m_scanner;
+  size_t m_lastReportedProgress;
+
+  WriteSettler m_settler;
+  IgnoreRules m_ignoreRules;
 
   sqlite3 *m_db;
 };
@@ -0,0 +1,289 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "ignore-rules.h"
+#include "logging.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <fnmatch.h>
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+INIT_LOGGER ("IgnoreRules");
+
+const char *IgnoreRules::FILE_NAME = ".chronoshareignore";
+
+static vector<string>
+splitPath (const fs::path &path)
+{
+  vector<string> components;
+  for (fs::path::iterator component = path.begin (); component != path.end (); component++)
+    {
+      string name = component->string ();
+      if (name.empty () || name == "/" || name == ".")
+        continue;
+      components.push_back (name);
+    }
+  return components;
+}
+
+static bool
+hasWildcards (const string &pattern)
+{
+  return pattern.find_first_of ("*?[\\") != string::npos;
+}
+
+void
+IgnoreRules::RuleSet::Add (const string &line)
+{
+  string pattern = line;
+
+  // trailing spaces are ignored (unless escaped, which is not supported)
+  size_t end = pattern.find_last_not_of (" \t\r");
+  pattern = (end == string::npos) ? "" : pattern.substr (0, end + 1);
+  if (pattern.empty () || pattern[0] == '#')
+    return;
+
+  Rule rule;
+  rule.m_negated = false;
+  rule.m_directoryOnly = false;
+  rule.m_anchored = false;
+
+  if (pattern[0] == '!')
+    {
+      rule.m_negated = true;
+      pattern = pattern.substr (1);
+    }
+  else if (pattern[0] == '\\')
+    {
+      pattern = pattern.substr (1); // escaped # or !
+    }
+
+  if (!pattern.empty () && pattern[pattern.size () - 1] == '/')
+    {
+      rule.m_directoryOnly = true;
+      pattern.erase (pattern.size () - 1);
+    }
+
+  if (pattern.find ('/') != string::npos)
+    {
+      rule.m_anchored = true;
+    }
+
+  split (rule.m_components, pattern, is_any_of ("/"), token_compress_on);
+  rule.m_components.erase (remove (rule.m_components.begin (), rule.m_components.end (), string ()), rule.m_components.end ());
+  if (rule.m_components.empty ())
+    return;
+
+  size_t index = m_rules.size ();
+  m_rules.push_back (rule);
+
+  if (rule.m_negated)
+    {
+      m_hasNegation = true;
+    }
+  else if (!rule.m_anchored && !hasWildcards (pattern))
+    {
+      (rule.m_directoryOnly ? m_directoryNames : m_names).insert (pattern);
+    }
+  else if (!rule.m_anchored && !rule.m_directoryOnly &&
+           pattern.size () > 1 && pattern[0] == '*' && pattern[1] == '.' && !hasWildcards (pattern.substr (1)))
+    {
+      // Match looks up only the suffixes that start at a dot ("*~" or "*rc" go to other rules)
+      m_extensions.insert (pattern.substr (1));
+    }
+  else
+    {
+      m_otherRules.push_back (index);
+    }
+}
+
+bool
+IgnoreRules::RuleSet::matchComponents (vector<string>::const_iterator pattern, vector<string>::const_iterator patternEnd,
+                                       vector<string>::const_iterator path, vector<string>::const_iterator pathEnd)
+{
+  for (; pattern != patternEnd; pattern++, path++)
+    {
+      if (*pattern == "**")
+        {
+          // any number of components (including none)
+          for (vector<string>::const_iterator rest = path; ; rest++)
+            {
+              if (matchComponents (pattern + 1, patternEnd, rest, pathEnd))
+                return true;
+              if (rest == pathEnd)
+                return false;
+            }
+        }
+
+      if (path == pathEnd || fnmatch (pattern->c_str (), path->c_str (), 0) != 0)
+        return false;
+    }
+  return path == pathEnd;
+}
+
+bool
+IgnoreRules::RuleSet::matches (const Rule &rule, const vector<string> &components, bool isDirectory)
+{
+  if (rule.m_directoryOnly && !isDirectory)
+    return false;
+
+  if (rule.m_anchored)
+    return matchComponents (rule.m_components.begin (), rule.m_components.end (), components.begin (), components.end ());
+  else
+    return fnmatch (rule.m_components[0].c_str (), components.back ().c_str (), 0) == 0;
+}
+
+IgnoreRules::RuleSet::Result
+IgnoreRules::RuleSet::Match (const fs::path &path, bool isDirectory) const
+{
+  vector<string> components = splitPath (path);
+  if (components.empty ())
+    return NO_MATCH;
+
+  if (!m_hasNegation)
+    {
+      const string &name = components.back ();
+      if (m_names.find (name) != m_names.end () ||
+          (isDirectory && m_directoryNames.find (name) != m_directoryNames.end ()))
+        return IGNORE;
+
+      size_t dot = name.find ('.');
+      while (dot != string::npos)
+        {
+          // "*.tar.gz" should match "a.b.tar.gz"
+          if (m_extensions.find (name.substr (dot)) != m_extensions.end ())
+            return IGNORE;
+          dot = name.find ('.', dot + 1);
+        }
+
+      for (vector<size_t>::const_iterator index = m_otherRules.begin (); index != m_otherRules.end (); index++)
+        {
+          if (matches (m_rules[*index], components, isDirectory))
+            return IGNORE;
+        }
+      return NO_MATCH;
+    }
+
+  // the last matching rule decides
+  for (vector<Rule>::const_reverse_iterator rule = m_rules.rbegin (); rule != m_rules.rend (); rule++)
+    {
+      if (matches (*rule, components, isDirectory))
+        return rule->m_negated ? INCLUDE : IGNORE;
+    }
+  return NO_MATCH;
+}
+
+IgnoreRules::IgnoreRules (const fs::path &root)
+  : m_root (root)
+{
+}
+
+IgnoreRules::RuleSetPtr
+IgnoreRules::getRules (const fs::path &dir)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  map<fs::path, RuleSetPtr>::iterator cached = m_rules.find (dir);
+  if (cached != m_rules.end ())
+    return cached->second;
+
+  RuleSetPtr rules;
+  fs::path ruleFile = m_root / dir / FILE_NAME;
+  if (fs::is_regular_file (ruleFile))
+    {
+      rules = boost::make_shared<RuleSet> ();
+      fs::ifstream in (ruleFile);
+      string line;
+      while (getline (in, line))
+        {
+          rules->Add (line);
+        }
+      _LOG_DEBUG ("Loaded ignore rules from [" << ruleFile << "]");
+
+      if (rules->IsEmpty ())
+        rules.reset ();
+    }
+
+  m_rules [dir] = rules;
+  return rules;
+}
+
+bool
+IgnoreRules::isIgnoredEntry (const vector<string> &components, size_t count, bool isDirectory)
+{
+  // rules of all directories above the entry, starting from the root; deeper ones take precedence
+  bool ignored = false;
+  fs::path dir;
+  for (size_t level = 0; level < count; level++)
+    {
+      RuleSetPtr rules = getRules (dir);
+      if (rules)
+        {
+          fs::path relative;
+          for (size_t i = level; i < count; i++)
+            {
+              relative /= components[i];
+            }
+
+          RuleSet::Result result = rules->Match (relative, isDirectory);
+          if (result != RuleSet::NO_MATCH)
+            {
+              ignored = (result == RuleSet::IGNORE);
+            }
+        }
+
+      dir /= components[level];
+    }
+  return ignored;
+}
+
+bool
+IgnoreRules::IsIgnoredEntry (const fs::path &path, bool isDirectory)
+{
+  vector<string> components = splitPath (path);
+  return !components.empty () && isIgnoredEntry (components, components.size (), isDirectory);
+}
+
+bool
+IgnoreRules::IsIgnored (const fs::path &path, bool isDirectory)
+{
+  vector<string> components = splitPath (path);
+  for (size_t count = 1; count <= components.size (); count++)
+    {
+      if (isIgnoredEntry (components, count, count < components.size () || isDirectory))
+        return true;
+    }
+  return false;
+}
+
+void
+IgnoreRules::Invalidate (const fs::path &dir)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_rules.erase (dir);
+}
@@ -0,0 +1,143 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+#ifndef IGNORE_RULES_H
+#define IGNORE_RULES_H
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief User-defined exclusions, read from .chronoshareignore files (gitignore syntax)
+ *
+ * Each directory of the shared folder can have a rule file, whose rules apply to everything
+ * below that directory.  Supported syntax: comments (#), negation (!), directory-only rules
+ * (trailing /), rules anchored to the directory of the rule file (containing / other than
+ * trailing), wildcards *, ? and [...] within a path component, and ** for any number of
+ * components.  Later rules override earlier ones, and rules of deeper directories override
+ * rules of their parents.  As in git, a file cannot be re-included if its parent directory
+ * is excluded.
+ *
+ * Rule files are read on first use and cached until Invalidate () is called for the directory.
+ * Methods can be called from several threads.
+ */
+class IgnoreRules
+{
+public:
+  static const char *FILE_NAME; // .chronoshareignore
+
+  /**
+   * @brief Rules of one rule file, compiled for matching
+   */
+  class RuleSet
+  {
+  public:
+    enum Result
+      {
+        NO_MATCH,
+        IGNORE,
+        INCLUDE
+      };
+
+    RuleSet () : m_hasNegation (false) { }
+
+    void
+    Add (const std::string &line);
+
+    /**
+     * @param path path relative to the directory of the rule file
+     */
+    Result
+    Match (const boost::filesystem::path &path, bool isDirectory) const;
+
+    bool
+    IsEmpty () const { return m_rules.empty (); }
+
+  private:
+    struct Rule
+    {
+      std::vector<std::string> m_components; // pattern split by /
+      bool m_negated;
+      bool m_directoryOnly;
+      bool m_anchored;                       // matched against the whole path, not the name only
+    };
+
+    static bool
+    matchComponents (std::vector<std::string>::const_iterator pattern, std::vector<std::string>::const_iterator patternEnd,
+                     std::vector<std::string>::const_iterator path, std::vector<std::string>::const_iterator pathEnd);
+
+    static bool
+    matches (const Rule &rule, const std::vector<std::string> &components, bool isDirectory);
+
+  private:
+    std::vector<Rule> m_rules;
+
+    // without negations, names and extensions are looked up directly instead of trying every rule
+    bool m_hasNegation;
+    std::set<std::string> m_names;          // "name" rules
+    std::set<std::string> m_directoryNames; // "name/" rules
+    std::set<std::string> m_extensions;     // "*.ext" rules (with the dot)
+    std::vector<size_t> m_otherRules;
+  };
+  typedef boost::shared_ptr<RuleSet> RuleSetPtr;
+
+  IgnoreRules (const boost::filesystem::path &root);
+
+  /**
+   * @brief Check if the path or any of its parent directories is excluded
+   * @param path path relative to the root
+   */
+  bool
+  IsIgnored (const boost::filesystem::path &path, bool isDirectory);
+
+  /**
+   * @brief Same as IsIgnored, but parent directories are assumed to be not excluded
+   * (e.g., during traversal, which does not descend into excluded directories)
+   */
+  bool
+  IsIgnoredEntry (const boost::filesystem::path &path, bool isDirectory);
+
+  /**
+   * @brief Forget cached rules of the directory (the rule file has changed)
+   */
+  void
+  Invalidate (const boost::filesystem::path &dir);
+
+private:
+  RuleSetPtr
+  getRules (const boost::filesystem::path &dir);
+
+  bool
+  isIgnoredEntry (const std::vector<std::string> &components, size_t count, bool isDirectory);
+
+private:
+  boost::filesystem::path m_root;
+
+  boost::mutex m_mutex;
+  std::map<boost::filesystem::path, RuleSetPtr> m_rules; // directory -> rules (0 if there is no rule file)
+};
+
+#endif // IGNORE_RULES_H
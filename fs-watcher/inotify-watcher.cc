@@ -0,0 +1,263 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "inotify-watcher.h"
+#include "db-helper.h"
+#include "logging.h"
+
+#ifdef HAVE_INOTIFY
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+INIT_LOGGER ("InotifyWatcher");
+
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB |
+                                   IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+static bool
+isInside (const fs::path &path, const fs::path &dir)
+{
+  const string &pathStr = path.string ();
+  const string &dirStr = dir.string ();
+  return pathStr == dirStr ||
+    (pathStr.size () > dirStr.size () && pathStr.compare (0, dirStr.size (), dirStr) == 0 && pathStr[dirStr.size ()] == '/');
+}
+
+InotifyWatcher::InotifyWatcher ()
+{
+  m_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0)
+    {
+      BOOST_THROW_EXCEPTION (Error::InotifyWatcher () << errmsg_info_str (string ("Cannot initialize inotify: ") + strerror (errno)));
+    }
+}
+
+InotifyWatcher::~InotifyWatcher ()
+{
+  close (m_fd);
+}
+
+bool
+InotifyWatcher::AddDirectory (const fs::path &dir)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  if (m_watches.find (dir) != m_watches.end ())
+    return true;
+
+  int wd = inotify_add_watch (m_fd, dir.c_str (), WATCH_MASK);
+  if (wd < 0)
+    {
+      _LOG_ERROR ("Cannot watch [" << dir << "]: " << strerror (errno)
+                  << (errno == ENOSPC ? " (increase fs.inotify.max_user_watches)" : ""));
+      return false;
+    }
+
+  // the same directory could be known under another name (e.g., renamed while the event was in flight)
+  std::map<int, fs::path>::iterator known = m_dirs.find (wd);
+  if (known != m_dirs.end ())
+    {
+      m_watches.erase (known->second);
+    }
+
+  m_dirs [wd] = dir;
+  m_watches [dir] = wd;
+  return true;
+}
+
+void
+InotifyWatcher::RemoveDirectory (const fs::path &dir)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  for (std::map<fs::path, int>::iterator watch = m_watches.begin (); watch != m_watches.end (); )
+    {
+      if (isInside (watch->first, dir))
+        {
+          inotify_rm_watch (m_fd, watch->second);
+          m_dirs.erase (watch->second);
+          m_watches.erase (watch++);
+        }
+      else
+        {
+          watch++;
+        }
+    }
+}
+
+bool
+InotifyWatcher::IsWatched (const fs::path &dir)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_watches.find (dir) != m_watches.end ();
+}
+
+size_t
+InotifyWatcher::GetWatchCount ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_watches.size ();
+}
+
+void
+InotifyWatcher::forget (int wd)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  std::map<int, fs::path>::iterator dir = m_dirs.find (wd);
+  if (dir != m_dirs.end ())
+    {
+      m_watches.erase (dir->second);
+      m_dirs.erase (dir);
+    }
+}
+
+InotifyWatcher::Events
+InotifyWatcher::ReadEvents ()
+{
+  Events events;
+  std::map<uint32_t, size_t> movedFrom; // cookie -> index of the event
+
+  char buf [64 * 1024] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  while (true)
+    {
+      ssize_t len = read (m_fd, buf, sizeof (buf));
+      if (len < 0 && errno == EINTR)
+        continue;
+      if (len <= 0)
+        break; // EAGAIN, nothing else to read
+
+      for (char *ptr = buf; ptr < buf + len; )
+        {
+          const struct inotify_event *event = reinterpret_cast<const struct inotify_event *> (ptr);
+          ptr += sizeof (struct inotify_event) + event->len;
+
+          if (event->mask & IN_Q_OVERFLOW)
+            {
+              _LOG_ERROR ("inotify queue overflow, events are lost");
+              Event overflow;
+              overflow.m_type = Event::OVERFLOW;
+              overflow.m_isDirectory = true;
+              overflow.m_closed = false;
+              events.push_back (overflow);
+              continue;
+            }
+
+          if (event->mask & IN_IGNORED)
+            {
+              // directory is gone or the watch was removed
+              forget (event->wd);
+              continue;
+            }
+
+          if (event->len == 0)
+            continue; // event about the watched directory itself, parent directory reports it too
+
+          fs::path dir;
+          {
+            boost::mutex::scoped_lock lock (m_mutex);
+            std::map<int, fs::path>::iterator watched = m_dirs.find (event->wd);
+            if (watched == m_dirs.end ())
+              continue;
+            dir = watched->second;
+          }
+
+          Event item;
+          item.m_isDirectory = (event->mask & IN_ISDIR) != 0;
+          item.m_closed = (event->mask & (IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO)) != 0;
+          item.m_path = dir / event->name;
+
+          if (event->mask & IN_MOVED_FROM)
+            {
+              item.m_type = Event::REMOVED; // unless the other half is found
+              movedFrom [event->cookie] = events.size ();
+              events.push_back (item);
+            }
+          else if (event->mask & IN_MOVED_TO)
+            {
+              std::map<uint32_t, size_t>::iterator from = movedFrom.find (event->cookie);
+              if (from == movedFrom.end ())
+                {
+                  item.m_type = Event::CHANGED; // moved in from outside of the watched tree
+                  events.push_back (item);
+                  continue;
+                }
+
+              Event &moved = events [from->second];
+              moved.m_type = Event::MOVED;
+              moved.m_oldPath = moved.m_path;
+              moved.m_path = item.m_path;
+              movedFrom.erase (from);
+
+              if (moved.m_isDirectory)
+                {
+                  // watches follow the directories, only names need to be updated
+                  boost::mutex::scoped_lock lock (m_mutex);
+                  std::map<fs::path, int> renamed;
+                  for (std::map<fs::path, int>::iterator watch = m_watches.begin (); watch != m_watches.end (); )
+                    {
+                      if (isInside (watch->first, moved.m_oldPath))
+                        {
+                          fs::path newPath = moved.m_path.string () + watch->first.string ().substr (moved.m_oldPath.string ().size ());
+                          renamed [newPath] = watch->second;
+                          m_dirs [watch->second] = newPath;
+                          m_watches.erase (watch++);
+                        }
+                      else
+                        {
+                          watch++;
+                        }
+                    }
+                  m_watches.insert (renamed.begin (), renamed.end ());
+                }
+            }
+          else if (event->mask & IN_DELETE)
+            {
+              item.m_type = Event::REMOVED;
+              events.push_back (item);
+            }
+          else if (event->mask & (IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB))
+            {
+              item.m_type = Event::CHANGED;
+              events.push_back (item);
+            }
+        }
+    }
+
+  // directories moved out of the tree are still watched under the old names
+  for (std::map<uint32_t, size_t>::iterator from = movedFrom.begin (); from != movedFrom.end (); from++)
+    {
+      if (events [from->second].m_isDirectory)
+        {
+          RemoveDirectory (events [from->second].m_path);
+        }
+    }
+
+  return events;
+}
+
+#endif // HAVE_INOTIFY
@@ -0,0 +1,110 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+#ifndef INOTIFY_WATCHER_H
+#define INOTIFY_WATCHER_H
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Thin wrapper around Linux inotify
+ *
+ * Only directories are watched (one watch per directory, not recursive), events about files are
+ * reported for their parent directory.  Rename within the watched tree is reported as a single
+ * MOVED event when both halves (matched by the inotify cookie) are read together; otherwise it
+ * looks like a removal or a creation.
+ *
+ * The user should poll GetFd () for reading and call ReadEvents when it is readable.
+ */
+class InotifyWatcher
+{
+public:
+  struct Event
+  {
+    enum Type
+      {
+        CHANGED,  ///< file was written and closed, created, or its attributes changed
+        REMOVED,  ///< file or directory removed (or moved outside of the watched tree)
+        MOVED,    ///< file or directory renamed from m_oldPath to m_path
+        OVERFLOW  ///< events were lost, everything needs to be rescanned
+      };
+
+    Type m_type;
+    bool m_isDirectory;
+    bool m_closed;                     ///< file is complete (closed after writing, or moved)
+    boost::filesystem::path m_path;    ///< absolute path
+    boost::filesystem::path m_oldPath; ///< absolute path before rename (for MOVED only)
+  };
+  typedef std::vector<Event> Events;
+
+  InotifyWatcher ();
+  ~InotifyWatcher ();
+
+  int
+  GetFd () const { return m_fd; }
+
+  /**
+   * @brief Start watching the directory (does nothing if already watched)
+   * @returns false if the watch cannot be added (e.g., max_user_watches limit is reached)
+   */
+  bool
+  AddDirectory (const boost::filesystem::path &dir);
+
+  /**
+   * @brief Stop watching the directory and all watched directories inside it
+   */
+  void
+  RemoveDirectory (const boost::filesystem::path &dir);
+
+  bool
+  IsWatched (const boost::filesystem::path &dir);
+
+  size_t
+  GetWatchCount ();
+
+  /**
+   * @brief Read all events available without blocking
+   */
+  Events
+  ReadEvents ();
+
+private:
+  void
+  forget (int wd);
+
+private:
+  int m_fd;
+
+  boost::mutex m_mutex;
+  std::map<int, boost::filesystem::path> m_dirs; // watch descriptor -> directory
+  std::map<boost::filesystem::path, int> m_watches;
+};
+
+namespace Error {
+struct InotifyWatcher : virtual boost::exception, virtual std::exception { };
+}
+
+#endif // INOTIFY_WATCHER_H
@@ -0,0 +1,252 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "parallel-scanner.h"
+#include "logging.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+INIT_LOGGER ("ParallelScanner");
+
+FileFingerprint::FileFingerprint (const struct stat &info)
+  : m_size (info.st_size)
+  , m_inode (info.st_ino)
+{
+#ifdef __APPLE__
+  m_mtimeNs = static_cast<int64_t> (info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+  m_ctimeNs = static_cast<int64_t> (info.st_ctimespec.tv_sec) * 1000000000 + info.st_ctimespec.tv_nsec;
+#else
+  m_mtimeNs = static_cast<int64_t> (info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+  m_ctimeNs = static_cast<int64_t> (info.st_ctim.tv_sec) * 1000000000 + info.st_ctim.tv_nsec;
+#endif
+}
+
+ParallelScanner::ParallelScanner (size_t threads/* = 0*/, size_t batchSize/* = 512*/)
+  : m_threads (threads)
+  , m_batchSize (batchSize > 0 ? batchSize : 1)
+  , m_pendingDirectories (0)
+  , m_runningWorkers (0)
+  , m_scannedDirectories (0)
+  , m_foundFiles (0)
+{
+  if (m_threads == 0)
+    {
+      m_threads = std::max<size_t> (4, boost::thread::hardware_concurrency ());
+    }
+}
+
+void
+ParallelScanner::Scan (const fs::path &root,
+                       const Exclude_Predicate &exclude,
+                       const Batch_Callback &onBatch,
+                       const Progress_Callback &onProgress/* = Progress_Callback ()*/)
+{
+  m_root = root;
+  m_exclude = exclude;
+  m_directories.clear ();
+  m_directories.push_back (fs::path ());
+  m_pendingDirectories = 1;
+  m_batches.clear ();
+  m_scannedDirectories = 0;
+  m_foundFiles = 0;
+  m_runningWorkers = m_threads;
+
+  thread_group workers;
+  for (size_t i = 0; i < m_threads; i++)
+    {
+      workers.create_thread (bind (&ParallelScanner::worker, this));
+    }
+
+  boost::mutex::scoped_lock lock (m_mutex);
+  while (true)
+    {
+      while (m_batches.empty () && m_runningWorkers > 0)
+        {
+          m_cond.wait (lock);
+        }
+
+      if (m_batches.empty ())
+        break; // all workers are done and everything is delivered
+
+      Entries batch;
+      batch.swap (m_batches.front ());
+      m_batches.pop_front ();
+      size_t directories = m_scannedDirectories;
+      size_t files = m_foundFiles;
+
+      lock.unlock ();
+      onBatch (batch);
+      if (!onProgress.empty ())
+        {
+          onProgress (directories, files);
+        }
+      lock.lock ();
+    }
+  lock.unlock ();
+
+  workers.join_all ();
+  _LOG_DEBUG ("Scanned " << m_scannedDirectories << " directories, found " << m_foundFiles << " files in [" << root << "]");
+}
+
+void
+ParallelScanner::worker ()
+{
+  Entries batch;
+  while (true)
+    {
+      fs::path dir;
+      {
+        boost::mutex::scoped_lock lock (m_mutex);
+        while (m_directories.empty () && m_pendingDirectories > 0)
+          {
+            m_cond.wait (lock);
+          }
+
+        if (m_directories.empty ())
+          break; // everything is scanned
+
+        dir = m_directories.front ();
+        m_directories.pop_front ();
+      }
+
+      scanDirectory (dir, batch);
+
+      boost::mutex::scoped_lock lock (m_mutex);
+      m_scannedDirectories ++;
+      m_pendingDirectories --;
+      if (m_pendingDirectories == 0)
+        {
+          m_cond.notify_all (); // wake up other workers to exit
+        }
+    }
+
+  if (!batch.empty ())
+    {
+      deliver (batch);
+    }
+
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_runningWorkers --;
+  m_cond.notify_all ();
+}
+
+void
+ParallelScanner::scanDirectory (const fs::path &relativeDir, Entries &batch)
+{
+  fs::path absDir = m_root / relativeDir;
+  int dirFd = open (absDir.c_str (), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (dirFd < 0)
+    {
+      // could have been removed while scanning, it is not an error
+      _LOG_DEBUG ("Cannot open [" << absDir << "]: " << strerror (errno));
+      return;
+    }
+
+  DIR *dir = fdopendir (dirFd);
+  if (dir == 0)
+    {
+      close (dirFd);
+      return;
+    }
+
+  // readdir reads entries in large chunks (getdents), stat is done relative to the open
+  // directory, so the path is not resolved again for every entry
+  vector<fs::path> subdirectories;
+  while (struct dirent *entry = readdir (dir))
+    {
+      string name = entry->d_name;
+      if (name == "." || name == "..")
+        continue;
+
+#ifdef DT_LNK
+      if (entry->d_type == DT_LNK)
+        continue;
+#endif
+
+      struct stat info;
+      if (fstatat (dirFd, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+        continue; // removed meanwhile
+
+      if (m_exclude (relativeDir / name, S_ISDIR (info.st_mode)))
+        continue; // excluded directories are not descended into
+
+      if (S_ISDIR (info.st_mode))
+        {
+          subdirectories.push_back (relativeDir / name);
+
+          Entry found;
+          found.m_path = subdirectories.back ();
+          found.m_isDirectory = true;
+          batch.push_back (found);
+        }
+      else if (S_ISREG (info.st_mode))
+        {
+          Entry found;
+          found.m_path = relativeDir / name;
+          found.m_isDirectory = false;
+          found.m_fingerprint = FileFingerprint (info);
+          batch.push_back (found);
+        }
+
+      if (batch.size () >= m_batchSize)
+        {
+          deliver (batch);
+        }
+    }
+  closedir (dir);
+
+  if (!subdirectories.empty ())
+    {
+      boost::mutex::scoped_lock lock (m_mutex);
+      m_directories.insert (m_directories.end (), subdirectories.begin (), subdirectories.end ());
+      m_pendingDirectories += subdirectories.size ();
+      m_cond.notify_all ();
+    }
+}
+
+void
+ParallelScanner::deliver (Entries &batch)
+{
+  size_t files = 0;
+  for (Entries::iterator entry = batch.begin (); entry != batch.end (); entry++)
+    {
+      if (!entry->m_isDirectory)
+        files ++;
+    }
+
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_foundFiles += files;
+  m_batches.push_back (Entries ());
+  m_batches.back ().swap (batch);
+  m_cond.notify_all ();
+}
@@ -0,0 +1,139 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+#ifndef PARALLEL_SCANNER_H
+#define PARALLEL_SCANNER_H
+
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Cheap stat-based identity of the file content
+ *
+ * If the fingerprint is the same as recorded, the file is assumed unchanged and is not
+ * reported (avoids rehashing every file of the directory on each directory event)
+ */
+struct FileFingerprint
+{
+  FileFingerprint ()
+    : m_size (0), m_mtimeNs (0), m_inode (0), m_ctimeNs (0) { }
+
+  explicit
+  FileFingerprint (const struct stat &info);
+
+  bool
+  operator == (const FileFingerprint &other) const
+  {
+    return m_size == other.m_size && m_mtimeNs == other.m_mtimeNs &&
+      m_inode == other.m_inode && m_ctimeNs == other.m_ctimeNs;
+  }
+
+  int64_t m_size;
+  int64_t m_mtimeNs;
+  int64_t m_inode;
+  int64_t m_ctimeNs;
+};
+
+/**
+ * @brief Multi-threaded recursive directory walk, used for the initial (and overflow) scan
+ *
+ * Directories are distributed between worker threads through a shared queue; each worker
+ * reads a directory in one pass and stats its entries relative to the open directory
+ * descriptor.  Found entries are handed over in batches to the thread that called Scan (),
+ * so the callbacks are never invoked concurrently and need no locking.
+ *
+ * Symbolic links are not followed and not reported.
+ */
+class ParallelScanner
+{
+public:
+  struct Entry
+  {
+    boost::filesystem::path m_path; ///< path relative to the scanned root
+    bool m_isDirectory;
+    FileFingerprint m_fingerprint;  ///< only for files
+  };
+  typedef std::vector<Entry> Entries;
+
+  typedef boost::function<bool (const boost::filesystem::path &/*relativePath*/, bool /*isDirectory*/)> Exclude_Predicate;
+  typedef boost::function<void (const Entries &)> Batch_Callback;
+  typedef boost::function<void (size_t /*directories*/, size_t /*files*/)> Progress_Callback;
+
+  /**
+   * @param threads number of worker threads (0 means one per CPU core, but at least 4,
+   *        as the workers mostly wait for the disk)
+   * @param batchSize number of entries delivered in one Batch_Callback call
+   */
+  ParallelScanner (size_t threads = 0, size_t batchSize = 512);
+
+  /**
+   * @brief Walk the tree rooted at root, blocks until the whole tree is scanned
+   *
+   * @param exclude called with the path (relative to root) of each entry; excluded directories
+   *        are not descended into
+   * @param onBatch called (in the calling thread) with each batch of found files and directories
+   * @param onProgress called (in the calling thread) after each batch with running totals
+   */
+  void
+  Scan (const boost::filesystem::path &root,
+        const Exclude_Predicate &exclude,
+        const Batch_Callback &onBatch,
+        const Progress_Callback &onProgress = Progress_Callback ());
+
+  size_t
+  GetThreadCount () const { return m_threads; }
+
+private:
+  void
+  worker ();
+
+  void
+  scanDirectory (const boost::filesystem::path &relativeDir, Entries &batch);
+
+  void
+  deliver (Entries &batch);
+
+private:
+  size_t m_threads;
+  size_t m_batchSize;
+
+  // state of the current scan
+  boost::filesystem::path m_root;
+  Exclude_Predicate m_exclude;
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+  std::deque<boost::filesystem::path> m_directories; // relative paths waiting to be scanned
+  size_t m_pendingDirectories;                      // queued or being scanned
+  size_t m_runningWorkers;
+  std::deque<Entries> m_batches;                    // ready to be delivered
+  size_t m_scannedDirectories;
+  size_t m_foundFiles;
+};
+
+#endif // PARALLEL_SCANNER_H
@@ -0,0 +1,157 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "write-settler.h"
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+WriteSettler::WriteSettler (double settleTime/* = 1.0*/, double maxDeferral/* = 300.0*/)
+  : m_settleTime (posix_time::microseconds (static_cast<int64_t> (settleTime * 1000000)))
+  , m_maxDeferral (posix_time::microseconds (static_cast<int64_t> (maxDeferral * 1000000)))
+{
+}
+
+void
+WriteSettler::Changed (const fs::path &file, const FileFingerprint &fingerprint, bool closed,
+                       const posix_time::ptime &now)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_counters.m_events ++;
+
+  PendingMap::iterator item = m_pending.find (file);
+  if (item == m_pending.end ())
+    {
+      Pending pending;
+      pending.m_fingerprint = fingerprint;
+      pending.m_closed = closed;
+      pending.m_firstEvent = now;
+      pending.m_lastChange = now;
+      m_pending.insert (make_pair (file, pending));
+      return;
+    }
+
+  m_counters.m_coalesced ++;
+  if (!(item->second.m_fingerprint == fingerprint))
+    {
+      item->second.m_fingerprint = fingerprint;
+      item->second.m_lastChange = now;
+      item->second.m_closed = closed; // written again after it was closed
+    }
+  else
+    {
+      item->second.m_closed = item->second.m_closed || closed;
+    }
+}
+
+bool
+WriteSettler::Observe (const fs::path &file, const FileFingerprint &fingerprint,
+                       const posix_time::ptime &now)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  PendingMap::iterator item = m_pending.find (file);
+  if (item == m_pending.end ())
+    return false;
+
+  if (!(item->second.m_fingerprint == fingerprint))
+    {
+      item->second.m_fingerprint = fingerprint;
+      item->second.m_lastChange = now;
+      item->second.m_closed = false;
+    }
+  return true;
+}
+
+bool
+WriteSettler::Cancel (const fs::path &file)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  if (m_pending.erase (file) == 0)
+    return false;
+
+  m_counters.m_cancelled ++;
+  return true;
+}
+
+bool
+WriteSettler::IsPending (const fs::path &file)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_pending.find (file) != m_pending.end ();
+}
+
+vector<fs::path>
+WriteSettler::GetPending ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  vector<fs::path> files;
+  for (PendingMap::iterator item = m_pending.begin (); item != m_pending.end (); item++)
+    {
+      files.push_back (item->first);
+    }
+  return files;
+}
+
+WriteSettler::SettledFiles
+WriteSettler::TakeSettled (const posix_time::ptime &now)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  SettledFiles settled;
+  for (PendingMap::iterator item = m_pending.begin (); item != m_pending.end (); )
+    {
+      bool isSettled = item->second.m_closed || now - item->second.m_lastChange >= m_settleTime;
+      bool isForced = !isSettled && now - item->second.m_firstEvent >= m_maxDeferral;
+      if (!isSettled && !isForced)
+        {
+          item++;
+          continue;
+        }
+
+      if (isSettled)
+        m_counters.m_settled ++;
+      else
+        m_counters.m_forced ++;
+
+      Settled file;
+      file.m_path = item->first;
+      file.m_fingerprint = item->second.m_fingerprint;
+      settled.push_back (file);
+
+      m_pending.erase (item++);
+    }
+  return settled;
+}
+
+size_t
+WriteSettler::GetPendingCount ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_pending.size ();
+}
+
+WriteSettler::Counters
+WriteSettler::GetCounters ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_counters;
+}
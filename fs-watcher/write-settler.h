@@ -0,0 +1,128 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Jared Lindblom <lindblom@cs.ucla.edu>
+ *         Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *         Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+#ifndef WRITE_SETTLER_H
+#define WRITE_SETTLER_H
+
+#include "parallel-scanner.h"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <vector>
+
+/**
+ * @brief Holds back change notifications for files that are still being written
+ *
+ * All events about a file are coalesced into one pending entry.  The file is released when it
+ * has settled: it was closed after writing (close-write from inotify), or its fingerprint
+ * (size, mtime, ...) did not change for the settle time.  A file that never settles (e.g., a
+ * growing log) is released anyway once it has been pending for the maximum deferral time.
+ *
+ * Methods can be called from several threads.
+ */
+class WriteSettler
+{
+public:
+  struct Counters
+  {
+    Counters ()
+      : m_events (0), m_coalesced (0), m_settled (0), m_forced (0), m_cancelled (0) { }
+
+    size_t m_events;    ///< change events received
+    size_t m_coalesced; ///< events merged into an already pending file
+    size_t m_settled;   ///< files released after they settled
+    size_t m_forced;    ///< files released because of the maximum deferral
+    size_t m_cancelled; ///< pending files removed before they settled
+  };
+
+  struct Settled
+  {
+    boost::filesystem::path m_path;
+    FileFingerprint m_fingerprint;
+  };
+  typedef std::vector<Settled> SettledFiles;
+
+  WriteSettler (double settleTime = 1.0, double maxDeferral = 300.0);
+
+  /**
+   * @brief Record change event for the file with its current fingerprint
+   * @param closed the event says that the file was closed after writing
+   */
+  void
+  Changed (const boost::filesystem::path &file, const FileFingerprint &fingerprint, bool closed,
+           const boost::posix_time::ptime &now);
+
+  /**
+   * @brief Record current fingerprint of a pending file (periodic check, not an event)
+   * @returns false if file is not pending
+   */
+  bool
+  Observe (const boost::filesystem::path &file, const FileFingerprint &fingerprint,
+           const boost::posix_time::ptime &now);
+
+  /**
+   * @brief Forget the pending file (e.g., it was removed)
+   */
+  bool
+  Cancel (const boost::filesystem::path &file);
+
+  bool
+  IsPending (const boost::filesystem::path &file);
+
+  /**
+   * @brief Get pending files, to be checked with Observe
+   */
+  std::vector<boost::filesystem::path>
+  GetPending ();
+
+  /**
+   * @brief Take files that have settled (or waited for too long)
+   */
+  SettledFiles
+  TakeSettled (const boost::posix_time::ptime &now);
+
+  size_t
+  GetPendingCount ();
+
+  Counters
+  GetCounters ();
+
+private:
+  struct Pending
+  {
+    FileFingerprint m_fingerprint;
+    bool m_closed;
+    boost::posix_time::ptime m_firstEvent;
+    boost::posix_time::ptime m_lastChange; // last time the fingerprint was seen different
+  };
+  typedef std::map<boost::filesystem::path, Pending> PendingMap;
+
+  boost::posix_time::time_duration m_settleTime;
+  boost::posix_time::time_duration m_maxDeferral;
+
+  boost::mutex m_mutex;
+  PendingMap m_pending;
+  Counters m_counters;
+};
+
+#endif // WRITE_SETTLER_H
@@ -26,6 +26,7 @@
 
 #include "logging.h"
 #include "ccnx-wrapper.h"
+#include "digest.h"
 #include <QValidator>
 #include <QDir>
 #include <QFileInfo>
@@ -45,11 +46,15 @@ static const string DOC_ROOT = ":/html";
 #endif
 static const QString ICON_BIG_FILE(":/images/chronoshare-big.png");
 static const QString ICON_TRAY_FILE(":/images/" TRAY_ICON);
+static const int MAX_PARALLEL_FETCHES = 1024; // upper bound offered in settings
 
 INIT_LOGGER ("Gui");
 
 ChronoShareGui::ChronoShareGui(QWidget *parent)
   : QDialog(parent)
+  , m_verification(false)
+  , m_minFetches(FetchManager::DEFAULT_MIN_PARALLEL_FETCHES)
+  , m_maxFetches(FetchManager::DEFAULT_MAX_PARALLEL_FETCHES)
   , m_watcher(0)
   , m_dispatcher(0)
   , m_httpServer(0)
@@ -66,6 +71,11 @@ ChronoShareGui::ChronoShareGui(QWidget *parent)
   labelUsername = new QLabel("Username (hint: /<username>)");
   labelSharedFolder = new QLabel("Shared Folder Name");
   labelSharedFolderPath = new QLabel("Shared Folder Path");
+  labelPinnedFolders = new QLabel("Folders to fetch first (comma separated, relative to the shared folder)");
+  labelDigestAlgorithm = new QLabel("Digest algorithm for new files");
+  labelUploadLimits = new QLabel("Upload limits (comma separated, KiB/s: <rate>, HH:MM-HH:MM=<rate>, *=<rate> or /<device>=<rate>)");
+  labelDownloadLimits = new QLabel("Download limits (same format as upload limits)");
+  labelFetches = new QLabel("Number of files fetched in parallel (minimum and maximum)");
 
   QRegExp regex("(/[^/]+)+$");
   QValidator *prefixValidator = new QRegExpValidator(regex, this);
@@ -83,6 +93,28 @@ ChronoShareGui::ChronoShareGui(QWidget *parent)
   QPalette pal = editSharedFolderPath->palette();
   pal.setColor(QPalette::Active, QPalette::Base, pal.color(QPalette::Disabled, QPalette::Base));
   editSharedFolderPath->setPalette(pal);
+
+  editPinnedFolders = new QLineEdit();
+
+  comboDigestAlgorithm = new QComboBox();
+  Digest::Algorithm algorithms[] = { Digest::SHA256, Digest::BLAKE3 };
+  for (size_t i = 0; i < sizeof (algorithms) / sizeof (algorithms[0]); i++)
+    {
+      if (Digest::IsSupported (algorithms[i]))
+        comboDigestAlgorithm->addItem(Digest::GetName (algorithms[i]));
+    }
+
+  checkVerification = new QCheckBox("Verify signatures of received data");
+  editUploadLimits = new QLineEdit();
+  editDownloadLimits = new QLineEdit();
+
+  spinMinFetches = new QSpinBox();
+  spinMinFetches->setRange(1, MAX_PARALLEL_FETCHES);
+  spinMaxFetches = new QSpinBox();
+  spinMaxFetches->setRange(1, MAX_PARALLEL_FETCHES);
+  fetchesLayout = new QHBoxLayout;
+  fetchesLayout->addWidget(spinMinFetches);
+  fetchesLayout->addWidget(spinMaxFetches);
   button = new QPushButton("Save and apply settings");
 
   QString versionString = QString("Version: ChronoShare v%1").arg(CHRONOSHARE_VERSION);
@@ -97,6 +129,17 @@ ChronoShareGui::ChronoShareGui(QWidget *parent)
   mainLayout->addWidget(editSharedFolder);
   mainLayout->addWidget(labelSharedFolderPath);
   mainLayout->addWidget(editSharedFolderPath);
+  mainLayout->addWidget(labelPinnedFolders);
+  mainLayout->addWidget(editPinnedFolders);
+  mainLayout->addWidget(labelDigestAlgorithm);
+  mainLayout->addWidget(comboDigestAlgorithm);
+  mainLayout->addWidget(checkVerification);
+  mainLayout->addWidget(labelUploadLimits);
+  mainLayout->addWidget(editUploadLimits);
+  mainLayout->addWidget(labelDownloadLimits);
+  mainLayout->addWidget(editDownloadLimits);
+  mainLayout->addWidget(labelFetches);
+  mainLayout->addLayout(fetchesLayout);
   mainLayout->addWidget(button);
   mainLayout->addWidget(label);
   setLayout(mainLayout);
@@ -173,7 +216,13 @@ ChronoShareGui::startBackend (bool restart/*=false*/)
   // Alex: this **must** be here, otherwise m_dirPath will be uninitialized
   m_watcher = new FsWatcher (realPathToFolder.string ().c_str (),
                              bind (&Dispatcher::Did_LocalFile_AddOrModify, m_dispatcher, _1),
-                             bind (&Dispatcher::Did_LocalFile_Delete,      m_dispatcher, _1));
+                             bind (&Dispatcher::Did_LocalFile_Delete,      m_dispatcher, _1),
+                             bind (&Dispatcher::Did_LocalFiles_AddOrModify, m_dispatcher, _1));
+
+  applyPinnedFolders (QStringList ());
+  applyVerification ();
+  applyRateLimits ();
+  applyFetchConcurrency ();
 
   if (m_httpServer != 0)
     {
@@ -207,6 +256,96 @@ ChronoShareGui::startBackend (bool restart/*=false*/)
   }
 }
 
+void
+ChronoShareGui::applyDigestAlgorithm ()
+{
+  Digest::Algorithm algorithm;
+  if (!Digest::FromName (m_digestAlgorithm.toStdString (), algorithm) ||
+      !Digest::SetDefaultAlgorithm (algorithm))
+    {
+      // keep the current one and show it in settings
+      m_digestAlgorithm = Digest::GetName (Digest::GetDefaultAlgorithm ());
+      comboDigestAlgorithm->setCurrentIndex(comboDigestAlgorithm->findText(m_digestAlgorithm));
+    }
+}
+
+void
+ChronoShareGui::applyVerification ()
+{
+  if (m_dispatcher != 0)
+    {
+      m_dispatcher->SetVerification (m_verification);
+    }
+}
+
+void
+ChronoShareGui::applyRateLimits ()
+{
+  if (m_dispatcher == 0)
+    {
+      return;
+    }
+
+  m_dispatcher->GetUploadRateLimiter ()->Reset ();
+  foreach (const QString &limit, m_uploadLimits)
+    {
+      m_dispatcher->GetUploadRateLimiter ()->SetLimit (limit.toStdString ());
+    }
+
+  m_dispatcher->GetDownloadRateLimiter ()->Reset ();
+  foreach (const QString &limit, m_downloadLimits)
+    {
+      m_dispatcher->GetDownloadRateLimiter ()->SetLimit (limit.toStdString ());
+    }
+}
+
+void
+ChronoShareGui::applyFetchConcurrency ()
+{
+  if (m_dispatcher != 0)
+    {
+      m_dispatcher->SetFileFetchConcurrency (m_minFetches, m_maxFetches);
+    }
+}
+
+// returns the first limit that cannot be parsed or null string if all are valid
+static QString
+parseRateLimits (const QString &text, QStringList &limits)
+{
+  limits.clear();
+  foreach (const QString &limit, text.split(",", QString::SkipEmptyParts))
+    {
+      if (limit.trimmed().isEmpty())
+        continue;
+
+      RateLimiter check;
+      if (!check.SetLimit (limit.trimmed().toStdString ()))
+        return limit.trimmed();
+
+      limits << limit.trimmed();
+    }
+  return QString();
+}
+
+void
+ChronoShareGui::applyPinnedFolders (const QStringList &oldPinnedFolders)
+{
+  if (m_dispatcher == 0)
+    {
+      return;
+    }
+
+  foreach (const QString &folder, oldPinnedFolders)
+    {
+      m_dispatcher->PinFolder (folder.toStdString (), false);
+    }
+
+  foreach (const QString &folder, m_pinnedFolders)
+    {
+      m_dispatcher->PinFolder (folder.toStdString ());
+    }
+}
+
 ChronoShareGui::~ChronoShareGui()
 {
 #ifdef ADHOC_SUPPORTED
@@ -241,6 +380,18 @@ ChronoShareGui::~ChronoShareGui()
   delete labelSharedFolder;
   delete editUsername;
   delete editSharedFolder;
+  delete labelPinnedFolders;
+  delete editPinnedFolders;
+  delete labelDigestAlgorithm;
+  delete comboDigestAlgorithm;
+  delete checkVerification;
+  delete labelUploadLimits;
+  delete editUploadLimits;
+  delete labelDownloadLimits;
+  delete editDownloadLimits;
+  delete labelFetches;
+  delete spinMinFetches;
+  delete spinMaxFetches;
   delete button;
   delete label;
   delete mainLayout;
@@ -450,6 +601,11 @@ void ChronoShareGui::openFile()
     QDesktopServices::openUrl(QUrl("file:///" + pAction->toolTip()));
 #endif
   }
+  else if (!pAction->data().isNull() && m_dispatcher != 0)
+  {
+    // file is not fetched yet, fetch it before other files
+    m_dispatcher->FetchNow(pAction->data().toString().toStdString());
+  }
 }
 
 void ChronoShareGui::updateRecentFilesMenu()
@@ -473,6 +629,7 @@ void ChronoShareGui::checkFileAction (const std::string &filename, int action, i
     // This is a hack, we just use some field to store the path
     m_fileActions[index]->setToolTip(fileInfo.absolutePath());
     m_fileActions[index]->setEnabled(true);
+    m_fileActions[index]->setData(QVariant());
   }
   else
   {
@@ -485,14 +642,16 @@ void ChronoShareGui::checkFileAction (const std::string &filename, int action, i
     // as a remedy
     // Give up at least for now
     m_fileActions[index]->setEnabled(false);
-    // UPDATE, file not fetched yet
-    if (action == 0)
+    // UPDATE (or rename), file not fetched yet
+    if (action != 1)
     {
       QFont font;
       // supposed by change the font, didn't happen
       font.setWeight(QFont::Light);
       m_fileActions[index]->setFont(font);
-      m_fileActions[index]->setToolTip(tr("Fetching..."));
+      m_fileActions[index]->setToolTip(tr("Fetching... (click to fetch it first)"));
+      // openFile will ask the dispatcher to fetch this file first
+      m_fileActions[index]->setData(QString::fromStdString(filename));
     }
     // DELETE
     else
@@ -502,6 +661,7 @@ void ChronoShareGui::checkFileAction (const std::string &filename, int action, i
       font.setStrikeOut(true);
       m_fileActions[index]->setFont(font);
       m_fileActions[index]->setToolTip(tr("Deleted..."));
+      m_fileActions[index]->setData(QVariant());
     }
   }
   m_fileActions[index]->setText(fileInfo.fileName());
@@ -523,14 +683,48 @@ void ChronoShareGui::changeSettings()
   else
     editSharedFolder->setText(m_sharedFolderName);
 
+  QStringList oldPinnedFolders = m_pinnedFolders;
+  m_pinnedFolders.clear();
+  foreach (const QString &folder, editPinnedFolders->text().split(",", QString::SkipEmptyParts))
+    {
+      if (!folder.trimmed().isEmpty())
+        m_pinnedFolders << folder.trimmed();
+    }
+  editPinnedFolders->setText(m_pinnedFolders.join(", "));
+
+  m_digestAlgorithm = comboDigestAlgorithm->currentText();
+  applyDigestAlgorithm();
+
+  m_verification = checkVerification->isChecked();
+
+  // maximum is never below minimum
+  m_minFetches = spinMinFetches->value();
+  m_maxFetches = qMax(spinMaxFetches->value(), spinMinFetches->value());
+  spinMaxFetches->setValue(m_maxFetches);
+
+  QStringList uploadLimits, downloadLimits;
+  QString invalidLimit = parseRateLimits (editUploadLimits->text(), uploadLimits);
+  if (invalidLimit.isNull ())
+    invalidLimit = parseRateLimits (editDownloadLimits->text(), downloadLimits);
+
   if (m_username.isNull () || m_username=="" ||
       m_sharedFolderName.isNull () || m_sharedFolderName=="")
     {
       openMessageBox ("Error",
                       "Username and shared folder name cannot be empty");
     }
+  else if (!invalidLimit.isNull ())
+    {
+      openMessageBox ("Error",
+                      "Invalid bandwidth limit: " + invalidLimit);
+    }
   else
     {
+      m_uploadLimits = uploadLimits;
+      m_downloadLimits = downloadLimits;
+      editUploadLimits->setText(m_uploadLimits.join(", "));
+      editDownloadLimits->setText(m_downloadLimits.join(", "));
+
       saveSettings();
       this->hide();
 
@@ -539,6 +733,13 @@ void ChronoShareGui::changeSettings()
         {
           startBackend (true); // restart dispatcher/fswatcher
         }
+      else
+        {
+          applyPinnedFolders (oldPinnedFolders);
+          applyVerification ();
+          applyRateLimits ();
+          applyFetchConcurrency ();
+        }
     }
 }
 
@@ -652,6 +853,27 @@ bool ChronoShareGui::loadSettings()
 
   editSharedFolderPath->setText(m_dirPath);
 
+  // optional, not required to start the backend
+  m_pinnedFolders = settings.value("pinnedfolders").toStringList();
+  editPinnedFolders->setText(m_pinnedFolders.join(", "));
+
+  m_digestAlgorithm = settings.value("digestalgorithm", Digest::GetName (Digest::SHA256)).toString();
+  comboDigestAlgorithm->setCurrentIndex(comboDigestAlgorithm->findText(m_digestAlgorithm));
+  applyDigestAlgorithm();
+
+  m_verification = settings.value("verification", false).toBool();
+  checkVerification->setChecked(m_verification);
+
+  m_uploadLimits = settings.value("uploadlimits").toStringList();
+  editUploadLimits->setText(m_uploadLimits.join(", "));
+  m_downloadLimits = settings.value("downloadlimits").toStringList();
+  editDownloadLimits->setText(m_downloadLimits.join(", "));
+
+  m_minFetches = settings.value("minfetches", FetchManager::DEFAULT_MIN_PARALLEL_FETCHES).toUInt();
+  m_maxFetches = settings.value("maxfetches", FetchManager::DEFAULT_MAX_PARALLEL_FETCHES).toUInt();
+  spinMinFetches->setValue(m_minFetches);
+  spinMaxFetches->setValue(m_maxFetches);
+
   _LOG_DEBUG ("Found configured path: " << (successful ? m_dirPath.toStdString () : std::string("no")));
 
   return successful;
@@ -666,6 +888,13 @@ void ChronoShareGui::saveSettings()
   settings.setValue("dirPath", m_dirPath);
   settings.setValue("username", m_username);
   settings.setValue("sharedfoldername", m_sharedFolderName);
+  settings.setValue("pinnedfolders", m_pinnedFolders);
+  settings.setValue("digestalgorithm", m_digestAlgorithm);
+  settings.setValue("verification", m_verification);
+  settings.setValue("uploadlimits", m_uploadLimits);
+  settings.setValue("downloadlimits", m_downloadLimits);
+  settings.setValue("minfetches", m_minFetches);
+  settings.setValue("maxfetches", m_maxFetches);
 }
 
 void ChronoShareGui::closeEvent(QCloseEvent* event)
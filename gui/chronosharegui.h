@@ -116,6 +116,26 @@ private:
   void
   startBackend(bool restart=false);
 
+  // makes the digest algorithm from settings the default for new content
+  void
+  applyDigestAlgorithm();
+
+  // enables or disables verification of received data in the dispatcher
+  void
+  applyVerification();
+
+  // replaces bandwidth limits of the dispatcher with limits from settings
+  void
+  applyRateLimits();
+
+  // sets bounds of the number of parallel file fetches in the dispatcher
+  void
+  applyFetchConcurrency();
+
+  // pins folders from settings in the dispatcher (unpinning the previously pinned ones)
+  void
+  applyPinnedFolders(const QStringList &oldPinnedFolders);
+
 private:
   QSystemTrayIcon* m_trayIcon; // tray icon
   QMenu* m_trayIconMenu; // tray icon menu
@@ -134,6 +154,13 @@ private:
   QString m_dirPath; // shared directory
   QString m_username; // username
   QString m_sharedFolderName; // shared folder name
+  QStringList m_pinnedFolders; // folders (relative to the shared folder) fetched first
+  QString m_digestAlgorithm; // digest algorithm for new content (name as in Digest::GetName)
+  bool m_verification; // verify signatures of received data
+  QStringList m_uploadLimits; // upload bandwidth limits (as in RateLimiter::SetLimit)
+  QStringList m_downloadLimits; // download bandwidth limits (as in RateLimiter::SetLimit)
+  uint32_t m_minFetches; // bounds of the number of files fetched in parallel
+  uint32_t m_maxFetches;
 
   FsWatcher  *m_watcher;
   Dispatcher *m_dispatcher;
@@ -147,6 +174,19 @@ private:
   QLineEdit* editUsername;
   QLineEdit* editSharedFolder;
   QLineEdit* editSharedFolderPath;
+  QLabel* labelPinnedFolders;
+  QLineEdit* editPinnedFolders;
+  QLabel* labelDigestAlgorithm;
+  QComboBox* comboDigestAlgorithm;
+  QCheckBox* checkVerification;
+  QLabel* labelUploadLimits;
+  QLineEdit* editUploadLimits;
+  QLabel* labelDownloadLimits;
+  QLineEdit* editDownloadLimits;
+  QLabel* labelFetches;
+  QSpinBox* spinMinFetches;
+  QSpinBox* spinMaxFetches;
+  QHBoxLayout* fetchesLayout;
   QLabel *label;
   QVBoxLayout *mainLayout;
 
@@ -21,8 +21,11 @@
 
 #include "action-log.h"
 #include "logging.h"
+#include "db-upgrade.h"
 
 #include <boost/make_shared.hpp>
+#include <boost/throw_exception.hpp>
+#include <algorithm>
 
 using namespace boost;
 using namespace std;
@@ -43,6 +46,7 @@ CREATE TABLE ActionLog (                                                \n\
     action_timestamp TIMESTAMP NOT NULL,                                \n\
                                                                         \n\
     file_hash   BLOB, /* NULL if action is \"delete\" */                \n\
+    file_hash_algorithm INTEGER, /* see Digest::Algorithm, NULL is SHA-256 */ \n\
     file_atime  TIMESTAMP,                                              \n\
     file_mtime  TIMESTAMP,                                              \n\
     file_ctime  TIMESTAMP,                                              \n\
@@ -51,6 +55,7 @@ CREATE TABLE ActionLog (                                                \n\
                                                                         \n\
     parent_device_name BLOB,                                            \n\
     parent_seq_no      INTEGER,                                         \n\
+    moved_from  TEXT, /* previous name if the update is a rename */     \n\
                                                                         \n\
     action_name	     TEXT,                                              \n\
     action_content_object BLOB,                                         \n\
@@ -62,6 +67,16 @@ CREATE INDEX ActionLog_filename_version ON ActionLog (filename,version);
 CREATE INDEX ActionLog_parent ON ActionLog (parent_device_name, parent_seq_no);   \n\
 CREATE INDEX ActionLog_action_name ON ActionLog (action_name);          \n\
 CREATE INDEX ActionLog_filename_version_hash ON ActionLog (filename,version,file_hash); \n\
+";
+
+static const ColumnUpgrade UPGRADE_COLUMNS[] = {
+  { "ActionLog", "file_hash_algorithm", "INTEGER" },
+  { "ActionLog", "moved_from", "TEXT" },
+};
+
+// recreated on every start, so databases created by older versions get the current one
+const std::string INIT_TRIGGER = "\
+DROP TRIGGER IF EXISTS ActionLogInsert_trigger;                         \n\
                                                                         \n\
 CREATE TRIGGER ActionLogInsert_trigger                                  \n\
     AFTER INSERT ON ActionLog                                           \n\
@@ -79,7 +94,7 @@ CREATE TRIGGER ActionLogInsert_trigger                                  \n\
         SELECT apply_action (NEW.device_name, NEW.seq_no,               \
                              NEW.action,NEW.filename,NEW.version,NEW.file_hash,     \
                              strftime('%s', NEW.file_atime),strftime('%s', NEW.file_mtime),strftime('%s', NEW.file_ctime), \
-                             NEW.file_chmod, NEW.file_seg_num); /* function that applies action and adds record the FileState */  \n \
+                             NEW.file_chmod, NEW.file_seg_num, NEW.file_hash_algorithm); /* function that applies action and adds record the FileState */  \n \
     END;                                                                \n\
 ";
 
@@ -115,10 +130,22 @@ ActionLog::ActionLog (boost::shared_ptr<ndn::Face> face, const boost::filesystem
                              << errmsg_info_str ("Cannot create function ``apply_action''"));
     }
 
+  if (!AddMissingColumns (m_db, UPGRADE_COLUMNS))
+    {
+      _LOG_ERROR ("Cannot upgrade ActionLog: " << sqlite3_errmsg (m_db));
+    }
+
+  sqlite3_exec (m_db, INIT_TRIGGER.c_str (), NULL, NULL, NULL);
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+
+  // INIT_DATABASE stops on the first error, so the index needs to be created separately for existing databases
+  sqlite3_exec (m_db, "CREATE INDEX IF NOT EXISTS ActionLog_file_hash ON ActionLog (file_hash)", NULL, NULL, NULL);
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+
   m_fileState = boost::make_shared<FileState> (path);
 }
 
-tuple<sqlite3_int64 /*version*/, ndn::BufferPtr /*device name*/, sqlite3_int64 /*seq_no*/>
+boost::tuple<sqlite3_int64 /*version*/, ndn::BufferPtr /*device name*/, sqlite3_int64 /*seq_no*/>
 ActionLog::GetLatestActionForFile (const std::string &filename)
 {
   // check if something already exists
@@ -142,7 +169,7 @@ ActionLog::GetLatestActionForFile (const std::string &filename)
     {
       version = sqlite3_column_int64 (stmt, 0);
 
-      if (sqlite3_column_int (stmt, 3) == 0) // prevent "linking" if the file was previously deleted
+      if (sqlite3_column_int (stmt, 3) != 1) // prevent "linking" if the file was previously deleted
         {
           parent_device_name = boost::make_shared<ndn::Buffer> (sqlite3_column_blob (stmt, 1), sqlite3_column_bytes (stmt, 1));
           parent_seq_no = sqlite3_column_int64 (stmt, 2);
@@ -150,7 +177,7 @@ ActionLog::GetLatestActionForFile (const std::string &filename)
     }
 
   sqlite3_finalize (stmt);
-  return make_tuple (version, parent_device_name, parent_seq_no);
+  return boost::make_tuple (version, parent_device_name, parent_seq_no);
 }
 
 // local add action. remote action is extracted from content object
@@ -159,7 +186,38 @@ ActionLog::AddLocalActionUpdate (const std::string &filename,
                                  const Hash &hash,
                                  time_t wtime,
                                  int mode,
-                                 int seg_num)
+                                 int seg_num,
+                                 const Hash &segmentRoot/* = Hash ()*/)
+{
+  return addLocalActionUpdate (filename, hash, wtime, mode, seg_num, segmentRoot, "");
+}
+
+ActionItemPtr
+ActionLog::AddLocalActionMove (const std::string &oldFilename,
+                               const std::string &filename,
+                               const Hash &hash,
+                               time_t wtime,
+                               int mode,
+                               int seg_num,
+                               const Hash &segmentRoot/* = Hash ()*/)
+{
+  _LOG_DEBUG ("Adding local action MOVE " << oldFilename << " -> " << filename);
+
+  // new name first, so peers still have the old file to rename when they apply the move
+  ActionItemPtr item = addLocalActionUpdate (filename, hash, wtime, mode, seg_num, segmentRoot, oldFilename);
+  AddLocalActionDelete (oldFilename);
+
+  return item;
+}
+
+ActionItemPtr
+ActionLog::addLocalActionUpdate (const std::string &filename,
+                                 const Hash &hash,
+                                 time_t wtime,
+                                 int mode,
+                                 int seg_num,
+                                 const Hash &segmentRoot,
+                                 const std::string &movedFrom)
 {
   sqlite3_exec (m_db, "BEGIN TRANSACTION;", 0,0,0);
 
@@ -179,11 +237,11 @@ ActionLog::AddLocalActionUpdate (const std::string &filename,
                                 "(device_name, seq_no, action, filename, version, action_timestamp, "
                                 "file_hash, file_atime, file_mtime, file_ctime, file_chmod, file_seg_num, "
                                 "parent_device_name, parent_seq_no, "
-                                "action_name, action_content_object) "
+                                "action_name, action_content_object, file_hash_algorithm, moved_from) "
                                 "VALUES (?, ?, ?, ?, ?, datetime(?, 'unixepoch'),"
                                 "        ?, datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), ?,?, "
                                 "        ?, ?, "
-                                "        ?, ?);", -1, &stmt, 0);
+                                "        ?, ?, ?, ?);", -1, &stmt, 0);
 
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
 
@@ -196,7 +254,7 @@ ActionLog::AddLocalActionUpdate (const std::string &filename,
 
   sqlite3_bind_blob  (stmt, 1, device_name.value (), device_name.size (), SQLITE_STATIC);
   sqlite3_bind_int64 (stmt, 2, seq_no);
-  sqlite3_bind_int   (stmt, 3, 0);
+  sqlite3_bind_int   (stmt, 3, ActionItem::UPDATE);
   sqlite3_bind_text  (stmt, 4, filename.c_str (), filename.size (), SQLITE_STATIC);
   sqlite3_bind_int64 (stmt, 5, version);
   sqlite3_bind_int64 (stmt, 6, action_time);
@@ -208,6 +266,11 @@ ActionLog::AddLocalActionUpdate (const std::string &filename,
   // sqlite3_bind_int64 (stmt, 10, ctime); // NULL
   sqlite3_bind_int   (stmt, 11, mode);
   sqlite3_bind_int   (stmt, 12, seg_num);
+  sqlite3_bind_int   (stmt, 17, hash.GetAlgorithm ());
+  if (!movedFrom.empty ())
+    {
+      sqlite3_bind_text (stmt, 18, movedFrom.c_str (), movedFrom.size (), SQLITE_STATIC);
+    }
 
   if (parent_device_name && parent_seq_no > 0)
     {
@@ -221,11 +284,24 @@ ActionLog::AddLocalActionUpdate (const std::string &filename,
   item->set_version (version);
   item->set_timestamp (action_time);
   item->set_file_hash (hash.GetHash (), hash.GetHashBytes ());
+  if (hash.GetAlgorithm () != Digest::SHA256)
+    {
+      // omitted for SHA-256, so the action is understood by peers that do not know about the field
+      item->set_file_hash_algorithm (hash.GetAlgorithm ());
+    }
   // item->set_atime (atime);
   item->set_mtime (wtime);
   // item->set_ctime (ctime);
   item->set_mode (mode);
   item->set_seg_num (seg_num);
+  if (segmentRoot.GetHashBytes () > 0)
+    {
+      item->set_segment_root (segmentRoot.GetHash (), segmentRoot.GetHashBytes ());
+    }
+  if (!movedFrom.empty ())
+    {
+      item->set_moved_from (movedFrom);
+    }
 
   if (parent_device_name && parent_seq_no > 0)
     {
@@ -284,14 +360,6 @@ ActionLog::AddLocalActionUpdate (const std::string &filename,
   return item;
 }
 
-// void
-// ActionLog::AddActionMove (const std::string &oldFile, const std::string &newFile)
-// {
-//   // not supported yet
-//   BOOST_THROW_EXCEPTION (Error::Db ()
-//                          << errmsg_info_str ("Move operation is not yet supported"));
-// }
-
 ActionItemPtr
 ActionLog::AddLocalActionDelete (const std::string &filename)
 {
@@ -500,9 +568,9 @@ ActionLog::LookupAction (const std::string &filename, sqlite3_int64 version, con
 {
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2 (m_db,
-                      "SELECT device_name, seq_no, strftime('%s', file_mtime), file_chmod, file_seg_num, file_hash "
+                      "SELECT device_name, seq_no, strftime('%s', file_mtime), file_chmod, file_seg_num, file_hash, file_hash_algorithm "
                       " FROM ActionLog "
-                      " WHERE action = 0 AND "
+                      " WHERE action <> 1 AND "
                       "       filename=? AND "
                       "       version=? AND "
                       "       is_prefix (?, file_hash)=1", -1, &stmt, 0);
@@ -525,6 +593,7 @@ ActionLog::LookupAction (const std::string &filename, sqlite3_int64 version, con
       fileItem->set_seg_num (sqlite3_column_int64 (stmt, 4));
 
       fileItem->set_file_hash (sqlite3_column_blob (stmt, 5), sqlite3_column_bytes (stmt, 5));
+      fileItem->set_file_hash_algorithm (sqlite3_column_int (stmt, 6));
     }
 
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE || sqlite3_errcode (m_db) != SQLITE_ROW || sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
@@ -533,6 +602,67 @@ ActionLog::LookupAction (const std::string &filename, sqlite3_int64 version, con
 }
 
 
+// Delete actions store the whole Name TLV in device_name, other actions store the value of the TLV followed by
+// as many bytes as there are in the TLV header (value () is bound with size () of the whole block)
+static ndn::Name
+decodeDeviceName (const void *blob, int bytes)
+{
+  const uint8_t *buf = reinterpret_cast<const uint8_t*> (blob);
+  if (bytes > 0 && buf[0] == ndn::tlv::Name)
+    {
+      return ndn::Name (ndn::Block (buf, bytes));
+    }
+
+  size_t header = bytes - 2 < 253 ? 2 : 4; // type and 1- or 3-byte length
+  if (bytes < static_cast<int> (header))
+    {
+      BOOST_THROW_EXCEPTION (ndn::tlv::Error ("Device name is too short"));
+    }
+  return ndn::Name (ndn::Block (ndn::tlv::Name, boost::make_shared<ndn::Buffer> (buf, bytes - header)));
+}
+
+std::vector<ActionLog::ContentSource>
+ActionLog::LookupSourcesForHash (const Hash &filehash)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db,
+                      "SELECT device_name, device_name "
+                      " FROM ActionLog "
+                      " WHERE file_hash=? AND action <> 1 "
+                      "UNION "
+                      "SELECT later.device_name, published.device_name "
+                      " FROM ActionLog AS published JOIN ActionLog AS later "
+                      "   ON later.filename = published.filename AND later.version > published.version "
+                      " WHERE published.file_hash=? AND published.action <> 1", -1, &stmt, 0);
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+
+  sqlite3_bind_blob (stmt, 1, filehash.GetHash (), filehash.GetHashBytes (), SQLITE_STATIC);
+  sqlite3_bind_blob (stmt, 2, filehash.GetHash (), filehash.GetHashBytes (), SQLITE_STATIC);
+
+  std::vector<ContentSource> sources;
+  while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      try
+        {
+          ContentSource source (decodeDeviceName (sqlite3_column_blob (stmt, 0), sqlite3_column_bytes (stmt, 0)),
+                                decodeDeviceName (sqlite3_column_blob (stmt, 1), sqlite3_column_bytes (stmt, 1)));
+          if (std::find (sources.begin (), sources.end (), source) == sources.end ())
+            {
+              sources.push_back (source);
+            }
+        }
+      catch (ndn::tlv::Error &error)
+        {
+          _LOG_ERROR ("Cannot decode device name: " << error.what ());
+        }
+    }
+
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE, sqlite3_errmsg (m_db));
+  sqlite3_finalize (stmt);
+
+  return sources;
+}
+
 ActionItemPtr
 ActionLog::AddRemoteAction (const ndn::Name &deviceName, sqlite3_int64 seqno, boost::shared_ptr<ndn::Data> actionPco)
 {
@@ -541,82 +671,120 @@ ActionLog::AddRemoteAction (const ndn::Name &deviceName, sqlite3_int64 seqno, bo
       _LOG_ERROR ("actionPco is not valid");
       return ActionItemPtr ();
     }
-  ActionItemPtr action = deserialize (actionPco->getContent ());
 
-  if (!action)
-    {
-      _LOG_ERROR ("action cannot be decoded");
-      return ActionItemPtr ();
-    }
+  RemoteActions actions;
+  actions.push_back (RemoteAction (deviceName, seqno, actionPco));
 
-  _LOG_DEBUG ("AddRemoteAction: [" << deviceName << "] seqno: " << seqno);
+  return AddRemoteActions (actions).front ();
+}
 
-  sqlite3_stmt *stmt;
-  int res = sqlite3_prepare_v2 (m_db, "INSERT INTO ActionLog "
-                                "(device_name, seq_no, action, filename, version, action_timestamp, "
-                                "file_hash, file_atime, file_mtime, file_ctime, file_chmod, file_seg_num, "
-                                "parent_device_name, parent_seq_no, "
-                                "action_name, action_content_object) "
-                                "VALUES (?, ?, ?, ?, ?, datetime(?, 'unixepoch'),"
-                                "        ?, datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), ?,?, "
-                                "        ?, ?, "
-                                "        ?, ?);", -1, &stmt, 0);
-  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+void
+ActionLog::insertRemoteAction (sqlite3_stmt *stmt, const RemoteAction &remoteAction, const ActionItem &action)
+{
+  _LOG_DEBUG ("AddRemoteAction: [" << remoteAction.m_deviceName << "] seqno: " << remoteAction.m_seqno);
 
-  ndn::Block device_name = deviceName.wireEncode ();
+  ndn::Block device_name = remoteAction.m_deviceName.wireEncode ();
   sqlite3_bind_blob  (stmt, 1, device_name.value (), device_name.size (), SQLITE_STATIC);
-  sqlite3_bind_int64 (stmt, 2, seqno);
+  sqlite3_bind_int64 (stmt, 2, remoteAction.m_seqno);
+
+  sqlite3_bind_int   (stmt, 3, action.action ());
+  sqlite3_bind_text  (stmt, 4, action.filename ().c_str (), action.filename ().size (), SQLITE_STATIC);
 
-  sqlite3_bind_int   (stmt, 3, action->action ());
-  sqlite3_bind_text  (stmt, 4, action->filename ().c_str (), action->filename ().size (), SQLITE_STATIC);
-  sqlite3_bind_int64 (stmt, 5, action->version ());
-  sqlite3_bind_int64 (stmt, 6, action->timestamp ());
+  // same as directory_name(filename), but without a separate UPDATE for each action
+  std::string directory = boost::filesystem::path (action.filename ()).parent_path ().generic_string ();
+  if (directory.size () > 0)
+    {
+      sqlite3_bind_text (stmt, 5, directory.c_str (), directory.size (), SQLITE_STATIC);
+    }
 
-  if (action->action () == ActionItem::UPDATE)
+  sqlite3_bind_int64 (stmt, 6, action.version ());
+  sqlite3_bind_int64 (stmt, 7, action.timestamp ());
+
+  if (action.action () != ActionItem::DELETE)
     {
-      sqlite3_bind_blob  (stmt, 7, action->file_hash ().c_str (), action->file_hash ().size (), SQLITE_STATIC);
+      sqlite3_bind_blob  (stmt, 8, action.file_hash ().c_str (), action.file_hash ().size (), SQLITE_STATIC);
 
-      // sqlite3_bind_int64 (stmt, 8, atime); // NULL
-      sqlite3_bind_int64 (stmt, 9, action->mtime ());
-      // sqlite3_bind_int64 (stmt, 10, ctime); // NULL
+      // sqlite3_bind_int64 (stmt, 9, atime); // NULL
+      sqlite3_bind_int64 (stmt, 10, action.mtime ());
+      // sqlite3_bind_int64 (stmt, 11, ctime); // NULL
 
-      sqlite3_bind_int   (stmt, 11, action->mode ());
-      sqlite3_bind_int   (stmt, 12, action->seg_num ());
+      sqlite3_bind_int   (stmt, 12, action.mode ());
+      sqlite3_bind_int   (stmt, 13, action.seg_num ());
+      sqlite3_bind_int   (stmt, 18, action.file_hash_algorithm ());
+      if (action.has_moved_from ())
+        {
+          sqlite3_bind_text (stmt, 19, action.moved_from ().c_str (), action.moved_from ().size (), SQLITE_STATIC);
+        }
     }
 
-  if (action->has_parent_device_name ())
+  if (action.has_parent_device_name ())
     {
-      sqlite3_bind_blob (stmt, 13, action->parent_device_name ().c_str (), action->parent_device_name ().size (), SQLITE_STATIC);
-      sqlite3_bind_int64 (stmt, 14, action->parent_seq_no ());
+      sqlite3_bind_blob (stmt, 14, action.parent_device_name ().c_str (), action.parent_device_name ().size (), SQLITE_STATIC);
+      sqlite3_bind_int64 (stmt, 15, action.parent_seq_no ());
     }
 
-  ndn::Name actionName = ndn::Name(deviceName);
-  actionName.append("action").append(m_sharedFolderName).appendNumber(seqno);
+  ndn::Name actionName = ndn::Name (remoteAction.m_deviceName);
+  actionName.append ("action").append (m_sharedFolderName).appendNumber (remoteAction.m_seqno);
 
-  const ndn::Block nameBlock = actionName.wireEncode();
+  const ndn::Block nameBlock = actionName.wireEncode ();
 
-  sqlite3_bind_blob (stmt, 15, nameBlock.wire (), nameBlock.size (), SQLITE_STATIC);
-  sqlite3_bind_blob (stmt, 16, actionPco->getContent ().wire (), actionPco->getContent ().size (), SQLITE_STATIC);
+  sqlite3_bind_blob (stmt, 16, nameBlock.wire (), nameBlock.size (), SQLITE_STATIC);
+  sqlite3_bind_blob (stmt, 17, remoteAction.m_actionPco->getContent ().wire (), remoteAction.m_actionPco->getContent ().size (), SQLITE_STATIC);
   sqlite3_step (stmt);
 
   // if action needs to be applied to file state, the trigger will take care of it
 
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE, sqlite3_errmsg (m_db));
 
-  sqlite3_finalize (stmt);
+  sqlite3_reset (stmt);
+  sqlite3_clear_bindings (stmt);
+}
 
-  // I had a problem including directory_name assignment as part of the initial insert.
-  sqlite3_prepare_v2 (m_db, "UPDATE ActionLog SET directory=directory_name(filename) WHERE device_name=? AND seq_no=?", -1, &stmt, 0);
+ActionLog::ActionItems
+ActionLog::AddRemoteActions (const RemoteActions &actions)
+{
+  ActionItems items (actions.size ());
+  if (actions.empty ())
+    return items;
+
+  for (size_t i = 0; i < actions.size (); i++)
+    {
+      if (actions[i].m_actionPco)
+        {
+          items[i] = deserialize (actions[i].m_actionPco->getContent ());
+        }
+    }
+
+  sqlite3_exec (m_db, "BEGIN TRANSACTION;", 0,0,0);
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db, "INSERT INTO ActionLog "
+                      "(device_name, seq_no, action, filename, directory, version, action_timestamp, "
+                      "file_hash, file_atime, file_mtime, file_ctime, file_chmod, file_seg_num, "
+                      "parent_device_name, parent_seq_no, "
+                      "action_name, action_content_object, file_hash_algorithm, moved_from) "
+                      "VALUES (?, ?, ?, ?, ?, ?, datetime(?, 'unixepoch'),"
+                      "        ?, datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), ?,?, "
+                      "        ?, ?, "
+                      "        ?, ?, ?, ?);", -1, &stmt, 0);
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
 
-  sqlite3_bind_blob  (stmt, 1, device_name.value (), device_name.size (), SQLITE_STATIC);
-  sqlite3_bind_int64 (stmt, 2, seqno);
-  sqlite3_step (stmt);
-  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE, sqlite3_errmsg (m_db));
+  for (size_t i = 0; i < actions.size (); i++)
+    {
+      if (!items[i])
+        {
+          _LOG_ERROR ("action cannot be decoded");
+          continue;
+        }
+
+      insertRemoteAction (stmt, actions[i], *items[i]);
+    }
 
   sqlite3_finalize (stmt);
 
-  return action;
+  sqlite3_exec (m_db, "END TRANSACTION;", 0,0,0);
+
+  return items;
 }
 
 ActionItemPtr
@@ -690,7 +858,7 @@ ActionLog::LookupActionsInFolderRecursively (const boost::function<void (const n
       sqlite3_prepare_v2 (m_db,
                           "SELECT device_name,seq_no,action,filename,directory,version,strftime('%s', action_timestamp), "
                           "       file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num, "
-                          "       parent_device_name,parent_seq_no "
+                          "       parent_device_name,parent_seq_no,file_hash_algorithm,moved_from "
                           "   FROM ActionLog "
                           "   WHERE is_dir_prefix (?, directory)=1 "
                           "   ORDER BY action_timestamp DESC "
@@ -708,7 +876,7 @@ ActionLog::LookupActionsInFolderRecursively (const boost::function<void (const n
       sqlite3_prepare_v2 (m_db,
                           "SELECT device_name,seq_no,action,filename,directory,version,strftime('%s', action_timestamp), "
                           "       file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num, "
-                          "       parent_device_name,parent_seq_no "
+                          "       parent_device_name,parent_seq_no,file_hash_algorithm,moved_from "
                           "   FROM ActionLog "
                           "   ORDER BY action_timestamp DESC "
                           "   LIMIT ? OFFSET ?", -1, &stmt, 0);
@@ -735,12 +903,20 @@ ActionLog::LookupActionsInFolderRecursively (const boost::function<void (const n
       action.set_version     (sqlite3_column_int64 (stmt, 5));
       action.set_timestamp   (sqlite3_column_int64 (stmt, 6));
 
-      if (action.action () == 0)
+      if (action.action () != ActionItem::DELETE)
         {
           action.set_file_hash   (sqlite3_column_blob  (stmt, 7), sqlite3_column_bytes (stmt, 7));
           action.set_mtime       (sqlite3_column_int   (stmt, 8));
           action.set_mode        (sqlite3_column_int   (stmt, 9));
           action.set_seg_num     (sqlite3_column_int64 (stmt, 10));
+          if (sqlite3_column_int (stmt, 13) != Digest::SHA256)
+            {
+              action.set_file_hash_algorithm (sqlite3_column_int (stmt, 13));
+            }
+          if (sqlite3_column_type (stmt, 14) != SQLITE_NULL)
+            {
+              action.set_moved_from (reinterpret_cast<const char *> (sqlite3_column_text (stmt, 14)), sqlite3_column_bytes (stmt, 14));
+            }
         }
       if (sqlite3_column_bytes (stmt, 11) > 0)
         {
@@ -777,7 +953,7 @@ ActionLog::LookupActionsForFile (const boost::function<void (const ndn::Name &na
   sqlite3_prepare_v2 (m_db,
                       "SELECT device_name,seq_no,action,filename,directory,version,strftime('%s', action_timestamp), "
                       "       file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num, "
-                      "       parent_device_name,parent_seq_no "
+                      "       parent_device_name,parent_seq_no,file_hash_algorithm,moved_from "
                       "   FROM ActionLog "
                       "   WHERE filename=? "
                       "   ORDER BY action_timestamp DESC "
@@ -809,12 +985,20 @@ ActionLog::LookupActionsForFile (const boost::function<void (const ndn::Name &na
       action.set_version     (sqlite3_column_int64 (stmt, 5));
       action.set_timestamp   (sqlite3_column_int64 (stmt, 6));
 
-      if (action.action () == 0)
+      if (action.action () != ActionItem::DELETE)
         {
           action.set_file_hash   (sqlite3_column_blob  (stmt, 7), sqlite3_column_bytes (stmt, 7));
           action.set_mtime       (sqlite3_column_int   (stmt, 8));
           action.set_mode        (sqlite3_column_int   (stmt, 9));
           action.set_seg_num     (sqlite3_column_int64 (stmt, 10));
+          if (sqlite3_column_int (stmt, 13) != Digest::SHA256)
+            {
+              action.set_file_hash_algorithm (sqlite3_column_int (stmt, 13));
+            }
+          if (sqlite3_column_type (stmt, 14) != SQLITE_NULL)
+            {
+              action.set_moved_from (reinterpret_cast<const char *> (sqlite3_column_text (stmt, 14)), sqlite3_column_bytes (stmt, 14));
+            }
         }
       if (sqlite3_column_bytes (stmt, 11) > 0)
         {
@@ -876,9 +1060,9 @@ ActionLog::apply_action_xFun (sqlite3_context *context, int argc, sqlite3_value
 {
   ActionLog *the = reinterpret_cast<ActionLog*> (sqlite3_user_data (context));
 
-  if (argc != 11)
+  if (argc != 12)
     {
-      sqlite3_result_error (context, "``apply_action'' expects 10 arguments", -1);
+      sqlite3_result_error (context, "``apply_action'' expects 12 arguments", -1);
       return;
     }
 
@@ -895,7 +1079,8 @@ ActionLog::apply_action_xFun (sqlite3_context *context, int argc, sqlite3_value
 
   if (action == 0) // update
     {
-      Hash hash (sqlite3_value_blob (argv[5]), sqlite3_value_bytes (argv[5]));
+      Hash hash (sqlite3_value_blob (argv[5]), sqlite3_value_bytes (argv[5]),
+                 static_cast<Digest::Algorithm> (sqlite3_value_int (argv[11])));
       time_t atime = static_cast<time_t> (sqlite3_value_int64 (argv[6]));
       time_t mtime = static_cast<time_t> (sqlite3_value_int64 (argv[7]));
       time_t ctime = static_cast<time_t> (sqlite3_value_int64 (argv[8]));
@@ -30,6 +30,7 @@
 
 #include <boost/tuple/tuple.hpp>
 #include <ndn-cxx/face.hpp>
+#include <vector>
 
 class ActionLog;
 typedef boost::shared_ptr<ActionLog> ActionLogPtr;
@@ -43,6 +44,22 @@ public:
 
   typedef boost::function<void (std::string /*filename*/)> OnFileRemovedCallback;
 
+  struct RemoteAction
+  {
+    RemoteAction (const ndn::Name &deviceName, sqlite3_int64 seqno, boost::shared_ptr<ndn::Data> actionPco)
+      : m_deviceName (deviceName)
+      , m_seqno (seqno)
+      , m_actionPco (actionPco)
+    {
+    }
+
+    ndn::Name m_deviceName;
+    sqlite3_int64 m_seqno;
+    boost::shared_ptr<ndn::Data> m_actionPco;
+  };
+  typedef std::vector<RemoteAction> RemoteActions;
+  typedef std::vector<ActionItemPtr> ActionItems;
+
 public:
   ActionLog (boost::shared_ptr<ndn::Face> face, const boost::filesystem::path &path,
              SyncLogPtr syncLog,
@@ -54,15 +71,31 @@ public:
   //////////////////////////
   // Local operations     //
   //////////////////////////
+  /**
+   * @param segmentRoot root of MerkleTree over the segments of the file, lets peers verify every segment on arrival
+   */
   ActionItemPtr
   AddLocalActionUpdate (const std::string &filename,
                         const Hash &hash,
                         time_t wtime,
                         int mode,
-                        int seg_num);
+                        int seg_num,
+                        const Hash &segmentRoot = Hash ());
 
-  // void
-  // AddActionMove (const std::string &oldFile, const std::string &newFile);
+  /**
+   * @brief Publish rename of the local file
+   *
+   * Two actions are added: UPDATE of the new file with moved_from set (with the full description of
+   * the content, so peers without the old file or older peers can fetch it) and DELETE of the old file
+   */
+  ActionItemPtr
+  AddLocalActionMove (const std::string &oldFilename,
+                      const std::string &filename,
+                      const Hash &hash,
+                      time_t wtime,
+                      int mode,
+                      int seg_num,
+                      const Hash &segmentRoot = Hash ());
 
   ActionItemPtr
   AddLocalActionDelete (const std::string &filename);
@@ -82,6 +115,15 @@ public:
   ActionItemPtr
   AddRemoteAction (boost::shared_ptr<ndn::Data> actionPco);
 
+  /**
+   * @brief Add a batch of remote actions
+   *
+   * All actions are inserted within a single transaction using one prepared statement.  Returned vector
+   * has one element per input action (in the same order); the element is empty if the action could not be decoded.
+   */
+  ActionItems
+  AddRemoteActions (const RemoteActions &actions);
+
   ///////////////////////////
   // General operations    //
   ///////////////////////////
@@ -115,6 +157,22 @@ public:
   void
   LookupRecentFileActions(const boost::function<void (const std::string &, int, int)> &visitor, int limit = 5);
 
+  /**
+   * @brief Device that can serve the content and the device that published it (segments are served under
+   *        the name of the publisher)
+   */
+  typedef std::pair<ndn::Name /*device*/, ndn::Name /*publisher*/> ContentSource;
+
+  /**
+   * @brief Get all devices that have content with the specified hash in their ObjectDb
+   *
+   * These are devices that published the content and devices that recorded a newer version of the same
+   * file, as normally they fetch the content before changing the file (a device that doesn't have it
+   * after all is dropped by the fetcher after a few timeouts).
+   */
+  std::vector<ContentSource>
+  LookupSourcesForHash (const Hash &filehash);
+
   //
   inline FileStatePtr
   GetFileState ();
@@ -125,12 +183,24 @@ public:
   LogSize ();
 
 private:
+  ActionItemPtr
+  addLocalActionUpdate (const std::string &filename,
+                        const Hash &hash,
+                        time_t wtime,
+                        int mode,
+                        int seg_num,
+                        const Hash &segmentRoot,
+                        const std::string &movedFrom);
+
   boost::tuple<sqlite3_int64 /*version*/, ndn::BufferPtr /*device name*/, sqlite3_int64 /*seq_no*/>
   GetLatestActionForFile (const std::string &filename);
 
   boost::shared_ptr<ActionItem>
   deserialize (const ndn::Block &content);
 
+  void
+  insertRemoteAction (sqlite3_stmt *stmt, const RemoteAction &remoteAction, const ActionItem &action);
+
   static void
   apply_action_xFun (sqlite3_context *context, int argc, sqlite3_value **argv);
 
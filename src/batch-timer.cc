@@ -0,0 +1,92 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "batch-timer.h"
+#include "logging.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+INIT_LOGGER ("BatchTimer");
+
+using namespace std;
+using namespace boost;
+
+BatchTimer::BatchTimer (SchedulerPtr scheduler, const string &tag, const boost::function<void ()> &callback)
+  : m_scheduler (scheduler)
+  , m_tag (tag)
+  , m_callback (callback)
+  , m_armed (false)
+  , m_generation (0)
+{
+}
+
+bool
+BatchTimer::Arm (double delay)
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  if (m_armed)
+    return false;
+
+  m_generation ++;
+  TaskPtr task = Scheduler::scheduleOneTimeTask (m_scheduler, delay,
+                                                 bind (&BatchTimer::onTimer, this, m_generation),
+                                                 m_tag + "-" + lexical_cast<string> (m_generation));
+  m_armed = static_cast<bool> (task);
+  if (!m_armed)
+    {
+      _LOG_ERROR ("Cannot schedule " << m_tag);
+    }
+  return m_armed;
+}
+
+void
+BatchTimer::Cancel ()
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  if (!m_armed)
+    return;
+
+  m_scheduler->deleteTask (m_tag + "-" + lexical_cast<string> (m_generation));
+  m_armed = false;
+}
+
+bool
+BatchTimer::IsArmed ()
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  return m_armed;
+}
+
+void
+BatchTimer::onTimer (uint64_t generation)
+{
+  {
+    boost::unique_lock<boost::mutex> lock (m_mutex);
+    if (!m_armed || generation != m_generation)
+      return; // cancelled, but the task was already running
+
+    m_armed = false;
+  }
+
+  m_callback ();
+}
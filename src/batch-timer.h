@@ -0,0 +1,78 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#ifndef BATCH_TIMER_H
+#define BATCH_TIMER_H
+
+#include "scheduler.h"
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <stdint.h>
+
+/**
+ * @brief Invokes the callback once after a delay, no matter how many times the timer is armed meanwhile
+ *
+ * Every arming schedules a task with its own tag, so the timer can be armed again as soon as the
+ * callback starts (including from the callback itself), while the fired task is still registered
+ * in the scheduler.
+ *
+ * Scheduler must be stopped (or the timer cancelled) before the timer is destroyed.
+ */
+class BatchTimer : boost::noncopyable
+{
+public:
+  BatchTimer (SchedulerPtr scheduler, const std::string &tag, const boost::function<void ()> &callback);
+
+  /**
+   * @brief Schedule the callback, if it is not scheduled yet
+   * @returns false if the callback was already scheduled
+   */
+  bool
+  Arm (double delay);
+
+  /**
+   * @brief Cancel scheduled callback (callback that has already started is not affected)
+   */
+  void
+  Cancel ();
+
+  bool
+  IsArmed ();
+
+private:
+  void
+  onTimer (uint64_t generation);
+
+private:
+  SchedulerPtr m_scheduler;
+  std::string m_tag;
+  boost::function<void ()> m_callback;
+
+  bool m_armed;
+  uint64_t m_generation;
+  boost::mutex m_mutex;
+};
+
+#endif // BATCH_TIMER_H
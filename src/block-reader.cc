@@ -0,0 +1,409 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "block-reader.h"
+#include "logging.h"
+
+#include <boost/assert.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+INIT_LOGGER ("BlockReader");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+static const size_t BUFFER_ALIGNMENT = 4096;
+
+static const ssize_t SLOT_EMPTY = -1;
+static const ssize_t SLOT_FAILED = -2;
+
+#ifdef HAVE_LIBURING
+struct BlockReader::Uring
+{
+  io_uring m_ring;
+};
+#endif
+
+BlockReader::BlockReader (const fs::path &file, size_t blockSize/* = DEFAULT_BLOCK_SIZE*/, Backend backend/* = AUTO*/)
+  : m_fd (-1)
+  , m_blockSize ((blockSize + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT)
+  , m_backend (backend)
+  , m_failed (false)
+  , m_current (-1)
+  , m_offset (0)
+  , m_eof (false)
+  , m_stop (false)
+#ifdef HAVE_LIBURING
+  , m_uring (0)
+#endif
+{
+  m_buffers[0] = m_buffers[1] = 0;
+  m_ready[0] = m_ready[1] = SLOT_EMPTY;
+#ifdef HAVE_LIBURING
+  m_pending[0] = m_pending[1] = false;
+#endif
+
+  if (m_blockSize == 0)
+    m_blockSize = BUFFER_ALIGNMENT;
+
+  m_fd = ::open (file.c_str (), O_RDONLY);
+  if (m_fd < 0)
+    {
+      _LOG_DEBUG ("Cannot open [" << file << "]: " << strerror (errno));
+      m_failed = true;
+      return;
+    }
+
+  struct stat st;
+  if (::fstat (m_fd, &st) != 0)
+    {
+      m_failed = true;
+      return;
+    }
+
+  if (m_backend == AUTO)
+    {
+      if (static_cast<uint64_t> (st.st_size) <= m_blockSize)
+        {
+          m_backend = DIRECT;
+          // no need for a large buffer, unless the file grows while it is being read
+          size_t size = (static_cast<size_t> (st.st_size) + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+          m_blockSize = std::max (size, BUFFER_ALIGNMENT);
+        }
+      else
+        m_backend = IO_URING;
+    }
+
+#ifdef HAVE_LIBURING
+  if (m_backend == IO_URING && !setupUring ())
+    m_backend = THREAD;
+#else
+  if (m_backend == IO_URING)
+    m_backend = THREAD;
+#endif
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  if (m_backend != DIRECT)
+    posix_fadvise (m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  int buffers = (m_backend == DIRECT) ? 1 : 2;
+  for (int i = 0; i < buffers; i++)
+    {
+      void *buf = 0;
+      if (posix_memalign (&buf, BUFFER_ALIGNMENT, m_blockSize) != 0)
+        {
+          _LOG_ERROR ("Cannot allocate " << m_blockSize << " bytes for reading [" << file << "]");
+          m_failed = true;
+          return;
+        }
+      m_buffers[i] = reinterpret_cast<uint8_t*> (buf);
+    }
+
+  if (m_backend == THREAD)
+    {
+      m_thread = boost::thread (bind (&BlockReader::readerThread, this));
+    }
+}
+
+BlockReader::~BlockReader ()
+{
+  if (m_thread.joinable ())
+    {
+      {
+        boost::mutex::scoped_lock lock (m_mutex);
+        m_stop = true;
+      }
+      m_cond.notify_all ();
+      m_thread.join ();
+    }
+
+#ifdef HAVE_LIBURING
+  if (m_uring != 0)
+    {
+      // in-flight reads must complete before their buffers are released
+      for (int slot = 0; slot < 2; slot++)
+        {
+          while (m_pending[slot])
+            {
+              io_uring_cqe *cqe = 0;
+              if (io_uring_wait_cqe (&m_uring->m_ring, &cqe) != 0)
+                break;
+              m_pending[io_uring_cqe_get_data64 (cqe)] = false;
+              io_uring_cqe_seen (&m_uring->m_ring, cqe);
+            }
+        }
+      io_uring_queue_exit (&m_uring->m_ring);
+      delete m_uring;
+    }
+#endif
+
+  free (m_buffers[0]);
+  free (m_buffers[1]);
+
+  if (m_fd >= 0)
+    ::close (m_fd);
+}
+
+bool
+BlockReader::IsUringSupported ()
+{
+#ifdef HAVE_LIBURING
+  io_uring ring;
+  if (io_uring_queue_init (2, &ring, 0) != 0)
+    return false;
+  io_uring_queue_exit (&ring);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+BlockReader::Next (const uint8_t *&data, size_t &size)
+{
+  if (m_failed || m_eof)
+    return false;
+
+  switch (m_backend)
+    {
+    case THREAD:
+      return nextThread (data, size);
+#ifdef HAVE_LIBURING
+    case IO_URING:
+      return nextUring (data, size);
+#endif
+    default:
+      return nextDirect (data, size);
+    }
+}
+
+ssize_t
+BlockReader::readBlock (int slot, uint64_t offset)
+{
+  size_t got = 0;
+  while (got < m_blockSize)
+    {
+      ssize_t ret = ::pread (m_fd, m_buffers[slot] + got, m_blockSize - got, offset + got);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+      if (ret == 0)
+        break;
+
+      got += ret;
+    }
+  return got;
+}
+
+bool
+BlockReader::nextDirect (const uint8_t *&data, size_t &size)
+{
+  ssize_t ret = readBlock (0, m_offset);
+  if (ret < 0)
+    {
+      m_failed = true;
+      return false;
+    }
+
+  m_offset += ret;
+  m_eof = (static_cast<size_t> (ret) < m_blockSize);
+
+  data = m_buffers[0];
+  size = ret;
+  return ret > 0;
+}
+
+void
+BlockReader::readerThread ()
+{
+  uint64_t offset = 0;
+  for (int slot = 0; ; slot = 1 - slot)
+    {
+      {
+        boost::mutex::scoped_lock lock (m_mutex);
+        while (!m_stop && m_ready[slot] != SLOT_EMPTY)
+          m_cond.wait (lock);
+
+        if (m_stop)
+          return;
+      }
+
+      ssize_t ret = readBlock (slot, offset);
+
+      {
+        boost::mutex::scoped_lock lock (m_mutex);
+        m_ready[slot] = (ret < 0) ? SLOT_FAILED : ret;
+      }
+      m_cond.notify_all ();
+
+      if (ret < 0 || static_cast<size_t> (ret) < m_blockSize)
+        return;
+
+      offset += ret;
+    }
+}
+
+bool
+BlockReader::nextThread (const uint8_t *&data, size_t &size)
+{
+  int slot = (m_current + 1) % 2;
+
+  boost::mutex::scoped_lock lock (m_mutex);
+  if (m_current >= 0)
+    {
+      // the caller is done with the previous block, let the reader refill it
+      m_ready[m_current] = SLOT_EMPTY;
+      m_cond.notify_all ();
+    }
+
+  while (m_ready[slot] == SLOT_EMPTY)
+    m_cond.wait (lock);
+
+  ssize_t ret = m_ready[slot];
+  if (ret == SLOT_FAILED)
+    {
+      m_failed = true;
+      return false;
+    }
+
+  m_current = slot;
+  m_offset += ret;
+  m_eof = (static_cast<size_t> (ret) < m_blockSize);
+
+  data = m_buffers[slot];
+  size = ret;
+  return ret > 0;
+}
+
+#ifdef HAVE_LIBURING
+
+bool
+BlockReader::setupUring ()
+{
+  m_uring = new Uring;
+  int ret = io_uring_queue_init (2, &m_uring->m_ring, 0);
+  if (ret != 0)
+    {
+      _LOG_DEBUG ("io_uring is not available (" << strerror (-ret) << "), falling back to the reader thread");
+      delete m_uring;
+      m_uring = 0;
+      return false;
+    }
+  return true;
+}
+
+bool
+BlockReader::submitUring (int slot, uint64_t offset)
+{
+  io_uring_sqe *sqe = io_uring_get_sqe (&m_uring->m_ring);
+  if (sqe == 0)
+    return false;
+
+  io_uring_prep_read (sqe, m_fd, m_buffers[slot], m_blockSize, offset);
+  io_uring_sqe_set_data64 (sqe, slot);
+
+  if (io_uring_submit (&m_uring->m_ring) != 1)
+    return false;
+
+  m_pending[slot] = true;
+  return true;
+}
+
+bool
+BlockReader::nextUring (const uint8_t *&data, size_t &size)
+{
+  int slot = (m_current + 1) % 2;
+
+  if (!m_pending[slot] && !submitUring (slot, m_offset))
+    {
+      m_failed = true;
+      return false;
+    }
+
+  io_uring_cqe *cqe = 0;
+  if (io_uring_wait_cqe (&m_uring->m_ring, &cqe) != 0)
+    {
+      m_failed = true;
+      return false;
+    }
+  BOOST_ASSERT (io_uring_cqe_get_data64 (cqe) == static_cast<uint64_t> (slot));
+  int ret = cqe->res;
+  io_uring_cqe_seen (&m_uring->m_ring, cqe);
+  m_pending[slot] = false;
+
+  if (ret < 0)
+    {
+      m_failed = true;
+      return false;
+    }
+
+  if (ret > 0 && static_cast<size_t> (ret) < m_blockSize)
+    {
+      // short read does not necessarily mean the end of the file, top it up synchronously
+      while (static_cast<size_t> (ret) < m_blockSize)
+        {
+          ssize_t more = ::pread (m_fd, m_buffers[slot] + ret, m_blockSize - ret, m_offset + ret);
+          if (more < 0 && errno == EINTR)
+            continue;
+          if (more < 0)
+            {
+              m_failed = true;
+              return false;
+            }
+          if (more == 0)
+            break;
+          ret += more;
+        }
+    }
+
+  m_current = slot;
+  m_offset += ret;
+  m_eof = (static_cast<size_t> (ret) < m_blockSize);
+
+  // start reading the next block while the caller is processing this one
+  if (!m_eof && !submitUring (1 - slot, m_offset))
+    {
+      m_failed = true;
+      return false;
+    }
+
+  data = m_buffers[slot];
+  size = ret;
+  return ret > 0;
+}
+
+#endif // HAVE_LIBURING
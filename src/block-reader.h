@@ -0,0 +1,129 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef BLOCK_READER_H
+#define BLOCK_READER_H
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <sys/types.h>
+#include <stdint.h>
+
+/**
+ * @brief Sequential reader of a file in large aligned blocks
+ *
+ * Two buffers are used: while the caller processes one block (e.g., computes a digest), the next
+ * block is being read into the other buffer, either by io_uring (Linux, if available) or by a
+ * helper thread.  Files that fit into one block are read directly, without any of that.
+ */
+class BlockReader
+{
+public:
+  static const size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+  enum Backend
+    {
+      AUTO,     ///< DIRECT for small files, IO_URING if available, THREAD otherwise
+      DIRECT,   ///< plain read () in the calling thread, no overlap
+      THREAD,   ///< next block is read by a helper thread
+      IO_URING  ///< next block is read asynchronously by the kernel
+    };
+
+  BlockReader (const boost::filesystem::path &file, size_t blockSize = DEFAULT_BLOCK_SIZE, Backend backend = AUTO);
+  ~BlockReader ();
+
+  bool
+  IsOpen () const { return m_fd >= 0; }
+
+  /**
+   * @brief Get the next block of the file
+   *
+   * The block stays valid until the next call
+   * @returns false at the end of the file or if reading failed (see HasFailed)
+   */
+  bool
+  Next (const uint8_t *&data, size_t &size);
+
+  bool
+  HasFailed () const { return m_failed; }
+
+  /**
+   * @brief Backend actually used (AUTO is resolved on open, IO_URING falls back to THREAD if it cannot be set up)
+   */
+  Backend
+  GetBackend () const { return m_backend; }
+
+  static bool
+  IsUringSupported ();
+
+private:
+  // read up to m_blockSize bytes at the offset (short only at the end of the file), -1 on error
+  ssize_t
+  readBlock (int slot, uint64_t offset);
+
+  bool
+  nextDirect (const uint8_t *&data, size_t &size);
+
+  bool
+  nextThread (const uint8_t *&data, size_t &size);
+
+  void
+  readerThread ();
+
+#ifdef HAVE_LIBURING
+  bool
+  setupUring ();
+
+  bool
+  submitUring (int slot, uint64_t offset);
+
+  bool
+  nextUring (const uint8_t *&data, size_t &size);
+#endif
+
+private:
+  int m_fd;
+  size_t m_blockSize;
+  Backend m_backend;
+  bool m_failed;
+
+  uint8_t *m_buffers[2];
+  int m_current;      // slot returned by the last Next ()
+  uint64_t m_offset;  // offset of the next block to be requested
+  bool m_eof;
+
+  // THREAD backend
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+  boost::thread m_thread;
+  ssize_t m_ready[2]; // bytes in the slot (-1 if not filled yet)
+  bool m_stop;
+
+#ifdef HAVE_LIBURING
+  struct Uring;
+  Uring *m_uring;
+  bool m_pending[2];  // read for the slot is in flight
+#endif
+};
+
+#endif // BLOCK_READER_H
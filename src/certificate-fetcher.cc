@@ -0,0 +1,137 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "certificate-fetcher.h"
+#include "logging.h"
+
+#include <ndn-cxx/face.hpp>
+#include <algorithm>
+
+INIT_LOGGER ("CertificateFetcher");
+
+using namespace std;
+using namespace boost;
+
+CertificateFetcher::CertificateFetcher (VerificationService &service, int timeout/* = DEFAULT_TIMEOUT*/)
+  : m_service (service)
+  , m_timeout (timeout)
+{
+}
+
+static void
+onCertificate (boost::shared_ptr<ndn::Data> &result, const ndn::Interest &interest, ndn::Data &data)
+{
+  result = boost::make_shared<ndn::Data> (data);
+}
+
+static void
+onTimeout (const ndn::Interest &interest)
+{
+  _LOG_DEBUG ("Timeout fetching certificate " << interest.getName ());
+}
+
+bool
+CertificateFetcher::Fetch (const ndn::Name &keyName, ndn::Buffer &publicKey, time_t &notAfter)
+{
+  {
+    boost::unique_lock<boost::mutex> lock (m_keyChainMutex);
+    if (m_keyChain.doesCertificateExist (keyName))
+      {
+        // installed locally, trusted as is
+        boost::shared_ptr<ndn::IdentityCertificate> certificate = m_keyChain.getCertificate (keyName);
+        publicKey = certificate->getPublicKeyInfo ().get ();
+        notAfter = ndn::time::system_clock::to_time_t (certificate->getNotAfter ());
+        _LOG_DEBUG ("Certificate " << keyName << " is in the KeyChain");
+        return true;
+      }
+  }
+
+  if (m_chain.get () == 0)
+    {
+      m_chain.reset (new std::vector<ndn::Name>);
+    }
+  std::vector<ndn::Name> &chain = *m_chain;
+  if (chain.size () >= MAX_CHAIN_LENGTH || std::find (chain.begin (), chain.end (), keyName) != chain.end ())
+    {
+      _LOG_ERROR ("Certificate chain of " << keyName << " does not end in the KeyChain");
+      return false;
+    }
+
+  boost::shared_ptr<ndn::Data> data = fetchData (keyName);
+  if (!data)
+    {
+      return false;
+    }
+
+  // certificate of the issuer is fetched by a nested call, if it is not in the cache
+  chain.push_back (keyName);
+  bool verified = m_service.VerifyNow (*data);
+  chain.pop_back ();
+
+  if (!verified)
+    {
+      _LOG_ERROR ("Certificate " << data->getName () << " is not signed by a valid certificate");
+      return false;
+    }
+
+  try
+    {
+      ndn::IdentityCertificate certificate (*data);
+      if (certificate.getNotBefore () > ndn::time::system_clock::now ())
+        {
+          _LOG_ERROR ("Certificate " << data->getName () << " is not yet valid");
+          return false;
+        }
+
+      publicKey = certificate.getPublicKeyInfo ().get ();
+      notAfter = ndn::time::system_clock::to_time_t (certificate.getNotAfter ());
+    }
+  catch (std::exception &error)
+    {
+      _LOG_ERROR ("Cannot decode certificate " << data->getName () << ": " << error.what ());
+      return false;
+    }
+
+  _LOG_DEBUG ("Fetched and validated certificate " << data->getName ());
+  return true;
+}
+
+boost::shared_ptr<ndn::Data>
+CertificateFetcher::fetchData (const ndn::Name &keyName)
+{
+  boost::shared_ptr<ndn::Data> result;
+  try
+    {
+      // own face, as the fetch blocks the worker thread until the certificate arrives
+      ndn::Face face;
+      face.expressInterest (ndn::Interest (keyName, ndn::time::milliseconds (m_timeout)),
+                            bind (onCertificate, boost::ref (result), _1, _2),
+                            bind (onTimeout, _1));
+      face.processEvents (ndn::time::milliseconds (m_timeout));
+    }
+  catch (std::exception &error)
+    {
+      _LOG_ERROR ("Cannot fetch certificate " << keyName << ": " << error.what ());
+    }
+
+  return result;
+}
@@ -0,0 +1,75 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#ifndef CERTIFICATE_FETCHER_H
+#define CERTIFICATE_FETCHER_H
+
+#include "verification-service.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/identity-certificate.hpp>
+#include <ctime>
+#include <vector>
+
+/**
+ * @brief KeyFetcher of VerificationService: certificates are taken from the local KeyChain
+ *        (trust anchors) or fetched and validated up to a certificate in the KeyChain
+ *
+ * Signature of the fetched certificate is checked by the service, so the issuer's certificate
+ * is fetched the same way (and cached) if needed.
+ */
+class CertificateFetcher
+{
+public:
+  static const int DEFAULT_TIMEOUT = 4000; // milliseconds
+  static const size_t MAX_CHAIN_LENGTH = 8;
+
+  /**
+   * @param service service that uses the fetcher (it must outlive the fetcher)
+   */
+  CertificateFetcher (VerificationService &service, int timeout = DEFAULT_TIMEOUT);
+
+  /**
+   * @brief See VerificationService::KeyFetcher (can be called from several worker threads at once)
+   */
+  bool
+  Fetch (const ndn::Name &keyName, ndn::Buffer &publicKey, time_t &notAfter);
+
+private:
+  boost::shared_ptr<ndn::Data>
+  fetchData (const ndn::Name &keyName);
+
+private:
+  VerificationService &m_service;
+  int m_timeout;
+  ndn::KeyChain m_keyChain;
+  boost::mutex m_keyChainMutex;
+
+  // certificates being validated by the thread, to stop on loops and too long chains
+  boost::thread_specific_ptr<std::vector<ndn::Name> > m_chain;
+};
+
+typedef boost::shared_ptr<CertificateFetcher> CertificateFetcherPtr;
+
+#endif // CERTIFICATE_FETCHER_H
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "concurrency-controller.h"
+#include "logging.h"
+
+#include <algorithm>
+
+INIT_LOGGER ("ConcurrencyController");
+
+static const double GOODPUT_GAIN = 1.05;   // increase is considered useful if goodput grew by at least 5%
+static const double GOODPUT_LOSS = 0.90;   // increase is considered harmful if goodput dropped by more than 10%
+static const double DELAY_DECREASE = 0.75;
+
+ConcurrencyController::ConcurrencyController (uint32_t initial, uint32_t minLimit/* = 1*/, uint32_t maxLimit/* = 64*/,
+                                              double maxQueueingDelay/* = 0.2*/)
+  : m_limit (initial)
+  , m_minLimit (minLimit)
+  , m_maxLimit (maxLimit)
+  , m_maxQueueingDelay (maxQueueingDelay)
+  , m_lastGoodput (0)
+  , m_lastIncreased (false)
+{
+  SetLimits (minLimit, maxLimit);
+}
+
+void
+ConcurrencyController::SetLimits (uint32_t minLimit, uint32_t maxLimit)
+{
+  m_minLimit = std::max<uint32_t> (minLimit, 1);
+  m_maxLimit = std::max (maxLimit, m_minLimit);
+  m_limit = std::min (std::max (m_limit, m_minLimit), m_maxLimit);
+}
+
+uint32_t
+ConcurrencyController::Update (double goodput, double queueingDelay, bool backlogged)
+{
+  uint32_t oldLimit = m_limit;
+  bool increased = false;
+
+  if (queueingDelay > m_maxQueueingDelay)
+    {
+      // link is saturated, more parallel fetches would only add delay
+      m_limit = static_cast<uint32_t> (m_limit * DELAY_DECREASE);
+    }
+  else if (m_lastIncreased && goodput < m_lastGoodput * GOODPUT_LOSS)
+    {
+      // last increase made things worse
+      m_limit --;
+    }
+  else if (backlogged && goodput > m_lastGoodput * GOODPUT_GAIN)
+    {
+      m_limit ++;
+      increased = true;
+    }
+
+  m_limit = std::min (std::max (m_limit, m_minLimit), m_maxLimit);
+  m_lastIncreased = increased && m_limit > oldLimit;
+  m_lastGoodput = goodput;
+
+  _LOG_DEBUG_COND (m_limit != oldLimit, "Parallel fetch limit " << oldLimit << " -> " << m_limit
+                   << " (goodput: " << goodput << ", queueing delay: " << queueingDelay << ")");
+
+  return m_limit;
+}
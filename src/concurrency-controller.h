@@ -0,0 +1,77 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef CONCURRENCY_CONTROLLER_H
+#define CONCURRENCY_CONTROLLER_H
+
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+
+/**
+ * @brief Hill-climbing controller for the number of parallel fetches
+ *
+ * Periodically fed with aggregate goodput and queueing delay (smoothed RTT above the minimum
+ * observed RTT).  While there is a backlog, the limit grows as long as goodput keeps improving
+ * (by at least a few percent since the previous update, flat goodput keeps the limit unchanged),
+ * backs off when an increase did not pay off, and is cut multiplicatively when queueing delay
+ * indicates that the link is saturated.
+ */
+class ConcurrencyController
+{
+public:
+  ConcurrencyController (uint32_t initial, uint32_t minLimit = 1, uint32_t maxLimit = 64,
+                         double maxQueueingDelay = 0.2/*seconds*/);
+
+  /**
+   * @brief Update the limit
+   * @param goodput         aggregate goodput (bytes/second) since the last update
+   * @param queueingDelay   current estimate of queueing delay (seconds)
+   * @param backlogged      whether there are fetches waiting for a free slot
+   * @returns new limit
+   */
+  uint32_t
+  Update (double goodput, double queueingDelay, bool backlogged);
+
+  uint32_t
+  GetLimit () const { return m_limit; }
+
+  void
+  SetLimits (uint32_t minLimit, uint32_t maxLimit);
+
+  uint32_t
+  GetMinLimit () const { return m_minLimit; }
+
+  uint32_t
+  GetMaxLimit () const { return m_maxLimit; }
+
+private:
+  uint32_t m_limit;
+  uint32_t m_minLimit;
+  uint32_t m_maxLimit;
+  double m_maxQueueingDelay;
+
+  double m_lastGoodput;
+  bool m_lastIncreased;
+};
+
+typedef boost::shared_ptr<ConcurrencyController> ConcurrencyControllerPtr;
+
+#endif // CONCURRENCY_CONTROLLER_H
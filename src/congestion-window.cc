@@ -0,0 +1,159 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "congestion-window.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+INIT_LOGGER ("CongestionWindow");
+
+using namespace boost;
+using namespace boost::posix_time;
+
+static const double MULTIPLICATIVE_DECREASE = 0.5;
+
+static const double CUBIC_C = 0.4;
+static const double CUBIC_BETA = 0.7; // window after decrease is CUBIC_BETA * W_max
+
+CongestionWindow::CongestionWindow (Algorithm algorithm/* = AIMD*/,
+                                    double initialWindow/* = 6.0*/,
+                                    double minWindow/* = 1.0*/,
+                                    double maxWindow/* = 1024.0*/)
+  : m_algorithm (algorithm)
+  , m_window (initialWindow)
+  , m_minWindow (minWindow)
+  , m_maxWindow (maxWindow)
+  , m_slowStartThreshold (maxWindow)
+  , m_inFlight (0)
+  , m_lastDecrease (neg_infin)
+  , m_windowBeforeDecrease (initialWindow)
+{
+}
+
+ptime
+CongestionWindow::Now ()
+{
+  return microsec_clock::universal_time ();
+}
+
+bool
+CongestionWindow::TryAcquire ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  if (m_inFlight >= static_cast<uint32_t> (m_window))
+    return false;
+
+  m_inFlight ++;
+  return true;
+}
+
+void
+CongestionWindow::Release ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  if (m_inFlight > 0)
+    m_inFlight --;
+}
+
+void
+CongestionWindow::OnData ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  if (m_inFlight > 0)
+    m_inFlight --;
+
+  increase ();
+}
+
+void
+CongestionWindow::OnTimeout (const ptime &sendTime)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  if (sendTime <= m_lastDecrease)
+    {
+      // already reacted to this loss event
+      return;
+    }
+
+  decrease (Now ());
+}
+
+double
+CongestionWindow::GetWindowSize () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_window;
+}
+
+uint32_t
+CongestionWindow::GetInFlight () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_inFlight;
+}
+
+void
+CongestionWindow::increase ()
+{
+  if (m_window < m_slowStartThreshold)
+    {
+      m_window += 1.0;
+    }
+  else if (m_algorithm == CUBIC && !m_lastDecrease.is_special ())
+    {
+      double t = (Now () - m_lastDecrease).total_microseconds () / 1000000.0;
+      double k = std::pow (m_windowBeforeDecrease * (1 - CUBIC_BETA) / CUBIC_C, 1.0 / 3.0);
+      double target = CUBIC_C * std::pow (t - k, 3.0) + m_windowBeforeDecrease;
+
+      // never grow slower than AIMD would
+      m_window += std::max (target - m_window, 1.0) / m_window;
+    }
+  else
+    {
+      m_window += 1.0 / m_window;
+    }
+
+  m_window = std::min (m_window, m_maxWindow);
+}
+
+void
+CongestionWindow::decrease (const ptime &now)
+{
+  m_windowBeforeDecrease = m_window;
+
+  if (m_algorithm == CUBIC)
+    m_window *= CUBIC_BETA;
+  else
+    m_window *= MULTIPLICATIVE_DECREASE;
+
+  m_window = std::max (m_window, m_minWindow);
+  m_slowStartThreshold = m_window;
+  m_lastDecrease = now;
+
+  _LOG_DEBUG ("Window decreased from " << m_windowBeforeDecrease << " to " << m_window);
+}
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef CONGESTION_WINDOW_H
+#define CONGESTION_WINDOW_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <stdint.h>
+
+/**
+ * @brief Interest window shared by all fetchers that retrieve data from the same peer
+ *
+ * Window grows by one per Data in slow start and by 1/window per Data in congestion
+ * avoidance.  On a timeout the window is cut multiplicatively, at most once per loss event:
+ * timeouts of Interests that were sent before the last decrease are attributed to the same event.
+ *
+ * With CUBIC algorithm, congestion avoidance follows W(t) = C*(t-K)^3 + W_max instead of
+ * the linear increase, recovering to the pre-loss window much faster on high-bandwidth links.
+ */
+class CongestionWindow
+{
+public:
+  enum Algorithm
+    {
+      AIMD,
+      CUBIC
+    };
+
+  CongestionWindow (Algorithm algorithm = AIMD,
+                    double initialWindow = 6.0,
+                    double minWindow = 1.0,
+                    double maxWindow = 1024.0);
+
+  /**
+   * @brief Reserve a slot for a new Interest
+   * @returns false if the window is already full
+   */
+  bool
+  TryAcquire ();
+
+  /**
+   * @brief Release slot without any congestion signal (e.g., fetch was cancelled)
+   */
+  void
+  Release ();
+
+  /**
+   * @brief Data for an Interest received, slot is released
+   */
+  void
+  OnData ();
+
+  /**
+   * @brief Interest sent at sendTime timed out
+   *
+   * The slot is NOT released, as it is expected that the Interest is retransmitted.
+   * Use Release () if it will not be.
+   */
+  void
+  OnTimeout (const boost::posix_time::ptime &sendTime);
+
+  double
+  GetWindowSize () const;
+
+  uint32_t
+  GetInFlight () const;
+
+  static boost::posix_time::ptime
+  Now ();
+
+private:
+  void
+  increase ();
+
+  void
+  decrease (const boost::posix_time::ptime &now);
+
+private:
+  Algorithm m_algorithm;
+
+  double m_window;
+  double m_minWindow;
+  double m_maxWindow;
+  double m_slowStartThreshold;
+  uint32_t m_inFlight;
+
+  // last decrease, to detect multiple timeouts belonging to the same loss event
+  boost::posix_time::ptime m_lastDecrease;
+
+  // for CUBIC
+  double m_windowBeforeDecrease;
+
+  mutable boost::mutex m_mutex;
+};
+
+typedef boost::shared_ptr<CongestionWindow> CongestionWindowPtr;
+
+#endif // CONGESTION_WINDOW_H
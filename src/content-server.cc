@@ -20,6 +20,7 @@
  */
 
 #include "content-server.h"
+#include "merkle-tree.h"
 #include "logging.h"
 #include <boost/make_shared.hpp>
 #include <utility>
@@ -28,6 +29,7 @@
 #include "simple-interval-generator.h"
 #include <boost/lexical_cast.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <ndn-cxx/face.hpp>
 
 INIT_LOGGER ("ContentServer");
@@ -37,6 +39,7 @@ using namespace std;
 using namespace boost;
 
 static const int DB_CACHE_LIFETIME = 60;
+static const int DEFAULT_INTEREST_LIFETIME = 4000; // milliseconds, if not specified in the Interest
 
 ContentServer::ContentServer(ActionLogPtr actionLog,
                              const boost::filesystem::path &rootDir,
@@ -51,6 +54,7 @@ ContentServer::ContentServer(ActionLogPtr actionLog,
   , m_userName (userName)
   , m_sharedFolderName (sharedFolderName)
   , m_appName (appName)
+  , m_signingMode (ObjectManager::SIGN_DIGEST)
 {
   m_scheduler->start ();
   TaskPtr flushStaleDbCacheTask = boost::make_shared<PeriodicTask>(boost::bind(&ContentServer::flushStaleDbCache, this), "flush-state-db-cache", m_scheduler, boost::make_shared<SimpleIntervalGenerator>(DB_CACHE_LIFETIME));
@@ -79,7 +83,7 @@ ContentServer::registerPrefix (const ndn::Name &forwardingHint)
 
   _LOG_DEBUG (">> content server: register " << forwardingHint);
 
-  const ndn::RegisteredPrefixId *id = m_ndn->setInterestFilter (ndn::InterestFilter(forwardingHint), bind(&ContentServer::filterAndServe, this, forwardingHint, _1), bind(&ContentServer::doNothing, this));
+  const ndn::RegisteredPrefixId *id = m_ndn->setInterestFilter (ndn::InterestFilter(forwardingHint), bind(&ContentServer::filterAndServe, this, forwardingHint, _2), bind(&ContentServer::doNothing, this));
 
   ScopedLock lock (m_mutex);
   //m_prefixes.insert(tuple<ndn::Name, ndn::RegisteredPrefixId>(forwardingHint, id)); //TODO fix later...
@@ -114,7 +118,8 @@ ContentServer::deregisterPrefix (const ndn::RegisteredPrefixId &forwardingHint)
 
 
 void
-ContentServer::filterAndServeImpl (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest)
+ContentServer::filterAndServeImpl (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest,
+                                   const posix_time::ptime &deadline)
 {
   // interest for files:   /<forwarding-hint>/<device_name>/<appname>/file/<hash>/<segment>
   // interest for actions: /<forwarding-hint>/<device_name>/<appname>/action/<shared-folder>/<action-seq>
@@ -127,7 +132,7 @@ ContentServer::filterAndServeImpl (const ndn::Name &forwardingHint, const ndn::N
      string type = name.get (-3).toUri ();
      if (type == "file")
      {
-        serve_File (forwardingHint, name, interest);
+        serve_File (forwardingHint, name, interest, deadline);
      }
      else if (type == "action")
      {
@@ -147,16 +152,21 @@ ContentServer::doNothing ()
 }
 
 void
-ContentServer::filterAndServe (ndn::Name forwardingHint, const ndn::Name &interest)
+ContentServer::filterAndServe (ndn::Name forwardingHint, const ndn::Interest &interestPacket)
 {
+   const ndn::Name &interest = interestPacket.getName ();
+   int64_t lifetime = interestPacket.getInterestLifetime ().count ();
+   posix_time::ptime deadline = posix_time::microsec_clock::universal_time () +
+     posix_time::milliseconds (lifetime >= 0 ? lifetime : DEFAULT_INTEREST_LIFETIME);
+
    if (forwardingHint.size () > 0 &&
        m_userName.size () >= forwardingHint.size () &&
        m_userName.getSubName (0, forwardingHint.size ()) == forwardingHint)
    {
-      filterAndServeImpl (Name ("/"), interest, interest); // try without forwarding hints
+      filterAndServeImpl (Name ("/"), interest, interest, deadline); // try without forwarding hints
    }
 
-      filterAndServeImpl (forwardingHint, interest.getSubName (forwardingHint.size()), interest); // always try with hint... :( have to
+      filterAndServeImpl (forwardingHint, interest.getSubName (forwardingHint.size()), interest, deadline); // always try with hint... :( have to
 }
 
 void
@@ -168,16 +178,18 @@ ContentServer::serve_Action (const ndn::Name &forwardingHint, const ndn::Name &n
 }
 
 void
-ContentServer::serve_File (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest)
+ContentServer::serve_File (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest,
+                           const posix_time::ptime &deadline)
 {
   _LOG_DEBUG (">> content server serving FILE, hint: " << forwardingHint << ", interest: " << interest);
 
-  m_scheduler->scheduleOneTimeTask (m_scheduler, 0, bind (&ContentServer::serve_File_Execute, this, forwardingHint, name, interest), boost::lexical_cast<string>(name));
+  m_scheduler->scheduleOneTimeTask (m_scheduler, 0, bind (&ContentServer::serve_File_Execute, this, forwardingHint, name, interest, deadline), boost::lexical_cast<string>(name));
   // need to unlock ccnx mutex... or at least don't lock it
 }
 
 void
-ContentServer::serve_File_Execute (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest)
+ContentServer::serve_File_Execute (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest,
+                                   const posix_time::ptime &deadline)
 {
   // forwardingHint: /<forwarding-hint>
   // interest:       /<forwarding-hint>/<device_name>/<appname>/file/<hash>/<segment>
@@ -216,7 +228,8 @@ ContentServer::serve_File_Execute (const ndn::Name &forwardingHint, const ndn::N
 
   if (db)
   {
-	ndn::BufferPtr co = db->fetchSegment (deviceName, segment);
+    std::string proof;
+	ndn::BufferPtr co = db->fetchSegment (deviceName, segment, proof);
     if (co)
       {
         if (forwardingHint.size () == 0)
@@ -224,7 +237,9 @@ ContentServer::serve_File_Execute (const ndn::Name &forwardingHint, const ndn::N
             _LOG_DEBUG (ParsedContentObject (*co).name ());
             ndn::Data data;
             data.setContent(co->buf (), co->size ());
-            m_ndn->put(data);
+            MerkleTree::AttachProof (data, proof);
+            ObjectManager::SignSegment (m_keyChain, m_signingMode, data);
+            put(data, deadline);
           }
         else
           {
@@ -234,14 +249,18 @@ ContentServer::serve_File_Execute (const ndn::Name &forwardingHint, const ndn::N
                 data.setName(interest);
                 data.setFreshnessPeriod(time::seconds(m_freshness));
                 data.setContent(co->buf (), co->size ());
-                m_ndn->put(data);
+                MerkleTree::AttachProof (data, proof);
+                ObjectManager::SignSegment (m_keyChain, m_signingMode, data);
+                put(data, deadline);
               }
             else
               {
                 ndn::Data data;
                 data.setName(interest);
                 data.setContent(co->buf (), co->size ());
-                m_ndn->put(data);
+                MerkleTree::AttachProof (data, proof);
+                ObjectManager::SignSegment (m_keyChain, m_signingMode, data);
+                put(data, deadline);
               }
           }
 
@@ -254,6 +273,43 @@ ContentServer::serve_File_Execute (const ndn::Name &forwardingHint, const ndn::N
   }
 }
 
+void
+ContentServer::put (const ndn::Data &data, const posix_time::ptime &deadline)
+{
+  if (!m_rateLimiter)
+    {
+      m_ndn->put (data);
+      return;
+    }
+
+  // NDN Interests don't tell who is asking, so only the global limit applies to uploads
+  double delay = m_rateLimiter->GetDelay (ndn::Name ());
+  if (delay > 0)
+    {
+      if (posix_time::microsec_clock::universal_time () + posix_time::microseconds (static_cast<int64_t> (delay * 1000000)) > deadline)
+        {
+          // the Interest will be expressed again, if still needed
+          _LOG_DEBUG ("Upload rate limit: " << data.getName () << " would be sent after the Interest expires, dropping");
+          return;
+        }
+
+      if (!Scheduler::scheduleOneTimeTask (m_scheduler, delay, bind (&ndn::Face::put, m_ndn, data),
+                                           lexical_cast<string> (data.getName ()) + "-put"))
+        {
+          // the same Data is already waiting to be sent (e.g., Interest was retransmitted)
+          return;
+        }
+      _LOG_DEBUG ("Upload rate limit: delaying " << data.getName () << " by " << delay << " seconds");
+    }
+  else
+    {
+      m_ndn->put (data);
+    }
+
+  // charged only for the Data that is actually sent
+  m_rateLimiter->Consume (ndn::Name (), data.getContent ().value_size ());
+}
+
 void
 ContentServer::serve_Action_Execute (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest)
 {
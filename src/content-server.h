@@ -23,12 +23,15 @@
 #define CONTENT_SERVER_H
 
 #include "object-db.h"
+#include "object-manager.h"
 #include "action-log.h"
 #include <set>
 #include <map>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include "scheduler.h"
+#include "rate-limiter.h"
 #include <ndn-cxx/face.hpp>
 
 class ContentServer
@@ -47,32 +50,52 @@ public:
   void deregisterPrefix(const ndn::RegisteredPrefixId &forwardingHint);
   void deregisterPrefix(const ndn::Name &forwardingHint);
 
+  // limits upload rate of file segments (actions are not limited)
+  void
+  SetRateLimiter (RateLimiterPtr rateLimiter) { m_rateLimiter = rateLimiter; }
+
+  /**
+   * @brief Set how served file segments are signed (SIGN_DIGEST by default)
+   */
+  void
+  SetSigningMode (ObjectManager::SigningMode mode) { m_signingMode = mode; }
+
 private:
 
   void
   doNothing ();
 
   void
-  filterAndServe (ndn::Name forwardingHint, const ndn::Name &interest);
+  filterAndServe (ndn::Name forwardingHint, const ndn::Interest &interest);
 
+  // deadline: when the Interest expires, Data sent after that is useless
   void
-  filterAndServeImpl (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest);
+  filterAndServeImpl (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest,
+                      const boost::posix_time::ptime &deadline);
 
   void
   serve_Action (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest);
 
   void
-  serve_File (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest);
+  serve_File (const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest,
+              const boost::posix_time::ptime &deadline);
 
   void
   serve_Action_Execute(const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest);
 
   void
-  serve_File_Execute(const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest);
+  serve_File_Execute(const ndn::Name &forwardingHint, const ndn::Name &name, const ndn::Name &interest,
+                     const boost::posix_time::ptime &deadline);
 
   void
   flushStaleDbCache();
 
+  /**
+   * @brief Send data, delayed if upload rate is limited (dropped if it cannot be sent before the deadline)
+   */
+  void
+  put (const ndn::Data &data, const boost::posix_time::ptime &deadline);
+
 private:
   shared_ptr<ndn::Face> m_ndn;
   ActionLogPtr m_actionLog;
@@ -94,5 +117,10 @@ private:
   ndn::Name m_userName;
   std::string m_sharedFolderName;
   std::string m_appName;
+
+  RateLimiterPtr m_rateLimiter;
+
+  ndn::KeyChain m_keyChain;
+  ObjectManager::SigningMode m_signingMode;
 };
 #endif // CONTENT_SERVER_H
@@ -105,7 +105,7 @@ DbHelper::hash_xStep (sqlite3_context *context, int argc, sqlite3_value **argv)
       return;
     }
 
-  EVP_MD_CTX **hash_context = reinterpret_cast<EVP_MD_CTX **> (sqlite3_aggregate_context (context, sizeof (EVP_MD_CTX *)));
+  Digest **hash_context = reinterpret_cast<Digest **> (sqlite3_aggregate_context (context, sizeof (Digest *)));
 
   if (hash_context == 0)
     {
@@ -115,22 +115,22 @@ DbHelper::hash_xStep (sqlite3_context *context, int argc, sqlite3_value **argv)
 
   if (*hash_context == 0)
     {
-      *hash_context = EVP_MD_CTX_create ();
-      EVP_DigestInit_ex (*hash_context, HASH_FUNCTION (), 0);
+      // state digests are compared between peers, so they do not depend on the configured content digest
+      *hash_context = new Digest (Digest::SHA256);
     }
 
   int nameBytes       = sqlite3_value_bytes (argv[0]);
   const void *name    = sqlite3_value_blob  (argv[0]);
   sqlite3_int64 seqno = sqlite3_value_int64 (argv[1]);
 
-  EVP_DigestUpdate (*hash_context, name, nameBytes);
-  EVP_DigestUpdate (*hash_context, &seqno, sizeof(sqlite3_int64));
+  (*hash_context)->Update (name, nameBytes);
+  (*hash_context)->Update (&seqno, sizeof(sqlite3_int64));
 }
 
 void
 DbHelper::hash_xFinal (sqlite3_context *context)
 {
-  EVP_MD_CTX **hash_context = reinterpret_cast<EVP_MD_CTX **> (sqlite3_aggregate_context (context, sizeof (EVP_MD_CTX *)));
+  Digest **hash_context = reinterpret_cast<Digest **> (sqlite3_aggregate_context (context, sizeof (Digest *)));
 
   if (hash_context == 0)
     {
@@ -145,16 +145,12 @@ DbHelper::hash_xFinal (sqlite3_context *context)
       return;
     }
 
-  unsigned char *hash = new unsigned char [EVP_MAX_MD_SIZE];
-  unsigned int hashLength = 0;
-
-  int ok = EVP_DigestFinal_ex (*hash_context,
-			       hash, &hashLength);
+  unsigned char hash[Digest::MAX_SIZE];
+  unsigned int hashLength = (*hash_context)->Final (hash);
 
   sqlite3_result_blob (context, hash, hashLength, SQLITE_TRANSIENT); //SQLITE_TRANSIENT forces to make a copy
-  delete [] hash;
 
-  EVP_MD_CTX_destroy (*hash_context);
+  delete *hash_context;
 }
 
 void
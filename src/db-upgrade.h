@@ -0,0 +1,86 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#ifndef DB_UPGRADE_H
+#define DB_UPGRADE_H
+
+#include <sqlite3.h>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief Column that was added to the table after databases had already been created by earlier versions
+ */
+struct ColumnUpgrade
+{
+  const char *m_table;
+  const char *m_column;
+  const char *m_definition; // type and constraints, as in ALTER TABLE ... ADD COLUMN
+};
+
+inline bool
+HasColumn (sqlite3 *db, const char *table, const char *column)
+{
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v2 (db, (std::string ("PRAGMA table_info(") + table + ")").c_str (), -1, &stmt, 0) != SQLITE_OK)
+    return false;
+
+  bool found = false;
+  while (!found && sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      // columns of table_info: cid, name, type, notnull, dflt_value, pk
+      const char *name = reinterpret_cast<const char*> (sqlite3_column_text (stmt, 1));
+      found = name != 0 && strcmp (name, column) == 0;
+    }
+  sqlite3_finalize (stmt);
+  return found;
+}
+
+/**
+ * @brief Add columns that are missing in the database created by an earlier version
+ *
+ * CREATE TABLE statements of the current schema already have all the columns, so columns are added only
+ * to the tables that existed before, and only if PRAGMA table_info does not list them.
+ *
+ * @returns false if any of the missing columns cannot be added
+ */
+template<size_t N>
+inline bool
+AddMissingColumns (sqlite3 *db, const ColumnUpgrade (&columns)[N])
+{
+  bool ok = true;
+  for (size_t i = 0; i < N; i++)
+    {
+      if (HasColumn (db, columns[i].m_table, columns[i].m_column))
+        continue;
+
+      std::string sql = std::string ("ALTER TABLE ") + columns[i].m_table +
+        " ADD COLUMN " + columns[i].m_column + " " + columns[i].m_definition;
+      if (sqlite3_exec (db, sql.c_str (), NULL, NULL, NULL) != SQLITE_OK)
+        {
+          ok = false;
+        }
+    }
+  return ok;
+}
+
+#endif // DB_UPGRADE_H
@@ -0,0 +1,257 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "digest.h"
+#include "logging.h"
+
+#include <boost/throw_exception.hpp>
+#include <openssl/evp.h>
+#include <string.h>
+
+#ifdef HAVE_BLAKE3
+#include <blake3.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+INIT_LOGGER ("Digest");
+
+typedef boost::error_info<struct tag_errmsg, std::string> errmsg_info_str;
+
+using namespace std;
+
+// below this size splitting the update between threads costs more than it saves
+static const size_t BLAKE3_PARALLEL_THRESHOLD = 128 * 1024;
+
+static Digest::Algorithm g_defaultAlgorithm = Digest::SHA256;
+
+struct Digest::Context
+{
+  EVP_MD_CTX *m_evp;
+#ifdef HAVE_BLAKE3
+  blake3_hasher m_blake3;
+#endif
+};
+
+Digest::Digest (Algorithm algorithm)
+  : m_algorithm (algorithm)
+  , m_context (0)
+{
+  if (!IsSupported (algorithm))
+    {
+      BOOST_THROW_EXCEPTION (Error::UnsupportedDigest ()
+                             << errmsg_info_str (string ("Digest algorithm is not supported: ") + GetName (algorithm)));
+    }
+
+  m_context = new Context;
+  m_context->m_evp = 0;
+
+  switch (m_algorithm)
+    {
+#ifdef HAVE_BLAKE3
+    case BLAKE3:
+      blake3_hasher_init (&m_context->m_blake3);
+      break;
+#endif
+    default:
+      m_context->m_evp = EVP_MD_CTX_create ();
+      EVP_DigestInit_ex (m_context->m_evp, EVP_sha256 (), 0);
+      break;
+    }
+}
+
+Digest::~Digest ()
+{
+  if (m_context->m_evp != 0)
+    EVP_MD_CTX_destroy (m_context->m_evp);
+  delete m_context;
+}
+
+void
+Digest::Update (const void *data, size_t size)
+{
+  switch (m_algorithm)
+    {
+#ifdef HAVE_BLAKE3
+    case BLAKE3:
+#ifdef HAVE_BLAKE3_TBB
+      if (size >= BLAKE3_PARALLEL_THRESHOLD)
+        {
+          blake3_hasher_update_tbb (&m_context->m_blake3, data, size);
+          break;
+        }
+#endif
+      blake3_hasher_update (&m_context->m_blake3, data, size);
+      break;
+#endif
+    default:
+      EVP_DigestUpdate (m_context->m_evp, data, size);
+      break;
+    }
+}
+
+unsigned int
+Digest::Final (unsigned char *result)
+{
+  unsigned int length = 0;
+  switch (m_algorithm)
+    {
+#ifdef HAVE_BLAKE3
+    case BLAKE3:
+      blake3_hasher_finalize (&m_context->m_blake3, result, BLAKE3_OUT_LEN);
+      length = BLAKE3_OUT_LEN;
+      break;
+#endif
+    default:
+      EVP_DigestFinal_ex (m_context->m_evp, result, &length);
+      break;
+    }
+  return length;
+}
+
+bool
+Digest::IsSupported (Algorithm algorithm)
+{
+  switch (algorithm)
+    {
+    case SHA256:
+      return true;
+    case BLAKE3:
+#ifdef HAVE_BLAKE3
+      return true;
+#else
+      return false;
+#endif
+    default:
+      return false;
+    }
+}
+
+const char *
+Digest::GetName (Algorithm algorithm)
+{
+  switch (algorithm)
+    {
+    case SHA256:
+      return "sha256";
+    case BLAKE3:
+      return "blake3";
+    default:
+      return "unknown";
+    }
+}
+
+bool
+Digest::FromName (const std::string &name, Algorithm &algorithm)
+{
+  if (name == "sha256")
+    {
+      algorithm = SHA256;
+      return true;
+    }
+  if (name == "blake3")
+    {
+      algorithm = BLAKE3;
+      return true;
+    }
+  return false;
+}
+
+std::string
+Digest::GetImplementation (Algorithm algorithm)
+{
+  if (!IsSupported (algorithm))
+    return "not available";
+
+  string cpu;
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (__get_cpuid_count (7, 0, &eax, &ebx, &ecx, &edx))
+    {
+      if (algorithm == SHA256 && (ebx & (1 << 29)))
+        cpu += ", SHA-NI";
+      if (ebx & (1 << 5))
+        cpu += ", AVX2";
+      if (algorithm == BLAKE3 && (ebx & (1 << 16)))
+        cpu += ", AVX-512";
+    }
+#endif
+
+  if (algorithm == BLAKE3)
+    {
+#ifdef HAVE_BLAKE3_TBB
+      return "libblake3 (multi-threaded" + cpu + ")";
+#else
+      return "libblake3 (single-threaded" + cpu + ")";
+#endif
+    }
+
+  return "OpenSSL" + (cpu.empty () ? string () : " (" + cpu.substr (2) + ")");
+}
+
+bool
+Digest::SelfTest (Algorithm algorithm)
+{
+  static const unsigned char SHA256_ABC[] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+  };
+  static const unsigned char BLAKE3_ABC[] = {
+    0x64, 0x37, 0xb3, 0xac, 0x38, 0x46, 0x51, 0x33, 0xff, 0xb6, 0x3b, 0x75, 0x27, 0x3a, 0x8d, 0xb5,
+    0x48, 0xc5, 0x58, 0x46, 0x5d, 0x79, 0xdb, 0x03, 0xfd, 0x35, 0x9c, 0x6c, 0xd5, 0xbd, 0x9d, 0x85
+  };
+
+  if (!IsSupported (algorithm))
+    return false;
+
+  const unsigned char *expected = (algorithm == BLAKE3) ? BLAKE3_ABC : SHA256_ABC;
+
+  Digest digest (algorithm);
+  digest.Update ("abc", 3);
+
+  unsigned char result[MAX_SIZE];
+  unsigned int length = digest.Final (result);
+
+  return length == 32 && memcmp (result, expected, length) == 0;
+}
+
+Digest::Algorithm
+Digest::GetDefaultAlgorithm ()
+{
+  return g_defaultAlgorithm;
+}
+
+bool
+Digest::SetDefaultAlgorithm (Algorithm algorithm)
+{
+  if (!SelfTest (algorithm))
+    {
+      _LOG_ERROR ("Digest algorithm " << GetName (algorithm) << " is not available, keeping " << GetName (g_defaultAlgorithm));
+      return false;
+    }
+
+  _LOG_DEBUG ("New content is digested with " << GetName (algorithm) << ", " << GetImplementation (algorithm));
+  g_defaultAlgorithm = algorithm;
+  return true;
+}
@@ -0,0 +1,119 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <boost/exception/all.hpp>
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <stddef.h>
+
+/**
+ * @brief Streaming digest with a selectable algorithm
+ *
+ * SHA-256 is computed by OpenSSL, which picks SHA-NI/AVX2 code at run time when the CPU supports
+ * it.  BLAKE3 is available if ChronoShare is built with libblake3 (HAVE_BLAKE3); large updates are
+ * then hashed in tree mode by several threads, if libblake3 is built with TBB (HAVE_BLAKE3_TBB).
+ *
+ * Algorithm ids are recorded in actions and file state, so they must never be renumbered.
+ */
+class Digest : boost::noncopyable
+{
+public:
+  enum Algorithm
+    {
+      SHA256 = 0, ///< used when the algorithm is not specified (e.g., by older peers)
+      BLAKE3 = 1
+    };
+
+  static const size_t MAX_SIZE = 64;
+
+  /**
+   * @brief Start a new digest
+   * @throws Error::UnsupportedDigest if the algorithm is not available in this build
+   */
+  explicit
+  Digest (Algorithm algorithm);
+
+  ~Digest ();
+
+  void
+  Update (const void *data, size_t size);
+
+  /**
+   * @brief Finish the digest, can be called only once
+   * @param result buffer of at least MAX_SIZE bytes
+   * @returns size of the digest
+   */
+  unsigned int
+  Final (unsigned char *result);
+
+  Algorithm
+  GetAlgorithm () const { return m_algorithm; }
+
+  static bool
+  IsSupported (Algorithm algorithm);
+
+  static const char *
+  GetName (Algorithm algorithm);
+
+  static bool
+  FromName (const std::string &name, Algorithm &algorithm);
+
+  /**
+   * @brief Description of the code used for the algorithm (for logs)
+   */
+  static std::string
+  GetImplementation (Algorithm algorithm);
+
+  /**
+   * @brief Check the algorithm against a known answer
+   */
+  static bool
+  SelfTest (Algorithm algorithm);
+
+  /**
+   * @brief Algorithm used to digest new content (SHA-256, unless changed)
+   */
+  static Algorithm
+  GetDefaultAlgorithm ();
+
+  /**
+   * @brief Change the algorithm used to digest new content
+   * @returns false (and the default is not changed) if the algorithm is not supported or fails the self test
+   */
+  static bool
+  SetDefaultAlgorithm (Algorithm algorithm);
+
+private:
+  Algorithm m_algorithm;
+
+  struct Context;
+  Context *m_context;
+};
+
+namespace Error {
+struct UnsupportedDigest : virtual boost::exception, virtual std::exception { };
+}
+
+#endif // DIGEST_H
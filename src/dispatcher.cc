@@ -22,9 +22,13 @@
 #include "dispatcher.h"
 #include "logging.h"
 #include "fetch-task-db.h"
+#include "certificate-fetcher.h"
+#include "merkle-tree.h"
 
 #include <boost/make_shared.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/future.hpp>
 #include <ndn-cxx/name-component.hpp>
 
 using namespace ndn;
@@ -39,6 +43,16 @@ static const string BROADCAST_DOMAIN = "/ndn/broadcast";
 static const int CONTENT_FRESHNESS = 1800;  // seconds
 const static double DEFAULT_SYNC_INTEREST_INTERVAL = 10.0; // seconds;
 
+static const double ACTION_BATCH_WINDOW = 0.05; // seconds
+static const size_t ACTION_BATCH_MAX_SIZE = 256;
+static const string ACTION_BATCH_TAG = "action-batch";
+static const string ASSEMBLY_FOLDER = "assembly"; // in .chronoshare, for files being fetched
+static const double MATERIALIZE_COMMIT_DELAY = 0.5; // seconds
+static const string MATERIALIZE_COMMIT_TAG = "materialize-commit";
+static const double MOVE_DETECTION_WINDOW = 2.0; // seconds
+static const string MOVE_DETECTION_TAG = "move-detection";
+static const sqlite3_int64 RACY_STAT_WINDOW = 2000000000; // ns, covers filesystems with coarse timestamps
+
 Dispatcher::Dispatcher(const std::string &localUserName
                        , const std::string &sharedFolder
                        , const filesystem::path &rootDir
@@ -50,10 +64,22 @@ Dispatcher::Dispatcher(const std::string &localUserName
            , m_executor(1) // creates problems with file assembly. need to ensure somehow that FinishExectute is called after all Segment_Execute finished
            , m_objectManager(rootDir, CHRONOSHARE_APP)
            , m_localUserName(localUserName)
+           , m_moveDetector(MOVE_DETECTION_WINDOW)
            , m_sharedFolder(sharedFolder)
            , m_server(NULL)
            , m_enablePrefixDiscovery(enablePrefixDiscovery)
+           , m_swarmEnabled(true)
+           , m_sampledVerification(false)
+           , m_scheduler(new Scheduler ())
+           , m_uploadLimiter(new RateLimiter ())
+           , m_downloadLimiter(new RateLimiter ())
+           , m_actionBatchTimer(m_scheduler, ACTION_BATCH_TAG, bind (&Dispatcher::Did_FetchManager_ActionBatch, this))
+           , m_moveDetectionTimer(m_scheduler, MOVE_DETECTION_TAG, bind (&Dispatcher::Did_MoveDetector_WindowExpired, this))
+           , m_materializeCommitTimer(m_scheduler, MATERIALIZE_COMMIT_TAG, bind (&Dispatcher::Did_Materializer_CommitDue, this))
 {
+  // partially assembled files cannot be continued, fetches will be resumed from ObjectDb
+  FileAssembler::Cleanup (m_rootDir / ".chronoshare" / ASSEMBLY_FOLDER);
+
   m_syncLog = boost::make_shared<SyncLog>(m_rootDir, localUserName);
   m_actionLog = boost::make_shared<ActionLog>(m_ndn, m_rootDir, m_syncLog, sharedFolder, CHRONOSHARE_APP,
                                        // bind (&Dispatcher::Did_ActionLog_ActionApply_AddOrModify, this, _1, _2, _3, _4, _5, _6, _7),
@@ -69,6 +95,7 @@ Dispatcher::Dispatcher(const std::string &localUserName
   m_server = new ContentServer(m_actionLog, rootDir, m_localUserName, m_sharedFolder, CHRONOSHARE_APP, CONTENT_FRESHNESS);
   m_server->registerPrefix(ndn::Name("/"));
   m_server->registerPrefix(ndn::Name(BROADCAST_DOMAIN));
+  m_server->SetRateLimiter (m_uploadLimiter);
 
   m_stateServer = new StateServer (m_actionLog, rootDir, m_localUserName, m_sharedFolder, CHRONOSHARE_APP, m_objectManager, CONTENT_FRESHNESS);
   // no need to register, right now only listening on localhost prefix
@@ -88,7 +115,12 @@ Dispatcher::Dispatcher(const std::string &localUserName
 						      3,
 						      bind (&Dispatcher::Did_FetchManager_FileSegmentFetch, this, _1, _2, _3, _4),
                                               bind (&Dispatcher::Did_FetchManager_FileFetchComplete, this, _1, _2),
-                                              fileTaskDb);
+                                              fileTaskDb,
+                                              bind (&Dispatcher::Reconcile_FetchManager_FileFetch, this, _1, _2, _3, _4, _5),
+                                              bind (&Dispatcher::Make_FetchManager_FileVerifier, this, _1, _2, _3, _4));
+  m_fileFetcher->SetFailureCallback (bind (&Dispatcher::Did_FetchManager_FileFetchFailed, this, _1, _2));
+  m_fileFetcher->SetRateLimiter (m_downloadLimiter);
+  m_fileFetcher->SetOrderingPolicy (FetchManager::SmallestFirstOrdering ());
 
 
   if (m_enablePrefixDiscovery)
@@ -106,13 +138,34 @@ Dispatcher::Dispatcher(const std::string &localUserName
   }
 
   m_executor.start ();
+  m_scheduler->start ();
 }
 
 Dispatcher::~Dispatcher()
 {
   _LOG_DEBUG ("Enter destructor of dispatcher");
+  m_scheduler->shutdown ();
+
+  // don't lose actions that were already fetched, but not yet added to the action log:
+  // process them (and enqueue their files, to be resumed on the next start) before the executor is stopped
+  boost::promise<void> drained;
+  m_executor.execute (bind (&Dispatcher::Did_FetchManager_ActionBatch_Execute, this));
+  m_executor.execute (bind (&boost::promise<void>::set_value, &drained));
+  drained.get_future ().wait ();
+
   m_executor.shutdown ();
 
+  // removals still waiting for a possible new name are published as deletes right away
+  // (a new name that has not been reported yet is picked up as a new file by the rescan on the next start)
+  MoveDetector::Removals removals = m_moveDetector.TakeAll ();
+  for (MoveDetector::Removals::iterator removal = removals.begin (); removal != removals.end (); removal++)
+    {
+      m_actionLog->AddLocalActionDelete (removal->m_filename);
+    }
+
+  // put in place files that are already assembled
+  m_materializer.Commit ();
+
   // _LOG_DEBUG (">>");
 
   if (m_enablePrefixDiscovery)
@@ -122,6 +175,12 @@ Dispatcher::~Dispatcher()
     //Ccnx::CcnxDiscovery::deregisterCallback (TaggedFunction (bind (&Dispatcher::Did_LocalPrefix_Updated, this, _1), tag));//TODO fix
   }
 
+  if (m_verificationService)
+    {
+      // no verification callbacks into the sync core and fetchers after this point
+      m_verificationService->Shutdown ();
+    }
+
   if (m_core != NULL)
   {
     delete m_core;
@@ -202,6 +261,79 @@ Dispatcher::Did_LocalFile_AddOrModify (const filesystem::path &relativeFilePath)
   m_executor.execute (bind (&Dispatcher::Did_LocalFile_AddOrModify_Execute, this, relativeFilePath));
 }
 
+void
+Dispatcher::Did_LocalFiles_AddOrModify (const vector<filesystem::path> &relativeFilePaths)
+{
+  m_executor.execute (bind (&Dispatcher::Did_LocalFiles_AddOrModify_Execute, this, relativeFilePaths));
+}
+
+void
+Dispatcher::Did_LocalFiles_AddOrModify_Execute (vector<filesystem::path> relativeFilePaths)
+{
+  _LOG_DEBUG ("Processing batch of " << relativeFilePaths.size () << " added/modified files");
+  for (vector<filesystem::path>::iterator file = relativeFilePaths.begin (); file != relativeFilePaths.end (); file++)
+    {
+      Did_LocalFile_AddOrModify_Execute (*file);
+    }
+}
+
+bool
+Dispatcher::IsLocalFileUnchanged (const std::string &filename)
+{
+  LocalFileStat recorded;
+  LocalFileStat current;
+  if (!m_fileState->LookupLocalStat (filename, recorded) ||
+      !LocalFileStat::Read (m_rootDir / filename, current) ||
+      !current.IsSameMetadata (recorded))
+    {
+      return false;
+    }
+
+  if (m_sampledVerification)
+    {
+      HashPtr sample = Hash::FromFileSamples (m_rootDir / filename);
+      if (recorded.m_sample.size () != sample->GetHashBytes () ||
+          memcmp (recorded.m_sample.c_str (), sample->GetHash (), sample->GetHashBytes ()) != 0)
+        {
+          _LOG_DEBUG ("Sampled content of [" << filename << "] changed, but metadata did not");
+          return false;
+        }
+    }
+
+  FileItemPtr file = m_fileState->LookupFile (filename);
+  return file && file->is_complete ();
+}
+
+void
+Dispatcher::RecordLocalStat (const std::string &filename, const LocalFileStat &stat)
+{
+  LocalFileStat current;
+  if (!LocalFileStat::Read (m_rootDir / filename, current) || !current.IsSameMetadata (stat))
+    return; // changed meanwhile, will be reported again
+
+  posix_time::time_duration sinceEpoch = posix_time::microsec_clock::universal_time () - posix_time::from_time_t (0);
+  if (stat.m_mtimeNs > static_cast<sqlite3_int64> (sinceEpoch.total_microseconds ()) * 1000 - RACY_STAT_WINDOW)
+    return; // could be modified again without changing mtime
+
+  current.m_sample.clear ();
+  HashPtr sample = Hash::FromFileSamples (m_rootDir / filename);
+  current.m_sample.assign (reinterpret_cast<const char *> (sample->GetHash ()), sample->GetHashBytes ());
+
+  m_fileState->SetLocalStat (filename, current);
+}
+
+void
+Dispatcher::Did_Materializer_FileCommitted (const std::string &filename)
+{
+  m_fileState->SetFileComplete (filename);
+
+  LocalFileStat stat;
+  if (LocalFileStat::Read (m_rootDir / filename, stat))
+    {
+      RecordLocalStat (filename, stat);
+    }
+}
+
 void
 Dispatcher::Did_LocalFile_AddOrModify_Execute (filesystem::path relativeFilePath)
 {
@@ -214,9 +346,45 @@ Dispatcher::Did_LocalFile_AddOrModify_Execute (filesystem::path relativeFilePath
       return;
     }
 
+  // file reappeared before its removal was published
+  m_moveDetector.Cancel (relativeFilePath.generic_string ());
+
+  // spurious notification (e.g., attributes changed or file was touched by the watcher rescan)
+  if (IsLocalFileUnchanged (relativeFilePath.generic_string ()))
+    {
+      _LOG_DEBUG ("Got notification about the same file [" << relativeFilePath << "] (metadata did not change)");
+      return;
+    }
+
+  // taken before the content is read, so a modification while hashing is not missed
+  LocalFileStat stat;
+  LocalFileStat::Read (absolutePath, stat);
+
+  HashPtr hash;
   FileItemPtr currentFile = m_fileState->LookupFile (relativeFilePath.generic_string ());
-  if (currentFile &&
-      *Hash::FromFileContent (absolutePath) == Hash (currentFile->file_hash ().c_str (), currentFile->file_hash ().size ())
+  bool sameContent = false;
+  try
+    {
+      hash = Hash::FromFileContent (absolutePath);
+
+      if (currentFile)
+        {
+          Hash currentHash (currentFile->file_hash ().c_str (), currentFile->file_hash ().size (),
+                            static_cast<Digest::Algorithm> (currentFile->file_hash_algorithm ()));
+
+          // current version could have been published with a different digest (e.g., by another peer)
+          sameContent = (currentHash.GetAlgorithm () == hash->GetAlgorithm ()) ?
+            currentHash == *hash : HasLocalContent (absolutePath, currentHash);
+        }
+    }
+  catch (filesystem::filesystem_error &error)
+    {
+      // e.g., file was removed or truncated while being read, the watcher will report it again
+      _LOG_ERROR ("Cannot read [" << relativeFilePath << "]: " << error.what ());
+      return;
+    }
+
+  if (sameContent
       // The following two are commented out to prevent front end from reporting intermediate files
       // should enable it if there is other way to prevent this
       // && last_write_time (absolutePath) == currentFile->mtime ()
@@ -224,6 +392,10 @@ Dispatcher::Did_LocalFile_AddOrModify_Execute (filesystem::path relativeFilePath
       )
     {
       _LOG_ERROR ("Got notification about the same file [" << relativeFilePath << "]");
+      if (currentFile->is_complete ())
+        {
+          RecordLocalStat (relativeFilePath.generic_string (), stat);
+        }
       return;
     }
 
@@ -234,22 +406,43 @@ Dispatcher::Did_LocalFile_AddOrModify_Execute (filesystem::path relativeFilePath
       return;
     }
 
-
-  int seg_num;
-  HashPtr hash;
-  tie (hash, seg_num) = m_objectManager.localFileToObjects (absolutePath, m_localUserName);
-
   try
     {
-      m_actionLog->AddLocalActionUpdate (relativeFilePath.generic_string(),
-                                         *hash,
-                                         last_write_time (absolutePath), 
+      time_t mtime = last_write_time (absolutePath);
 #if BOOST_VERSION >= 104900
-                                         status (absolutePath).permissions (), 
+      int mode = status (absolutePath).permissions ();
 #else
-                                         0,
+      int mode = 0;
 #endif
-                                         seg_num);
+
+      MoveDetector::Removal removal;
+      if (!currentFile && FindMoveSource (*hash, mtime, removal))
+        {
+          int seg_num = removal.m_segNum;
+          HashPtr segmentRoot;
+          if (!ObjectDb::DoesExist (m_rootDir / ".chronoshare", m_localUserName, lexical_cast<string> (*hash)))
+            {
+              // content came from another device, peers without the old file will fetch it from us
+              tie (hash, seg_num, segmentRoot) = m_objectManager.localFileToObjects (absolutePath, m_localUserName, hash);
+            }
+          else
+            {
+              segmentRoot = m_objectManager.segmentRoot (m_localUserName, *hash, seg_num);
+            }
+
+          m_actionLog->AddLocalActionMove (removal.m_filename, relativeFilePath.generic_string (),
+                                           *hash, mtime, mode, seg_num, *segmentRoot);
+        }
+      else
+        {
+          int seg_num;
+          HashPtr segmentRoot;
+          tie (hash, seg_num, segmentRoot) = m_objectManager.localFileToObjects (absolutePath, m_localUserName, hash);
+
+          m_actionLog->AddLocalActionUpdate (relativeFilePath.generic_string(),
+                                             *hash, mtime, mode, seg_num, *segmentRoot);
+        }
+      RecordLocalStat (relativeFilePath.generic_string (), stat);
 
       // notify SyncCore to propagate the change
       m_core->localStateChangedDelayed ();
@@ -260,6 +453,30 @@ Dispatcher::Did_LocalFile_AddOrModify_Execute (filesystem::path relativeFilePath
     }
 }
 
+bool
+Dispatcher::FindMoveSource (const Hash &hash, time_t mtime, MoveDetector::Removal &removal)
+{
+  if (m_moveDetector.MatchAdded (hash, mtime, removal))
+    return true;
+
+  // removal of the old file may not be reported yet
+  FileItemsPtr files = m_fileState->LookupFilesForHash (hash);
+  for (FileItems::iterator file = files->begin (); file != files->end (); file++)
+    {
+      if (!file->is_complete () || filesystem::exists (m_rootDir / file->filename ()))
+        continue;
+
+      removal.m_filename = file->filename ();
+      removal.m_hash = hash;
+      removal.m_mtime = file->mtime ();
+      removal.m_segNum = file->seg_num ();
+      if (removal.m_mtime == mtime)
+        break;
+    }
+
+  return !removal.m_filename.empty ();
+}
+
 void
 Dispatcher::Did_LocalFile_Delete (const filesystem::path &relativeFilePath)
 {
@@ -277,11 +494,57 @@ Dispatcher::Did_LocalFile_Delete_Execute (filesystem::path relativeFilePath)
       return;
     }
 
+  FileItemPtr currentFile = m_fileState->LookupFile (relativeFilePath.generic_string ());
+  if (currentFile && currentFile->is_complete ())
+    {
+      // could be a rename, the new name is usually reported shortly
+      m_moveDetector.AddRemoved (relativeFilePath.generic_string (),
+                                 Hash (currentFile->file_hash ().c_str (), currentFile->file_hash ().size (),
+                                       static_cast<Digest::Algorithm> (currentFile->file_hash_algorithm ())),
+                                 currentFile->mtime (), currentFile->seg_num (),
+                                 posix_time::microsec_clock::universal_time ());
+
+      m_moveDetectionTimer.Arm (m_moveDetector.GetWindow ());
+      return;
+    }
+
   m_actionLog->AddLocalActionDelete (relativeFilePath.generic_string());
   // notify SyncCore to propagate the change
   m_core->localStateChangedDelayed();
 }
 
+void
+Dispatcher::Did_MoveDetector_WindowExpired ()
+{
+  m_executor.execute (bind (&Dispatcher::Did_MoveDetector_WindowExpired_Execute, this));
+}
+
+void
+Dispatcher::Did_MoveDetector_WindowExpired_Execute ()
+{
+  PublishRemovals (m_moveDetector.TakeExpired (posix_time::microsec_clock::universal_time ()));
+
+  if (m_moveDetector.GetPendingCount () > 0)
+    {
+      // removals added after the timer fired
+      m_moveDetectionTimer.Arm (m_moveDetector.GetWindow ());
+    }
+}
+
+void
+Dispatcher::PublishRemovals (const MoveDetector::Removals &removals)
+{
+  if (removals.empty ())
+    return;
+
+  for (MoveDetector::Removals::const_iterator removal = removals.begin (); removal != removals.end (); removal++)
+    {
+      m_actionLog->AddLocalActionDelete (removal->m_filename);
+    }
+  // notify SyncCore to propagate the change
+  m_core->localStateChangedDelayed ();
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -337,31 +600,111 @@ Dispatcher::Did_SyncLog_StateChange_Execute (SyncStateMsgPtr stateMsg)
 void
 Dispatcher::Did_FetchManager_ActionFetch (const ndn::Name &deviceName, const ndn::Name &actionBaseName, uint32_t seqno, boost::shared_ptr<ndn::Data> actionPco)
 {
-  /// @todo Errors and exception checking
   _LOG_DEBUG ("Received action deviceName: " << deviceName << ", actionBaseName: " << actionBaseName << ", seqno: " << seqno);
 
-  ActionItemPtr action = m_actionLog->AddRemoteAction (deviceName, seqno, actionPco);
-  if (!action)
+  size_t pending = 0;
+  {
+    boost::mutex::scoped_lock lock (m_pendingActionsMutex);
+    m_pendingActions.push_back (ActionLog::RemoteAction (deviceName, seqno, actionPco));
+    pending = m_pendingActions.size ();
+  }
+
+  if (pending >= ACTION_BATCH_MAX_SIZE)
     {
-      _LOG_ERROR ("AddRemoteAction did not insert action, ignoring");
-      return;
+      m_actionBatchTimer.Cancel ();
+      Did_FetchManager_ActionBatch ();
+    }
+  else
+    {
+      // wait a little bit for other actions to arrive (nothing is done if already waiting)
+      m_actionBatchTimer.Arm (ACTION_BATCH_WINDOW);
     }
+}
+
+void
+Dispatcher::Did_FetchManager_ActionBatch ()
+{
+  m_executor.execute (bind (&Dispatcher::Did_FetchManager_ActionBatch_Execute, this));
+}
+
+static bool
+verifySegment (const Hash &root, uint64_t segments, uint64_t seqno, const ndn::Data &data)
+{
+  return MerkleTree::Verify (root, segments, seqno, data.getContent ().value (), data.getContent ().value_size (),
+                             MerkleTree::ExtractProof (data));
+}
+
+void
+Dispatcher::Did_FetchManager_ActionBatch_Execute ()
+{
+  /// @todo Errors and exception checking
+  ActionLog::RemoteActions remoteActions;
+  {
+    boost::mutex::scoped_lock lock (m_pendingActionsMutex);
+    remoteActions.swap (m_pendingActions);
+  }
+
+  if (remoteActions.empty ())
+    return;
+
+  _LOG_DEBUG ("Adding batch of " << remoteActions.size () << " remote actions");
+
+  ActionLog::ActionItems actions = m_actionLog->AddRemoteActions (remoteActions);
   // trigger may invoke Did_ActionLog_ActionApply_Delete or Did_ActionLog_ActionApply_AddOrModify callbacks
 
-  if (action->action () == ActionItem::UPDATE)
+  // several actions in the batch may refer to the same file content, request it only once
+  std::map<ObjectDb::Key, ActionItemPtr> files;
+  ObjectDb::Keys candidates;
+  for (size_t i = 0; i < actions.size (); i++)
     {
-      Hash hash (action->file_hash ().c_str(), action->file_hash ().size ());
+      if (!actions[i])
+        {
+          _LOG_ERROR ("AddRemoteAction did not insert action, ignoring");
+          continue;
+        }
+
+      if (actions[i]->action () == ActionItem::UPDATE && actions[i]->has_moved_from () &&
+          Apply_RemoteMove (*actions[i]))
+        {
+          continue;
+        }
+
+      if (actions[i]->action () == ActionItem::UPDATE)
+        {
+          Hash hash (actions[i]->file_hash ().c_str(), actions[i]->file_hash ().size ());
+          ObjectDb::Key key (remoteActions[i].m_deviceName, lexical_cast<string> (hash));
+
+          files [key] = actions[i];
+          candidates.insert (key);
+        }
+      // if necessary (when version number is the highest) delete will be applied through the trigger in m_actionLog->AddRemoteActions call
+    }
+
+  ObjectDb::Keys existing = ObjectDb::FindExisting (m_rootDir / ".chronoshare", candidates);
+
+  for (std::map<ObjectDb::Key, ActionItemPtr>::iterator file = files.begin (); file != files.end (); file++)
+    {
+      const ndn::Name &deviceName = file->first.first;
+      const string &hashStr = file->first.second;
+      Hash hash (file->second->file_hash ().c_str(), file->second->file_hash ().size ());
 
       //Name fileNameBase = Name ("/")(deviceName)(CHRONOSHARE_APP)("file")(hash.GetHash (), hash.GetHashBytes ());
       ndn::Name fileNameBase = ndn::Name ("/");
       fileNameBase.append(deviceName).append(CHRONOSHARE_APP).append("file");
       fileNameBase.append((const char *) hash.GetHash ());
 
-      string hashStr = lexical_cast<string> (hash);
-      if (ObjectDb::DoesExist (m_rootDir / ".chronoshare",  deviceName, hashStr))
+      if (existing.find (file->first) != existing.end ())
         {
           _LOG_DEBUG ("File already exists in the database. No need to refetch, just directly applying the action");
           Did_FetchManager_FileFetchComplete (deviceName, fileNameBase);
+          continue;
+        }
+
+      boost::filesystem::path localCopy = FindLocalCopy (m_fileState, m_rootDir, hash);
+      if (!localCopy.empty ())
+        {
+          _LOG_DEBUG ("Content of [" << file->second->filename () << "] is already in [" << localCopy << "], no need to fetch");
+          Did_FetchManager_FileFetchComplete_Execute (deviceName, fileNameBase, localCopy);
         }
       else
         {
@@ -371,11 +714,159 @@ Dispatcher::Did_FetchManager_ActionFetch (const ndn::Name &deviceName, const ndn
               m_objectDbMap [hash] = boost::make_shared<ObjectDb> (m_rootDir / ".chronoshare", hashStr);
             }
 
+          // without segment_root (e.g., action of an older peer) content is verified only as a whole file
           m_fileFetcher->Enqueue (deviceName, fileNameBase,
-                                  0, action->seg_num () - 1, FetchManager::PRIORITY_NORMAL);
+                                  0, file->second->seg_num () - 1,
+                                  IsInPinnedFolder (file->second->filename ()) ? FetchManager::PRIORITY_HIGH : FetchManager::PRIORITY_NORMAL,
+                                  file->second->mtime (), file->second->segment_root ());
+
+          if (m_swarmEnabled)
+            {
+              // every device that published or fetched the same content can serve it too
+              std::vector<ActionLog::ContentSource> sources = m_actionLog->LookupSourcesForHash (hash);
+              for (std::vector<ActionLog::ContentSource>::iterator source = sources.begin (); source != sources.end (); source++)
+                {
+                  if (source->first == deviceName || source->first == m_localUserName)
+                    continue;
+
+                  ndn::Name sourceNameBase = ndn::Name ("/");
+                  sourceNameBase.append(source->second).append(CHRONOSHARE_APP).append("file");
+                  sourceNameBase.append((const char *) hash.GetHash ());
+
+                  m_fileFetcher->AddSource (fileNameBase, source->first, sourceNameBase);
+                }
+            }
+        }
+    }
+}
+
+void
+Dispatcher::SetVerification (bool enabled)
+{
+  if (enabled && !m_verificationService)
+    {
+      m_verificationService = boost::make_shared<VerificationService> (m_rootDir);
+      m_verificationService->SetKeyFetcher (bind (&CertificateFetcher::Fetch,
+                                                  boost::make_shared<CertificateFetcher> (boost::ref (*m_verificationService)),
+                                                  _1, _2, _3));
+      _LOG_DEBUG ("Verification enabled, " << m_verificationService->GetCertificateCount () << " cached certificates");
+    }
+  else if (!enabled && m_verificationService)
+    {
+      // wait for callbacks into the sync core and fetchers that are still running, drop queued packets
+      m_verificationService->Shutdown ();
+      m_verificationService.reset ();
+    }
+
+  m_core->SetVerificationService (m_verificationService);
+  m_actionFetcher->SetVerificationService (m_verificationService);
+  m_fileFetcher->SetVerificationService (m_verificationService);
+}
+
+void
+Dispatcher::PinFolder (const std::string &folder, bool pinned/* = true*/)
+{
+  boost::mutex::scoped_lock lock (m_pinnedFoldersMutex);
+  if (pinned)
+    {
+      m_pinnedFolders.insert (folder);
+    }
+  else
+    {
+      m_pinnedFolders.erase (folder);
+    }
+}
+
+bool
+Dispatcher::IsInPinnedFolder (const std::string &filename)
+{
+  boost::mutex::scoped_lock lock (m_pinnedFoldersMutex);
+  for (std::set<std::string>::iterator folder = m_pinnedFolders.begin (); folder != m_pinnedFolders.end (); folder++)
+    {
+      if (folder->empty () ||
+          (filename.size () > folder->size () && filename.compare (0, folder->size (), *folder) == 0 && filename [folder->size ()] == '/'))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+Dispatcher::FetchNow (const std::string &filename)
+{
+  m_executor.execute (bind (&Dispatcher::FetchNow_Execute, this, filename));
+}
+
+static void
+storeLatestAction (ndn::Name &deviceName, ActionItem &latest, const ndn::Name &name, sqlite3_int64 seq_no, const ActionItem &action)
+{
+  deviceName = name;
+  latest = action;
+}
+
+void
+Dispatcher::FetchNow_Execute (std::string filename)
+{
+  ndn::Name deviceName;
+  ActionItem action;
+  if (!m_actionLog->LookupActionsForFile (bind (storeLatestAction, boost::ref (deviceName), boost::ref (action), _1, _2, _3), filename, 0, 1) ||
+      !action.IsInitialized () || action.action () == ActionItem::DELETE)
+    {
+      _LOG_DEBUG ("Nothing to fetch for " << filename);
+      return;
+    }
+
+  ndn::Name fileNameBase = ndn::Name ("/");
+  fileNameBase.append(deviceName).append(CHRONOSHARE_APP).append("file");
+  Hash hash (action.file_hash ().c_str(), action.file_hash ().size ());
+  fileNameBase.append((const char *) hash.GetHash ());
+
+  if (!m_fileFetcher->Promote (fileNameBase))
+    {
+      _LOG_DEBUG ("File " << filename << " is not being fetched");
+    }
+}
+
+bool
+Dispatcher::Apply_RemoteMove (const ActionItem &action)
+{
+  Hash hash (action.file_hash ().c_str (), action.file_hash ().size (),
+             static_cast<Digest::Algorithm> (action.file_hash_algorithm ()));
+
+  // action could be superseded by a newer one
+  FileItemPtr file = m_fileState->LookupFile (action.filename ());
+  if (!file || file->version () != action.version () ||
+      !(Hash (file->file_hash ().c_str (), file->file_hash ().size ()) == hash))
+    {
+      return false;
+    }
+
+  filesystem::path oldPath = m_rootDir / action.moved_from ();
+  filesystem::path newPath = m_rootDir / action.filename ();
+  try
+    {
+      if (!HasLocalContent (oldPath, hash))
+        {
+          return false;
         }
+
+      filesystem::create_directories (newPath.parent_path ());
+      last_write_time (oldPath, action.mtime ());
+#if BOOST_VERSION >= 104900
+      permissions (oldPath, static_cast<filesystem::perms> (action.mode ()));
+#endif
+      rename (oldPath, newPath);
+    }
+  catch (filesystem::filesystem_error &error)
+    {
+      _LOG_ERROR ("Cannot move [" << oldPath << "] to [" << newPath << "]: " << error.what ());
+      return false;
     }
-  // if necessary (when version number is the highest) delete will be applied through the trigger in m_actionLog->AddRemoteAction call
+
+  _LOG_DEBUG ("Moved [" << action.moved_from () << "] to [" << action.filename () << "], nothing to fetch");
+  Did_Materializer_FileCommitted (action.filename ());
+  return true;
 }
 
 void
@@ -440,27 +931,151 @@ Dispatcher::Did_FetchManager_FileSegmentFetch_Execute (ndn::Name deviceName, ndn
   // _LOG_DEBUG ("Looking up objectdb for " << hash);
 
   map<Hash, ObjectDbPtr>::iterator db = m_objectDbMap.find (hash);
-  if (db != m_objectDbMap.end())
+  if (db == m_objectDbMap.end())
+  {
+    // fetch was resumed after restart
+    _LOG_DEBUG ("create ObjectDb for " << hash);
+    db = m_objectDbMap.insert (make_pair (hash, boost::make_shared<ObjectDb> (m_rootDir / ".chronoshare", lexical_cast<string> (hash)))).first;
+  }
+
+  db->second->saveContentObject(deviceName, segment, fileSegmentPco->getContent (), MerkleTree::ExtractProof (*fileSegmentPco));
+
+  FileAssemblerPtr &assembler = m_assemblers [fileSegmentBaseName];
+  if (!assembler)
   {
-    db->second->saveContentObject(deviceName, segment, fileSegmentPco->getContent ());
+    assembler = boost::make_shared<FileAssembler> (m_rootDir / ".chronoshare" / ASSEMBLY_FOLDER, deviceName, lexical_cast<string> (hash));
+    // in case fetch was resumed, start with segments that were fetched before
+    assembler->CatchUp (*db->second);
   }
   else
   {
-    _LOG_ERROR ("no db available for this content object: " << fileSegmentBaseName << ", size: " << fileSegmentPco->buf ().size());
+    assembler->AddSegment (segment, fileSegmentPco->getContent ());
   }
 
   // ObjectDb objectDb (m_rootDir / ".chronoshare", lexical_cast<string> (hash));
   // objectDb.saveContentObject(deviceName, segment, fileSegmentPco->buf ());
 }
 
+void
+Dispatcher::Reconcile_FetchManager_FileFetch (const ndn::Name &deviceName, const ndn::Name &fileBaseName,
+                                              uint64_t minSeqNo, uint64_t maxSeqNo, ReceiveWindow &progress)
+{
+  // fileBaseName:  /<device_name>/<appname>/file/<hash>
+
+  ndn::name::Component comp = fileBaseName.get (-1);
+  Hash hash (comp.value (), comp.value_size ());
+  string hashStr = lexical_cast<string> (hash);
+  boost::filesystem::path objectsFolder = m_rootDir / ".chronoshare";
+
+  // checkpoints are written independently from ObjectDb commits and may be ahead of (or behind) the saved
+  // segments.  Trust the in-order part of the checkpoint if all of it is in ObjectDb, otherwise start over
+  int64_t base = progress.GetBase ();
+  if (base > static_cast<int64_t> (minSeqNo) &&
+      ObjectDb::CountSegments (objectsFolder, hashStr, deviceName, minSeqNo, base - 1) != base - static_cast<int64_t> (minSeqNo))
+    {
+      base = minSeqNo;
+    }
+
+  std::vector<sqlite3_int64> segments = ObjectDb::FindSegments (objectsFolder, hashStr, deviceName, base, maxSeqNo);
+
+  progress.Reset (base);
+  for (std::vector<sqlite3_int64>::iterator segment = segments.begin (); segment != segments.end (); segment++)
+    {
+      progress.MarkReceived (*segment);
+    }
+
+  _LOG_DEBUG ("Resume " << fileBaseName << ": " << progress.GetBase () - static_cast<int64_t> (minSeqNo) << " segments in order and "
+              << progress.GetOutOfOrderCount () << " out of order are already saved, " << maxSeqNo - minSeqNo + 1 << " in total");
+}
+
+FetchManager::SegmentVerifier
+Dispatcher::Make_FetchManager_FileVerifier (const ndn::Name &fileBaseName, uint64_t minSeqNo, uint64_t maxSeqNo,
+                                            const std::string &segmentRoot)
+{
+  // fileBaseName:  /<device_name>/<appname>/file/<hash>
+
+  ndn::name::Component comp = fileBaseName.get (-1);
+  Hash hash (comp.value (), comp.value_size ());
+
+  // segment root uses the same algorithm as the file hash
+  FileItemsPtr files = m_fileState->LookupFilesForHash (hash);
+  if (files->empty ())
+    {
+      _LOG_DEBUG ("No file has content of " << fileBaseName << ", segments will not be verified");
+      return FetchManager::SegmentVerifier ();
+    }
+
+  Hash root (segmentRoot.c_str (), segmentRoot.size (),
+             static_cast<Digest::Algorithm> (files->begin ()->file_hash_algorithm ()));
+  return bind (verifySegment, root, maxSeqNo - minSeqNo + 1, _1, _2);
+}
+
 void
 Dispatcher::Did_FetchManager_FileFetchComplete (const ndn::Name &deviceName, const ndn::Name &fileBaseName)
 {
-  m_executor.execute (bind (&Dispatcher::Did_FetchManager_FileFetchComplete_Execute, this, deviceName, fileBaseName));
+  m_executor.execute (bind (&Dispatcher::Did_FetchManager_FileFetchComplete_Execute, this, deviceName, fileBaseName, boost::filesystem::path ()));
 }
 
 void
-Dispatcher::Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, ndn::Name fileBaseName)
+Dispatcher::Did_FetchManager_FileFetchFailed (const ndn::Name &deviceName, const ndn::Name &fileBaseName)
+{
+  m_executor.execute (bind (&Dispatcher::Did_FetchManager_FileFetchFailed_Execute, this, deviceName, fileBaseName));
+}
+
+void
+Dispatcher::Did_FetchManager_FileFetchFailed_Execute (ndn::Name deviceName, ndn::Name fileBaseName)
+{
+  // retry can take minutes, don't keep the file open and out-of-order segments in memory until then
+  if (m_assemblers.erase (fileBaseName) > 0)
+    {
+      _LOG_DEBUG ("Fetch of " << fileBaseName << " failed, temporary file is removed");
+    }
+}
+
+bool
+Dispatcher::HasLocalContent (const boost::filesystem::path &path, const Hash &hash)
+{
+  if (!Digest::IsSupported (hash.GetAlgorithm ()))
+    {
+      _LOG_DEBUG ("Cannot check content of [" << path << "], " << Digest::GetName (hash.GetAlgorithm ()) << " is not supported");
+      return false;
+    }
+
+  return filesystem::is_regular_file (path) &&
+    *Hash::FromFileContent (path, hash.GetAlgorithm ()) == hash;
+}
+
+boost::filesystem::path
+Dispatcher::FindLocalCopy (FileStatePtr fileState, const boost::filesystem::path &rootDir, const Hash &hash)
+{
+  FileItemsPtr files = fileState->LookupFilesForHash (hash);
+  for (FileItems::iterator file = files->begin (); file != files->end (); file++)
+    {
+      if (!file->is_complete ())
+        continue;
+
+      boost::filesystem::path filePath = rootDir / file->filename ();
+      try
+        {
+          // file could have been changed after it was last scanned, even if its metadata was not
+          if (HasLocalContent (filePath, Hash (hash.GetHash (), hash.GetHashBytes (),
+                                               static_cast<Digest::Algorithm> (file->file_hash_algorithm ()))))
+            {
+              return filePath;
+            }
+        }
+      catch (filesystem::filesystem_error &error)
+        {
+          _LOG_DEBUG ("Cannot check [" << filePath << "]: " << error.what ());
+        }
+    }
+
+  return boost::filesystem::path ();
+}
+
+void
+Dispatcher::Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, ndn::Name fileBaseName,
+                                                        boost::filesystem::path localCopy/* = boost::filesystem::path ()*/)
 {
   // fileBaseName:  /<device_name>/<appname>/file/<hash>
 
@@ -473,23 +1088,74 @@ Dispatcher::Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, nd
 
   _LOG_DEBUG ("Extracted hash: " << hash.shortHash ());
 
+  FileAssemblerPtr assembler;
+  std::map<ndn::Name, FileAssemblerPtr>::iterator assemblerItem = m_assemblers.find (fileBaseName);
+  if (assemblerItem != m_assemblers.end ())
+  {
+    assembler = assemblerItem->second;
+    m_assemblers.erase (assemblerItem);
+  }
+
   if (m_objectDbMap.find (hash) != m_objectDbMap.end())
   {
+    if (assembler && !assembler->Finish (*m_objectDbMap [hash]))
+    {
+      assembler.reset ();
+    }
+
     // remove the db handle
     m_objectDbMap.erase (hash); // to commit write
   }
   else
   {
-    _LOG_ERROR ("no db available for this file: " << hash);
+    if (localCopy.empty ())
+      {
+        _LOG_ERROR ("no db available for this file: " << hash);
+      }
+    assembler.reset ();
   }
 
+  if (!assembler && localCopy.empty ())
+    {
+      localCopy = FindLocalCopy (m_fileState, m_rootDir, hash);
+    }
+
   FileItemsPtr filesToAssemble = m_fileState->LookupFilesForHash (hash);
 
+  if (assembler && !filesToAssemble->empty ())
+    {
+      // segments are checked on arrival only if the action has segment_root, check the whole content
+      // before it is put in place.  The database has the same content, so nothing can be restored from it either
+      Hash expected (hash.GetHash (), hash.GetHashBytes (),
+                     static_cast<Digest::Algorithm> (filesToAssemble->begin ()->file_hash_algorithm ()));
+      bool valid = false;
+      try
+        {
+          // content hashed with an algorithm that is not supported here cannot be checked (as before)
+          valid = !Digest::IsSupported (expected.GetAlgorithm ()) ||
+            HasLocalContent (assembler->GetPath (), expected);
+        }
+      catch (filesystem::filesystem_error &error)
+        {
+          _LOG_ERROR ("Cannot check assembled file [" << assembler->GetPath () << "]: " << error.what ());
+        }
+
+      if (!valid)
+        {
+          _LOG_ERROR ("Content of " << fileBaseName << " does not match its hash, discarding it");
+          return; // assembler removes the temporary file
+        }
+    }
+
+  boost::filesystem::path assembledPath;
+
   for (FileItems::iterator file = filesToAssemble->begin ();
        file != filesToAssemble->end ();
        file++)
     {
       boost::filesystem::path filePath = m_rootDir / file->filename ();
+      if (filePath == localCopy)
+        continue; // already verified to be in place
 
       try
         {
@@ -498,7 +1164,8 @@ Dispatcher::Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, nd
 #if BOOST_VERSION >= 104900
               filesystem::status (filePath).permissions () == static_cast<filesystem::perms> (file->mode ()) &&
 #endif
-              *Hash::FromFileContent (filePath) == hash)
+              HasLocalContent (filePath, Hash (hash.GetHash (), hash.GetHashBytes (),
+                                               static_cast<Digest::Algorithm> (file->file_hash_algorithm ()))))
             {
               _LOG_DEBUG ("Asking to assemble a file, but file already exists on a filesystem");
               continue;
@@ -509,19 +1176,46 @@ Dispatcher::Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, nd
           _LOG_ERROR ("File operations failed on [" << filePath << "] (ignoring)");
         }
 
-      if (ObjectDb::DoesExist (m_rootDir / ".chronoshare",  deviceName, boost::lexical_cast<string>(hash)))
+      FileMaterializer::CommitCallback onCommitted = bind (&Dispatcher::Did_Materializer_FileCommitted, this, file->filename ());
+
+      if (assembler && assembledPath.empty ())
+        {
+          // the first file takes the assembled file, others are copied from it (before the batch is committed)
+          assembledPath = assembler->GetPath ();
+          if (m_materializer.Adopt (assembledPath, filePath, file->mtime (), file->mode (), onCommitted))
+            {
+              assembler->Release ();
+              continue;
+            }
+
+          _LOG_ERROR ("Cannot put assembled file at [" << filePath << "], restoring it from the database");
+          assembler.reset ();
+        }
+
+      if (assembler)
       {
-        bool ok = m_objectManager.objectsToLocalFile (deviceName, hash, filePath);
-        if (ok)
+        if (!m_materializer.Begin (filePath, file_size (assembledPath)) ||
+            !m_materializer.WriteFile (assembledPath) ||
+            !m_materializer.End (file->mtime (), file->mode (), onCommitted))
           {
-            last_write_time (filePath, file->mtime ());
-#if BOOST_VERSION >= 104900
-            permissions (filePath, static_cast<filesystem::perms> (file->mode ()));
-#endif
-
-            m_fileState->SetFileComplete (file->filename ());
+            _LOG_ERROR ("Cannot copy assembled file to [" << filePath << "]");
+          }
+      }
+      else if (!localCopy.empty ())
+      {
+        // the same content is already in the shared folder (e.g., file was copied or moved on another device)
+        if (!m_materializer.Begin (filePath, file_size (localCopy)) ||
+            !m_materializer.WriteFile (localCopy) ||
+            !m_materializer.End (file->mtime (), file->mode (), onCommitted))
+          {
+            _LOG_ERROR ("Cannot copy [" << localCopy << "] to [" << filePath << "]");
           }
-        else
+      }
+      else if (ObjectDb::DoesExist (m_rootDir / ".chronoshare",  deviceName, boost::lexical_cast<string>(hash)))
+      {
+        bool ok = m_objectManager.objectsToLocalFile (deviceName, hash, filePath,
+                                                      m_materializer, file->mtime (), file->mode (), onCommitted);
+        if (!ok)
           {
             _LOG_ERROR ("Notified about complete fetch, but file cannot be restored from the database: [" << filePath << "]");
           }
@@ -532,6 +1226,29 @@ Dispatcher::Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, nd
         // should abort for debugging
       }
     }
+
+  // files of many small fetches that complete around the same time are synced together
+  if (m_materializer.IsBatchFull ())
+    {
+      m_materializeCommitTimer.Cancel ();
+      m_materializer.Commit ();
+    }
+  else if (m_materializer.GetPendingCount () > 0)
+    {
+      m_materializeCommitTimer.Arm (MATERIALIZE_COMMIT_DELAY);
+    }
+}
+
+void
+Dispatcher::Did_Materializer_CommitDue ()
+{
+  m_executor.execute (bind (&Dispatcher::Did_Materializer_CommitDue_Execute, this));
+}
+
+void
+Dispatcher::Did_Materializer_CommitDue_Execute ()
+{
+  m_materializer.Commit ();
 }
 
 // moved to state-server
@@ -27,14 +27,20 @@
 #include "executor.h"
 #include "object-db.h"
 #include "object-manager.h"
+#include "file-assembler.h"
+#include "move-detector.h"
 #include "content-server.h"
 #include "state-server.h"
 #include "fetch-manager.h"
+#include "scheduler.h"
+#include "batch-timer.h"
 
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/shared_ptr.hpp>
 #include <map>
+#include <set>
 
 typedef boost::shared_ptr<ActionItem> ActionItemPtr;
 
@@ -60,6 +66,10 @@ public:
   void
   Did_LocalFile_AddOrModify (const boost::filesystem::path &relativeFilepath);
 
+  // same, for many files at once (e.g., initial scan), submitted as one job
+  void
+  Did_LocalFiles_AddOrModify (const std::vector<boost::filesystem::path> &relativeFilepaths);
+
   void
   Did_LocalFile_Delete (const boost::filesystem::path &relativeFilepath);
 
@@ -69,6 +79,79 @@ public:
   void
   Restore_LocalFile (FileItemPtr file);
 
+  /**
+   * @brief Enable or disable fetching file segments from all devices known to have the file (enabled by default)
+   */
+  void
+  SetSwarmMode (bool enabled) { m_swarmEnabled = enabled; }
+
+  /**
+   * @brief Sign every published segment by the device key or only by its digest (digest by default)
+   */
+  void
+  SetSigningMode (ObjectManager::SigningMode mode) { m_objectManager.SetSigningMode (mode); m_server->SetSigningMode (mode); }
+
+  /**
+   * @brief Set bounds for the number of files fetched in parallel (actual number adapts to the network conditions)
+   */
+  void
+  SetFileFetchConcurrency (uint32_t minFetches, uint32_t maxFetches) { m_fileFetcher->SetParallelFetchLimits (minFetches, maxFetches); }
+
+  /**
+   * @brief Set order in which files are fetched (smaller files first by default)
+   */
+  void
+  SetFileFetchOrdering (const FetchManager::OrderingPolicy &policy) { m_fileFetcher->SetOrderingPolicy (policy); }
+
+  /**
+   * @brief Fetch files in the folder (relative to the shared folder) before files in other folders
+   */
+  void
+  PinFolder (const std::string &folder, bool pinned = true);
+
+  /**
+   * @brief Fetch the file before any other file (if it is being fetched)
+   */
+  void
+  FetchNow (const std::string &filename);
+
+  /**
+   * @brief Limits for file segments served to other devices (sync and action traffic is not limited)
+   */
+  RateLimiterPtr
+  GetUploadRateLimiter () { return m_uploadLimiter; }
+
+  /**
+   * @brief Limits for file segments fetched from other devices (sync and action traffic is not limited)
+   */
+  RateLimiterPtr
+  GetDownloadRateLimiter () { return m_downloadLimiter; }
+
+  /**
+   * @brief Verify signatures of the received sync, action and file data on a worker pool (disabled by default)
+   *
+   * Missing certificates are fetched and validated up to a certificate in the local KeyChain (see CertificateFetcher).
+   * Validated certificates are kept in .chronoshare across restarts
+   */
+  void
+  SetVerification (bool enabled);
+
+  /**
+   * @brief Service used to verify received data (null if verification is disabled), e.g., for ok/fail counters
+   */
+  VerificationServicePtr
+  GetVerificationService () { return m_verificationService; }
+
+  /**
+   * @brief Find a complete file in the shared folder that really has the content
+   *
+   * Content of every candidate is digested, as unchanged metadata does not guarantee unchanged content
+   *
+   * @returns empty path if there is no such file
+   */
+  static boost::filesystem::path
+  FindLocalCopy (FileStatePtr fileState, const boost::filesystem::path &rootDir, const Hash &hash);
+
   // for test
   HashPtr
   SyncRoot() { return m_core->root(); }
@@ -80,9 +163,40 @@ private:
   void
   Did_LocalFile_AddOrModify_Execute (boost::filesystem::path relativeFilepath); // cannot be const & for Execute event!!! otherwise there will be segfault
 
+  void
+  Did_LocalFiles_AddOrModify_Execute (std::vector<boost::filesystem::path> relativeFilepaths);
+
+  /**
+   * @brief Record metadata of the local file, whose content now matches FileState
+   *
+   * Nothing is recorded if the file was modified too recently (its next modification could keep the
+   * same timestamp) or if it does not look like stat (taken before the content was read) anymore
+   */
+  void
+  RecordLocalStat (const std::string &filename, const LocalFileStat &stat);
+
+  // fetched file is in place
+  void
+  Did_Materializer_FileCommitted (const std::string &filename);
+
   void
   Did_LocalFile_Delete_Execute (boost::filesystem::path relativeFilepath); // cannot be const & for Execute event!!! otherwise there will be segfault
 
+  /**
+   * @brief Find the file the added file was moved from: removed recently, or removed but not yet reported
+   */
+  bool
+  FindMoveSource (const Hash &hash, time_t mtime, MoveDetector::Removal &removal);
+
+  void
+  Did_MoveDetector_WindowExpired ();
+
+  void
+  Did_MoveDetector_WindowExpired_Execute ();
+
+  void
+  PublishRemovals (const MoveDetector::Removals &removals);
+
   void
   Restore_LocalFile_Execute (FileItemPtr file);
 
@@ -113,6 +227,20 @@ private:
   void
   Did_FetchManager_ActionFetch (const ndn::Name &deviceName, const ndn::Name &actionName, uint32_t seqno, boost::shared_ptr<ndn::Data> actionPco);
 
+  void
+  Did_FetchManager_ActionBatch ();
+
+  // adds all pending remote actions to the action log at once and requests files for them
+  void
+  Did_FetchManager_ActionBatch_Execute ();
+
+  /**
+   * @brief Apply remote rename (update with moved_from) by renaming the local file (if it is still there and has the content)
+   * @returns false if the content needs to be obtained the usual way
+   */
+  bool
+  Apply_RemoteMove (const ActionItem &action);
+
   void
   Did_ActionLog_ActionApply_Delete (const std::string &filename);
 
@@ -132,12 +260,75 @@ private:
   void
   Did_FetchManager_FileFetchComplete (const ndn::Name &deviceName, const ndn::Name &fileBaseName);
 
+  /**
+   * @brief Make progress of the file fetch interrupted by restart consistent with segments actually saved in ObjectDb
+   */
+  void
+  Reconcile_FetchManager_FileFetch (const ndn::Name &deviceName, const ndn::Name &fileBaseName,
+                                    uint64_t minSeqNo, uint64_t maxSeqNo, ReceiveWindow &progress);
+
+  /**
+   * @brief Check of the file segments against the segment root of the action (stored with the fetch task)
+   */
+  FetchManager::SegmentVerifier
+  Make_FetchManager_FileVerifier (const ndn::Name &fileBaseName, uint64_t minSeqNo, uint64_t maxSeqNo,
+                                  const std::string &segmentRoot);
+
+  /**
+   * @brief Put in place all files with the fetched content
+   * @param localCopy already verified file in the shared folder with the same content (if known),
+   *                  which is then cloned instead of assembling the content from ObjectDb
+   */
   void
-  Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, ndn::Name fileBaseName);
+  Did_FetchManager_FileFetchComplete_Execute (ndn::Name deviceName, ndn::Name fileBaseName,
+                                              boost::filesystem::path localCopy = boost::filesystem::path ());
+
+  /**
+   * @brief Release the temporary file of the failed fetch, it is assembled again from ObjectDb when the fetch is retried
+   */
+  void
+  Did_FetchManager_FileFetchFailed (const ndn::Name &deviceName, const ndn::Name &fileBaseName);
+
+  void
+  Did_FetchManager_FileFetchFailed_Execute (ndn::Name deviceName, ndn::Name fileBaseName);
+
+  void
+  Did_Materializer_CommitDue ();
+
+  void
+  Did_Materializer_CommitDue_Execute ();
 
   void
   Did_LocalPrefix_Updated (const ndn::Name &prefix);
 
+  void
+  FetchNow_Execute (std::string filename);
+
+  bool
+  IsInPinnedFolder (const std::string &filename);
+
+  /**
+   * @brief Check that the file has the content, digesting it with the algorithm of the hash
+   */
+  static bool
+  HasLocalContent (const boost::filesystem::path &path, const Hash &hash);
+
+  /**
+   * @brief Check, without reading the whole file, that the local file still has the content recorded in FileState
+   *
+   * True if size, modification time and inode are the same as when the content was last known to match
+   * (and, with sampled verification, sampled blocks of the file did not change either)
+   */
+  bool
+  IsLocalFileUnchanged (const std::string &filename);
+
+  /**
+   * @brief Also compare sampled blocks of files with unchanged metadata
+   * (for filesystems where modification time cannot be trusted)
+   */
+  void
+  SetSampledVerification (bool enabled) { m_sampledVerification = enabled; }
+
 private:
   void
   AssembleFile_Execute (const ndn::Name &deviceName, const Hash &filehash, const boost::filesystem::path &relativeFilepath);
@@ -173,13 +364,41 @@ private:
 
   std::map<Hash, ObjectDbPtr> m_objectDbMap;
 
+  // files being assembled while their segments are fetched, by file base name
+  std::map<ndn::Name, FileAssemblerPtr> m_assemblers;
+
+  // assembled files are put in place in batches
+  FileMaterializer m_materializer;
+
+  // local removals are held for a while to detect renames
+  MoveDetector m_moveDetector;
+
   std::string m_sharedFolder;
   ContentServer *m_server;
   StateServer   *m_stateServer;
   bool m_enablePrefixDiscovery;
+  bool m_swarmEnabled;
+  bool m_sampledVerification;
 
   FetchManagerPtr m_actionFetcher;
   FetchManagerPtr m_fileFetcher;
+
+  SchedulerPtr m_scheduler;
+
+  std::set<std::string> m_pinnedFolders;
+  boost::mutex m_pinnedFoldersMutex;
+
+  RateLimiterPtr m_uploadLimiter;
+  RateLimiterPtr m_downloadLimiter;
+
+  VerificationServicePtr m_verificationService;
+
+  // remote actions are accumulated and processed in batches
+  ActionLog::RemoteActions m_pendingActions;
+  boost::mutex m_pendingActionsMutex;
+  BatchTimer m_actionBatchTimer;
+  BatchTimer m_moveDetectionTimer;
+  BatchTimer m_materializeCommitTimer;
 };
 
 namespace Error
@@ -24,6 +24,8 @@
 #include <boost/ref.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/lexical_cast.hpp>
+#include <cmath>
+#include <ctime>
 
 #include "simple-interval-generator.h"
 #include "logging.h"
@@ -38,23 +40,76 @@ using namespace ndn;
 struct fetcher_disposer { void operator() (Fetcher *delete_this) { delete delete_this; } };
 
 static const string SCHEDULE_FETCHES_TAG = "ScheduleFetches";
+static const string ADJUST_CONCURRENCY_TAG = "AdjustConcurrency";
+static const double ADJUST_CONCURRENCY_INTERVAL = 1.0; // seconds
+static const string CHECKPOINT_TASKS_TAG = "CheckpointTasks";
+static const double CHECKPOINT_TASKS_INTERVAL = 5.0; // seconds
+
+const uint32_t FetchManager::DEFAULT_MIN_PARALLEL_FETCHES;
+const uint32_t FetchManager::DEFAULT_MAX_PARALLEL_FETCHES;
+
+static double
+fifoPenalty (uint64_t segments, time_t timestamp)
+{
+  return 0;
+}
+
+static double
+smallestFirstPenalty (double secondsPerDoubling, uint64_t segments, time_t timestamp)
+{
+  return secondsPerDoubling * std::log (static_cast<double> (segments) + 1) / std::log (2.0);
+}
+
+static double
+recentFirstPenalty (double secondsPerDoubling, uint64_t segments, time_t timestamp)
+{
+  double age = timestamp > 0 ? std::max<double> (std::time (0) - timestamp, 0) : 365 * 24 * 3600; // unknown: assume a year old
+  return secondsPerDoubling * std::log (age + 1) / std::log (2.0);
+}
+
+FetchManager::OrderingPolicy
+FetchManager::FifoOrdering ()
+{
+  return fifoPenalty;
+}
+
+FetchManager::OrderingPolicy
+FetchManager::SmallestFirstOrdering (double secondsPerDoubling/* = 10*/)
+{
+  return bind (smallestFirstPenalty, secondsPerDoubling, _1, _2);
+}
+
+FetchManager::OrderingPolicy
+FetchManager::RecentFirstOrdering (double secondsPerDoubling/* = 10*/)
+{
+  return bind (recentFirstPenalty, secondsPerDoubling, _1, _2);
+}
 
 FetchManager::FetchManager (const Mapping &mapping,
                             const Name &broadcastForwardingHint,
                             uint32_t parallelFetches, // = 3
                             const SegmentCallback &defaultSegmentCallback,
                             const FinishCallback &defaultFinishCallback,
-                            const FetchTaskDbPtr &taskDb
+                            const FetchTaskDbPtr &taskDb,
+                            const ReconcileCallback &reconcile,
+                            const VerifierFactory &verifierFactory
                             )
   : m_ndn ()
   , m_mapping (mapping)
   , m_maxParallelFetches (parallelFetches)
   , m_currentParallelFetches (0)
+  , m_concurrency (parallelFetches, DEFAULT_MIN_PARALLEL_FETCHES, std::max (parallelFetches, DEFAULT_MAX_PARALLEL_FETCHES))
+  , m_deliveredBytes (0)
+  , m_lastAdjustment (posix_time::microsec_clock::universal_time ())
   , m_scheduler (new Scheduler)
   , m_executor (new Executor(1))
   , m_defaultSegmentCallback(defaultSegmentCallback)
   , m_defaultFinishCallback(defaultFinishCallback)
   , m_taskDb(taskDb)
+  , m_verifierFactory(verifierFactory)
+  , m_orderingPolicy (FifoOrdering ())
+  , m_epoch (posix_time::microsec_clock::universal_time ())
+  , m_congestionAlgorithm (CongestionWindow::AIMD)
   , m_broadcastHint (broadcastForwardingHint)
 {
   m_scheduler->start ();
@@ -63,10 +118,18 @@ FetchManager::FetchManager (const Mapping &mapping,
   m_scheduleFetchesTask = Scheduler::schedulePeriodicTask (m_scheduler,
                                                            boost::make_shared<SimpleIntervalGenerator> (300), // no need to check to often. if needed, will be rescheduled
                                                            bind (&FetchManager::ScheduleFetches, this), SCHEDULE_FETCHES_TAG);
+
+  Scheduler::schedulePeriodicTask (m_scheduler,
+                                   boost::make_shared<SimpleIntervalGenerator> (ADJUST_CONCURRENCY_INTERVAL),
+                                   bind (&FetchManager::AdjustConcurrency, this), ADJUST_CONCURRENCY_TAG);
   // resume un-finished fetches if there is any
   if (m_taskDb)
   {
-    m_taskDb->foreachTask(bind(&FetchManager::Enqueue, this, _1, _2, _3, _4, _5));
+    m_taskDb->foreachTask(bind(&FetchManager::ResumeTask, this, reconcile, _1, _2, _3, _4, _5, _6));
+
+    Scheduler::schedulePeriodicTask (m_scheduler,
+                                     boost::make_shared<SimpleIntervalGenerator> (CHECKPOINT_TASKS_INTERVAL),
+                                     bind (&FetchTaskDb::checkpoint, m_taskDb), CHECKPOINT_TASKS_TAG);
   }
 }
 
@@ -77,21 +140,84 @@ FetchManager::~FetchManager ()
 
   m_ndn.reset ();
 
+  m_deviceQueues.clear ();
+  m_delayedFetchers.clear ();
   m_fetchList.clear_and_dispose (fetcher_disposer ());
 }
 
 // Enqueue using default callbacks
 void
 FetchManager::Enqueue (const ndn::Name &deviceName, const ndn::Name &baseName,
-           uint64_t minSeqNo, uint64_t maxSeqNo, int priority)
+           uint64_t minSeqNo, uint64_t maxSeqNo, int priority, time_t timestamp, const std::string &segmentRoot)
+{
+  Enqueue(deviceName, baseName, m_defaultSegmentCallback, m_defaultFinishCallback, minSeqNo, maxSeqNo, priority, timestamp, segmentRoot);
+}
+
+void
+FetchManager::ResumeTask (const ReconcileCallback &reconcile,
+                          const ndn::Name &deviceName, const ndn::Name &baseName,
+                          uint64_t minSeqNo, uint64_t maxSeqNo, int priority,
+                          const std::string &segmentRoot)
 {
-  Enqueue(deviceName, baseName, m_defaultSegmentCallback, m_defaultFinishCallback, minSeqNo, maxSeqNo, priority);
+  if (!reconcile.empty ())
+    {
+      ReceiveWindow progress (minSeqNo);
+      m_taskDb->getProgress (deviceName, baseName, progress);
+
+      reconcile (deviceName, baseName, minSeqNo, maxSeqNo, progress);
+      m_taskDb->setProgress (deviceName, baseName, progress);
+    }
+
+  Enqueue (deviceName, baseName, minSeqNo, maxSeqNo, priority, 0, segmentRoot);
+}
+
+CongestionWindowPtr
+FetchManager::GetCongestionWindow (const ndn::Name &deviceName)
+{
+  CongestionWindowPtr &window = m_congestionWindows [deviceName];
+  if (!window)
+    {
+      window = boost::make_shared<CongestionWindow> (m_congestionAlgorithm);
+    }
+  return window;
+}
+
+void
+FetchManager::AddSource (const ndn::Name &baseName, const ndn::Name &sourceDeviceName, const ndn::Name &sourceBaseName)
+{
+  ndn::Name forwardingHint = m_mapping (sourceDeviceName);
+
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  for (FetchList::iterator item = m_fetchList.begin (); item != m_fetchList.end (); item++)
+    {
+      if (item->GetName () == baseName)
+        {
+          _LOG_TRACE ("++++ Add source " << sourceDeviceName << " to fetcher: " << baseName);
+          // fetcher state can be modified only from the executor thread
+          m_executor->execute (bind (&Fetcher::AddSource, &*item, sourceDeviceName, sourceBaseName, forwardingHint,
+                                     GetCongestionWindow (sourceDeviceName), GetRttEstimator (sourceDeviceName)));
+          break;
+        }
+    }
+}
+
+RttEstimatorPtr
+FetchManager::GetRttEstimator (const ndn::Name &deviceName)
+{
+  RttEstimatorPtr &estimator = m_rttEstimators [deviceName];
+  if (!estimator)
+    {
+      estimator = boost::make_shared<RttEstimator> ();
+    }
+  return estimator;
 }
 
 void
 FetchManager::Enqueue (const ndn::Name &deviceName, const ndn::Name &baseName,
          const SegmentCallback &segmentCallback, const FinishCallback &finishCallback,
-         uint64_t minSeqNo, uint64_t maxSeqNo, int priority/*PRIORITY_NORMAL*/)
+         uint64_t minSeqNo, uint64_t maxSeqNo, int priority/*PRIORITY_NORMAL*/, time_t timestamp/* = 0*/,
+         const std::string &segmentRoot/* = std::string()*/)
 {
   // Assumption for the following code is minSeqNo <= maxSeqNo
   if (minSeqNo > maxSeqNo)
@@ -103,80 +229,368 @@ FetchManager::Enqueue (const ndn::Name &deviceName, const ndn::Name &baseName,
   ndn::Name forwardingHint;
   forwardingHint = m_mapping (deviceName);
 
+  ReceiveWindow progress (minSeqNo);
   if (m_taskDb)
     {
-      m_taskDb->addTask(deviceName, baseName, minSeqNo, maxSeqNo, priority);
+      m_taskDb->addTask(deviceName, baseName, minSeqNo, maxSeqNo, priority, segmentRoot);
+      m_taskDb->getProgress(deviceName, baseName, progress);
+
+      if (progress.GetBase () > static_cast<int64_t> (maxSeqNo))
+        {
+          _LOG_DEBUG ("All segments of " << baseName << " were already fetched");
+          m_taskDb->deleteTask(deviceName, baseName);
+
+          if (!finishCallback.empty ())
+            {
+              ndn::Name device = deviceName;
+              ndn::Name base = baseName;
+              finishCallback (device, base);
+            }
+          return;
+        }
+
+      if (progress.GetBase () > static_cast<int64_t> (minSeqNo) || progress.GetOutOfOrderCount () > 0)
+        {
+          _LOG_DEBUG ("Resume " << baseName << " from segment " << progress.GetBase ()
+                      << " (" << progress.GetOutOfOrderCount () << " segments above were already fetched)");
+        }
     }
 
   boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
 
   _LOG_TRACE ("++++ Create fetcher: " << baseName);
   Fetcher *fetcher = new Fetcher (m_executor,
-                                  segmentCallback,
+                                  bind (&FetchManager::DidSegmentFetched, this, segmentCallback, _1, _2, _3, _4),
                                   finishCallback,
                                   bind (&FetchManager::DidFetchComplete, this, _1, _2, _3),
                                   bind (&FetchManager::DidNoDataTimeout, this, _1),
                                   deviceName, baseName, minSeqNo, maxSeqNo,
                                   boost::posix_time::seconds (30),
-                                  forwardingHint);
-
-  switch (priority)
+                                  forwardingHint,
+                                  GetCongestionWindow (deviceName),
+                                  GetRttEstimator (deviceName));
+
+  fetcher->SetProgress (progress);
+  fetcher->SetPriority (std::min<int> (std::max<int> (priority, PRIORITY_NORMAL), PRIORITY_URGENT));
+  fetcher->SetRank ((posix_time::microsec_clock::universal_time () - m_epoch).total_milliseconds () / 1000.0 +
+                    m_orderingPolicy (fetcher->GetRemainingSegments (), timestamp));
+  fetcher->SetScheduler (m_scheduler);
+  if (m_rateLimiter)
+    {
+      fetcher->SetRateLimiter (m_rateLimiter, m_scheduler);
+    }
+  if (!segmentRoot.empty () && !m_verifierFactory.empty ())
     {
-    case PRIORITY_HIGH:
-      _LOG_TRACE ("++++ Push front fetcher: " << fetcher->GetName ());
-      m_fetchList.push_front (*fetcher);
-      break;
-
-    case PRIORITY_NORMAL:
-    default:
-      _LOG_TRACE ("++++ Push back fetcher: " << fetcher->GetName ());
-      m_fetchList.push_back (*fetcher);
-      break;
+      fetcher->SetSegmentVerifier (m_verifierFactory (baseName, minSeqNo, maxSeqNo, segmentRoot));
     }
+  fetcher->SetVerificationService (m_verificationService);
+
+  _LOG_TRACE ("++++ Push fetcher: " << fetcher->GetName () << ", priority: " << fetcher->GetPriority () << ", rank: " << fetcher->GetRank ());
+  m_fetchList.push_back (*fetcher);
+  PushReady (*fetcher);
 
   _LOG_DEBUG ("++++ Reschedule fetcher task");
   m_scheduler->rescheduleTaskAt (m_scheduleFetchesTask, 0);
   // ScheduleFetches (); // will start a fetch if m_currentParallelFetches is less than max, otherwise does nothing
 }
 
+bool
+FetchManager::Promote (const ndn::Name &baseName, int priority/* = PRIORITY_URGENT*/)
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  for (FetchList::iterator item = m_fetchList.begin (); item != m_fetchList.end (); item++)
+    {
+      if (item->GetName () != baseName || item->IsTimedWait ())
+        continue;
+
+      if (item->GetPriority () >= priority)
+        return true;
+
+      _LOG_DEBUG ("Promote fetch of " << baseName << " to priority " << priority);
+
+      bool ready = RemoveReady (*item);
+      if (!ready)
+        {
+          // waiting for retry: start it right away
+          for (DelayedFetchers::iterator delayed = m_delayedFetchers.begin (); delayed != m_delayedFetchers.end (); delayed++)
+            {
+              if (delayed->second == &*item)
+                {
+                  m_delayedFetchers.erase (delayed);
+                  ready = true;
+                  break;
+                }
+            }
+        }
+
+      item->SetPriority (priority);
+      if (ready)
+        {
+          PushReady (*item);
+          m_scheduler->rescheduleTaskAt (m_scheduleFetchesTask, 0);
+        }
+      // otherwise already active, new priority will apply if it has to be restarted
+      return true;
+    }
+
+  return false;
+}
+
 void
-FetchManager::ScheduleFetches ()
+FetchManager::SetOrderingPolicy (const OrderingPolicy &policy)
 {
   boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+  m_orderingPolicy = policy;
+}
 
-  boost::posix_time::ptime currentTime = date_time::second_clock<boost::posix_time::ptime>::universal_time ();
-  boost::posix_time::ptime nextSheduleCheck = currentTime + posix_time::seconds (300); // no reason to have anything, but just in case
+void
+FetchManager::SetRateLimiter (RateLimiterPtr rateLimiter)
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  m_rateLimiter = rateLimiter;
+  for (FetchList::iterator item = m_fetchList.begin (); item != m_fetchList.end (); item++)
+    {
+      // fetcher state can be modified only from the executor thread
+      m_executor->execute (bind (&Fetcher::SetRateLimiter, &*item, rateLimiter, m_scheduler));
+    }
+}
+
+void
+FetchManager::SetVerificationService (VerificationServicePtr service)
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  m_verificationService = service;
+  for (FetchList::iterator item = m_fetchList.begin (); item != m_fetchList.end (); item++)
+    {
+      // fetcher state can be modified only from the executor thread
+      m_executor->execute (bind (&Fetcher::SetVerificationService, &*item, service));
+    }
+}
+
+void
+FetchManager::SetParallelFetchLimits (uint32_t minFetches, uint32_t maxFetches)
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  m_concurrency.SetLimits (minFetches, maxFetches);
+  m_maxParallelFetches = m_concurrency.GetLimit ();
 
-  for (FetchList::iterator item = m_fetchList.begin ();
-       m_currentParallelFetches < m_maxParallelFetches && item != m_fetchList.end ();
-       item++)
+  m_scheduler->rescheduleTaskAt (m_scheduleFetchesTask, 0);
+}
+
+uint32_t
+FetchManager::GetParallelFetchLimit ()
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+  return m_maxParallelFetches;
+}
+
+void
+FetchManager::DidSegmentFetched (const SegmentCallback &callback,
+                                 ndn::Name &deviceName, ndn::Name &baseName, uint64_t seq, boost::shared_ptr<ndn::Data> pco)
+{
+  {
+    boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+    m_deliveredBytes += pco->getContent ().value_size ();
+  }
+
+  if (m_taskDb)
+    {
+      m_taskDb->markReceived (deviceName, baseName, seq);
+    }
+
+  if (!callback.empty ())
     {
-      if (item->IsActive ())
+      callback (deviceName, baseName, seq, pco);
+    }
+}
+
+void
+FetchManager::AdjustConcurrency ()
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  posix_time::ptime now = posix_time::microsec_clock::universal_time ();
+  double elapsed = (now - m_lastAdjustment).total_microseconds () / 1000000.0;
+  if (elapsed <= 0)
+    return;
+
+  double goodput = m_deliveredBytes / elapsed;
+  m_deliveredBytes = 0;
+  m_lastAdjustment = now;
+
+  // queueing delay averaged over devices that are currently being fetched from
+  double queueingDelay = 0;
+  int devices = 0;
+  bool backlogged = false;
+  for (DeviceQueues::iterator device = m_deviceQueues.begin (); device != m_deviceQueues.end (); device++)
+    {
+      if (device->second.HasReady ())
+        {
+          backlogged = true;
+        }
+
+      if (device->second.m_active == 0)
+        continue;
+
+      std::map<ndn::Name, RttEstimatorPtr>::iterator rtt = m_rttEstimators.find (device->first);
+      if (rtt != m_rttEstimators.end () && rtt->second->HasMeasurement ())
         {
-          _LOG_DEBUG ("Item is active");
-          continue;
+          queueingDelay += rtt->second->GetSmoothedRtt () - rtt->second->GetMinRtt ();
+          devices ++;
         }
+    }
+  if (devices > 0)
+    queueingDelay /= devices;
+
+  uint32_t oldLimit = m_maxParallelFetches;
+  m_maxParallelFetches = m_concurrency.Update (goodput, queueingDelay, backlogged);
+
+  if (m_maxParallelFetches > oldLimit)
+    {
+      m_scheduler->rescheduleTaskAt (m_scheduleFetchesTask, 0);
+    }
+}
+
+bool
+FetchManager::DeviceQueue::HasReady () const
+{
+  for (int priority = PRIORITY_NORMAL; priority <= PRIORITY_URGENT; priority++)
+    {
+      if (!m_ready [priority].empty ())
+        return true;
+    }
+  return false;
+}
+
+void
+FetchManager::PushReady (Fetcher &fetcher)
+{
+  m_deviceQueues [fetcher.GetDeviceName ()].m_ready [fetcher.GetPriority ()].insert (make_pair (fetcher.GetRank (), &fetcher));
+}
 
-      if (item->IsTimedWait ())
+bool
+FetchManager::RemoveReady (Fetcher &fetcher)
+{
+  DeviceQueues::iterator device = m_deviceQueues.find (fetcher.GetDeviceName ());
+  if (device == m_deviceQueues.end ())
+    return false;
+
+  ReadyQueue &queue = device->second.m_ready [fetcher.GetPriority ()];
+  std::pair<ReadyQueue::iterator, ReadyQueue::iterator> range = queue.equal_range (fetcher.GetRank ());
+  for (ReadyQueue::iterator item = range.first; item != range.second; item++)
+    {
+      if (item->second == &fetcher)
         {
-          _LOG_DEBUG ("Item is in timed-wait");
-          continue;
+          queue.erase (item);
+          return true;
         }
+    }
+  return false;
+}
 
-      if (currentTime < item->GetNextScheduledRetry ())
+void
+FetchManager::PushDelayed (Fetcher &fetcher)
+{
+  m_delayedFetchers.insert (make_pair (fetcher.GetNextScheduledRetry (), &fetcher));
+}
+
+Fetcher *
+FetchManager::PopReady ()
+{
+  if (m_deviceQueues.empty ())
+    return 0;
+
+  for (int priority = PRIORITY_URGENT; priority >= PRIORITY_NORMAL; priority--)
+    {
+      // start right after the last served device and wrap around
+      DeviceQueues::iterator start = m_deviceQueues.upper_bound (m_lastServedDevice);
+      if (start == m_deviceQueues.end ())
+        start = m_deviceQueues.begin ();
+
+      DeviceQueues::iterator best = m_deviceQueues.end ();
+      DeviceQueues::iterator device = start;
+      do
         {
-          if (item->GetNextScheduledRetry () < nextSheduleCheck)
-            nextSheduleCheck = item->GetNextScheduledRetry ();
+          if (!device->second.m_ready [priority].empty () &&
+              (best == m_deviceQueues.end () ||
+               device->second.m_active < best->second.m_active ||
+               (device->second.m_active == best->second.m_active &&
+                device->second.m_ready [priority].begin ()->first < best->second.m_ready [priority].begin ()->first)))
+            {
+              best = device;
+            }
+
+          device++;
+          if (device == m_deviceQueues.end ())
+            device = m_deviceQueues.begin ();
+        }
+      while (device != start);
 
-          _LOG_DEBUG ("Item is delayed");
-          continue;
+      if (best != m_deviceQueues.end ())
+        {
+          Fetcher *fetcher = best->second.m_ready [priority].begin ()->second;
+          best->second.m_ready [priority].erase (best->second.m_ready [priority].begin ());
+          best->second.m_active ++;
+          m_lastServedDevice = best->first;
+          return fetcher;
         }
+    }
+
+  return 0;
+}
+
+void
+FetchManager::DidFetchStop (Fetcher &fetcher)
+{
+  m_currentParallelFetches --;
+
+  DeviceQueues::iterator device = m_deviceQueues.find (fetcher.GetDeviceName ());
+  if (device == m_deviceQueues.end ())
+    return;
 
-      _LOG_DEBUG ("Start fetching of " << item->GetName ());
+  device->second.m_active --;
+  if (device->second.m_active == 0 && !device->second.HasReady ())
+    {
+      m_deviceQueues.erase (device);
+    }
+}
+
+void
+FetchManager::ScheduleFetches ()
+{
+  boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+
+  boost::posix_time::ptime currentTime = date_time::second_clock<boost::posix_time::ptime>::universal_time ();
+  boost::posix_time::ptime nextSheduleCheck = currentTime + posix_time::seconds (300); // no reason to have anything, but just in case
+
+  // move fetchers that are due for retry to the ready queues
+  DelayedFetchers::iterator due = m_delayedFetchers.upper_bound (currentTime);
+  for (DelayedFetchers::iterator item = m_delayedFetchers.begin (); item != due; item++)
+    {
+      PushReady (*item->second);
+    }
+  m_delayedFetchers.erase (m_delayedFetchers.begin (), due);
+
+  if (!m_delayedFetchers.empty () && m_delayedFetchers.begin ()->first < nextSheduleCheck)
+    {
+      nextSheduleCheck = m_delayedFetchers.begin ()->first;
+    }
+
+  while (m_currentParallelFetches < m_maxParallelFetches)
+    {
+      Fetcher *fetcher = PopReady ();
+      if (fetcher == 0)
+        break;
+
+      _LOG_DEBUG ("Start fetching of " << fetcher->GetName ());
 
       m_currentParallelFetches ++;
-      _LOG_TRACE ("++++ RESTART PIPELINE: " << item->GetName ());
-      item->RestartPipeline ();
+      _LOG_TRACE ("++++ RESTART PIPELINE: " << fetcher->GetName ());
+      fetcher->RestartPipeline ();
     }
 
   m_scheduler->rescheduleTaskAt (m_scheduleFetchesTask, (nextSheduleCheck - currentTime).total_seconds ());
@@ -189,10 +603,16 @@ FetchManager::DidNoDataTimeout (Fetcher &fetcher)
 
   {
     boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
-    m_currentParallelFetches --;
-    // no need to do anything with the m_fetchList
+    DidFetchStop (fetcher);
   }
 
+  if (!m_failureCallback.empty ())
+    {
+      ndn::Name deviceName = fetcher.GetDeviceName ();
+      ndn::Name baseName = fetcher.GetName ();
+      m_failureCallback (deviceName, baseName);
+    }
+
   if (fetcher.GetForwardingHint ().size () == 0)
     {
       // will be tried initially and again after empty forwarding hint
@@ -232,8 +652,12 @@ FetchManager::DidNoDataTimeout (Fetcher &fetcher)
       delay = std::min (2*delay, 300.0); // 5 minutes max
     }
 
-  fetcher.SetRetryPause (delay);
-  fetcher.SetNextScheduledRetry (date_time::second_clock<boost::posix_time::ptime>::universal_time () + posix_time::seconds (delay));
+  {
+    boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
+    fetcher.SetRetryPause (delay);
+    fetcher.SetNextScheduledRetry (date_time::second_clock<boost::posix_time::ptime>::universal_time () + posix_time::milliseconds (static_cast<int64_t> (delay * 1000)));
+    PushDelayed (fetcher);
+  }
 
   m_scheduler->rescheduleTaskAt (m_scheduleFetchesTask, 0);
 }
@@ -243,7 +667,7 @@ FetchManager::DidFetchComplete (Fetcher &fetcher, const ndn::Name &deviceName, c
 {
   {
     boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
-    m_currentParallelFetches --;
+    DidFetchStop (fetcher);
 
     if (m_taskDb)
       {
@@ -262,5 +686,8 @@ FetchManager::TimedWait (Fetcher &fetcher)
 {
     boost::unique_lock<boost::mutex> lock (m_parellelFetchMutex);
     _LOG_TRACE ("+++++ removing fetcher: " << fetcher.GetName ());
-    m_fetchList.erase_and_dispose (FetchList::s_iterator_to (fetcher), fetcher_disposer ());
+    m_fetchList.erase (FetchList::s_iterator_to (fetcher));
+
+    // on the executor, after all already queued calls of the fetcher
+    m_executor->execute (bind<void> (fetcher_disposer (), &fetcher));
 }
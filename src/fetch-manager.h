@@ -27,12 +27,14 @@
 #include <boost/function.hpp>
 #include <string>
 #include <list>
+#include <map>
 #include <stdint.h>
 #include "scheduler.h"
 #include "executor.h"
 #include "fetch-task-db.h"
 
 #include "fetcher.h"
+#include "concurrency-controller.h"
 
 class FetchManager
 {
@@ -40,30 +42,148 @@ public:
   enum
     {
       PRIORITY_NORMAL,
-      PRIORITY_HIGH
+      PRIORITY_HIGH,
+      PRIORITY_URGENT // explicitly requested by the user
     };
 
   typedef boost::function<ndn::Name(const ndn::Name &)> Mapping;
   typedef boost::function<void(ndn::Name &deviceName, ndn::Name &baseName, uint64_t seq, boost::shared_ptr<ndn::Data> pco)> SegmentCallback;
   typedef boost::function<void(ndn::Name &deviceName, ndn::Name &baseName)> FinishCallback;
+  typedef Fetcher::SegmentVerifier SegmentVerifier;
+
+  /**
+   * @brief Callback to adjust progress of the unfinished task (stored in taskDb) to the data actually
+   *        saved by the application, called for every task when fetches are resumed
+   */
+  typedef boost::function<void(const ndn::Name &deviceName, const ndn::Name &baseName,
+                               uint64_t minSeqNo, uint64_t maxSeqNo, ReceiveWindow &progress)> ReconcileCallback;
+
+  /**
+   * @brief Callback to create check of every segment of the fetch from the segment root given to Enqueue,
+   *        called for new fetches and for fetches resumed from taskDb (where the segment root is stored)
+   */
+  typedef boost::function<SegmentVerifier (const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo,
+                                           const std::string &segmentRoot)> VerifierFactory;
+
+  /**
+   * @brief Ordering of fetches with the same priority
+   *
+   * Fetches are started in the increasing order of their rank: time (seconds) when the fetch was enqueued
+   * plus the penalty returned by the policy for the number of segments to fetch and the timestamp of the content.
+   * Since ranks of newly enqueued fetches keep growing, a fetch is delayed by at most its penalty and cannot be starved.
+   */
+  typedef boost::function<double(uint64_t segments, time_t timestamp)> OrderingPolicy;
+
+  /**
+   * @brief Fetches are started in the order they were enqueued
+   */
+  static OrderingPolicy
+  FifoOrdering ();
+
+  /**
+   * @brief Smaller fetches first, every doubling of the size costs secondsPerDoubling of the delay
+   */
+  static OrderingPolicy
+  SmallestFirstOrdering (double secondsPerDoubling = 10);
+
+  /**
+   * @brief Recently modified content first, every doubling of the content age costs secondsPerDoubling of the delay
+   */
+  static OrderingPolicy
+  RecentFirstOrdering (double secondsPerDoubling = 10);
+
   FetchManager (const Mapping &mapping,
                 const ndn::Name &broadcastForwardingHint,
                 uint32_t parallelFetches = 3,
                 const SegmentCallback &defaultSegmentCallback = SegmentCallback(),
                 const FinishCallback &defaultFinishCallback = FinishCallback(),
-                const FetchTaskDbPtr &taskDb = FetchTaskDbPtr()
+                const FetchTaskDbPtr &taskDb = FetchTaskDbPtr(),
+                const ReconcileCallback &reconcile = ReconcileCallback(),
+                const VerifierFactory &verifierFactory = VerifierFactory()
                 );
   virtual ~FetchManager ();
 
+  /**
+   * @param timestamp modification time of the content (if known), used by some ordering policies
+   * @param segmentRoot if not empty, every segment is checked on arrival by the verifier made by VerifierFactory
+   *                    (see Fetcher::SetSegmentVerifier)
+   */
   void
   Enqueue (const ndn::Name &deviceName, const ndn::Name &baseName,
            const SegmentCallback &segmentCallback, const FinishCallback &finishCallback,
-           uint64_t minSeqNo, uint64_t maxSeqNo, int priority=PRIORITY_NORMAL);
+           uint64_t minSeqNo, uint64_t maxSeqNo, int priority=PRIORITY_NORMAL, time_t timestamp=0,
+           const std::string &segmentRoot=std::string());
 
   // Enqueue using default callbacks
   void
   Enqueue (const ndn::Name &deviceName, const ndn::Name &baseName,
-           uint64_t minSeqNo, uint64_t maxSeqNo, int priority=PRIORITY_NORMAL);
+           uint64_t minSeqNo, uint64_t maxSeqNo, int priority=PRIORITY_NORMAL, time_t timestamp=0,
+           const std::string &segmentRoot=std::string());
+
+  /**
+   * @brief Raise priority of the fetch of baseName and start it as soon as possible, even if it is waiting for retry
+   * @returns false if there is no such fetch
+   */
+  bool
+  Promote (const ndn::Name &baseName, int priority=PRIORITY_URGENT);
+
+  /**
+   * @brief Set ordering of fetches enqueued after this call (FIFO by default)
+   */
+  void
+  SetOrderingPolicy (const OrderingPolicy &policy);
+
+  /**
+   * @brief Add alternative source for the fetch of baseName (swarm mode)
+   *
+   * The alternative source publishes the same content under sourceBaseName.  Does nothing
+   * if there is no fetch for baseName.
+   */
+  void
+  AddSource (const ndn::Name &baseName, const ndn::Name &sourceDeviceName, const ndn::Name &sourceBaseName);
+
+  /**
+   * @brief Set bounds for the number of parallel fetches
+   *
+   * Within the bounds, the number is adjusted based on the measured aggregate goodput and queueing delay.
+   * Setting minFetches equal to maxFetches effectively disables the adjustment.
+   */
+  void
+  SetParallelFetchLimits (uint32_t minFetches, uint32_t maxFetches);
+
+  // bounds used until SetParallelFetchLimits is called
+  static const uint32_t DEFAULT_MIN_PARALLEL_FETCHES = 1;
+  static const uint32_t DEFAULT_MAX_PARALLEL_FETCHES = 64;
+
+  /**
+   * @brief Current limit of the parallel fetches
+   */
+  uint32_t
+  GetParallelFetchLimit ();
+
+  /**
+   * @brief Limit download rate of all fetches (including already enqueued)
+   */
+  void
+  SetRateLimiter (RateLimiterPtr rateLimiter);
+
+  /**
+   * @brief Verify signatures of the data received by all fetches (including already enqueued)
+   */
+  void
+  SetVerificationService (VerificationServicePtr service);
+
+  /**
+   * @brief Set callback notified every time a fetch fails (the fetch stays enqueued and is retried later)
+   */
+  void
+  SetFailureCallback (const FinishCallback &failureCallback) { m_failureCallback = failureCallback; }
+
+  /**
+   * @brief Set congestion control algorithm for windows created after this call
+   */
+  void
+  SetCongestionControl (CongestionWindow::Algorithm algorithm) { m_congestionAlgorithm = algorithm; }
 
   // only for Fetcher
 //  inline Ccnx::CcnxWrapperPtr
@@ -84,12 +204,54 @@ private:
   void
   ScheduleFetches ();
 
+  void
+  ResumeTask (const ReconcileCallback &reconcile,
+              const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo, int priority,
+              const std::string &segmentRoot);
+
+  void
+  AdjustConcurrency ();
+
+  void
+  DidSegmentFetched (const SegmentCallback &callback,
+                     ndn::Name &deviceName, ndn::Name &baseName, uint64_t seq, boost::shared_ptr<ndn::Data> pco);
+
+  // the following should be called with m_parellelFetchMutex locked
+
+  void
+  PushReady (Fetcher &fetcher);
+
+  // returns true if fetcher was in the ready queue
+  bool
+  RemoveReady (Fetcher &fetcher);
+
+  void
+  PushDelayed (Fetcher &fetcher);
+
+  /**
+   * @brief Get next fetcher to start: highest priority first, then device with the fewest active
+   *        fetches (the smallest rank, then round-robin between equal devices)
+   */
+  Fetcher *
+  PopReady ();
+
+  void
+  DidFetchStop (Fetcher &fetcher);
+
   void
   TimedWait (Fetcher &fetcher);
 
   inline boost::shared_ptr<ndn::Face>
   GetNdn ();
 
+  // should be called with m_parellelFetchMutex locked
+  CongestionWindowPtr
+  GetCongestionWindow (const ndn::Name &deviceName);
+
+  // should be called with m_parellelFetchMutex locked
+  RttEstimatorPtr
+  GetRttEstimator (const ndn::Name &deviceName);
+
 private:
   boost::shared_ptr<ndn::Face> m_ndn;
   Mapping m_mapping;
@@ -98,18 +260,54 @@ private:
   uint32_t m_currentParallelFetches;
   boost::mutex m_parellelFetchMutex;
 
+  ConcurrencyController m_concurrency;
+  uint64_t m_deliveredBytes; // since the last concurrency adjustment
+  boost::posix_time::ptime m_lastAdjustment;
+
   // optimized list structure for fetch queue
   typedef boost::intrusive::member_hook< Fetcher,
                                          boost::intrusive::list_member_hook<>, &Fetcher::m_managerListHook> MemberOption;
   typedef boost::intrusive::list<Fetcher, MemberOption> FetchList;
 
-  FetchList m_fetchList;
+  FetchList m_fetchList; // owns all fetchers
+
+  typedef std::multimap<double /*rank*/, Fetcher *> ReadyQueue;
+
+  struct DeviceQueue
+  {
+    DeviceQueue () : m_active (0) {}
+
+    bool
+    HasReady () const;
+
+    ReadyQueue m_ready[PRIORITY_URGENT + 1];
+    uint32_t m_active;
+  };
+  typedef std::map<ndn::Name, DeviceQueue> DeviceQueues;
+
+  DeviceQueues m_deviceQueues; // fetchers ready to be started, per device
+  ndn::Name m_lastServedDevice; // for round-robin
+
+  typedef std::multimap<boost::posix_time::ptime, Fetcher *> DelayedFetchers;
+  DelayedFetchers m_delayedFetchers; // fetchers waiting for the retry, ordered by the retry time
   SchedulerPtr m_scheduler;
   ExecutorPtr m_executor;
   TaskPtr m_scheduleFetchesTask;
   SegmentCallback m_defaultSegmentCallback;
   FinishCallback m_defaultFinishCallback;
+  FinishCallback m_failureCallback;
   FetchTaskDbPtr m_taskDb;
+  VerifierFactory m_verifierFactory;
+  RateLimiterPtr m_rateLimiter;
+  VerificationServicePtr m_verificationService;
+
+  OrderingPolicy m_orderingPolicy;
+  boost::posix_time::ptime m_epoch; // reference point for the ranks
+
+  // all fetchers from the same device share the same window
+  std::map<ndn::Name, CongestionWindowPtr> m_congestionWindows;
+  CongestionWindow::Algorithm m_congestionAlgorithm;
+  std::map<ndn::Name, RttEstimatorPtr> m_rttEstimators;
 
   const ndn::Name m_broadcastHint;
 };
@@ -20,6 +20,13 @@
  */
 #include "fetch-task-db.h"
 #include "db-helper.h"
+#include "db-upgrade.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <vector>
+
+INIT_LOGGER ("FetchTaskDb");
 
 using namespace std;
 using namespace boost;
@@ -34,12 +41,66 @@ CREATE TABLE IF NOT EXISTS                                      \n\
     minSeqNo    INTEGER,                                        \n\
     maxSeqNo    INTEGER,                                        \n\
     priority    INTEGER,                                        \n\
+    nextSeqNo   INTEGER,                                        \n\
+    received    BLOB,                                           \n\
+    segmentRoot BLOB,                                           \n\
     PRIMARY KEY (deviceName, baseName)                          \n\
   );                                                            \n\
 CREATE INDEX identifier ON Task (deviceName, baseName);         \n\
 ";
 
+static const ColumnUpgrade UPGRADE_COLUMNS[] = {
+  { "Task", "nextSeqNo", "INTEGER" },
+  { "Task", "received", "BLOB" },
+  { "Task", "segmentRoot", "BLOB" },
+};
+
+// number of received segments after which progress is checkpointed without waiting for explicit checkpoint
+static const uint32_t CHECKPOINT_BATCH_SIZE = 1024;
+
+static ndn::Name
+decodeName (sqlite3_stmt *stmt, int column)
+{
+  return ndn::Name (ndn::Block (reinterpret_cast<const uint8_t*> (sqlite3_column_blob (stmt, column)),
+                                sqlite3_column_bytes (stmt, column)));
+}
+
+// bit i of the bitmap is set if segment (base + i) is received
+static std::string
+encodeReceived (const ReceiveWindow &progress)
+{
+  std::string bitmap;
+  uint32_t found = 0;
+  for (int64_t seqNo = progress.GetBase () + 1; found < progress.GetOutOfOrderCount (); seqNo++)
+    {
+      if (!progress.IsReceived (seqNo))
+        continue;
+
+      uint64_t offset = seqNo - progress.GetBase ();
+      if (bitmap.size () <= offset / 8)
+        bitmap.resize (offset / 8 + 1, 0);
+      bitmap[offset / 8] |= (1 << (offset % 8));
+      found ++;
+    }
+  return bitmap;
+}
+
+static void
+decodeReceived (ReceiveWindow &progress, int64_t base, const uint8_t *bitmap, int size)
+{
+  progress.Reset (base);
+  for (int i = 0; i < size; i++)
+    {
+      for (int bit = 0; bit < 8; bit++)
+        {
+          if (bitmap[i] & (1 << bit))
+            progress.MarkReceived (base + i * 8 + bit);
+        }
+    }
+}
+
 FetchTaskDb::FetchTaskDb(const boost::filesystem::path &folder, const std::string &tag)
+  : m_pendingUpdates(0)
 {
   fs::path actualFolder = folder / ".chronoshare" / "fetch_tasks";
   fs::create_directories (actualFolder);
@@ -60,10 +121,17 @@ FetchTaskDb::FetchTaskDb(const boost::filesystem::path &folder, const std::strin
   else
   {
   }
+
+  if (!AddMissingColumns(m_db, UPGRADE_COLUMNS))
+  {
+    _LOG_ERROR("Cannot upgrade Task table: " << sqlite3_errmsg(m_db));
+  }
 }
 
 FetchTaskDb::~FetchTaskDb()
 {
+  checkpoint();
+
   int res = sqlite3_close(m_db);
   if (res != SQLITE_OK)
   {
@@ -72,19 +140,24 @@ FetchTaskDb::~FetchTaskDb()
 }
 
 void
-FetchTaskDb::addTask(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo, int priority)
+FetchTaskDb::addTask(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo, int priority,
+                     const std::string &segmentRoot/* = std::string()*/)
 {
   sqlite3_stmt *stmt;
-  sqlite3_prepare_v2(m_db, "INSERT OR IGNORE INTO Task (deviceName, baseName, minSeqNo, maxSeqNo, priority) VALUES (?, ?, ?, ?, ?)", -1, &stmt, 0);
+  sqlite3_prepare_v2(m_db, "INSERT OR IGNORE INTO Task (deviceName, baseName, minSeqNo, maxSeqNo, priority, segmentRoot) VALUES (?, ?, ?, ?, ?, ?)", -1, &stmt, 0);
 
   ndn::Block deviceBlock = deviceName.wireEncode();
   ndn::Block baseBlock = baseName.wireEncode();
 
-  sqlite3_bind_blob(stmt, 1, deviceBlock.value (), deviceBlock.size (), SQLITE_STATIC);
-  sqlite3_bind_blob(stmt, 2, baseBlock.value (), baseBlock.size (), SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 1, deviceBlock.wire (), deviceBlock.size (), SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 2, baseBlock.wire (), baseBlock.size (), SQLITE_STATIC);
   sqlite3_bind_int64(stmt, 3, minSeqNo);
   sqlite3_bind_int64(stmt, 4, maxSeqNo);
   sqlite3_bind_int(stmt, 5, priority);
+  if (!segmentRoot.empty())
+  {
+    sqlite3_bind_blob(stmt, 6, segmentRoot.c_str(), segmentRoot.size(), SQLITE_STATIC);
+  }
   int res = sqlite3_step(stmt);
 
   if (res == SQLITE_OK)
@@ -96,14 +169,20 @@ FetchTaskDb::addTask(const ndn::Name &deviceName, const ndn::Name &baseName, uin
 void
 FetchTaskDb::deleteTask(const ndn::Name &deviceName, const ndn::Name &baseName)
 {
+  {
+    boost::mutex::scoped_lock lock(m_progressMutex);
+    m_progress.erase(TaskKey(deviceName, baseName));
+    m_dirty.erase(TaskKey(deviceName, baseName));
+  }
+
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(m_db, "DELETE FROM Task WHERE deviceName = ? AND baseName = ?;", -1, &stmt, 0);
 
   ndn::Block deviceBlock = deviceName.wireEncode();
   ndn::Block baseBlock = baseName.wireEncode();
 
-  sqlite3_bind_blob(stmt, 1, deviceBlock.value (), baseBlock.size (), SQLITE_STATIC);
-  sqlite3_bind_blob(stmt, 2, baseBlock.value (), baseBlock.size (), SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 1, deviceBlock.wire (), deviceBlock.size (), SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 2, baseBlock.wire (), baseBlock.size (), SQLITE_STATIC);
   int res = sqlite3_step(stmt);
   if (res == SQLITE_OK)
   {
@@ -111,24 +190,200 @@ FetchTaskDb::deleteTask(const ndn::Name &deviceName, const ndn::Name &baseName)
   sqlite3_finalize(stmt);
 }
 
+struct StoredTask
+{
+  ndn::Name deviceName;
+  ndn::Name baseName;
+  uint64_t minSeqNo;
+  uint64_t maxSeqNo;
+  int priority;
+  std::string segmentRoot;
+};
+
 void
 FetchTaskDb::foreachTask(const FetchTaskCallback &callback)
 {
+  std::vector<StoredTask> tasks;
+  std::vector<sqlite3_int64> undecodable;
+
   sqlite3_stmt *stmt;
-  sqlite3_prepare_v2(m_db, "SELECT * FROM Task;", -1, &stmt, 0);
+  sqlite3_prepare_v2(m_db, "SELECT rowid, deviceName, baseName, minSeqNo, maxSeqNo, priority, segmentRoot FROM Task;", -1, &stmt, 0);
   while (sqlite3_step(stmt) == SQLITE_ROW)
   {
-     ndn::Name deviceName(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, 0)));
-     deviceName.append(reinterpret_cast<const char*>(sqlite3_column_bytes(stmt, 0)));
+    StoredTask task;
+    try
+    {
+      task.deviceName = decodeName(stmt, 1);
+      task.baseName = decodeName(stmt, 2);
+    }
+    catch (tlv::Error &error)
+    {
+      // rows written in the old (pre-TLV) format cannot be resumed, the task will be recreated from the action log
+      _LOG_ERROR("Dropping fetch task that cannot be decoded: " << error.what());
+      undecodable.push_back(sqlite3_column_int64(stmt, 0));
+      continue;
+    }
+    task.minSeqNo = sqlite3_column_int64(stmt, 3);
+    task.maxSeqNo = sqlite3_column_int64(stmt, 4);
+    task.priority = sqlite3_column_int(stmt, 5);
+    task.segmentRoot = std::string(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, 6)), sqlite3_column_bytes(stmt, 6));
+    tasks.push_back(task);
+  }
+
+  sqlite3_finalize(stmt);
+
+  for (std::vector<sqlite3_int64>::iterator rowid = undecodable.begin(); rowid != undecodable.end(); rowid++)
+  {
+    sqlite3_prepare_v2(m_db, "DELETE FROM Task WHERE rowid = ?;", -1, &stmt, 0);
+    sqlite3_bind_int64(stmt, 1, *rowid);
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+    {
+      _LOG_ERROR("Cannot delete undecodable fetch task: " << sqlite3_errmsg(m_db));
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  // callback is invoked after the statement is finalized, so it can modify tasks
+  for (std::vector<StoredTask>::iterator task = tasks.begin(); task != tasks.end(); task++)
+  {
+    callback(task->deviceName, task->baseName, task->minSeqNo, task->maxSeqNo, task->priority, task->segmentRoot);
+  }
+}
+
+ReceiveWindow *
+FetchTaskDb::loadProgress(const TaskKey &key)
+{
+  std::map<TaskKey, ReceiveWindow>::iterator progress = m_progress.find(key);
+  if (progress != m_progress.end())
+  {
+    return &progress->second;
+  }
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(m_db, "SELECT minSeqNo, nextSeqNo, received FROM Task WHERE deviceName = ? AND baseName = ?;", -1, &stmt, 0);
+
+  ndn::Block deviceBlock = key.first.wireEncode();
+  ndn::Block baseBlock = key.second.wireEncode();
+
+  sqlite3_bind_blob(stmt, 1, deviceBlock.wire (), deviceBlock.size (), SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 2, baseBlock.wire (), baseBlock.size (), SQLITE_STATIC);
+
+  ReceiveWindow *retval = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    int64_t base = sqlite3_column_int64(stmt, 0);
+    if (sqlite3_column_type(stmt, 1) != SQLITE_NULL)
+    {
+      base = std::max(base, static_cast<int64_t>(sqlite3_column_int64(stmt, 1)));
+    }
+
+    retval = &m_progress.insert(std::make_pair(key, ReceiveWindow(base))).first->second;
+    decodeReceived(*retval, base,
+                   reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, 2)), sqlite3_column_bytes(stmt, 2));
+  }
+
+  sqlite3_finalize(stmt);
+  return retval;
+}
+
+void
+FetchTaskDb::markReceived(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t seqNo)
+{
+  boost::mutex::scoped_lock lock(m_progressMutex);
+
+  TaskKey key(deviceName, baseName);
+  ReceiveWindow *progress = loadProgress(key);
+  if (progress == 0)
+  {
+    return;
+  }
+
+  if (progress->MarkReceived(seqNo))
+  {
+    m_dirty.insert(key);
+    m_pendingUpdates ++;
 
-     ndn::Name baseName(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, 1)));
-     baseName.append(reinterpret_cast<const char*>(sqlite3_column_bytes(stmt, 1)));
+    if (m_pendingUpdates >= CHECKPOINT_BATCH_SIZE)
+    {
+      checkpointLocked();
+    }
+  }
+}
+
+bool
+FetchTaskDb::getProgress(const ndn::Name &deviceName, const ndn::Name &baseName, ReceiveWindow &progress)
+{
+  boost::mutex::scoped_lock lock(m_progressMutex);
 
-     uint64_t minSeqNo = sqlite3_column_int64(stmt, 2);
-     uint64_t maxSeqNo = sqlite3_column_int64(stmt, 3);
-     int priority = sqlite3_column_int(stmt, 4);
-     callback(deviceName, baseName, minSeqNo, maxSeqNo, priority);
+  ReceiveWindow *known = loadProgress(TaskKey(deviceName, baseName));
+  if (known == 0)
+  {
+    return false;
+  }
+
+  progress = *known;
+  return true;
+}
+
+void
+FetchTaskDb::setProgress(const ndn::Name &deviceName, const ndn::Name &baseName, const ReceiveWindow &progress)
+{
+  boost::mutex::scoped_lock lock(m_progressMutex);
+
+  TaskKey key(deviceName, baseName);
+  if (loadProgress(key) == 0)
+  {
+    return;
+  }
+
+  m_progress.find(key)->second = progress;
+  m_dirty.insert(key);
+  checkpointLocked();
+}
+
+void
+FetchTaskDb::checkpoint()
+{
+  boost::mutex::scoped_lock lock(m_progressMutex);
+  checkpointLocked();
+}
+
+void
+FetchTaskDb::checkpointLocked()
+{
+  m_pendingUpdates = 0;
+  if (m_dirty.empty())
+  {
+    return;
+  }
+
+  _LOG_DEBUG("Checkpoint progress of " << m_dirty.size() << " tasks");
+
+  sqlite3_exec(m_db, "BEGIN TRANSACTION;", 0, 0, 0);
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(m_db, "UPDATE Task SET nextSeqNo = ?, received = ? WHERE deviceName = ? AND baseName = ?;", -1, &stmt, 0);
+
+  for (std::set<TaskKey>::iterator key = m_dirty.begin(); key != m_dirty.end(); key++)
+  {
+    const ReceiveWindow &progress = m_progress.find(*key)->second;
+    std::string received = encodeReceived(progress);
+
+    ndn::Block deviceBlock = key->first.wireEncode();
+    ndn::Block baseBlock = key->second.wireEncode();
+
+    sqlite3_bind_int64(stmt, 1, progress.GetBase());
+    sqlite3_bind_blob(stmt, 2, received.c_str(), received.size(), SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 3, deviceBlock.wire (), deviceBlock.size (), SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 4, baseBlock.wire (), baseBlock.size (), SQLITE_STATIC);
+
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
   }
 
   sqlite3_finalize(stmt);
+  sqlite3_exec(m_db, "END TRANSACTION;", 0, 0, 0);
+
+  m_dirty.clear();
 }
@@ -24,7 +24,12 @@
 #include <sqlite3.h>
 #include <boost/filesystem.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 #include <ndn-cxx/name.hpp>
+#include <map>
+#include <set>
+#include "receive-window.h"
 
 class FetchTaskDb
 {
@@ -34,19 +39,64 @@ public:
 
   // task with same deviceName and baseName combination will be added only once
   // if task already exists, this call does nothing
+  // segmentRoot (if not empty) is kept so that segments of the resumed task can be verified the same way
   void
-  addTask(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo, int priority);
+  addTask(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo, int priority,
+          const std::string &segmentRoot = std::string());
 
   void
   deleteTask(const ndn::Name &deviceName, const ndn::Name &baseName);
 
-  typedef boost::function<void(const ndn::Name &, const ndn::Name &, uint64_t, uint64_t, int)> FetchTaskCallback;
+  typedef boost::function<void(const ndn::Name &, const ndn::Name &, uint64_t, uint64_t, int, const std::string &)> FetchTaskCallback;
 
   void
   foreachTask(const FetchTaskCallback &callback);
 
+  /**
+   * @brief Record that the segment of the task has been received
+   *
+   * Progress is kept in memory and written to the database in batches (see checkpoint).
+   * Does nothing if there is no such task.
+   */
+  void
+  markReceived(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t seqNo);
+
+  /**
+   * @brief Get last known progress of the task (including not yet checkpointed)
+   * @returns false if there is no such task
+   */
+  bool
+  getProgress(const ndn::Name &deviceName, const ndn::Name &baseName, ReceiveWindow &progress);
+
+  /**
+   * @brief Replace progress of the task (e.g., after reconciliation with the stored data)
+   */
+  void
+  setProgress(const ndn::Name &deviceName, const ndn::Name &baseName, const ReceiveWindow &progress);
+
+  /**
+   * @brief Write all progress updates to the database in one transaction
+   */
+  void
+  checkpoint();
+
+private:
+  typedef std::pair<ndn::Name, ndn::Name> TaskKey;
+
+  // should be called with m_progressMutex locked
+  ReceiveWindow *
+  loadProgress(const TaskKey &key);
+
+  void
+  checkpointLocked();
+
 private:
   sqlite3 *m_db;
+
+  boost::mutex m_progressMutex;
+  std::map<TaskKey, ReceiveWindow> m_progress; // cache of progress of tasks
+  std::set<TaskKey> m_dirty; // tasks with progress not yet checkpointed
+  uint32_t m_pendingUpdates;
 };
 
 typedef boost::shared_ptr<FetchTaskDb> FetchTaskDbPtr;
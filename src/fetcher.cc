@@ -25,11 +25,19 @@
 
 #include <boost/make_shared.hpp>
 #include <boost/ref.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <limits>
 
 INIT_LOGGER ("Fetcher");
 
+// fetchers are owned by FetchManager, m_self only tracks their lifetime
+struct null_deleter { void operator() (void const *) const {} };
+
+// how often a fetcher with nothing in flight checks for a free slot in the window shared with other fetchers
+static const double WINDOW_RETRY_DELAY = 0.1; // seconds
+
 using namespace boost;
 using namespace std;
 using namespace ndn;
@@ -40,7 +48,9 @@ Fetcher::Fetcher (ExecutorPtr executor,
                   OnFetchCompleteCallback onFetchComplete, OnFetchFailedCallback onFetchFailed,
                   const ndn::Name &deviceName, const ndn::Name &name, int64_t minSeqNo, int64_t maxSeqNo,
                   boost::posix_time::time_duration timeout/* = boost::posix_time::seconds (30)*/,
-                  const ndn::Name &forwardingHint/* = ndn::Name ()*/)
+                  const ndn::Name &forwardingHint/* = ndn::Name ()*/,
+                  CongestionWindowPtr window/* = CongestionWindowPtr ()*/,
+                  RttEstimatorPtr rttEstimator/* = RttEstimatorPtr ()*/)
   : m_ndn ()
   , m_segmentCallback (segmentCallback)
   , m_onFetchComplete (onFetchComplete)
@@ -55,16 +65,32 @@ Fetcher::Fetcher (ExecutorPtr executor,
   , m_maximumNoActivityPeriod (timeout)
 
   , m_minSendSeqNo (minSeqNo-1)
-  , m_maxInOrderRecvSeqNo (minSeqNo-1)
+  , m_receiveWindow (minSeqNo)
   , m_minSeqNo (minSeqNo)
   , m_maxSeqNo (maxSeqNo)
 
-  , m_pipeline (6) // initial "congestion window"
   , m_activePipeline (0)
+  , m_receivedBytes (0)
   , m_retryPause (0)
   , m_nextScheduledRetry (date_time::second_clock<boost::posix_time::ptime>::universal_time ())
+  , m_priority (0)
+  , m_rank (0)
   , m_executor (executor) // must be 1
+  , m_self (this, null_deleter ())
+  , m_refillScheduled (false)
+  , m_refillGeneration (0)
 {
+  if (!window)
+    {
+      window = boost::make_shared<CongestionWindow> ();
+    }
+
+  if (!rttEstimator)
+    {
+      rttEstimator = boost::make_shared<RttEstimator> ();
+    }
+
+  AddSource (deviceName, name, forwardingHint, window, rttEstimator);
 }
 
 Fetcher::~Fetcher ()
@@ -75,132 +101,353 @@ void
 Fetcher::RestartPipeline ()
 {
   m_active = true;
-  m_minSendSeqNo = m_maxInOrderRecvSeqNo;
+  m_minSendSeqNo = m_receiveWindow.GetBase () - 1;
   // cout << "Restart: " << m_minSendSeqNo << endl;
   m_lastPositiveActivity = date_time::second_clock<boost::posix_time::ptime>::universal_time();
 
+  m_receivedBytes = 0;
+  m_fetchStart = CongestionWindow::Now ();
+  m_retransmissions.clear ();
+
+  for (std::vector<Source>::iterator source = m_sources.begin (); source != m_sources.end (); source++)
+    {
+      source->m_receivedBytes = 0;
+      source->m_start = m_fetchStart;
+      source->m_timeouts = 0;
+      source->m_enabled = true;
+    }
+
   m_executor->execute (bind (&Fetcher::FillPipeline, this));
 }
 
+double
+Fetcher::GetGoodput () const
+{
+  double elapsed = (CongestionWindow::Now () - m_fetchStart).total_microseconds () / 1000000.0;
+  if (m_fetchStart.is_not_a_date_time () || elapsed <= 0)
+    return 0;
+
+  return m_receivedBytes / elapsed;
+}
+
 void
 Fetcher::SetForwardingHint (const ndn::Name &forwardingHint)
 {
   m_forwardingHint = forwardingHint;
+  m_sources[0].m_forwardingHint = forwardingHint;
+}
+
+void
+Fetcher::SetProgress (const ReceiveWindow &progress)
+{
+  if (progress.GetBase () < m_minSeqNo)
+    return;
+
+  m_receiveWindow = progress;
+  m_minSendSeqNo = m_receiveWindow.GetBase () - 1;
+}
+
+void
+Fetcher::AddSource (const ndn::Name &deviceName, const ndn::Name &name, const ndn::Name &forwardingHint,
+                    CongestionWindowPtr window, RttEstimatorPtr rttEstimator)
+{
+  for (std::vector<Source>::iterator source = m_sources.begin (); source != m_sources.end (); source++)
+    {
+      if (source->m_deviceName == deviceName)
+        return;
+    }
+
+  _LOG_DEBUG ("Add source " << deviceName << " for " << m_name);
+
+  Source source;
+  source.m_deviceName = deviceName;
+  source.m_name = name;
+  source.m_forwardingHint = forwardingHint;
+  source.m_window = window;
+  source.m_rttEstimator = rttEstimator;
+  source.m_receivedBytes = 0;
+  source.m_start = CongestionWindow::Now ();
+  source.m_timeouts = 0;
+  source.m_enabled = true;
+
+  m_sources.push_back (source);
+
+  if (m_active)
+    {
+      m_executor->execute (bind (&Fetcher::FillPipeline, this));
+    }
+}
+
+void
+Fetcher::SetRateLimiter (RateLimiterPtr rateLimiter, SchedulerPtr scheduler)
+{
+  m_rateLimiter = rateLimiter;
+  m_scheduler = scheduler;
+}
+
+void
+Fetcher::ScheduleRefill (double delay)
+{
+  if (!m_scheduler)
+    {
+      _LOG_ERROR ("No scheduler to resume " << m_name << ", fetch will stall until restarted");
+      return;
+    }
+
+  if (m_refillScheduled)
+    return;
+
+  // one-time task is still registered while its callback runs, so every refill needs its own tag
+  // to be scheduled again from the refill itself
+  m_refillGeneration ++;
+  Method refill = bind (&Fetcher::Refill, _1);
+  TaskPtr task = Scheduler::scheduleOneTimeTask (m_scheduler, delay,
+                                                 bind (&Fetcher::ExecuteIfAlive, m_executor, boost::weak_ptr<Fetcher> (m_self), refill),
+                                                 "refill-" + m_name.toUri () + "-" + lexical_cast<string> (m_refillGeneration));
+  m_refillScheduled = static_cast<bool> (task);
+  if (!m_refillScheduled)
+    {
+      _LOG_ERROR ("Cannot schedule refill of " << m_name << ", fetch will stall until restarted");
+    }
+}
+
+void
+Fetcher::Refill ()
+{
+  {
+    boost::unique_lock<boost::mutex> lock (m_seqNoMutex);
+    m_refillScheduled = false;
+  }
+
+  FillPipeline ();
+}
+
+void
+Fetcher::ExecuteIfAlive (ExecutorPtr executor, boost::weak_ptr<Fetcher> fetcher, const Method &method)
+{
+  executor->execute (bind (&Fetcher::RunIfAlive, fetcher, method));
+}
+
+void
+Fetcher::RunIfAlive (boost::weak_ptr<Fetcher> fetcher, const Method &method)
+{
+  boost::shared_ptr<Fetcher> self = fetcher.lock ();
+  if (self)
+    {
+      method (*self);
+    }
+}
+
+double
+Fetcher::GetSourceGoodput (size_t source) const
+{
+  double elapsed = (CongestionWindow::Now () - m_sources[source].m_start).total_microseconds () / 1000000.0;
+  if (elapsed <= 0)
+    return 0;
+
+  return m_sources[source].m_receivedBytes / elapsed;
+}
+
+int
+Fetcher::SelectSource (int exclude/* = -1*/)
+{
+  int best = -1;
+  double bestGoodput = 0;
+  for (size_t i = 0; i < m_sources.size (); i++)
+    {
+      if (!m_sources[i].m_enabled || static_cast<int> (i) == exclude)
+        continue;
+
+      // sources that have not yet delivered anything are probed first
+      double goodput = GetSourceGoodput (i);
+      if (m_sources[i].m_receivedBytes == 0 && m_sources[i].m_timeouts == 0)
+        goodput = std::numeric_limits<double>::max ();
+
+      if (best >= 0 && goodput <= bestGoodput)
+        continue;
+
+      if (m_sources[i].m_window->GetInFlight () >= static_cast<uint32_t> (m_sources[i].m_window->GetWindowSize ()))
+        continue;
+
+      best = i;
+      bestGoodput = goodput;
+    }
+
+  if (best >= 0 && !m_sources[best].m_window->TryAcquire ())
+    {
+      // window may be shared with other fetchers
+      return -1;
+    }
+
+  return best;
+}
+
+bool
+Fetcher::HasEnabledSource () const
+{
+  for (std::vector<Source>::const_iterator source = m_sources.begin (); source != m_sources.end (); source++)
+    {
+      if (source->m_enabled)
+        return true;
+    }
+  return false;
 }
 
 void
 Fetcher::FillPipeline ()
 {
-  for (; m_minSendSeqNo < m_maxSeqNo && m_activePipeline < m_pipeline; m_minSendSeqNo++)
+  if (!m_active)
+    return;
+
+  for (; m_minSendSeqNo < m_maxSeqNo; m_minSendSeqNo++)
     {
       boost::unique_lock<boost::mutex> lock (m_seqNoMutex);
 
-      if (m_outOfOrderRecvSeqNo.find (m_minSendSeqNo+1) != m_outOfOrderRecvSeqNo.end ())
+      if (m_receiveWindow.IsReceived (m_minSendSeqNo+1))
         continue;
 
-      if (m_inActivePipeline.find (m_minSendSeqNo+1) != m_inActivePipeline.end ())
+      if (m_receiveWindow.IsInFlight (m_minSendSeqNo+1))
         continue;
 
-      m_inActivePipeline.insert (m_minSendSeqNo+1);
+      // windows can be shared with other fetchers to the same device
+      int source = SelectSource ();
+      if (source < 0)
+        {
+          if (m_activePipeline == 0 && HasEnabledSource ())
+            {
+              // windows are kept full by other fetchers and nothing in flight would call FillPipeline again
+              ScheduleRefill (WINDOW_RETRY_DELAY);
+            }
+          break;
+        }
+
+      if (m_rateLimiter)
+        {
+          double delay = m_rateLimiter->GetDelay (m_sources[source].m_deviceName);
+          if (delay > 0)
+            {
+              m_sources[source].m_window->Release ();
+              if (m_activePipeline == 0)
+                {
+                  // nothing in flight that would trigger FillPipeline again
+                  ScheduleRefill (delay);
+                }
+              break;
+            }
+        }
 
-      _LOG_DEBUG (" >>> i " << ndn::Name (m_forwardingHint).append(m_name) << ", seq = " << (m_minSendSeqNo + 1 ));
+      m_receiveWindow.SetInFlight (m_minSendSeqNo+1, true);
 
       // cout << ">>> " << m_minSendSeqNo+1 << endl;
 
-      ndn::Interest interest(ndn::Name (m_forwardingHint).append(m_name).appendNumber(m_minSendSeqNo+1), time::seconds(1)); // Alex: this lifetime should be changed to RTO
-      m_ndn->expressInterest(interest,
-    		  	  	  bind(&Fetcher::OnData, this, m_minSendSeqNo+1, _1, _2),
-    				  bind(&Fetcher::OnTimeout, this, m_minSendSeqNo+1, _1));
-
-      _LOG_DEBUG (" >>> i ok");
+      ExpressInterest (m_minSendSeqNo+1, source);
 
       m_activePipeline ++;
     }
 }
 
 void
-Fetcher::OnData (uint64_t seqno, const ndn::Interest &interest, ndn::Data &data)
+Fetcher::ExpressInterest (int64_t seqno, size_t source)
 {
-  m_executor->execute (bind (&Fetcher::OnData_Execute, this, seqno, interest, data));
+  const Source &src = m_sources[source];
+  _LOG_DEBUG (" >>> i " << ndn::Name (src.m_forwardingHint).append(src.m_name) << ", seq = " << seqno);
+
+  ndn::Interest interest (ndn::Name (src.m_forwardingHint).append (src.m_name).appendNumber (seqno),
+                          time::milliseconds (static_cast<int64_t> (src.m_rttEstimator->GetRto () * 1000)));
+
+  posix_time::ptime now = CongestionWindow::Now ();
+  m_ndn->expressInterest (interest,
+                          bind (&Fetcher::OnData, this, seqno, source, now, _1, _2),
+                          bind (&Fetcher::OnTimeout, this, seqno, source, now, _1));
+
+  _LOG_DEBUG (" >>> i ok");
+}
+
+void
+Fetcher::OnData (uint64_t seqno, size_t source, posix_time::ptime sendTime, const ndn::Interest &interest, ndn::Data &data)
+{
+  if (m_verificationService)
+    {
+      m_verificationService->Verify (boost::make_shared<ndn::Data> (data),
+                                     bind (&Fetcher::OnVerified, m_executor, boost::weak_ptr<Fetcher> (m_self),
+                                           seqno, source, sendTime, interest, _1, _2));
+      return;
+    }
+
+  m_executor->execute (bind (&Fetcher::OnData_Execute, this, seqno, source, sendTime, interest, data));
+}
+
+void
+Fetcher::OnVerified (ExecutorPtr executor, boost::weak_ptr<Fetcher> fetcher,
+                     uint64_t seqno, size_t source, posix_time::ptime sendTime, const ndn::Interest &interest,
+                     boost::shared_ptr<ndn::Data> data, bool verified)
+{
+  // called from a verification worker, the fetcher may be destroyed by then
+  if (verified)
+    {
+      ExecuteIfAlive (executor, fetcher, bind (&Fetcher::OnData_Execute, _1, seqno, source, sendTime, interest, *data));
+    }
+  else
+    {
+      ExecuteIfAlive (executor, fetcher, bind (&Fetcher::OnBadData, _1, seqno, source));
+    }
 }
 
 void
-Fetcher::OnData_Execute (uint64_t seqno, const ndn::Interest &interest, ndn::Data &data)
+Fetcher::OnData_Execute (uint64_t seqno, size_t source, posix_time::ptime sendTime, const ndn::Interest &interest, ndn::Data &data)
 {
   const ndn::Name &name = data.getName ();
   _LOG_DEBUG (" <<< d " << name.getPartialName (0, name.size () - 1) << ", seq = " << seqno);
 
+  if (!m_segmentVerifier.empty () && !m_segmentVerifier (seqno, data))
+    {
+      OnBadData (seqno, source);
+      return;
+    }
 
   boost::shared_ptr<ndn::Data> pco = boost::make_shared<ndn::Data> (data.getContent ());
+  pco->setMetaInfo (data.getMetaInfo ()); // proof of the segment, so it can be served to other devices
 
-  if (m_forwardingHint == ndn::Name ())
-  {
-    // TODO: check verified!!!!
-    if (true)
+  if (!m_segmentCallback.empty ())
     {
-      if (!m_segmentCallback.empty ())
-      {
-        m_segmentCallback (m_deviceName, m_name, seqno, pco);
-      }
+      m_segmentCallback (m_deviceName, m_name, seqno, pco);
     }
-    else
+
+  m_activePipeline --;
+
+  Source &src = m_sources[source];
+  src.m_window->OnData ();
+  src.m_receivedBytes += data.getContent ().value_size ();
+
+  if (m_rateLimiter)
     {
-      _LOG_ERROR("Can not verify signature content. Name = " << name);
-      // probably needs to do more in the future
+      m_rateLimiter->Consume (src.m_deviceName, data.getContent ().value_size ());
+    }
+  src.m_timeouts = 0;
+
+  // Karn's algorithm: RTT of retransmitted Interests is ambiguous
+  std::map<int64_t, uint32_t>::iterator retx = m_retransmissions.find (seqno);
+  if (retx == m_retransmissions.end ())
+    {
+      src.m_rttEstimator->AddMeasurement ((CongestionWindow::Now () - sendTime).total_microseconds () / 1000000.0);
     }
-    // we don't have to tell FetchManager about this
-  }
   else
     {
-      // in this case we don't care whether "data" is verified,  in fact, we expect it is unverified
-
-      // we need to verify this pco and apply callback only when verified
-      // TODO: check verified !!!
-      if (true)
-      {
-        if (!m_segmentCallback.empty ())
-          {
-            m_segmentCallback (m_deviceName, m_name, seqno, pco);
-          }
-      }
-      else
-      { 
-        _LOG_ERROR("Can not verify signature content. Name = " << pco->getName ());
-        // probably needs to do more in the future
-      }
+      m_retransmissions.erase (retx);
     }
-
-  m_activePipeline --;
+  m_receivedBytes += data.getContent ().value_size ();
   m_lastPositiveActivity = date_time::second_clock<boost::posix_time::ptime>::universal_time();
 
   ////////////////////////////////////////////////////////////////////////////
   boost::unique_lock<boost::mutex> lock (m_seqNoMutex);
 
-  m_outOfOrderRecvSeqNo.insert (seqno);
-  m_inActivePipeline.erase (seqno);
-  _LOG_DEBUG ("Total segments received: " << m_outOfOrderRecvSeqNo.size ());
-  set<int64_t>::iterator inOrderSeqNo = m_outOfOrderRecvSeqNo.begin ();
-  for (; inOrderSeqNo != m_outOfOrderRecvSeqNo.end ();
-       inOrderSeqNo++)
-    {
-      _LOG_TRACE ("Checking " << *inOrderSeqNo << " and " << m_maxInOrderRecvSeqNo+1);
-      if (*inOrderSeqNo == m_maxInOrderRecvSeqNo+1)
-        {
-          m_maxInOrderRecvSeqNo = *inOrderSeqNo;
-        }
-      else if (*inOrderSeqNo < m_maxInOrderRecvSeqNo+1) // not possible anymore, but just in case
-        {
-          continue;
-        }
-      else
-        break;
-    }
-  m_outOfOrderRecvSeqNo.erase (m_outOfOrderRecvSeqNo.begin (), inOrderSeqNo);
+  m_receiveWindow.MarkReceived (seqno);
+  _LOG_DEBUG ("Segments received out of order: " << m_receiveWindow.GetOutOfOrderCount ());
   ////////////////////////////////////////////////////////////////////////////
 
-  _LOG_TRACE ("Max in order received: " << m_maxInOrderRecvSeqNo << ", max seqNo to request: " << m_maxSeqNo);
+  _LOG_TRACE ("Max in order received: " << m_receiveWindow.GetBase () - 1 << ", max seqNo to request: " << m_maxSeqNo);
 
-  if (m_maxInOrderRecvSeqNo == m_maxSeqNo)
+  if (m_receiveWindow.GetBase () - 1 == m_maxSeqNo)
     {
       _LOG_TRACE ("Fetch finished: " << m_name);
       m_active = false;
@@ -220,6 +467,15 @@ Fetcher::OnData_Execute (uint64_t seqno, const ndn::Interest &interest, ndn::Dat
           m_executor->execute (bind (m_onFetchComplete, boost::ref(*this), m_deviceName, m_name));
         }
     }
+  else if (m_activePipeline == 0 && !HasEnabledSource ())
+    {
+      // last segment requested from a source that was dropped
+      m_active = false;
+      if (!m_onFetchFailed.empty ())
+        {
+          m_onFetchFailed (boost::ref (*this));
+        }
+    }
   else
     {
       m_executor->execute (bind (&Fetcher::FillPipeline, this));
@@ -227,14 +483,45 @@ Fetcher::OnData_Execute (uint64_t seqno, const ndn::Interest &interest, ndn::Dat
 }
 
 void
-Fetcher::OnTimeout (uint64_t seqno, const ndn::Interest &interest)
+Fetcher::OnBadData (uint64_t seqno, size_t source)
+{
+  Source &src = m_sources[source];
+  _LOG_ERROR ("Segment " << seqno << " of " << m_name << " from " << src.m_deviceName << " failed verification, stop using the source");
+
+  src.m_enabled = false;
+  src.m_window->Release ();
+  m_activePipeline --;
+
+  {
+    boost::unique_lock<boost::mutex> lock (m_seqNoMutex);
+    m_receiveWindow.SetInFlight (seqno, false);
+    m_minSendSeqNo = std::min<int64_t> (m_minSendSeqNo, seqno - 1);
+  }
+
+  if (HasEnabledSource ())
+    {
+      // the segment will be requested again from another source
+      m_executor->execute (bind (&Fetcher::FillPipeline, this));
+    }
+  else if (m_activePipeline == 0)
+    {
+      m_active = false;
+      if (!m_onFetchFailed.empty ())
+        {
+          m_onFetchFailed (boost::ref (*this));
+        }
+    }
+}
+
+void
+Fetcher::OnTimeout (uint64_t seqno, size_t source, posix_time::ptime sendTime, const ndn::Interest &interest)
 {
   _LOG_DEBUG (this << ", " << m_executor.get ());
-  m_executor->execute (bind (&Fetcher::OnTimeout_Execute, this, seqno, interest));
+  m_executor->execute (bind (&Fetcher::OnTimeout_Execute, this, seqno, source, sendTime, interest));
 }
 
 void
-Fetcher::OnTimeout_Execute (uint64_t seqno, const ndn::Interest &interest)
+Fetcher::OnTimeout_Execute (uint64_t seqno, size_t source, posix_time::ptime sendTime, const ndn::Interest &interest)
 {
   const ndn::Name name = interest.getName ();
   _LOG_DEBUG (" <<< :( timeout " << name.getSubName (0, name.size () - 1) << ", seq = " << seqno);
@@ -244,14 +531,34 @@ Fetcher::OnTimeout_Execute (uint64_t seqno, const ndn::Interest &interest)
   //      << ", now: " << date_time::second_clock<boost::posix_time::ptime>::universal_time()
   //      << ", oldest: " << (date_time::second_clock<boost::posix_time::ptime>::universal_time() - m_maximumNoActivityPeriod) << endl;
 
+  Source &src = m_sources[source];
+  src.m_window->OnTimeout (sendTime);
+  src.m_rttEstimator->BackoffRto (sendTime);
+  src.m_timeouts ++;
+
+  if (src.m_enabled && src.m_timeouts >= MAX_RETRANSMISSIONS && source != 0)
+    {
+      // the original device is never dropped, FetchManager will deal with it if it fails
+      _LOG_DEBUG ("Source " << src.m_deviceName << " doesn't respond, stop using it for " << m_name);
+      src.m_enabled = false;
+    }
+
+  uint32_t &retransmissions = m_retransmissions [seqno];
+
   if (m_lastPositiveActivity <
-      (date_time::second_clock<boost::posix_time::ptime>::universal_time() - m_maximumNoActivityPeriod))
+      (date_time::second_clock<boost::posix_time::ptime>::universal_time() - m_maximumNoActivityPeriod) ||
+      retransmissions >= MAX_RETRANSMISSIONS)
     {
       bool done = false;
       {
         boost::unique_lock<boost::mutex> lock (m_seqNoMutex);
-        m_inActivePipeline.erase (seqno);
+        m_receiveWindow.SetInFlight (seqno, false);
         m_activePipeline --;
+        src.m_window->Release ();
+
+        // the segment is requested again if the fetch continues (other segments are still arriving)
+        m_minSendSeqNo = std::min<int64_t> (m_minSendSeqNo, seqno - 1);
+        m_retransmissions.erase (seqno);
 
         if (m_activePipeline == 0)
           {
@@ -264,7 +571,7 @@ Fetcher::OnTimeout_Execute (uint64_t seqno, const ndn::Interest &interest)
           {
             boost::unique_lock<boost::mutex> lock (m_seqNoMutex);
             _LOG_DEBUG ("Telling that fetch failed");
-            _LOG_DEBUG ("Active pipeline size should be zero: " << m_inActivePipeline.size ());
+            _LOG_DEBUG ("Active pipeline size should be zero: " << m_receiveWindow.GetInFlightCount ());
           }
 
           m_active = false;
@@ -277,8 +584,21 @@ Fetcher::OnTimeout_Execute (uint64_t seqno, const ndn::Interest &interest)
     }
   else
     {
-      _LOG_DEBUG ("Asking to reexpress seqno: " << seqno);
-      m_ndn->expressInterest(interest, bind(&Fetcher::OnData, this, seqno+1, _1, _2), //TODO: correct? do we pass in seqno+1?
-                                       bind(&Fetcher::OnTimeout, this, seqno+1, _1)); //TODO: correct? do we pass in seqno+1?
+      retransmissions ++;
+      _LOG_DEBUG ("Asking to reexpress seqno: " << seqno << " (retransmission " << retransmissions << ", RTO " << src.m_rttEstimator->GetRto () << ")");
+
+      // try another source, if there is one with free space in the window
+      int next = SelectSource (source);
+      if (next >= 0)
+        {
+          src.m_window->Release ();
+        }
+      else
+        {
+          next = source;
+        }
+
+      // new Interest with a new nonce and backed off lifetime
+      ExpressInterest (seqno, next);
     }
 }
@@ -23,9 +23,17 @@
 #define FETCHER_H
 
 #include "executor.h"
+#include "congestion-window.h"
+#include "rtt-estimator.h"
+#include "receive-window.h"
+#include "rate-limiter.h"
+#include "scheduler.h"
+#include "verification-service.h"
 #include <boost/intrusive/list.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
-#include <set>
+#include <map>
+#include <vector>
 #include <ndn-cxx/name.hpp>
 #include <ndn-cxx/data.hpp>
 #include <ndn-cxx/face.hpp>
@@ -40,6 +48,11 @@ public:
   typedef boost::function<void (Fetcher &, const ndn::Name &deviceName, const ndn::Name &baseName)> OnFetchCompleteCallback;
   typedef boost::function<void (Fetcher &)> OnFetchFailedCallback;
 
+  /**
+   * @brief Check of the segment on arrival (e.g., against the MerkleTree root published in the action)
+   */
+  typedef boost::function<bool (uint64_t seq, const ndn::Data &data)> SegmentVerifier;
+
   Fetcher (ExecutorPtr executor,
            const SegmentCallback &segmentCallback, // callback passed by caller of FetchManager
            const FinishCallback &finishCallback, // callback passed by caller of FetchManager
@@ -47,7 +60,9 @@ public:
            const ndn::Name &deviceName, const ndn::Name &name, int64_t minSeqNo, int64_t maxSeqNo,
            boost::posix_time::time_duration timeout = boost::posix_time::seconds (30), // this time is not precise, but sets min bound
                                                                                   // actual time depends on how fast Interests timeout
-           const ndn::Name &forwardingHint = ndn::Name ());
+           const ndn::Name &forwardingHint = ndn::Name (),
+           CongestionWindowPtr window = CongestionWindowPtr (), // if not specified, fetcher will use its own window
+           RttEstimatorPtr rttEstimator = RttEstimatorPtr ()); // if not specified, fetcher will use its own estimator
   virtual ~Fetcher ();
 
   inline bool
@@ -80,24 +95,174 @@ public:
   boost::posix_time::ptime
   GetNextScheduledRetry () const { return m_nextScheduledRetry; }
 
+  int
+  GetPriority () const { return m_priority; }
+
+  void
+  SetPriority (int priority) { m_priority = priority; }
+
+  /**
+   * @brief Order of the fetch among fetches with the same priority (smaller starts first)
+   */
+  double
+  GetRank () const { return m_rank; }
+
+  void
+  SetRank (double rank) { m_rank = rank; }
+
+  /**
+   * @brief Number of segments that are not yet received
+   */
+  uint64_t
+  GetRemainingSegments () const { return m_maxSeqNo + 1 - m_receiveWindow.GetBase () - m_receiveWindow.GetOutOfOrderCount (); }
+
   void
   SetNextScheduledRetry (boost::posix_time::ptime nextScheduledRetry) { m_nextScheduledRetry = nextScheduledRetry; }
 
+  /**
+   * @brief Current size of the (possibly shared) Interest window
+   */
+  double
+  GetWindowSize () const { return m_sources[0].m_window->GetWindowSize (); }
+
+  /**
+   * @brief Average rate of useful data (bytes per second) since the fetch was (re)started
+   */
+  double
+  GetGoodput () const;
+
+  /**
+   * @brief Current retransmission timeout (seconds) used as Interest lifetime
+   */
+  double
+  GetRto () const { return m_sources[0].m_rttEstimator->GetRto (); }
+
+  /**
+   * @brief Add another source of the same content (swarm mode)
+   *
+   * Segments are then requested from all enabled sources, each segment from the source
+   * that has free space in its window and the best observed goodput.  Segments are still
+   * reported to the callbacks with the original device and base names.
+   *
+   * @param deviceName device that holds the same content
+   * @param name       base name of the content published by this device
+   */
+  void
+  AddSource (const ndn::Name &deviceName, const ndn::Name &name, const ndn::Name &forwardingHint,
+             CongestionWindowPtr window, RttEstimatorPtr rttEstimator);
+
+  size_t
+  GetSourceCount () const { return m_sources.size (); }
+
+  /**
+   * @brief Skip segments that were already received (e.g., before restart)
+   *
+   * Should be called before the fetch is started
+   */
+  void
+  SetProgress (const ReceiveWindow &progress);
+
+  /**
+   * @brief Limit download rate of this fetcher (the limiter is normally shared between many fetchers)
+   * @param scheduler is used to resume fetching after the limiter delay expires
+   */
+  void
+  SetRateLimiter (RateLimiterPtr rateLimiter, SchedulerPtr scheduler);
+
+  /**
+   * @brief Scheduler to resume fetching when nothing is in flight, but no Interest can be sent
+   *        (e.g., shared window is kept full by other fetchers)
+   */
+  void
+  SetScheduler (SchedulerPtr scheduler) { m_scheduler = scheduler; }
+
+  /**
+   * @brief Verify every segment before it is reported to the segment callback
+   *
+   * Source that sent a segment failing the check is not used anymore and the segment is requested
+   * from other sources.  If no source is left, the fetch fails (all sources are tried again on restart).
+   */
+  void
+  SetSegmentVerifier (const SegmentVerifier &verifier) { m_segmentVerifier = verifier; }
+
+  /**
+   * @brief Check signature of every received packet on the worker pool of the service
+   *
+   * Packet with invalid signature is handled the same way as the segment failing SetSegmentVerifier check
+   */
+  void
+  SetVerificationService (VerificationServicePtr service) { m_verificationService = service; }
+
+  /**
+   * @brief Goodput (bytes per second) of the specific source
+   */
+  double
+  GetSourceGoodput (size_t source) const;
+
+  /**
+   * @brief Maximum number of times the same segment is re-expressed before fetch is declared failed
+   */
+  static const uint32_t MAX_RETRANSMISSIONS = 7;
+
 private:
   void
   FillPipeline ();
 
+  /**
+   * @brief Select source with free window slot and best goodput (slot is acquired)
+   * @returns index of the source or -1 if all windows are full
+   */
+  int
+  SelectSource (int exclude = -1);
+
+  bool
+  HasEnabledSource () const;
+
   void
-  OnData (uint64_t seqno, const ndn::Interest &interest, ndn::Data &data);
+  OnBadData (uint64_t seqno, size_t source);
 
   void
-  OnData_Execute (uint64_t seqno, const ndn::Interest &interest, ndn::Data &data);
+  ExpressInterest (int64_t seqno, size_t source);
 
+  /**
+   * @brief Call FillPipeline after delay, unless it is already scheduled
+   */
   void
-  OnTimeout (uint64_t seqno, const ndn::Interest &interest);
+  ScheduleRefill (double delay);
 
   void
-  OnTimeout_Execute (uint64_t seqno, const ndn::Interest &interest);
+  Refill ();
+
+  typedef boost::function<void (Fetcher &)> Method;
+
+  /**
+   * @brief Run method of the fetcher on the executor, unless the fetcher is destroyed by then
+   *
+   * For callbacks from other threads (scheduler, verification workers): fetchers are destroyed
+   * on the executor thread, so the check and the call cannot race with the destruction.
+   */
+  static void
+  ExecuteIfAlive (ExecutorPtr executor, boost::weak_ptr<Fetcher> fetcher, const Method &method);
+
+  static void
+  RunIfAlive (boost::weak_ptr<Fetcher> fetcher, const Method &method);
+
+  void
+  OnData (uint64_t seqno, size_t source, boost::posix_time::ptime sendTime, const ndn::Interest &interest, ndn::Data &data);
+
+  static void
+  OnVerified (ExecutorPtr executor, boost::weak_ptr<Fetcher> fetcher,
+              uint64_t seqno, size_t source, boost::posix_time::ptime sendTime, const ndn::Interest &interest,
+              boost::shared_ptr<ndn::Data> data, bool verified);
+
+  void
+  OnData_Execute (uint64_t seqno, size_t source, boost::posix_time::ptime sendTime, const ndn::Interest &interest, ndn::Data &data);
+
+  void
+  OnTimeout (uint64_t seqno, size_t source, boost::posix_time::ptime sendTime, const ndn::Interest &interest);
+
+  void
+  OnTimeout_Execute (uint64_t seqno, size_t source, boost::posix_time::ptime sendTime, const ndn::Interest &interest);
 
 public:
   boost::intrusive::list_member_hook<> m_managerListHook;
@@ -106,6 +271,8 @@ private:
   boost::shared_ptr<ndn::Face> m_ndn;
 
   SegmentCallback m_segmentCallback;
+  SegmentVerifier m_segmentVerifier;
+  VerificationServicePtr m_verificationService;
   OnFetchCompleteCallback m_onFetchComplete;
   OnFetchFailedCallback m_onFetchFailed;
 
@@ -121,23 +288,47 @@ private:
   boost::posix_time::time_duration m_maximumNoActivityPeriod;
 
   int64_t m_minSendSeqNo;
-  int64_t m_maxInOrderRecvSeqNo;
-  std::set<int64_t> m_outOfOrderRecvSeqNo;
-  std::set<int64_t> m_inActivePipeline;
+  ReceiveWindow m_receiveWindow; // received and in-flight segments
 
   int64_t m_minSeqNo;
   int64_t m_maxSeqNo;
 
-  uint32_t m_pipeline;
+  struct Source
+  {
+    ndn::Name m_deviceName;
+    ndn::Name m_name;
+    ndn::Name m_forwardingHint;
+    CongestionWindowPtr m_window;
+    RttEstimatorPtr m_rttEstimator;
+
+    uint64_t m_receivedBytes;
+    boost::posix_time::ptime m_start;
+    uint32_t m_timeouts; // consecutive timeouts
+    bool m_enabled;
+  };
+  std::vector<Source> m_sources; // first source is always the original device
+  std::map<int64_t, uint32_t> m_retransmissions; // only for segments that were retransmitted
   uint32_t m_activePipeline;
 
+  uint64_t m_receivedBytes;
+  boost::posix_time::ptime m_fetchStart;
+
   boost::posix_time::ptime m_lastPositiveActivity;
 
   double m_retryPause; // pause to stop trying to fetch (for fetch-manager)
   boost::posix_time::ptime m_nextScheduledRetry;
+  int m_priority; // for fetch-manager
+  double m_rank; // for fetch-manager
 
   ExecutorPtr m_executor; // to serialize FillPipeline events
 
+  boost::shared_ptr<Fetcher> m_self; // doesn't own the fetcher, only expires together with it
+
+  RateLimiterPtr m_rateLimiter;
+  SchedulerPtr m_scheduler;
+  bool m_refillScheduled; // protected by m_seqNoMutex
+  uint64_t m_refillGeneration;
+
   boost::mutex m_seqNoMutex;
 };
 
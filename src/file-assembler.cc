@@ -0,0 +1,185 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "file-assembler.h"
+#include "logging.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+INIT_LOGGER ("FileAssembler");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+// segments arriving out of order beyond this limit are not kept in memory and are read back from ObjectDb later
+static const size_t MAX_PENDING_SEGMENTS = 256;
+
+FileAssembler::FileAssembler (const fs::path &folder, const ndn::Name &deviceName, const std::string &hash)
+  : m_deviceName (deviceName)
+  , m_fd (-1)
+  , m_released (false)
+  , m_nextSegment (0)
+{
+  fs::create_directories (folder);
+  m_path = folder / fs::path (hash + "-" + fs::unique_path ("%%%%%%%%").string ());
+
+  m_fd = open (m_path.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (m_fd < 0)
+    {
+      _LOG_ERROR ("Cannot create temporary file [" << m_path << "]: " << strerror (errno));
+    }
+}
+
+FileAssembler::~FileAssembler ()
+{
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+    }
+
+  if (!m_released)
+    {
+      boost::system::error_code error;
+      fs::remove (m_path, error);
+    }
+}
+
+void
+FileAssembler::Cleanup (const fs::path &folder)
+{
+  boost::system::error_code error;
+  fs::remove_all (folder, error);
+}
+
+void
+FileAssembler::fail ()
+{
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      m_fd = -1;
+    }
+  m_pending.clear ();
+}
+
+bool
+FileAssembler::append (const uint8_t *buf, size_t size)
+{
+  while (size > 0)
+    {
+      ssize_t written = write (m_fd, buf, size);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          _LOG_ERROR ("Write to [" << m_path << "] failed: " << strerror (errno));
+          fail ();
+          return false;
+        }
+
+      buf += written;
+      size -= written;
+    }
+
+  m_nextSegment ++;
+  return true;
+}
+
+void
+FileAssembler::AddSegment (uint64_t segment, const ndn::Block &content)
+{
+  if (m_fd < 0 || segment < m_nextSegment)
+    return;
+
+  if (segment != m_nextSegment)
+    {
+      if (m_pending.size () < MAX_PENDING_SEGMENTS)
+        {
+          m_pending.insert (make_pair (segment, content));
+        }
+      return;
+    }
+
+  if (!append (content.value (), content.value_size ()))
+    return;
+
+  // flush segments that were waiting for this one
+  while (!m_pending.empty () && m_pending.begin ()->first <= m_nextSegment)
+    {
+      if (m_pending.begin ()->first == m_nextSegment &&
+          !append (m_pending.begin ()->second.value (), m_pending.begin ()->second.value_size ()))
+        return;
+
+      m_pending.erase (m_pending.begin ());
+    }
+}
+
+void
+FileAssembler::CatchUp (ObjectDb &db)
+{
+  while (m_fd >= 0)
+    {
+      std::map<uint64_t, ndn::Block>::iterator pending = m_pending.find (m_nextSegment);
+      if (pending != m_pending.end ())
+        {
+          if (!append (pending->second.value (), pending->second.value_size ()))
+            return;
+          m_pending.erase (pending);
+          continue;
+        }
+
+      ndn::BufferPtr bytes = db.fetchSegment (m_deviceName, m_nextSegment);
+      if (!bytes)
+        break;
+
+      if (!append (bytes->buf (), bytes->size ()))
+        return;
+    }
+
+  // everything below is already in the file
+  m_pending.erase (m_pending.begin (), m_pending.lower_bound (m_nextSegment));
+}
+
+bool
+FileAssembler::Finish (ObjectDb &db)
+{
+  CatchUp (db);
+  if (m_fd < 0)
+    return false;
+
+  if (!m_pending.empty ())
+    {
+      _LOG_ERROR ("Segment " << m_nextSegment << " is missing, cannot assemble [" << m_path << "]");
+      fail ();
+      return false;
+    }
+
+  close (m_fd);
+  m_fd = -1;
+
+  _LOG_DEBUG ("Assembled " << m_nextSegment << " segments into [" << m_path << "]");
+  return true;
+}
@@ -0,0 +1,117 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef FILE_ASSEMBLER_H
+#define FILE_ASSEMBLER_H
+
+#include "object-db.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/exception/all.hpp>
+#include <ndn-cxx/name.hpp>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+/**
+ * @brief Writes file content into a temporary file while segments are still being fetched
+ *
+ * Segments are appended as soon as they are available in order.  A limited number of segments that
+ * arrive out of order are buffered in memory, others are read back from ObjectDb when the gap is filled
+ * (see CatchUp).  When the fetch completes, the temporary file only needs to be synced and renamed.
+ */
+class FileAssembler
+{
+public:
+  /**
+   * @param folder   folder for temporary files (must be on the same filesystem as the destination)
+   * @param deviceName device that published the content
+   * @param hash     hash of the content (string representation)
+   */
+  FileAssembler (const boost::filesystem::path &folder, const ndn::Name &deviceName, const std::string &hash);
+  ~FileAssembler ();
+
+  /**
+   * @brief Add fetched segment (segments can be added in any order)
+   */
+  void
+  AddSegment (uint64_t segment, const ndn::Block &content);
+
+  /**
+   * @brief Append segments that are already saved in the database (e.g., when fetch was resumed)
+   */
+  void
+  CatchUp (ObjectDb &db);
+
+  /**
+   * @brief Append all remaining segments from the database and close the temporary file
+   *
+   * The file is not synced, FileMaterializer::Adopt takes care of it
+   * @returns false if assembly failed (temporary file is then removed)
+   */
+  bool
+  Finish (ObjectDb &db);
+
+  /**
+   * @brief Temporary file with the assembled content
+   */
+  const boost::filesystem::path &
+  GetPath () const { return m_path; }
+
+  /**
+   * @brief Next segment to be appended to the file
+   */
+  uint64_t
+  GetNextSegment () const { return m_nextSegment; }
+
+  /**
+   * @brief Tell that the temporary file has been moved and should not be removed
+   */
+  void
+  Release () { m_released = true; }
+
+  /**
+   * @brief Remove temporary files left after previous runs
+   */
+  static void
+  Cleanup (const boost::filesystem::path &folder);
+
+private:
+  bool
+  append (const uint8_t *buf, size_t size);
+
+  void
+  fail ();
+
+private:
+  boost::filesystem::path m_path;
+  ndn::Name m_deviceName;
+  int m_fd;
+  bool m_released;
+
+  uint64_t m_nextSegment;
+  std::map<uint64_t, ndn::Block> m_pending; // segments received out of order
+};
+
+typedef boost::shared_ptr<FileAssembler> FileAssemblerPtr;
+
+#endif // FILE_ASSEMBLER_H
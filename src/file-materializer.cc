@@ -0,0 +1,442 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "file-materializer.h"
+#include "logging.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <set>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/syscall.h>
+#endif
+
+INIT_LOGGER ("FileMaterializer");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+static const size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+static bool
+writeAll (int fd, const uint8_t *buf, size_t size)
+{
+  while (size > 0)
+    {
+      ssize_t written = write (fd, buf, size);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+
+      buf += written;
+      size -= written;
+    }
+  return true;
+}
+
+// Make target share all data extents with source (btrfs, XFS with reflink, ...), replacing content of target
+static bool
+cloneFile (int source, int target)
+{
+#ifdef FICLONE
+  return ioctl (target, FICLONE, source) == 0;
+#else
+  return false;
+#endif
+}
+
+// Copy inside the kernel (no round trip through user space, server-side copy on NFS).
+// Copying starts and continues from the current offsets, which are advanced.  Returns number of copied bytes
+static uint64_t
+copyFileRange (int source, int target)
+{
+  uint64_t copied = 0;
+#if defined(__linux__) && defined(__NR_copy_file_range)
+  while (true)
+    {
+      ssize_t bytes = syscall (__NR_copy_file_range, source, NULL, target, NULL, WRITE_BUFFER_SIZE * 16, 0);
+      if (bytes < 0 && errno == EINTR)
+        continue;
+      if (bytes <= 0)
+        break; // finished, or not supported for these files (the rest is copied the usual way)
+
+      copied += bytes;
+    }
+#endif
+  return copied;
+}
+
+FileMaterializer::FileMaterializer (size_t maxBatchFiles/* = 256*/, uint64_t maxBatchBytes/* = 64MB*/)
+  : m_maxBatchFiles (maxBatchFiles)
+  , m_maxBatchBytes (maxBatchBytes)
+  , m_pendingBytes (0)
+  , m_currentSize (0)
+  , m_buffer (WRITE_BUFFER_SIZE)
+  , m_buffered (0)
+{
+  m_current.m_fd = -1;
+}
+
+FileMaterializer::~FileMaterializer ()
+{
+  Abort ();
+  Commit ();
+}
+
+fs::path
+FileMaterializer::TempPath (const fs::path &file)
+{
+  return file.parent_path () / fs::path ("." + file.filename ().string () + ".chronoshare-" + fs::unique_path ("%%%%%%%%").string ());
+}
+
+bool
+FileMaterializer::Begin (const fs::path &file, uint64_t sizeHint/* = 0*/)
+{
+  Abort ();
+
+  try
+    {
+      fs::create_directories (file.parent_path ());
+    }
+  catch (fs::filesystem_error &error)
+    {
+      _LOG_ERROR ("Cannot create directory for [" << file << "]: " << error.what ());
+      return false;
+    }
+
+  m_current.m_file = file;
+  m_current.m_tempFile = TempPath (file);
+  m_current.m_onCommitted = CommitCallback ();
+  m_current.m_fd = open (m_current.m_tempFile.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (m_current.m_fd < 0)
+    {
+      _LOG_ERROR ("Cannot create [" << m_current.m_tempFile << "]: " << strerror (errno));
+      return false;
+    }
+
+#ifdef __linux__
+  if (sizeHint > 0)
+    {
+      // reserve contiguous space without changing the file size (not supported by all filesystems, which is fine)
+      fallocate (m_current.m_fd, FALLOC_FL_KEEP_SIZE, 0, sizeHint);
+    }
+#endif
+
+  m_currentSize = 0;
+  m_buffered = 0;
+  return true;
+}
+
+bool
+FileMaterializer::flush ()
+{
+  if (m_buffered == 0)
+    return true;
+
+  if (!writeAll (m_current.m_fd, &m_buffer[0], m_buffered))
+    {
+      _LOG_ERROR ("Write to [" << m_current.m_tempFile << "] failed: " << strerror (errno));
+      Abort ();
+      return false;
+    }
+
+  m_buffered = 0;
+  return true;
+}
+
+bool
+FileMaterializer::Write (const uint8_t *buf, size_t size)
+{
+  if (m_current.m_fd < 0)
+    return false;
+
+  m_currentSize += size;
+
+  if (m_buffered + size > m_buffer.size ())
+    {
+      if (!flush ())
+        return false;
+
+      if (size >= m_buffer.size ())
+        {
+          // no reason to copy large blocks through the buffer
+          if (!writeAll (m_current.m_fd, buf, size))
+            {
+              _LOG_ERROR ("Write to [" << m_current.m_tempFile << "] failed: " << strerror (errno));
+              Abort ();
+              return false;
+            }
+          return true;
+        }
+    }
+
+  memcpy (&m_buffer[m_buffered], buf, size);
+  m_buffered += size;
+  return true;
+}
+
+bool
+FileMaterializer::WriteFile (const fs::path &source)
+{
+  int fd = open (source.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      _LOG_ERROR ("Cannot open [" << source << "]: " << strerror (errno));
+      Abort ();
+      return false;
+    }
+
+  if (!flush ())
+    {
+      close (fd);
+      return false;
+    }
+
+  if (m_currentSize == 0 && cloneFile (fd, m_current.m_fd))
+    {
+      struct stat st;
+      if (fstat (m_current.m_fd, &st) == 0 && lseek (m_current.m_fd, 0, SEEK_END) >= 0)
+        {
+          _LOG_TRACE ("Cloned [" << source << "] to [" << m_current.m_tempFile << "]");
+          m_currentSize = st.st_size;
+          close (fd);
+          return true;
+        }
+      // should not really happen, start over
+      if (ftruncate (m_current.m_fd, 0) != 0 || lseek (m_current.m_fd, 0, SEEK_SET) != 0)
+        {
+          _LOG_ERROR ("Cannot reset [" << m_current.m_tempFile << "]: " << strerror (errno));
+          close (fd);
+          Abort ();
+          return false;
+        }
+    }
+
+  m_currentSize += copyFileRange (fd, m_current.m_fd);
+
+  bool ok = true;
+  while (ok)
+    {
+      ssize_t bytes = read (fd, &m_buffer[0], m_buffer.size ());
+      if (bytes < 0 && errno == EINTR)
+        continue;
+      if (bytes <= 0)
+        {
+          ok = (bytes == 0);
+          break;
+        }
+
+      m_currentSize += bytes;
+      ok = writeAll (m_current.m_fd, &m_buffer[0], bytes);
+    }
+  close (fd);
+
+  if (!ok)
+    {
+      _LOG_ERROR ("Copy of [" << source << "] to [" << m_current.m_tempFile << "] failed: " << strerror (errno));
+      Abort ();
+    }
+  return ok;
+}
+
+bool
+FileMaterializer::finishAttributes (int fd, const fs::path &path, time_t mtime, int mode)
+{
+  if (mode >= 0 && fchmod (fd, mode & 07777) != 0)
+    {
+      _LOG_ERROR ("Cannot set permissions of [" << path << "]: " << strerror (errno));
+      return false;
+    }
+
+  if (mtime > 0)
+    {
+      struct timespec times[2];
+      times[0].tv_sec = 0;
+      times[0].tv_nsec = UTIME_OMIT; // access time
+      times[1].tv_sec = mtime;
+      times[1].tv_nsec = 0;
+      if (futimens (fd, times) != 0)
+        {
+          _LOG_ERROR ("Cannot set modification time of [" << path << "]: " << strerror (errno));
+          return false;
+        }
+    }
+
+  return true;
+}
+
+bool
+FileMaterializer::End (time_t mtime/* = 0*/, int mode/* = -1*/, const CommitCallback &onCommitted/* = CommitCallback ()*/)
+{
+  if (m_current.m_fd < 0 || !flush ())
+    return false;
+
+  // drop space preallocated beyond the actual size
+  if (ftruncate (m_current.m_fd, m_currentSize) != 0 ||
+      !finishAttributes (m_current.m_fd, m_current.m_tempFile, mtime, mode))
+    {
+      Abort ();
+      return false;
+    }
+
+#ifdef __linux__
+  // start writeback now, so the sync in Commit mostly waits for writes that are already in progress
+  sync_file_range (m_current.m_fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+
+  m_current.m_onCommitted = onCommitted;
+  m_pending.push_back (m_current);
+  m_pendingBytes += m_currentSize;
+
+  m_current.m_fd = -1;
+  return true;
+}
+
+void
+FileMaterializer::Abort ()
+{
+  if (m_current.m_fd < 0)
+    return;
+
+  close (m_current.m_fd);
+  m_current.m_fd = -1;
+
+  boost::system::error_code error;
+  fs::remove (m_current.m_tempFile, error);
+}
+
+bool
+FileMaterializer::Adopt (const fs::path &tempFile, const fs::path &file,
+                         time_t mtime/* = 0*/, int mode/* = -1*/, const CommitCallback &onCommitted/* = CommitCallback ()*/)
+{
+  boost::system::error_code error;
+  fs::create_directories (file.parent_path (), error);
+  if (error)
+    {
+      _LOG_ERROR ("Cannot create [" << file.parent_path () << "]: " << error.message ());
+      return false;
+    }
+
+  PendingFile pending;
+  pending.m_tempFile = tempFile;
+  pending.m_file = file;
+  pending.m_onCommitted = onCommitted;
+  pending.m_fd = open (tempFile.c_str (), O_RDONLY);
+  if (pending.m_fd < 0)
+    {
+      _LOG_ERROR ("Cannot open [" << tempFile << "]: " << strerror (errno));
+      return false;
+    }
+
+  if (!finishAttributes (pending.m_fd, tempFile, mtime, mode))
+    {
+      close (pending.m_fd);
+      return false;
+    }
+
+  struct stat st;
+  if (fstat (pending.m_fd, &st) == 0)
+    {
+      m_pendingBytes += st.st_size;
+    }
+
+  m_pending.push_back (pending);
+  return true;
+}
+
+bool
+FileMaterializer::Commit ()
+{
+  if (m_pending.empty ())
+    return true;
+
+  _LOG_DEBUG ("Commit " << m_pending.size () << " files (" << m_pendingBytes << " bytes)");
+
+  bool ok = true;
+  std::set<fs::path> directories;
+
+  // Data of all files is synced before any of them is renamed.  Syncing files one right after
+  // another lets the filesystem fold metadata of the whole batch into few journal commits
+  for (std::vector<PendingFile>::iterator file = m_pending.begin (); file != m_pending.end (); file++)
+    {
+      if (fsync (file->m_fd) != 0)
+        {
+          _LOG_ERROR ("Sync of [" << file->m_tempFile << "] failed: " << strerror (errno));
+          file->m_file.clear ();
+        }
+      close (file->m_fd);
+      file->m_fd = -1;
+    }
+
+  for (std::vector<PendingFile>::iterator file = m_pending.begin (); file != m_pending.end (); file++)
+    {
+      boost::system::error_code error;
+      if (!file->m_file.empty ())
+        {
+          fs::rename (file->m_tempFile, file->m_file, error);
+          if (!error)
+            {
+              directories.insert (file->m_file.parent_path ());
+              continue;
+            }
+          _LOG_ERROR ("Cannot rename [" << file->m_tempFile << "] to [" << file->m_file << "]: " << error.message ());
+        }
+
+      ok = false;
+      fs::remove (file->m_tempFile, error);
+      file->m_file.clear ();
+    }
+
+  // make renames durable
+  for (std::set<fs::path>::iterator directory = directories.begin (); directory != directories.end (); directory++)
+    {
+      int fd = open (directory->c_str (), O_RDONLY);
+      if (fd >= 0)
+        {
+          fsync (fd);
+          close (fd);
+        }
+    }
+
+  std::vector<PendingFile> committed;
+  committed.swap (m_pending);
+  m_pendingBytes = 0;
+
+  for (std::vector<PendingFile>::iterator file = committed.begin (); file != committed.end (); file++)
+    {
+      if (!file->m_file.empty () && !file->m_onCommitted.empty ())
+        {
+          file->m_onCommitted ();
+        }
+    }
+
+  return ok;
+}
@@ -0,0 +1,153 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef FILE_MATERIALIZER_H
+#define FILE_MATERIALIZER_H
+
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief Writes files so that they never appear partially written
+ *
+ * Content is written (with large buffered writes) into a hidden temporary file in the same directory,
+ * with space preallocated when the size is known.  Files are renamed into place by Commit, after all
+ * files of the batch are synced to disk.  Syncing the whole batch at once makes materialization of
+ * many small files much cheaper than syncing every file separately.
+ *
+ * The class is not thread-safe.
+ */
+class FileMaterializer
+{
+public:
+  typedef boost::function<void ()> CommitCallback;
+
+  FileMaterializer (size_t maxBatchFiles = 256, uint64_t maxBatchBytes = 64 * 1024 * 1024);
+
+  /**
+   * @brief Commits pending files
+   */
+  ~FileMaterializer ();
+
+  /**
+   * @brief Start writing new content of the file
+   * @param sizeHint expected size of the file (0 if unknown), used to preallocate the space
+   */
+  bool
+  Begin (const boost::filesystem::path &file, uint64_t sizeHint = 0);
+
+  /**
+   * @brief Append to the file started by Begin
+   */
+  bool
+  Write (const uint8_t *buf, size_t size);
+
+  /**
+   * @brief Append content of another file to the file started by Begin
+   *
+   * If nothing has been written yet, the source is cloned (FICLONE) when the filesystem supports
+   * it, so both files share the same data blocks.  Otherwise data is copied in the kernel with
+   * copy_file_range, with a fallback to the regular read/write.
+   */
+  bool
+  WriteFile (const boost::filesystem::path &source);
+
+  /**
+   * @brief Finish writing the file started by Begin
+   * @param mtime    modification time to set (0 to leave as is)
+   * @param mode     permissions to set (-1 to leave as is)
+   * @param onCommitted is called when the file is in place (from Commit)
+   */
+  bool
+  End (time_t mtime = 0, int mode = -1, const CommitCallback &onCommitted = CommitCallback ());
+
+  /**
+   * @brief Discard the file started by Begin
+   */
+  void
+  Abort ();
+
+  /**
+   * @brief Add already written temporary file (must be on the same filesystem) to the batch
+   */
+  bool
+  Adopt (const boost::filesystem::path &tempFile, const boost::filesystem::path &file,
+         time_t mtime = 0, int mode = -1, const CommitCallback &onCommitted = CommitCallback ());
+
+  /**
+   * @brief Sync all pending files, rename them into place and sync their directories
+   * @returns false if any of the files could not be put in place
+   */
+  bool
+  Commit ();
+
+  size_t
+  GetPendingCount () const { return m_pending.size (); }
+
+  /**
+   * @brief Batch limits are reached and Commit should be called
+   */
+  bool
+  IsBatchFull () const { return m_pending.size () >= m_maxBatchFiles || m_pendingBytes >= m_maxBatchBytes; }
+
+  /**
+   * @brief Name of the temporary file for the file (hidden, in the same directory)
+   */
+  static boost::filesystem::path
+  TempPath (const boost::filesystem::path &file);
+
+private:
+  bool
+  flush ();
+
+  bool
+  finishAttributes (int fd, const boost::filesystem::path &path, time_t mtime, int mode);
+
+private:
+  struct PendingFile
+  {
+    boost::filesystem::path m_tempFile;
+    boost::filesystem::path m_file;
+    int m_fd;
+    CommitCallback m_onCommitted;
+  };
+
+  size_t m_maxBatchFiles;
+  uint64_t m_maxBatchBytes;
+
+  std::vector<PendingFile> m_pending;
+  uint64_t m_pendingBytes;
+
+  // file being written
+  PendingFile m_current;
+  uint64_t m_currentSize;
+  std::vector<uint8_t> m_buffer;
+  size_t m_buffered;
+};
+
+typedef boost::shared_ptr<FileMaterializer> FileMaterializerPtr;
+
+#endif // FILE_MATERIALIZER_H
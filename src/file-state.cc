@@ -21,8 +21,11 @@
 
 #include "file-state.h"
 #include "logging.h"
+#include "db-upgrade.h"
 #include <boost/bind.hpp>
 
+#include <sys/stat.h>
+
 INIT_LOGGER ("FileState");
 
 using namespace boost;
@@ -38,12 +41,17 @@ CREATE TABLE FileState (                                                \n\
     device_name BLOB NOT NULL,                                          \n\
     seq_no      INTEGER NOT NULL,                                       \n\
     file_hash   BLOB NOT NULL,                                          \n\
+    file_hash_algorithm INTEGER, /* see Digest::Algorithm, NULL is SHA-256 */ \n\
     file_atime  TIMESTAMP,                                              \n\
     file_mtime  TIMESTAMP,                                              \n\
     file_ctime  TIMESTAMP,                                              \n\
     file_chmod  INTEGER,                                                \n\
     file_seg_num INTEGER,                                               \n\
     is_complete INTEGER,                                               \n\
+    local_size     INTEGER, /* metadata of the local file, see LocalFileStat */ \n\
+    local_mtime_ns INTEGER,                                             \n\
+    local_inode    INTEGER,                                             \n\
+    local_sample   BLOB,                                                \n\
                                                                         \n\
     PRIMARY KEY (type, filename)                                        \n\
 );                                                                      \n\
@@ -52,11 +60,41 @@ CREATE INDEX FileState_device_name_seq_no ON FileState (device_name, seq_no); \n
 CREATE INDEX FileState_type_file_hash ON FileState (type, file_hash);   \n\
 ";
 
+static const ColumnUpgrade UPGRADE_COLUMNS[] = {
+  { "FileState", "local_size", "INTEGER" },
+  { "FileState", "local_mtime_ns", "INTEGER" },
+  { "FileState", "local_inode", "INTEGER" },
+  { "FileState", "local_sample", "BLOB" },
+  { "FileState", "file_hash_algorithm", "INTEGER" },
+};
+
+bool
+LocalFileStat::Read (const boost::filesystem::path &path, LocalFileStat &stat)
+{
+  struct stat info;
+  if (::stat (path.c_str (), &info) != 0 || !S_ISREG (info.st_mode))
+    return false;
+
+  stat.m_size = info.st_size;
+  stat.m_inode = info.st_ino;
+#ifdef __APPLE__
+  stat.m_mtimeNs = static_cast<sqlite3_int64> (info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+  stat.m_mtimeNs = static_cast<sqlite3_int64> (info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
 FileState::FileState (const boost::filesystem::path &path)
   : DbHelper (path / ".chronoshare", "file-state.db")
 {
   sqlite3_exec (m_db, INIT_DATABASE.c_str (), NULL, NULL, NULL);
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+
+  if (!AddMissingColumns (m_db, UPGRADE_COLUMNS))
+    {
+      _LOG_ERROR ("Cannot upgrade FileState: " << sqlite3_errmsg (m_db));
+    }
 }
 
 FileState::~FileState ()
@@ -74,23 +112,26 @@ FileState::UpdateFile (const std::string &filename, sqlite3_int64 version,
                       "device_name=?, seq_no=?, "
                       "version=?,"
                       "file_hash=?,"
+                      "file_hash_algorithm=?,"
                       "file_atime=datetime(?, 'unixepoch'),"
                       "file_mtime=datetime(?, 'unixepoch'),"
                       "file_ctime=datetime(?, 'unixepoch'),"
                       "file_chmod=?, "
-                      "file_seg_num=? "
+                      "file_seg_num=?, "
+                      "local_size=NULL, local_mtime_ns=NULL, local_inode=NULL, local_sample=NULL "
                       "WHERE type=0 AND filename=?", -1, &stmt, 0);
 
   sqlite3_bind_blob  (stmt, 1, device_name.buf (), device_name.size (), SQLITE_STATIC);
   sqlite3_bind_int64 (stmt, 2, seq_no);
   sqlite3_bind_int64 (stmt, 3, version);
   sqlite3_bind_blob  (stmt, 4, hash.GetHash (), hash.GetHashBytes (), SQLITE_STATIC);
-  sqlite3_bind_int64 (stmt, 5, atime);
-  sqlite3_bind_int64 (stmt, 6, mtime);
-  sqlite3_bind_int64 (stmt, 7, ctime);
-  sqlite3_bind_int   (stmt, 8, mode);
-  sqlite3_bind_int   (stmt, 9, seg_num);
-  sqlite3_bind_text  (stmt, 10, filename.c_str (), -1, SQLITE_STATIC);
+  sqlite3_bind_int   (stmt, 5, hash.GetAlgorithm ());
+  sqlite3_bind_int64 (stmt, 6, atime);
+  sqlite3_bind_int64 (stmt, 7, mtime);
+  sqlite3_bind_int64 (stmt, 8, ctime);
+  sqlite3_bind_int   (stmt, 9, mode);
+  sqlite3_bind_int   (stmt, 10, seg_num);
+  sqlite3_bind_text  (stmt, 11, filename.c_str (), -1, SQLITE_STATIC);
 
   sqlite3_step (stmt);
 
@@ -104,8 +145,8 @@ FileState::UpdateFile (const std::string &filename, sqlite3_int64 version,
     {
       sqlite3_stmt *stmt;
       sqlite3_prepare_v2 (m_db, "INSERT INTO FileState "
-                          "(type,filename,version,device_name,seq_no,file_hash,file_atime,file_mtime,file_ctime,file_chmod,file_seg_num) "
-                          "VALUES (0, ?, ?, ?, ?, ?, "
+                          "(type,filename,version,device_name,seq_no,file_hash,file_hash_algorithm,file_atime,file_mtime,file_ctime,file_chmod,file_seg_num) "
+                          "VALUES (0, ?, ?, ?, ?, ?, ?, "
                           "datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), datetime(?, 'unixepoch'), ?, ?)", -1, &stmt, 0);
 
       _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
@@ -115,11 +156,12 @@ FileState::UpdateFile (const std::string &filename, sqlite3_int64 version,
       sqlite3_bind_blob  (stmt, 3, device_name.buf (), device_name.size (), SQLITE_STATIC);
       sqlite3_bind_int64 (stmt, 4, seq_no);
       sqlite3_bind_blob  (stmt, 5, hash.GetHash (), hash.GetHashBytes (), SQLITE_STATIC);
-      sqlite3_bind_int64 (stmt, 6, atime);
-      sqlite3_bind_int64 (stmt, 7, mtime);
-      sqlite3_bind_int64 (stmt, 8, ctime);
-      sqlite3_bind_int   (stmt, 9, mode);
-      sqlite3_bind_int   (stmt, 10, seg_num);
+      sqlite3_bind_int   (stmt, 6, hash.GetAlgorithm ());
+      sqlite3_bind_int64 (stmt, 7, atime);
+      sqlite3_bind_int64 (stmt, 8, mtime);
+      sqlite3_bind_int64 (stmt, 9, ctime);
+      sqlite3_bind_int   (stmt, 10, mode);
+      sqlite3_bind_int   (stmt, 11, seg_num);
 
       sqlite3_step (stmt);
       _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE,
@@ -171,6 +213,54 @@ FileState::SetFileComplete (const std::string &filename)
 }
 
 
+void
+FileState::SetLocalStat (const std::string &filename, const LocalFileStat &stat)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db,
+                      "UPDATE FileState SET local_size=?, local_mtime_ns=?, local_inode=?, local_sample=? "
+                      "WHERE type = 0 AND filename = ?", -1, &stmt, 0);
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+  sqlite3_bind_int64 (stmt, 1, stat.m_size);
+  sqlite3_bind_int64 (stmt, 2, stat.m_mtimeNs);
+  sqlite3_bind_int64 (stmt, 3, stat.m_inode);
+  if (stat.m_sample.empty ())
+    sqlite3_bind_null (stmt, 4);
+  else
+    sqlite3_bind_blob (stmt, 4, stat.m_sample.c_str (), stat.m_sample.size (), SQLITE_STATIC);
+  sqlite3_bind_text (stmt, 5, filename.c_str(), -1, SQLITE_STATIC);
+
+  sqlite3_step (stmt);
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE, sqlite3_errmsg (m_db));
+
+  sqlite3_finalize (stmt);
+}
+
+bool
+FileState::LookupLocalStat (const std::string &filename, LocalFileStat &stat)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db,
+                      "SELECT local_size, local_mtime_ns, local_inode, local_sample "
+                      "       FROM FileState "
+                      "       WHERE type = 0 AND filename = ? AND local_size IS NOT NULL", -1, &stmt, 0);
+  _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
+  sqlite3_bind_text (stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
+
+  bool retval = false;
+  if (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      stat.m_size = sqlite3_column_int64 (stmt, 0);
+      stat.m_mtimeNs = sqlite3_column_int64 (stmt, 1);
+      stat.m_inode = sqlite3_column_int64 (stmt, 2);
+      stat.m_sample.assign (reinterpret_cast<const char *> (sqlite3_column_blob (stmt, 3)), sqlite3_column_bytes (stmt, 3));
+      retval = true;
+    }
+
+  sqlite3_finalize (stmt);
+  return retval;
+}
+
 /**
  * @todo Implement checking modification time and permissions
  */
@@ -179,7 +269,7 @@ FileState::LookupFile (const std::string &filename)
 {
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2 (m_db,
-                      "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete "
+                      "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete,file_hash_algorithm "
                       "       FROM FileState "
                       "       WHERE type = 0 AND filename = ?", -1, &stmt, 0);
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
@@ -198,6 +288,7 @@ FileState::LookupFile (const std::string &filename)
     retval->set_mode        (sqlite3_column_int   (stmt, 6));
     retval->set_seg_num     (sqlite3_column_int64 (stmt, 7));
     retval->set_is_complete (sqlite3_column_int   (stmt, 8));
+    retval->set_file_hash_algorithm (sqlite3_column_int (stmt, 9));
   }
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_DONE, sqlite3_errmsg (m_db));
   sqlite3_finalize (stmt);
@@ -210,7 +301,7 @@ FileState::LookupFilesForHash (const Hash &hash)
 {
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2 (m_db,
-                      "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete "
+                      "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete,file_hash_algorithm "
                       "   FROM FileState "
                       "   WHERE type = 0 AND file_hash = ?", -1, &stmt, 0);
   _LOG_DEBUG_COND (sqlite3_errcode (m_db) != SQLITE_OK, sqlite3_errmsg (m_db));
@@ -230,6 +321,7 @@ FileState::LookupFilesForHash (const Hash &hash)
       file.set_mode        (sqlite3_column_int   (stmt, 6));
       file.set_seg_num     (sqlite3_column_int64 (stmt, 7));
       file.set_is_complete (sqlite3_column_int   (stmt, 8));
+      file.set_file_hash_algorithm (sqlite3_column_int (stmt, 9));
 
       retval->push_back (file);
     }
@@ -245,7 +337,7 @@ FileState::LookupFilesInFolder (const boost::function<void (const FileItem&)> &v
 {
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2 (m_db,
-                      "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete "
+                      "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete,file_hash_algorithm "
                       "   FROM FileState "
                       "   WHERE type = 0 AND directory = ?"
                       "   LIMIT ? OFFSET ?", -1, &stmt, 0);
@@ -269,6 +361,7 @@ FileState::LookupFilesInFolder (const boost::function<void (const FileItem&)> &v
       file.set_mode        (sqlite3_column_int   (stmt, 6));
       file.set_seg_num     (sqlite3_column_int64 (stmt, 7));
       file.set_is_complete (sqlite3_column_int   (stmt, 8));
+      file.set_file_hash_algorithm (sqlite3_column_int (stmt, 9));
 
       visitor (file);
     }
@@ -301,7 +394,7 @@ FileState::LookupFilesInFolderRecursively (const boost::function<void (const Fil
       /// @todo Do something to improve efficiency of this query. Right now it is basically scanning the whole database
 
       sqlite3_prepare_v2 (m_db,
-                          "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete "
+                          "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete,file_hash_algorithm "
                           "   FROM FileState "
                           "   WHERE type = 0 AND is_dir_prefix (?, directory)=1 "
                           "   ORDER BY filename "
@@ -317,7 +410,7 @@ FileState::LookupFilesInFolderRecursively (const boost::function<void (const Fil
   else
     {
       sqlite3_prepare_v2 (m_db,
-                          "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete "
+                          "SELECT filename,version,device_name,seq_no,file_hash,strftime('%s', file_mtime),file_chmod,file_seg_num,is_complete,file_hash_algorithm "
                           "   FROM FileState "
                           "   WHERE type = 0"
                           "   ORDER BY filename "
@@ -343,6 +436,7 @@ FileState::LookupFilesInFolderRecursively (const boost::function<void (const Fil
       file.set_mode        (sqlite3_column_int   (stmt, 6));
       file.set_seg_num     (sqlite3_column_int64 (stmt, 7));
       file.set_is_complete (sqlite3_column_int   (stmt, 8));
+      file.set_file_hash_algorithm (sqlite3_column_int (stmt, 9));
 
       visitor (file);
       limit --;
@@ -36,6 +36,35 @@ typedef std::list<FileItem> FileItems;
 typedef boost::shared_ptr<FileItem>  FileItemPtr;
 typedef boost::shared_ptr<FileItems> FileItemsPtr;
 
+/**
+ * @brief Metadata of the local file, recorded when its content is known to match FileState
+ *
+ * If the metadata did not change since then, the file does not need to be rehashed
+ */
+struct LocalFileStat
+{
+  LocalFileStat ()
+    : m_size (0), m_mtimeNs (0), m_inode (0) { }
+
+  /**
+   * @brief Get metadata of the file (m_sample is not set)
+   * @returns false if the file does not exist or is not a regular file
+   */
+  static bool
+  Read (const boost::filesystem::path &path, LocalFileStat &stat);
+
+  bool
+  IsSameMetadata (const LocalFileStat &other) const
+  {
+    return m_size == other.m_size && m_mtimeNs == other.m_mtimeNs && m_inode == other.m_inode;
+  }
+
+  sqlite3_int64 m_size;
+  sqlite3_int64 m_mtimeNs;
+  sqlite3_int64 m_inode;
+  std::string m_sample; // digest of sampled blocks (see Hash::FromFileSamples), can be empty
+};
+
 
 class FileState : public DbHelper
 {
@@ -65,6 +94,21 @@ public:
   void
   SetFileComplete (const std::string &filename);
 
+  /**
+   * @brief Record metadata of the local file that matches the current state of the file
+   *
+   * Recorded metadata is cleared whenever the file is updated (UpdateFile)
+   */
+  void
+  SetLocalStat (const std::string &filename, const LocalFileStat &stat);
+
+  /**
+   * @brief Get recorded metadata of the local file
+   * @returns false if nothing is recorded
+   */
+  bool
+  LookupLocalStat (const std::string &filename, LocalFileStat &stat);
+
   /**
    * @brief Lookup file state using file name
    */
@@ -20,12 +20,13 @@
  */
 
 #include "hash-helper.h"
+#include "block-reader.h"
 
 #include <boost/assert.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/lexical_cast.hpp>
-#include <openssl/evp.h>
+#include <errno.h>
 #include <fstream>
 
 typedef boost::error_info<struct tag_errmsg, std::string> errmsg_info_str;
@@ -124,13 +125,13 @@ Hash::FromString (const std::string &hashInTextEncoding)
       return retval;
     }
 
-  if (hashInTextEncoding.size () > EVP_MAX_MD_SIZE * 2)
+  if (hashInTextEncoding.size () > Digest::MAX_SIZE * 2)
     {
       cerr << "Input hash is too long. Returning an empty hash" << endl;
       return retval;
     }
 
-  retval->m_buf = new unsigned char [EVP_MAX_MD_SIZE];
+  retval->m_buf = new unsigned char [Digest::MAX_SIZE];
 
   unsigned char *end = copy (string_to_binary (hashInTextEncoding.begin ()),
                             string_to_binary (hashInTextEncoding.end ()),
@@ -142,50 +143,77 @@ Hash::FromString (const std::string &hashInTextEncoding)
 }
 
 HashPtr
-Hash::FromFileContent (const fs::path &filename)
+Hash::FromFileContent (const fs::path &filename, Digest::Algorithm algorithm/* = Digest::GetDefaultAlgorithm ()*/)
 {
-  HashPtr retval = boost::make_shared<Hash> (reinterpret_cast<void*> (0), 0);
-  retval->m_buf = new unsigned char [EVP_MAX_MD_SIZE];
+  Digest digest (algorithm);
 
-  EVP_MD_CTX *hash_context = EVP_MD_CTX_create ();
-  EVP_DigestInit_ex (hash_context, HASH_FUNCTION (), 0);
+  HashPtr retval = boost::make_shared<Hash> (reinterpret_cast<void*> (0), 0, algorithm);
+  retval->m_buf = new unsigned char [Digest::MAX_SIZE];
 
-  fs::ifstream iff (filename, std::ios::in | std::ios::binary);
-  while (iff.good ())
+  // digest of the current block is computed while the next one is being read
+  BlockReader reader (filename);
+  const uint8_t *data = 0;
+  size_t size = 0;
+  while (reader.Next (data, size))
     {
-      char buf[1024];
-      iff.read (buf, 1024);
-      EVP_DigestUpdate (hash_context, buf, iff.gcount ());
+      digest.Update (data, size);
     }
 
-  retval->m_buf = new unsigned char [EVP_MAX_MD_SIZE];
-
-  EVP_DigestFinal_ex (hash_context,
-                      retval->m_buf, &retval->m_length);
+  if (reader.HasFailed ())
+    {
+      // digest of a partially read file must not be mistaken for the digest of the content
+      BOOST_THROW_EXCEPTION (fs::filesystem_error ("Cannot read file content", filename,
+                                                   boost::system::error_code (EIO, boost::system::system_category ())));
+    }
 
-  EVP_MD_CTX_destroy (hash_context);
+  retval->m_length = digest.Final (retval->m_buf);
 
   return retval;
 }
 
 HashPtr
-Hash::FromBytes (const ndn::Buffer &bytes)
+Hash::FromFileSamples (const fs::path &filename, size_t sampleSize/* = 4096*/)
 {
-  HashPtr retval = boost::make_shared<Hash> (reinterpret_cast<void*> (0), 0);
-  retval->m_buf = new unsigned char [EVP_MAX_MD_SIZE];
+  Digest digest (Digest::GetDefaultAlgorithm ());
 
-  EVP_MD_CTX *hash_context = EVP_MD_CTX_create ();
-  EVP_DigestInit_ex (hash_context, HASH_FUNCTION (), 0);
+  HashPtr retval = boost::make_shared<Hash> (reinterpret_cast<void*> (0), 0, Digest::GetDefaultAlgorithm ());
+  retval->m_buf = new unsigned char [Digest::MAX_SIZE];
 
-  // not sure whether it's bad to do so if bytes.size is huge
-  EVP_DigestUpdate(hash_context, bytes.buf(), bytes.size());
+  fs::ifstream iff (filename, std::ios::in | std::ios::binary);
+  uint64_t size = 0;
+  if (iff.is_open () && iff.seekg (0, std::ios::end))
+    {
+      size = static_cast<uint64_t> (iff.tellg ());
+    }
+  digest.Update (&size, sizeof (size));
 
-  retval->m_buf = new unsigned char [EVP_MAX_MD_SIZE];
+  uint64_t offsets[] = { 0, size / 2, size > sampleSize ? size - sampleSize : 0 };
+  std::vector<char> buf (sampleSize);
+  for (size_t i = 0; size > 0 && i < sizeof (offsets) / sizeof (offsets[0]); i++)
+    {
+      iff.clear ();
+      iff.seekg (offsets[i]);
+      iff.read (&buf[0], sampleSize);
+      digest.Update (&buf[0], iff.gcount ());
+    }
+
+  retval->m_length = digest.Final (retval->m_buf);
+
+  return retval;
+}
 
-  EVP_DigestFinal_ex (hash_context,
-                      retval->m_buf, &retval->m_length);
+HashPtr
+Hash::FromBytes (const ndn::Buffer &bytes, Digest::Algorithm algorithm/* = Digest::SHA256*/)
+{
+  Digest digest (algorithm);
+
+  HashPtr retval = boost::make_shared<Hash> (reinterpret_cast<void*> (0), 0, algorithm);
+  retval->m_buf = new unsigned char [Digest::MAX_SIZE];
+
+  // not sure whether it's bad to do so if bytes.size is huge
+  digest.Update (bytes.buf (), bytes.size ());
 
-  EVP_MD_CTX_destroy (hash_context);
+  retval->m_length = digest.Final (retval->m_buf);
 
   return retval;
 }
@@ -29,8 +29,7 @@
 #include <boost/filesystem.hpp>
 #include <ndn-cxx/encoding/buffer.hpp>
 
-// Other options: VP_md2, EVP_md5, EVP_sha, EVP_sha1, EVP_sha256, EVP_dss, EVP_dss1, EVP_mdc2, EVP_ripemd160
-#define HASH_FUNCTION EVP_sha256
+#include "digest.h"
 
 class Hash;
 typedef boost::shared_ptr<Hash> HashPtr;
@@ -44,11 +43,13 @@ public:
   Hash ()
     : m_buf(0)
     , m_length(0)
+    , m_algorithm (Digest::SHA256)
   {
   }
 
-  Hash (const void *buf, unsigned int length)
+  Hash (const void *buf, unsigned int length, Digest::Algorithm algorithm = Digest::SHA256)
     : m_length (length)
+    , m_algorithm (algorithm)
   {
     if (m_length != 0)
       {
@@ -59,6 +60,7 @@ public:
 
   Hash (const Hash &otherHash)
   : m_length (otherHash.m_length)
+  , m_algorithm (otherHash.m_algorithm)
   {
     if (m_length != 0)
       {
@@ -70,11 +72,22 @@ public:
   static HashPtr
   FromString (const std::string &hashInTextEncoding);
 
+  /**
+   * @throws boost::filesystem::filesystem_error if the file cannot be read completely
+   */
   static HashPtr
-  FromFileContent (const boost::filesystem::path &fileName);
+  FromFileContent (const boost::filesystem::path &fileName, Digest::Algorithm algorithm = Digest::GetDefaultAlgorithm ());
 
   static HashPtr
-  FromBytes (const ndn::Buffer &bytes);
+  FromBytes (const ndn::Buffer &bytes, Digest::Algorithm algorithm = Digest::SHA256);
+
+  /**
+   * @brief Digest of the file size and a few blocks of the file (beginning, middle and end)
+   *
+   * Much cheaper than FromFileContent for large files, but only detects changes in sampled blocks
+   */
+  static HashPtr
+  FromFileSamples (const boost::filesystem::path &fileName, size_t sampleSize = 4096);
 
   ~Hash ()
   {
@@ -89,6 +102,7 @@ public:
       delete [] m_buf;
 
     m_length = otherHash.m_length;
+    m_algorithm = otherHash.m_algorithm;
     if (m_length != 0)
       {
         m_buf = new unsigned char [m_length];
@@ -147,12 +161,22 @@ public:
     return m_length;
   }
 
+  /**
+   * @brief Algorithm the digest was computed with (not taken into account by comparisons)
+   */
+  Digest::Algorithm
+  GetAlgorithm () const
+  {
+    return m_algorithm;
+  }
+
   std::string
   shortHash () const;
 
 private:
   unsigned char *m_buf;
   unsigned int m_length;
+  Digest::Algorithm m_algorithm;
 
   friend std::ostream &
   operator << (std::ostream &os, const Hash &digest);
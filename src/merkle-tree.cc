@@ -0,0 +1,185 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "merkle-tree.h"
+#include <boost/make_shared.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+using namespace std;
+
+static const unsigned char LEAF_PREFIX = 0x00;
+static const unsigned char NODE_PREFIX = 0x01;
+
+static string
+leafDigest (Digest::Algorithm algorithm, const void *data, size_t size)
+{
+  Digest digest (algorithm);
+  digest.Update (&LEAF_PREFIX, 1);
+  digest.Update (data, size);
+
+  unsigned char result[Digest::MAX_SIZE];
+  unsigned int length = digest.Final (result);
+  return string (reinterpret_cast<const char*> (result), length);
+}
+
+static string
+nodeDigest (Digest::Algorithm algorithm, const char *left, const char *right, size_t size)
+{
+  Digest digest (algorithm);
+  digest.Update (&NODE_PREFIX, 1);
+  digest.Update (left, size);
+  digest.Update (right, size);
+
+  unsigned char result[Digest::MAX_SIZE];
+  unsigned int length = digest.Final (result);
+  return string (reinterpret_cast<const char*> (result), length);
+}
+
+MerkleTree::MerkleTree (Digest::Algorithm algorithm/* = Digest::SHA256*/)
+  : m_algorithm (algorithm)
+{
+  // also throws Error::UnsupportedDigest early, if the algorithm is not available
+  Digest digest (algorithm);
+  unsigned char result[Digest::MAX_SIZE];
+  m_digestSize = digest.Final (result);
+}
+
+void
+MerkleTree::AddLeaf (const void *data, size_t size)
+{
+  if (m_levels.empty ())
+    {
+      m_levels.push_back (string ());
+    }
+
+  m_levels[0] += leafDigest (m_algorithm, data, size);
+}
+
+HashPtr
+MerkleTree::GetRoot ()
+{
+  if (m_levels.empty ())
+    {
+      return boost::make_shared<Hash> ();
+    }
+
+  while (m_levels.back ().size () > m_digestSize)
+    {
+      const string &level = m_levels.back ();
+      uint64_t count = level.size () / m_digestSize;
+
+      string next;
+      for (uint64_t i = 0; i + 1 < count; i += 2)
+        {
+          next += nodeDigest (m_algorithm, level.c_str () + i * m_digestSize, level.c_str () + (i + 1) * m_digestSize, m_digestSize);
+        }
+      if (count % 2 == 1)
+        {
+          next.append (level, (count - 1) * m_digestSize, m_digestSize);
+        }
+
+      m_levels.push_back (next);
+    }
+
+  return boost::make_shared<Hash> (m_levels.back ().c_str (), m_digestSize, m_algorithm);
+}
+
+string
+MerkleTree::GetProof (uint64_t index) const
+{
+  string proof;
+  for (size_t level = 0; level + 1 < m_levels.size (); level++)
+    {
+      uint64_t sibling = index ^ 1;
+      if (sibling < m_levels[level].size () / m_digestSize)
+        {
+          proof.append (m_levels[level], sibling * m_digestSize, m_digestSize);
+        }
+      index >>= 1;
+    }
+  return proof;
+}
+
+HashPtr
+MerkleTree::ComputeRoot (Digest::Algorithm algorithm, uint64_t leafCount, uint64_t index,
+                         const void *data, size_t size, const string &proof)
+{
+  if (index >= leafCount || !Digest::IsSupported (algorithm))
+    return boost::make_shared<Hash> ();
+
+  string current = leafDigest (algorithm, data, size);
+  size_t digestSize = current.size ();
+
+  size_t offset = 0;
+  for (uint64_t count = leafCount; count > 1; count = (count + 1) / 2)
+    {
+      uint64_t sibling = index ^ 1;
+      if (sibling < count)
+        {
+          if (offset + digestSize > proof.size ())
+            return boost::make_shared<Hash> ();
+
+          const char *siblingDigest = proof.c_str () + offset;
+          offset += digestSize;
+
+          if (index % 2 == 0)
+            current = nodeDigest (algorithm, current.c_str (), siblingDigest, digestSize);
+          else
+            current = nodeDigest (algorithm, siblingDigest, current.c_str (), digestSize);
+        }
+      index >>= 1;
+    }
+
+  if (offset != proof.size ())
+    return boost::make_shared<Hash> ();
+
+  return boost::make_shared<Hash> (current.c_str (), digestSize, algorithm);
+}
+
+bool
+MerkleTree::Verify (const Hash &root, uint64_t leafCount, uint64_t index,
+                    const void *data, size_t size, const string &proof)
+{
+  HashPtr computed = ComputeRoot (root.GetAlgorithm (), leafCount, index, data, size, proof);
+  return computed->GetHashBytes () > 0 && *computed == root;
+}
+
+void
+MerkleTree::AttachProof (ndn::Data &data, const string &proof)
+{
+  if (proof.empty ())
+    return;
+
+  ndn::MetaInfo info = data.getMetaInfo ();
+  info.addAppMetaInfo (ndn::makeBinaryBlock (PROOF_TLV_TYPE, reinterpret_cast<const uint8_t*> (proof.c_str ()), proof.size ()));
+  data.setMetaInfo (info);
+}
+
+string
+MerkleTree::ExtractProof (const ndn::Data &data)
+{
+  const ndn::Block *block = data.getMetaInfo ().findAppMetaInfo (PROOF_TLV_TYPE);
+  if (block == 0)
+    return string ();
+
+  return string (reinterpret_cast<const char*> (block->value ()), block->value_size ());
+}
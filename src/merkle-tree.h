@@ -0,0 +1,101 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#ifndef MERKLE_TREE_H
+#define MERKLE_TREE_H
+
+#include "hash-helper.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <ndn-cxx/data.hpp>
+
+/**
+ * @brief Merkle tree over file segments
+ *
+ * Root of the tree is published in the action, so every segment can be verified on arrival with
+ * a proof of log2(n) digests, instead of only the whole file after all segments are fetched.
+ *
+ * Leaf is H(0x00 | segment), node is H(0x01 | left | right).  The last node of a level without a
+ * pair is moved to the next level as is, so the shape of the tree is defined by the number of leaves.
+ */
+class MerkleTree
+{
+public:
+  /**
+   * @brief Type of the application MetaInfo element that carries the proof of a segment
+   */
+  static const uint32_t PROOF_TLV_TYPE = 200;
+
+  explicit
+  MerkleTree (Digest::Algorithm algorithm = Digest::SHA256);
+
+  void
+  AddLeaf (const void *data, size_t size);
+
+  uint64_t
+  GetLeafCount () const { return m_levels.empty () ? 0 : m_levels[0].size () / m_digestSize; }
+
+  /**
+   * @brief Root of the tree, no leaves can be added afterwards
+   * @returns empty hash if there are no leaves
+   */
+  HashPtr
+  GetRoot ();
+
+  /**
+   * @brief Digests of the siblings on the path from the leaf to the root (should be called after GetRoot)
+   */
+  std::string
+  GetProof (uint64_t index) const;
+
+  /**
+   * @brief Root of the tree with leafCount leaves, in which the segment is the leaf index with the proof
+   * @returns empty hash if the proof doesn't match the shape of the tree
+   */
+  static HashPtr
+  ComputeRoot (Digest::Algorithm algorithm, uint64_t leafCount, uint64_t index,
+               const void *data, size_t size, const std::string &proof);
+
+  /**
+   * @brief Check that the segment is the leaf index of the tree with the root (algorithm is taken from the root)
+   */
+  static bool
+  Verify (const Hash &root, uint64_t leafCount, uint64_t index,
+          const void *data, size_t size, const std::string &proof);
+
+  static void
+  AttachProof (ndn::Data &data, const std::string &proof);
+
+  /**
+   * @returns empty string if data doesn't carry a proof
+   */
+  static std::string
+  ExtractProof (const ndn::Data &data);
+
+private:
+  Digest::Algorithm m_algorithm;
+  size_t m_digestSize;
+  std::vector<std::string> m_levels; // concatenated digests of nodes, leaves first
+};
+
+#endif // MERKLE_TREE_H
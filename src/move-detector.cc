@@ -0,0 +1,113 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "move-detector.h"
+
+using namespace std;
+namespace pt = boost::posix_time;
+
+MoveDetector::MoveDetector (double window/* = 2.0*/)
+  : m_window (window)
+{
+}
+
+void
+MoveDetector::AddRemoved (const std::string &filename, const Hash &hash, time_t mtime, int segNum,
+                          const pt::ptime &now)
+{
+  Cancel (filename);
+
+  Removal removal;
+  removal.m_filename = filename;
+  removal.m_hash = hash;
+  removal.m_mtime = mtime;
+  removal.m_segNum = segNum;
+  removal.m_deadline = now + pt::microseconds (static_cast<int64_t> (m_window * 1000000));
+
+  m_removals.insert (make_pair (hash, removal));
+}
+
+bool
+MoveDetector::MatchAdded (const Hash &hash, time_t mtime, Removal &removal)
+{
+  pair<RemovalMap::iterator, RemovalMap::iterator> range = m_removals.equal_range (hash);
+  if (range.first == range.second)
+    return false;
+
+  RemovalMap::iterator match = range.first;
+  for (RemovalMap::iterator candidate = range.first; candidate != range.second; candidate++)
+    {
+      if (candidate->second.m_mtime == mtime)
+        {
+          match = candidate;
+          break;
+        }
+    }
+
+  removal = match->second;
+  m_removals.erase (match);
+  return true;
+}
+
+bool
+MoveDetector::Cancel (const std::string &filename)
+{
+  for (RemovalMap::iterator removal = m_removals.begin (); removal != m_removals.end (); removal++)
+    {
+      if (removal->second.m_filename == filename)
+        {
+          m_removals.erase (removal);
+          return true;
+        }
+    }
+  return false;
+}
+
+MoveDetector::Removals
+MoveDetector::TakeExpired (const pt::ptime &now)
+{
+  Removals expired;
+  for (RemovalMap::iterator removal = m_removals.begin (); removal != m_removals.end (); )
+    {
+      if (removal->second.m_deadline <= now)
+        {
+          expired.push_back (removal->second);
+          m_removals.erase (removal++);
+        }
+      else
+        {
+          removal++;
+        }
+    }
+  return expired;
+}
+
+MoveDetector::Removals
+MoveDetector::TakeAll ()
+{
+  Removals all;
+  for (RemovalMap::iterator removal = m_removals.begin (); removal != m_removals.end (); removal++)
+    {
+      all.push_back (removal->second);
+    }
+  m_removals.clear ();
+  return all;
+}
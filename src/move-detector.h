@@ -0,0 +1,105 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef MOVE_DETECTOR_H
+#define MOVE_DETECTOR_H
+
+#include "hash-helper.h"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include <time.h>
+
+/**
+ * @brief Pairs files that disappeared with files that appeared with the same content
+ *
+ * A rename is reported by FsWatcher as a removal and an addition (in any order).  Removals
+ * of files with known content are held for a short window, during which an added file with
+ * the same hash is taken as the new name of the removed file.  Removals that were not
+ * matched within the window are handed back to be published as usual.
+ */
+class MoveDetector
+{
+public:
+  struct Removal
+  {
+    std::string m_filename;
+    Hash m_hash;
+    time_t m_mtime;
+    int m_segNum;
+    boost::posix_time::ptime m_deadline;
+  };
+  typedef std::vector<Removal> Removals;
+
+  MoveDetector (double window = 2.0);
+
+  /**
+   * @brief Remember a removed file with its last known content
+   */
+  void
+  AddRemoved (const std::string &filename, const Hash &hash, time_t mtime, int segNum,
+              const boost::posix_time::ptime &now);
+
+  /**
+   * @brief Find (and forget) a removed file with the same content
+   *
+   * If several removed files have the same content, the one with the same mtime is preferred
+   * (rename keeps the modification time)
+   * @returns false if there is no such file
+   */
+  bool
+  MatchAdded (const Hash &hash, time_t mtime, Removal &removal);
+
+  /**
+   * @brief Forget the removed file (e.g., it reappeared at the same place)
+   */
+  bool
+  Cancel (const std::string &filename);
+
+  /**
+   * @brief Take removals that were not matched within the window
+   */
+  Removals
+  TakeExpired (const boost::posix_time::ptime &now);
+
+  /**
+   * @brief Take all remembered removals
+   */
+  Removals
+  TakeAll ();
+
+  size_t
+  GetPendingCount () const { return m_removals.size (); }
+
+  double
+  GetWindow () const { return m_window; }
+
+private:
+  double m_window;
+
+  // hash -> removals with this content, in the order of removal
+  typedef std::multimap<Hash, Removal> RemovalMap;
+  RemovalMap m_removals;
+};
+
+#endif // MOVE_DETECTOR_H
@@ -23,8 +23,10 @@
 #include <iostream>
 #include <boost/make_shared.hpp>
 #include "db-helper.h"
+#include "db-upgrade.h"
 #include <sys/stat.h>
 #include "logging.h"
+#include <map>
 
 INIT_LOGGER ("Object.Db");
 
@@ -39,14 +41,23 @@ CREATE TABLE                                                            \n \
         device_name     BLOB NOT NULL,                                  \n\
         segment         INTEGER,                                        \n\
         content_object  BLOB,                                           \n\
+        proof           BLOB, /* MerkleTree proof of the segment */     \n\
                                                                         \
         PRIMARY KEY (device_name, segment)                              \n\
     );                                                                  \n\
 CREATE INDEX device ON File(device_name);                               \n\
 ";
 
+static const ColumnUpgrade UPGRADE_COLUMNS[] = {
+  { "File", "proof", "BLOB" },
+};
+
+// segments are committed in batches, so not everything is lost if the process is interrupted
+static const int COMMIT_BATCH_SIZE = 256;
+
 ObjectDb::ObjectDb (const fs::path &folder, const std::string &hash)
   : m_lastUsed (std::time(NULL))
+  , m_uncommitted (0)
 {
   fs::path actualFolder = folder / "objects" / hash.substr (0, 2);
   fs::create_directories (actualFolder);
@@ -72,45 +83,162 @@ ObjectDb::ObjectDb (const fs::path &folder, const std::string &hash)
       sqlite3_free (errmsg);
     }
 
+  if (!AddMissingColumns (m_db, UPGRADE_COLUMNS))
+    {
+      _LOG_ERROR ("Cannot upgrade File table: " << sqlite3_errmsg (m_db));
+    }
+
   // _LOG_DEBUG ("open db");
 
   willStartSave ();
 }
 
 bool
-ObjectDb::DoesExist (const boost::filesystem::path &folder, const ndn::Name &deviceName, const std::string &hash)
+ObjectDb::isComplete (sqlite3 *db, const ndn::Name &deviceName)
 {
-  fs::path actualFolder = folder / "objects" / hash.substr (0, 2);
   bool retval = false;
 
-  sqlite3 *db;
-  int res = sqlite3_open((actualFolder / hash.substr (2, hash.size () - 2)).c_str (), &db);
-  if (res == SQLITE_OK)
-    {
-      sqlite3_stmt *stmt;
-      sqlite3_prepare_v2 (db, "SELECT count(*), count(nullif(content_object,0)) FROM File WHERE device_name=?", -1, &stmt, 0);
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (db, "SELECT count(*), count(nullif(content_object,0)) FROM File WHERE device_name=?", -1, &stmt, 0);
+
+  const ndn::Block block = deviceName.wireEncode();
+
+  sqlite3_bind_blob (stmt, 1, block.wire (), block.size (), SQLITE_TRANSIENT);
 
-      const ndn::Block block = deviceName.wireEncode();
+  int res = sqlite3_step (stmt);
+  if (res == SQLITE_ROW)
+    {
+      int countAll = sqlite3_column_int (stmt, 0);
+      int countNonNull = sqlite3_column_int (stmt, 1);
 
-      sqlite3_bind_blob (stmt, 1, block.value (), block.size (), SQLITE_TRANSIENT);
+      _LOG_TRACE ("Total segments: " << countAll << ", non-empty segments: " << countNonNull);
 
-      int res = sqlite3_step (stmt);
-      if (res == SQLITE_ROW)
+      if (countAll > 0 && countAll==countNonNull)
         {
-          int countAll = sqlite3_column_int (stmt, 0);
-          int countNonNull = sqlite3_column_int (stmt, 1);
+          retval = true;
+        }
+    }
+
+  sqlite3_finalize (stmt);
+  return retval;
+}
+
+bool
+ObjectDb::DoesExist (const boost::filesystem::path &folder, const ndn::Name &deviceName, const std::string &hash)
+{
+  Keys keys;
+  keys.insert (Key (deviceName, hash));
+
+  return !FindExisting (folder, keys).empty ();
+}
+
+ObjectDb::Keys
+ObjectDb::FindExisting (const boost::filesystem::path &folder, const Keys &keys)
+{
+  Keys retval;
+
+  // group devices by hash, so every database is opened only once
+  std::map<std::string, std::vector<ndn::Name> > devicesPerHash;
+  for (Keys::const_iterator key = keys.begin (); key != keys.end (); key++)
+    {
+      devicesPerHash[key->second].push_back (key->first);
+    }
 
-          _LOG_TRACE ("Total segments: " << countAll << ", non-empty segments: " << countNonNull);
+  for (std::map<std::string, std::vector<ndn::Name> >::iterator i = devicesPerHash.begin (); i != devicesPerHash.end (); i++)
+    {
+      const std::string &hash = i->first;
+
+      sqlite3 *db = openReadOnly (folder, hash);
+      if (db == 0)
+        continue;
 
-          if (countAll > 0 && countAll==countNonNull)
+      for (std::vector<ndn::Name>::iterator deviceName = i->second.begin (); deviceName != i->second.end (); deviceName++)
+        {
+          if (isComplete (db, *deviceName))
             {
-              retval = true;
+              retval.insert (Key (*deviceName, hash));
             }
         }
 
-      sqlite3_finalize (stmt);
+      sqlite3_close (db);
+    }
+
+  return retval;
+}
+
+sqlite3 *
+ObjectDb::openReadOnly (const boost::filesystem::path &folder, const std::string &hash)
+{
+  fs::path dbPath = folder / "objects" / hash.substr (0, 2) / hash.substr (2, hash.size () - 2);
+
+  // don't let sqlite create empty databases for objects that were never fetched
+  if (!fs::exists (dbPath))
+    return 0;
+
+  sqlite3 *db;
+  int res = sqlite3_open_v2 (dbPath.c_str (), &db, SQLITE_OPEN_READONLY, 0);
+  if (res != SQLITE_OK)
+    {
+      sqlite3_close (db);
+      return 0;
+    }
+
+  return db;
+}
+
+sqlite3_int64
+ObjectDb::CountSegments (const boost::filesystem::path &folder, const std::string &hash, const ndn::Name &deviceName,
+                         sqlite3_int64 minSegment, sqlite3_int64 maxSegment)
+{
+  sqlite3 *db = openReadOnly (folder, hash);
+  if (db == 0)
+    return 0;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (db, "SELECT count(*) FROM File WHERE device_name=? AND segment>=? AND segment<=?", -1, &stmt, 0);
+
+  const ndn::Block block = deviceName.wireEncode ();
+
+  sqlite3_bind_blob (stmt, 1, block.wire (), block.size (), SQLITE_STATIC);
+  sqlite3_bind_int64 (stmt, 2, minSegment);
+  sqlite3_bind_int64 (stmt, 3, maxSegment);
+
+  sqlite3_int64 retval = 0;
+  if (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      retval = sqlite3_column_int64 (stmt, 0);
     }
 
+  sqlite3_finalize (stmt);
+  sqlite3_close (db);
+  return retval;
+}
+
+std::vector<sqlite3_int64>
+ObjectDb::FindSegments (const boost::filesystem::path &folder, const std::string &hash, const ndn::Name &deviceName,
+                        sqlite3_int64 minSegment, sqlite3_int64 maxSegment)
+{
+  std::vector<sqlite3_int64> retval;
+
+  sqlite3 *db = openReadOnly (folder, hash);
+  if (db == 0)
+    return retval;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (db, "SELECT segment FROM File WHERE device_name=? AND segment>=? AND segment<=? ORDER BY segment", -1, &stmt, 0);
+
+  const ndn::Block block = deviceName.wireEncode ();
+
+  sqlite3_bind_blob (stmt, 1, block.wire (), block.size (), SQLITE_STATIC);
+  sqlite3_bind_int64 (stmt, 2, minSegment);
+  sqlite3_bind_int64 (stmt, 3, maxSegment);
+
+  while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      retval.push_back (sqlite3_column_int64 (stmt, 0));
+    }
+
+  sqlite3_finalize (stmt);
   sqlite3_close (db);
   return retval;
 }
@@ -129,12 +257,13 @@ ObjectDb::~ObjectDb ()
 }
 
 void
-ObjectDb::saveContentObject (const ndn::Name &deviceName, sqlite3_int64 segment, const ndn::Block &data)
+ObjectDb::saveContentObject (const ndn::Name &deviceName, sqlite3_int64 segment, const ndn::Block &data,
+                             const std::string &proof/* = ""*/)
 {
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2 (m_db, "INSERT INTO File "
-                      "(device_name, segment, content_object) "
-                      "VALUES (?, ?, ?)", -1, &stmt, 0);
+                      "(device_name, segment, content_object, proof) "
+                      "VALUES (?, ?, ?, ?)", -1, &stmt, 0);
 
   //_LOG_DEBUG ("Saving content object for [" << deviceName << ", seqno: " << segment << ", size: " << data.size () << "]");
 
@@ -142,7 +271,11 @@ ObjectDb::saveContentObject (const ndn::Name &deviceName, sqlite3_int64 segment,
 
   sqlite3_bind_blob (stmt, 1, buf.wire (), buf.size (), SQLITE_STATIC);
   sqlite3_bind_int64 (stmt, 2, segment);
-  sqlite3_bind_blob (stmt, 3, data.value (), data.size (), SQLITE_STATIC);
+  sqlite3_bind_blob (stmt, 3, data.value (), data.value_size (), SQLITE_STATIC);
+  if (!proof.empty ())
+    {
+      sqlite3_bind_blob (stmt, 4, proof.c_str (), proof.size (), SQLITE_STATIC);
+    }
 
   sqlite3_step (stmt);
   //_LOG_DEBUG ("After saving object: " << sqlite3_errmsg (m_db));
@@ -150,17 +283,56 @@ ObjectDb::saveContentObject (const ndn::Name &deviceName, sqlite3_int64 segment,
 
   // update last used time
   m_lastUsed = std::time(NULL);
+
+  m_uncommitted ++;
+  if (m_uncommitted >= COMMIT_BATCH_SIZE)
+    {
+      didStopSave ();
+      willStartSave ();
+      m_uncommitted = 0;
+    }
+}
+
+void
+ObjectDb::saveProof (const ndn::Name &deviceName, sqlite3_int64 segment, const std::string &proof)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db, "UPDATE File SET proof=? WHERE device_name=? AND segment=?", -1, &stmt, 0);
+
+  ndn::Block buf = deviceName.wireEncode ();
+
+  sqlite3_bind_blob (stmt, 1, proof.c_str (), proof.size (), SQLITE_STATIC);
+  sqlite3_bind_blob (stmt, 2, buf.wire (), buf.size (), SQLITE_STATIC);
+  sqlite3_bind_int64 (stmt, 3, segment);
+
+  sqlite3_step (stmt);
+  sqlite3_finalize (stmt);
+
+  m_uncommitted ++;
+  if (m_uncommitted >= COMMIT_BATCH_SIZE)
+    {
+      didStopSave ();
+      willStartSave ();
+      m_uncommitted = 0;
+    }
 }
 
 ndn::BufferPtr
 ObjectDb::fetchSegment (const ndn::Name &deviceName, sqlite3_int64 segment)
+{
+  std::string proof;
+  return fetchSegment (deviceName, segment, proof);
+}
+
+ndn::BufferPtr
+ObjectDb::fetchSegment (const ndn::Name &deviceName, sqlite3_int64 segment, std::string &proof)
 {
   sqlite3_stmt *stmt;
-  sqlite3_prepare_v2 (m_db, "SELECT content_object FROM File WHERE device_name=? AND segment=?", -1, &stmt, 0);
+  sqlite3_prepare_v2 (m_db, "SELECT content_object, proof FROM File WHERE device_name=? AND segment=?", -1, &stmt, 0);
 
   const ndn::Block buf = deviceName.wireEncode ();
 
-  sqlite3_bind_blob (stmt, 1, buf.value (), buf.size (), SQLITE_TRANSIENT);
+  sqlite3_bind_blob (stmt, 1, buf.wire (), buf.size (), SQLITE_TRANSIENT);
   sqlite3_bind_int64 (stmt, 2, segment);
 
   ndn::BufferPtr ret;
@@ -173,6 +345,7 @@ ObjectDb::fetchSegment (const ndn::Name &deviceName, sqlite3_int64 segment)
 
       ret = boost::make_shared<ndn::Buffer> (buf, buf+bufBytes);
 
+      proof.assign (reinterpret_cast<const char*> (sqlite3_column_blob (stmt, 1)), sqlite3_column_bytes (stmt, 1));
     }
 
   sqlite3_finalize (stmt);
@@ -183,6 +356,50 @@ ObjectDb::fetchSegment (const ndn::Name &deviceName, sqlite3_int64 segment)
   return ret;
 }
 
+void
+ObjectDb::fetchSegments (const ndn::Name &deviceName, const SegmentVisitor &visitor)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db, "SELECT segment, content_object FROM File WHERE device_name=? ORDER BY segment", -1, &stmt, 0);
+
+  const ndn::Block buf = deviceName.wireEncode ();
+
+  sqlite3_bind_blob (stmt, 1, buf.wire (), buf.size (), SQLITE_STATIC);
+
+  while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      const uint8_t *content = reinterpret_cast<const uint8_t*> (sqlite3_column_blob (stmt, 1));
+      int contentBytes = sqlite3_column_bytes (stmt, 1);
+
+      if (!visitor (sqlite3_column_int64 (stmt, 0), content, contentBytes))
+        break;
+    }
+
+  sqlite3_finalize (stmt);
+
+  m_lastUsed = std::time(NULL);
+}
+
+sqlite3_int64
+ObjectDb::getContentSize (const ndn::Name &deviceName)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db, "SELECT sum(length(content_object)) FROM File WHERE device_name=?", -1, &stmt, 0);
+
+  const ndn::Block buf = deviceName.wireEncode ();
+
+  sqlite3_bind_blob (stmt, 1, buf.wire (), buf.size (), SQLITE_STATIC);
+
+  sqlite3_int64 retval = 0;
+  if (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      retval = sqlite3_column_int64 (stmt, 0);
+    }
+
+  sqlite3_finalize (stmt);
+  return retval;
+}
+
 time_t
 ObjectDb::secondsSinceLastUse()
 {
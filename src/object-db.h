@@ -28,6 +28,8 @@
 #include <boost/shared_ptr.hpp>
 #include <ctime>
 #include <vector>
+#include <boost/function.hpp>
+#include <set>
 #include <ndn-cxx/name.hpp>
 
 class ObjectDb
@@ -37,12 +39,42 @@ public:
   ObjectDb (const boost::filesystem::path &folder, const std::string &hash);
   ~ObjectDb ();
 
+  /**
+   * @param proof MerkleTree proof of the segment (if known), to be served along with the segment
+   */
   void
-  saveContentObject (const ndn::Name &deviceName, sqlite3_int64 segment, const ndn::Block &data);
+  saveContentObject (const ndn::Name &deviceName, sqlite3_int64 segment, const ndn::Block &data,
+                     const std::string &proof = "");
+
+  /**
+   * @brief Save proof of the already saved segment
+   */
+  void
+  saveProof (const ndn::Name &deviceName, sqlite3_int64 segment, const std::string &proof);
 
   ndn::BufferPtr
   fetchSegment (const ndn::Name &deviceName, sqlite3_int64 segment);
 
+  /**
+   * @brief The same as above, but also returns the saved proof of the segment (empty if unknown)
+   */
+  ndn::BufferPtr
+  fetchSegment (const ndn::Name &deviceName, sqlite3_int64 segment, std::string &proof);
+
+  typedef boost::function<bool (sqlite3_int64 segment, const uint8_t *buf, size_t size)> SegmentVisitor;
+
+  /**
+   * @brief Visit all segments of the device in increasing order with one query (stops if visitor returns false)
+   */
+  void
+  fetchSegments (const ndn::Name &deviceName, const SegmentVisitor &visitor);
+
+  /**
+   * @brief Total size of all segments of the device (i.e., size of the file)
+   */
+  sqlite3_int64
+  getContentSize (const ndn::Name &deviceName);
+
   // sqlite3_int64
   // getNumberOfSegments (const Ccnx::Name &deviceName);
 
@@ -52,7 +84,41 @@ public:
   static bool
   DoesExist (const boost::filesystem::path &folder, const ndn::Name &deviceName, const std::string &hash);
 
+  typedef std::pair<ndn::Name /*deviceName*/, std::string /*hash*/> Key;
+  typedef std::set<Key> Keys;
+
+  /**
+   * @brief Batch version of DoesExist
+   *
+   * Each object database is opened (read-only) at most once, no matter how many devices are queried for it.
+   * Returns subset of keys for which all segments are present
+   */
+  static Keys
+  FindExisting (const boost::filesystem::path &folder, const Keys &keys);
+
+  /**
+   * @brief Number of segments of the device in [minSegment, maxSegment] saved in the database of the hash
+   */
+  static sqlite3_int64
+  CountSegments (const boost::filesystem::path &folder, const std::string &hash, const ndn::Name &deviceName,
+                 sqlite3_int64 minSegment, sqlite3_int64 maxSegment);
+
+  /**
+   * @brief Segments of the device in [minSegment, maxSegment] saved in the database of the hash (in increasing order)
+   */
+  static std::vector<sqlite3_int64>
+  FindSegments (const boost::filesystem::path &folder, const std::string &hash, const ndn::Name &deviceName,
+                sqlite3_int64 minSegment, sqlite3_int64 maxSegment);
+
 private:
+  // returns 0 if database does not exist
+  static sqlite3 *
+  openReadOnly (const boost::filesystem::path &folder, const std::string &hash);
+
+  static bool
+  isComplete (sqlite3 *db, const ndn::Name &deviceName);
+
+
   void
   willStartSave ();
 
@@ -62,6 +128,7 @@ private:
 private:
   sqlite3 *m_db;
   time_t m_lastUsed;
+  int m_uncommitted; // segments saved in the currently open transaction
 };
 
 typedef boost::shared_ptr<ObjectDb> ObjectDbPtr;
@@ -21,6 +21,7 @@
 
 #include "object-manager.h"
 #include "object-db.h"
+#include "merkle-tree.h"
 #include "logging.h"
 
 #include <sys/stat.h>
@@ -42,6 +43,7 @@ ObjectManager::ObjectManager (const fs::path &folder, const std::string &appName
   : m_ndn ()
   , m_folder (folder / ".chronoshare")
   , m_appName (appName)
+  , m_signingMode (SIGN_DIGEST)
 {
   fs::create_directories (m_folder);
 }
@@ -51,11 +53,17 @@ ObjectManager::~ObjectManager ()
 }
 
 // /<devicename>/<appname>/file/<hash>/<segment>
-boost::tuple<HashPtr /*object-db name*/, size_t /* number of segments*/>
+boost::tuple<HashPtr /*object-db name*/, size_t /* number of segments*/, HashPtr /*segment root*/>
 ObjectManager::localFileToObjects (const fs::path &file, const ndn::Name &deviceName)
 {
-  HashPtr fileHash = Hash::FromFileContent (file);
+  return localFileToObjects (file, deviceName, Hash::FromFileContent (file));
+}
+
+boost::tuple<HashPtr /*object-db name*/, size_t /* number of segments*/, HashPtr /*segment root*/>
+ObjectManager::localFileToObjects (const fs::path &file, const ndn::Name &deviceName, HashPtr fileHash)
+{
   ObjectDb fileDb (m_folder, lexical_cast<string> (*fileHash));
+  MerkleTree tree (fileHash->GetAlgorithm ());
 
   fs::ifstream iff (file, std::ios::in | std::ios::binary);
   sqlite3_int64 segment = 0;
@@ -79,10 +87,11 @@ ObjectManager::localFileToObjects (const fs::path &file, const ndn::Name &device
       ndn::Data data;
       data.setName(name);
       data.setFreshnessPeriod(time::seconds(60));
-      data.setContent(reinterpret_cast<const uint8_t*>(&buf), sizeof(buf));
-      m_ndn->put(data);
+      data.setContent(reinterpret_cast<const uint8_t*>(&buf), iff.gcount ());
+      publishSegment (data);
 
       fileDb.saveContentObject (deviceName, segment, data.getContent ());
+      tree.AddLeaf (data.getContent ().value (), data.getContent ().value_size ());
 
       segment ++;
     }
@@ -96,18 +105,93 @@ ObjectManager::localFileToObjects (const fs::path &file, const ndn::Name &device
       data.setName(name);
       data.setFreshnessPeriod(time::seconds(0));
       data.setContent(0, 0);
-      m_ndn->put(data);
+      publishSegment (data);
 
       fileDb.saveContentObject (deviceName, 0, data.getContent ());
+      tree.AddLeaf (data.getContent ().value (), data.getContent ().value_size ());
 
       segment ++;
     }
 
-  return make_tuple (fileHash, segment);
+  // proofs are known only after all segments are digested
+  HashPtr root = tree.GetRoot ();
+  for (sqlite3_int64 i = 0; i < segment; i++)
+    {
+      fileDb.saveProof (deviceName, i, tree.GetProof (i));
+    }
+
+  return boost::make_tuple (fileHash, segment, root);
+}
+
+void
+ObjectManager::SignSegment (ndn::KeyChain &keyChain, SigningMode mode, ndn::Data &data)
+{
+  if (mode == SIGN_DIGEST)
+    {
+      // integrity only, receiver authenticates the segment by its proof against segment_root of the action
+      keyChain.signWithSha256 (data);
+    }
+  else
+    {
+      keyChain.sign (data);
+    }
+}
+
+void
+ObjectManager::publishSegment (ndn::Data &data)
+{
+  if (m_signingMode == SIGN_DIGEST)
+    {
+      // segments are signed with their proofs when served by ContentServer
+      return;
+    }
+
+  SignSegment (m_keyChain, m_signingMode, data);
+  if (m_ndn)
+    {
+      m_ndn->put(data);
+    }
+}
+
+HashPtr
+ObjectManager::segmentRoot (const ndn::Name &deviceName, const Hash &fileHash, size_t segments)
+{
+  ObjectDb fileDb (m_folder, lexical_cast<string> (fileHash));
+
+  std::string proof;
+  ndn::BufferPtr first = fileDb.fetchSegment (deviceName, 0, proof);
+  if (!first)
+    {
+      return boost::make_shared<Hash> ();
+    }
+
+  return MerkleTree::ComputeRoot (fileHash.GetAlgorithm (), segments, 0, first->buf (), first->size (), proof);
 }
 
 bool
 ObjectManager::objectsToLocalFile (/*in*/const ndn::Name &deviceName, /*in*/const Hash &fileHash, /*out*/ const fs::path &file)
+{
+  FileMaterializer materializer;
+
+  // permission and timestamp should be assigned somewhere else (ObjectManager has no idea about that)
+  return objectsToLocalFile (deviceName, fileHash, file, materializer) && materializer.Commit ();
+}
+
+static bool
+writeSegment (FileMaterializer &materializer, sqlite3_int64 &nextSegment,
+              sqlite3_int64 segment, const uint8_t *buf, size_t size)
+{
+  if (segment != nextSegment)
+    return false;
+
+  nextSegment ++;
+  return materializer.Write (buf, size);
+}
+
+bool
+ObjectManager::objectsToLocalFile (/*in*/const ndn::Name &deviceName, /*in*/const Hash &fileHash, /*out*/ const fs::path &file,
+                                   FileMaterializer &materializer, time_t mtime/* = 0*/, int mode/* = -1*/,
+                                   const FileMaterializer::CommitCallback &onCommitted/* = FileMaterializer::CommitCallback ()*/)
 {
   string hashStr = lexical_cast<string> (fileHash);
   if (!ObjectDb::DoesExist (m_folder, deviceName, hashStr))
@@ -116,29 +200,22 @@ ObjectManager::objectsToLocalFile (/*in*/const ndn::Name &deviceName, /*in*/cons
       return false;
     }
 
-  if (!exists (file.parent_path ()))
-    {
-      create_directories (file.parent_path ());
-    }
-
-  fs::ofstream off (file, std::ios::out | std::ios::binary);
   ObjectDb fileDb (m_folder, hashStr);
 
-  sqlite3_int64 segment = 0;
-  ndn::BufferPtr bytes = fileDb.fetchSegment (deviceName, 0);
-  while (bytes)
+  if (!materializer.Begin (file, fileDb.getContentSize (deviceName)))
     {
+      return false;
+    }
 
-      if (bytes->buf ())
-        {
-          off.write (reinterpret_cast<const char*> (bytes->buf ()), bytes->size ());
-        }
+  sqlite3_int64 nextSegment = 0;
+  fileDb.fetchSegments (deviceName, bind (writeSegment, boost::ref (materializer), boost::ref (nextSegment), _1, _2, _3));
 
-      segment ++;
-      bytes = fileDb.fetchSegment (deviceName, segment);
+  if (nextSegment == 0 || fileDb.fetchSegment (deviceName, nextSegment))
+    {
+      _LOG_ERROR ("Segment " << nextSegment << " of [" << file << "] cannot be restored");
+      materializer.Abort ();
+      return false;
     }
 
-  // permission and timestamp should be assigned somewhere else (ObjectManager has no idea about that)
-
-  return true;
+  return materializer.End (mtime, mode, onCommitted);
 }
@@ -24,33 +24,88 @@
 
 #include <string>
 #include <hash-helper.h>
+#include "file-materializer.h"
 #include <boost/filesystem.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <ndn-cxx/face.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
 
 // everything related to managing object files
 
 class ObjectManager
 {
 public:
+  enum SigningMode
+    {
+      SIGN_SEGMENTS, ///< every segment is signed by the device key
+      SIGN_DIGEST    ///< segments carry a digest (DigestSha256) signature and their MerkleTree proof
+    };
+
   ObjectManager (const boost::filesystem::path &folder, const std::string &appName);
   virtual ~ObjectManager ();
 
+  /**
+   * @brief Set how segments of files published after this call are signed (SIGN_DIGEST by default)
+   */
+  void
+  SetSigningMode (SigningMode mode) { m_signingMode = mode; }
+
+  SigningMode
+  GetSigningMode () const { return m_signingMode; }
+
+  /**
+   * @brief Sign the segment according to the mode
+   */
+  static void
+  SignSegment (ndn::KeyChain &keyChain, SigningMode mode, ndn::Data &data);
+
   /**
    * @brief Creates and saves local file in a local database file
    *
    * Format: /<appname>/file/<hash>/<devicename>/<segment>
+   *
+   * Every segment is saved with its proof in the MerkleTree over all segments, root of the tree is returned
+   * (to be published as segment_root of the action).
    */
-  boost::tuple<HashPtr /*object-db name*/, size_t /* number of segments*/>
+  boost::tuple<HashPtr /*object-db name*/, size_t /* number of segments*/, HashPtr /*segment root*/>
   localFileToObjects (const boost::filesystem::path &file, const ndn::Name &deviceName);
 
+  /**
+   * @brief The same as above, but with already calculated hash of the file content
+   */
+  boost::tuple<HashPtr /*object-db name*/, size_t /* number of segments*/, HashPtr /*segment root*/>
+  localFileToObjects (const boost::filesystem::path &file, const ndn::Name &deviceName, HashPtr fileHash);
+
+  /**
+   * @brief Root of the MerkleTree over already saved segments (recovered from the proof of the first segment)
+   * @returns empty hash if the segments were saved without proofs
+   */
+  HashPtr
+  segmentRoot (const ndn::Name &deviceName, const Hash &hash, size_t segments);
+
   bool
   objectsToLocalFile (/*in*/const ndn::Name &deviceName, /*in*/const Hash &hash, /*out*/ const boost::filesystem::path &file);
 
+  /**
+   * @brief Restore the file as part of the materializer batch
+   *
+   * The file appears at its place (and onCommitted is called) only when the batch is committed
+   */
+  bool
+  objectsToLocalFile (/*in*/const ndn::Name &deviceName, /*in*/const Hash &hash, /*out*/ const boost::filesystem::path &file,
+                      FileMaterializer &materializer, time_t mtime = 0, int mode = -1,
+                      const FileMaterializer::CommitCallback &onCommitted = FileMaterializer::CommitCallback ());
+
+private:
+  void
+  publishSegment (ndn::Data &data);
+
 private:
   boost::shared_ptr<ndn::Face> m_ndn;
+  ndn::KeyChain m_keyChain;
   boost::filesystem::path m_folder;
   std::string m_appName;
+  SigningMode m_signingMode;
 };
 
 typedef boost::shared_ptr<ObjectManager> ObjectManagerPtr;
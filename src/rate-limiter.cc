@@ -0,0 +1,320 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "rate-limiter.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+
+INIT_LOGGER ("RateLimiter");
+
+using namespace boost;
+using namespace boost::posix_time;
+
+static const double DEFAULT_BURST_INTERVAL = 0.5; // seconds worth of traffic
+static const double LIMIT_UNIT = 1024; // rates in SetLimit are in KiB/s
+
+TokenBucket::TokenBucket (double rate/* = 0*/, double burst/* = 0*/)
+  : m_rate (0)
+  , m_burst (0)
+  , m_tokens (0)
+{
+  SetRate (rate, burst);
+}
+
+void
+TokenBucket::SetRate (double rate, double burst/* = 0*/)
+{
+  if (rate == m_rate && (burst == m_burst || burst == 0))
+    return;
+
+  bool wasUnlimited = m_rate <= 0;
+
+  m_rate = rate;
+  m_burst = burst > 0 ? burst : rate * DEFAULT_BURST_INTERVAL;
+  m_tokens = wasUnlimited ? m_burst : std::min (m_tokens, m_burst);
+}
+
+void
+TokenBucket::refill (const ptime &now)
+{
+  if (!m_lastRefill.is_not_a_date_time () && now > m_lastRefill)
+    {
+      m_tokens += m_rate * (now - m_lastRefill).total_microseconds () / 1000000.0;
+      m_tokens = std::min (m_tokens, m_burst);
+    }
+  m_lastRefill = now;
+}
+
+void
+TokenBucket::Consume (size_t bytes, const ptime &now)
+{
+  if (m_rate <= 0)
+    return;
+
+  refill (now);
+  m_tokens -= bytes;
+}
+
+double
+TokenBucket::GetDelay (const ptime &now)
+{
+  if (m_rate <= 0)
+    return 0;
+
+  refill (now);
+  if (m_tokens >= 0)
+    return 0;
+
+  return -m_tokens / m_rate;
+}
+
+RateLimiter::RateLimiter ()
+  : m_globalRate (0)
+  , m_peerRate (0)
+{
+}
+
+void
+RateLimiter::SetGlobalRate (double rate)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_globalRate = rate;
+  applySchedule ();
+}
+
+void
+RateLimiter::SetPeerRate (double rate)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_peerRate = rate;
+
+  for (std::map<ndn::Name, TokenBucket>::iterator peer = m_peers.begin (); peer != m_peers.end (); peer++)
+    {
+      if (m_peerRates.find (peer->first) == m_peerRates.end ())
+        peer->second.SetRate (rate);
+    }
+}
+
+void
+RateLimiter::SetPeerRate (const ndn::Name &peer, double rate)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_peerRates [peer] = rate;
+
+  std::map<ndn::Name, TokenBucket>::iterator bucket = m_peers.find (peer);
+  if (bucket != m_peers.end ())
+    bucket->second.SetRate (rate);
+}
+
+void
+RateLimiter::AddSchedule (int startMinute, int endMinute, double rate)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  ScheduleEntry entry;
+  entry.m_startMinute = startMinute;
+  entry.m_endMinute = endMinute;
+  entry.m_rate = rate;
+  m_schedule.push_back (entry);
+
+  applySchedule ();
+}
+
+void
+RateLimiter::ClearSchedule ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_schedule.clear ();
+  applySchedule ();
+}
+
+void
+RateLimiter::Reset ()
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  m_globalRate = 0;
+  m_schedule.clear ();
+  applySchedule ();
+
+  m_peerRate = 0;
+  m_peerRates.clear ();
+  for (std::map<ndn::Name, TokenBucket>::iterator peer = m_peers.begin (); peer != m_peers.end (); peer++)
+    {
+      peer->second.SetRate (0);
+    }
+}
+
+// "HH:MM", 24:00 is accepted as the end of the day
+static bool
+parseMinute (const std::string &text, int &minute)
+{
+  size_t colon = text.find (':');
+  if (colon == std::string::npos)
+    return false;
+
+  try
+    {
+      int hours = lexical_cast<int> (text.substr (0, colon));
+      int minutes = lexical_cast<int> (text.substr (colon + 1));
+      if (hours < 0 || minutes < 0 || minutes >= 60 || hours * 60 + minutes > 24 * 60)
+        return false;
+
+      minute = hours * 60 + minutes;
+      return true;
+    }
+  catch (bad_lexical_cast &)
+    {
+      return false;
+    }
+}
+
+bool
+RateLimiter::SetLimit (const std::string &limit)
+{
+  size_t equals = limit.rfind ('=');
+  std::string target = (equals == std::string::npos) ? "" : limit.substr (0, equals);
+
+  double rate;
+  try
+    {
+      rate = lexical_cast<double> (equals == std::string::npos ? limit : limit.substr (equals + 1)) * LIMIT_UNIT;
+    }
+  catch (bad_lexical_cast &)
+    {
+      return false;
+    }
+  if (rate < 0)
+    return false;
+
+  if (equals == std::string::npos)
+    {
+      SetGlobalRate (rate);
+    }
+  else if (target == "*")
+    {
+      SetPeerRate (rate);
+    }
+  else if (!target.empty () && target[0] == '/')
+    {
+      SetPeerRate (ndn::Name (target), rate);
+    }
+  else
+    {
+      size_t dash = target.find ('-');
+      int startMinute, endMinute;
+      if (dash == std::string::npos ||
+          !parseMinute (target.substr (0, dash), startMinute) ||
+          !parseMinute (target.substr (dash + 1), endMinute))
+        return false;
+
+      AddSchedule (startMinute, endMinute, rate);
+    }
+
+  return true;
+}
+
+void
+RateLimiter::applySchedule ()
+{
+  double rate = m_globalRate;
+
+  if (!m_schedule.empty ())
+    {
+      int minute = second_clock::local_time ().time_of_day ().total_seconds () / 60;
+      for (std::vector<ScheduleEntry>::iterator entry = m_schedule.begin (); entry != m_schedule.end (); entry++)
+        {
+          bool inside = entry->m_startMinute <= entry->m_endMinute ?
+            (minute >= entry->m_startMinute && minute < entry->m_endMinute) :
+            (minute >= entry->m_startMinute || minute < entry->m_endMinute); // wraps around midnight
+
+          if (inside)
+            {
+              rate = entry->m_rate;
+              break;
+            }
+        }
+    }
+
+  if (rate != m_global.GetRate ())
+    {
+      _LOG_DEBUG ("Global rate limit: " << rate << " bytes/s");
+      m_global.SetRate (rate);
+    }
+}
+
+TokenBucket *
+RateLimiter::peerBucket (const ndn::Name &peer)
+{
+  if (peer.size () == 0)
+    return 0;
+
+  std::map<ndn::Name, TokenBucket>::iterator bucket = m_peers.find (peer);
+  if (bucket == m_peers.end ())
+    {
+      std::map<ndn::Name, double>::iterator rate = m_peerRates.find (peer);
+      bucket = m_peers.insert (std::make_pair (peer, TokenBucket (rate != m_peerRates.end () ? rate->second : m_peerRate))).first;
+    }
+
+  return &bucket->second;
+}
+
+double
+RateLimiter::Consume (const ndn::Name &peer, size_t bytes)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  ptime now = microsec_clock::universal_time ();
+  applySchedule ();
+
+  m_global.Consume (bytes, now);
+  double delay = m_global.GetDelay (now);
+
+  TokenBucket *bucket = peerBucket (peer);
+  if (bucket != 0)
+    {
+      bucket->Consume (bytes, now);
+      delay = std::max (delay, bucket->GetDelay (now));
+    }
+
+  return delay;
+}
+
+double
+RateLimiter::GetDelay (const ndn::Name &peer)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  ptime now = microsec_clock::universal_time ();
+  applySchedule ();
+
+  double delay = m_global.GetDelay (now);
+
+  TokenBucket *bucket = peerBucket (peer);
+  if (bucket != 0)
+    {
+      delay = std::max (delay, bucket->GetDelay (now));
+    }
+
+  return delay;
+}
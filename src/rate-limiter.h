@@ -0,0 +1,172 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <ndn-cxx/name.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Token bucket, rate and burst are in bytes
+ *
+ * Bucket is allowed to go into debt: bytes are always consumed and the caller is told how
+ * long to wait before sending more.
+ */
+class TokenBucket
+{
+public:
+  TokenBucket (double rate = 0, double burst = 0);
+
+  /**
+   * @brief Set rate (bytes/second), 0 means unlimited
+   */
+  void
+  SetRate (double rate, double burst = 0);
+
+  double
+  GetRate () const { return m_rate; }
+
+  void
+  Consume (size_t bytes, const boost::posix_time::ptime &now);
+
+  /**
+   * @brief Time (seconds) until the bucket is out of debt
+   */
+  double
+  GetDelay (const boost::posix_time::ptime &now);
+
+private:
+  void
+  refill (const boost::posix_time::ptime &now);
+
+private:
+  double m_rate;
+  double m_burst;
+  double m_tokens;
+  boost::posix_time::ptime m_lastRefill;
+};
+
+/**
+ * @brief Global and per-peer bandwidth limits, with optional time-of-day schedule for the global limit
+ *
+ * All limits are disabled (unlimited) by default.
+ */
+class RateLimiter
+{
+public:
+  RateLimiter ();
+
+  /**
+   * @brief Set global limit (bytes/second), 0 to disable
+   */
+  void
+  SetGlobalRate (double rate);
+
+  /**
+   * @brief Set default limit for every peer (bytes/second), 0 to disable
+   */
+  void
+  SetPeerRate (double rate);
+
+  /**
+   * @brief Set limit for the specific peer (bytes/second), overrides the default per-peer limit
+   */
+  void
+  SetPeerRate (const ndn::Name &peer, double rate);
+
+  /**
+   * @brief Use different global limit during [startMinute, endMinute) of the day (local time)
+   *
+   * Interval can wrap around midnight.  Outside scheduled intervals SetGlobalRate value is used
+   */
+  void
+  AddSchedule (int startMinute, int endMinute, double rate);
+
+  void
+  ClearSchedule ();
+
+  /**
+   * @brief Remove all limits (global, per-peer and schedule)
+   */
+  void
+  Reset ();
+
+  /**
+   * @brief Set limit given as text, rate is in KiB/s (0 to disable):
+   *
+   * - "<rate>" global limit
+   * - "HH:MM-HH:MM=<rate>" global limit during the interval of the day (see AddSchedule)
+   * - "*=<rate>" default limit for every peer
+   * - "/<peer>=<rate>" limit for the specific peer
+   *
+   * @returns false (and nothing is changed) if the text cannot be parsed
+   */
+  bool
+  SetLimit (const std::string &limit);
+
+  /**
+   * @brief Account bytes transferred from/to the peer (empty name if peer is not known)
+   * @returns time (seconds) to wait before transferring more
+   */
+  double
+  Consume (const ndn::Name &peer, size_t bytes);
+
+  /**
+   * @brief Time (seconds) to wait before transferring anything from/to the peer
+   */
+  double
+  GetDelay (const ndn::Name &peer);
+
+private:
+  void
+  applySchedule ();
+
+  TokenBucket *
+  peerBucket (const ndn::Name &peer);
+
+private:
+  struct ScheduleEntry
+  {
+    int m_startMinute;
+    int m_endMinute;
+    double m_rate;
+  };
+
+  TokenBucket m_global;
+  double m_globalRate;
+  std::vector<ScheduleEntry> m_schedule;
+
+  double m_peerRate;
+  std::map<ndn::Name, double> m_peerRates;
+  std::map<ndn::Name, TokenBucket> m_peers;
+
+  boost::mutex m_mutex;
+};
+
+typedef boost::shared_ptr<RateLimiter> RateLimiterPtr;
+
+#endif // RATE_LIMITER_H
@@ -0,0 +1,162 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "receive-window.h"
+
+#include <algorithm>
+
+ReceiveWindow::ReceiveWindow (int64_t base, uint32_t initialCapacity/* = 1024*/)
+  : m_base (base)
+  , m_capacity (64)
+  , m_outOfOrderCount (0)
+  , m_inFlightCount (0)
+{
+  while (m_capacity < initialCapacity)
+    m_capacity <<= 1;
+
+  m_received.resize (m_capacity / 64, 0);
+  m_inFlight.resize (m_capacity / 64, 0);
+}
+
+bool
+ReceiveWindow::IsReceived (int64_t seqno) const
+{
+  if (seqno < m_base)
+    return true;
+  if (seqno - m_base >= m_capacity)
+    return false;
+
+  return test (m_received, index (seqno));
+}
+
+bool
+ReceiveWindow::IsInFlight (int64_t seqno) const
+{
+  if (seqno < m_base || seqno - m_base >= m_capacity)
+    return false;
+
+  return test (m_inFlight, index (seqno));
+}
+
+void
+ReceiveWindow::SetInFlight (int64_t seqno, bool inFlight)
+{
+  if (seqno < m_base)
+    return;
+
+  ensureCapacity (seqno);
+
+  uint32_t i = index (seqno);
+  if (test (m_inFlight, i) == inFlight)
+    return;
+
+  if (inFlight)
+    {
+      set (m_inFlight, i);
+      m_inFlightCount ++;
+    }
+  else
+    {
+      clear (m_inFlight, i);
+      m_inFlightCount --;
+    }
+}
+
+bool
+ReceiveWindow::MarkReceived (int64_t seqno)
+{
+  if (seqno < m_base)
+    return false;
+
+  ensureCapacity (seqno);
+
+  uint32_t i = index (seqno);
+  if (test (m_received, i))
+    return false;
+
+  if (test (m_inFlight, i))
+    {
+      clear (m_inFlight, i);
+      m_inFlightCount --;
+    }
+
+  if (seqno != m_base)
+    {
+      set (m_received, i);
+      m_outOfOrderCount ++;
+      return true;
+    }
+
+  // advance base over all segments that were received out of order
+  m_base ++;
+  while (m_outOfOrderCount > 0)
+    {
+      uint32_t j = index (m_base);
+      if (!test (m_received, j))
+        break;
+
+      clear (m_received, j);
+      m_outOfOrderCount --;
+      m_base ++;
+    }
+
+  return true;
+}
+
+void
+ReceiveWindow::Reset (int64_t base)
+{
+  m_base = base;
+  m_outOfOrderCount = 0;
+  m_inFlightCount = 0;
+
+  std::fill (m_received.begin (), m_received.end (), 0);
+  std::fill (m_inFlight.begin (), m_inFlight.end (), 0);
+}
+
+void
+ReceiveWindow::ensureCapacity (int64_t seqno)
+{
+  if (seqno - m_base < m_capacity)
+    return;
+
+  uint32_t newCapacity = m_capacity;
+  while (seqno - m_base >= newCapacity)
+    newCapacity <<= 1;
+
+  std::vector<uint64_t> received (newCapacity / 64, 0);
+  std::vector<uint64_t> inFlight (newCapacity / 64, 0);
+
+  for (int64_t s = m_base; s < m_base + m_capacity; s++)
+    {
+      uint32_t from = index (s);
+      uint32_t to = static_cast<uint32_t> (s) & (newCapacity - 1);
+
+      if (test (m_received, from))
+        set (received, to);
+      if (test (m_inFlight, from))
+        set (inFlight, to);
+    }
+
+  m_received.swap (received);
+  m_inFlight.swap (inFlight);
+  m_capacity = newCapacity;
+}
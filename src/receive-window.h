@@ -0,0 +1,107 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef RECEIVE_WINDOW_H
+#define RECEIVE_WINDOW_H
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Bookkeeping of received and in-flight segments of a fetch
+ *
+ * Segments are tracked in two ring-buffer bitmaps, starting from the first segment that
+ * has not yet been received in order (base).  Marking a segment and advancing the base are O(1)
+ * (amortized), no allocation happens unless window needs to grow beyond its current capacity.
+ */
+class ReceiveWindow
+{
+public:
+  ReceiveWindow (int64_t base, uint32_t initialCapacity = 1024);
+
+  /**
+   * @brief First segment that has not yet been received in order
+   */
+  int64_t
+  GetBase () const { return m_base; }
+
+  /**
+   * @brief Number of segments received above the base (out of order)
+   */
+  uint32_t
+  GetOutOfOrderCount () const { return m_outOfOrderCount; }
+
+  uint32_t
+  GetInFlightCount () const { return m_inFlightCount; }
+
+  bool
+  IsReceived (int64_t seqno) const;
+
+  bool
+  IsInFlight (int64_t seqno) const;
+
+  /**
+   * @brief Mark segment as requested (or clear the mark)
+   */
+  void
+  SetInFlight (int64_t seqno, bool inFlight);
+
+  /**
+   * @brief Mark segment as received (it is no longer in flight) and advance base if possible
+   * @returns false if segment was already received before
+   */
+  bool
+  MarkReceived (int64_t seqno);
+
+  /**
+   * @brief Reset the window, all segments below base are considered received
+   */
+  void
+  Reset (int64_t base);
+
+private:
+  inline uint32_t
+  index (int64_t seqno) const { return static_cast<uint32_t> (seqno) & (m_capacity - 1); }
+
+  static inline bool
+  test (const std::vector<uint64_t> &bits, uint32_t i) { return (bits[i >> 6] >> (i & 63)) & 1; }
+
+  static inline void
+  set (std::vector<uint64_t> &bits, uint32_t i) { bits[i >> 6] |= (uint64_t (1) << (i & 63)); }
+
+  static inline void
+  clear (std::vector<uint64_t> &bits, uint32_t i) { bits[i >> 6] &= ~(uint64_t (1) << (i & 63)); }
+
+  void
+  ensureCapacity (int64_t seqno);
+
+private:
+  int64_t m_base;
+  uint32_t m_capacity; // always power of 2, at least 64
+
+  std::vector<uint64_t> m_received;
+  std::vector<uint64_t> m_inFlight;
+
+  uint32_t m_outOfOrderCount;
+  uint32_t m_inFlightCount;
+};
+
+#endif // RECEIVE_WINDOW_H
@@ -0,0 +1,123 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "rtt-estimator.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+INIT_LOGGER ("RttEstimator");
+
+// RFC 6298
+static const double ALPHA = 1.0 / 8;
+static const double BETA = 1.0 / 4;
+static const double K = 4;
+static const double CLOCK_GRANULARITY = 0.001; // seconds
+
+RttEstimator::RttEstimator (double initialRto/* = 1.0*/, double minRto/* = 0.2*/, double maxRto/* = 10.0*/)
+  : m_srtt (0)
+  , m_rttvar (0)
+  , m_rto (initialRto)
+  , m_minRtt (0)
+  , m_minRto (minRto)
+  , m_maxRto (maxRto)
+  , m_hasMeasurement (false)
+  , m_lastBackoff (boost::posix_time::neg_infin)
+{
+}
+
+void
+RttEstimator::AddMeasurement (double rtt)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  if (!m_hasMeasurement)
+    {
+      m_srtt = rtt;
+      m_rttvar = rtt / 2;
+      m_minRtt = rtt;
+      m_hasMeasurement = true;
+    }
+  else
+    {
+      m_rttvar = (1 - BETA) * m_rttvar + BETA * std::fabs (m_srtt - rtt);
+      m_srtt = (1 - ALPHA) * m_srtt + ALPHA * rtt;
+      m_minRtt = std::min (m_minRtt, rtt);
+    }
+
+  // valid sample also cancels any backoff
+  m_rto = m_srtt + std::max (CLOCK_GRANULARITY, K * m_rttvar);
+  m_rto = std::min (std::max (m_rto, m_minRto), m_maxRto);
+
+  _LOG_TRACE ("RTT sample: " << rtt << ", SRTT: " << m_srtt << ", RTTVAR: " << m_rttvar << ", RTO: " << m_rto);
+}
+
+void
+RttEstimator::BackoffRto (const boost::posix_time::ptime &sendTime/* = pos_infin*/)
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+
+  if (sendTime <= m_lastBackoff)
+    {
+      // already backed off for this loss event
+      return;
+    }
+
+  m_rto = std::min (m_rto * 2, m_maxRto);
+  m_lastBackoff = boost::posix_time::microsec_clock::universal_time ();
+}
+
+double
+RttEstimator::GetRto () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_rto;
+}
+
+double
+RttEstimator::GetSmoothedRtt () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_srtt;
+}
+
+double
+RttEstimator::GetRttVariation () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_rttvar;
+}
+
+double
+RttEstimator::GetMinRtt () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_minRtt;
+}
+
+bool
+RttEstimator::HasMeasurement () const
+{
+  boost::mutex::scoped_lock lock (m_mutex);
+  return m_hasMeasurement;
+}
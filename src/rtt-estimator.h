@@ -0,0 +1,95 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+/**
+ * @brief Round-trip time estimator (Jacobson/Karels), shared by all fetchers to the same peer
+ *
+ * Only samples from Interests that were not retransmitted should be fed to the estimator (Karn's algorithm).
+ * Each loss event doubles RTO until the next valid sample arrives.
+ */
+class RttEstimator
+{
+public:
+  RttEstimator (double initialRto = 1.0, double minRto = 0.2, double maxRto = 10.0);
+
+  /**
+   * @brief Add new RTT sample (in seconds)
+   */
+  void
+  AddMeasurement (double rtt);
+
+  /**
+   * @brief Exponential backoff of RTO, to be called on every Interest timeout
+   *
+   * RTO is doubled at most once per loss event: timeouts of Interests sent before the last
+   * backoff are attributed to the same event (the same way as in CongestionWindow::OnTimeout).
+   *
+   * @param sendTime when the timed out Interest was sent (by default, timeout is always a new event)
+   */
+  void
+  BackoffRto (const boost::posix_time::ptime &sendTime = boost::posix_time::pos_infin);
+
+  /**
+   * @brief Current retransmission timeout (in seconds), to be used as Interest lifetime
+   */
+  double
+  GetRto () const;
+
+  double
+  GetSmoothedRtt () const;
+
+  double
+  GetRttVariation () const;
+
+  /**
+   * @brief Minimum RTT sample so far (base delay of the path), 0 if there were no samples
+   */
+  double
+  GetMinRtt () const;
+
+  bool
+  HasMeasurement () const;
+
+private:
+  double m_srtt;
+  double m_rttvar;
+  double m_rto;
+  double m_minRtt;
+
+  double m_minRto;
+  double m_maxRto;
+
+  bool m_hasMeasurement;
+  boost::posix_time::ptime m_lastBackoff;
+
+  mutable boost::mutex m_mutex;
+};
+
+typedef boost::shared_ptr<RttEstimator> RttEstimatorPtr;
+
+#endif // RTT_ESTIMATOR_H
@@ -157,9 +157,10 @@ StateServer::formatActionJson (json_spirit::Array &actions,
   json.push_back (Pair ("timestamp", to_iso_extended_string (from_time_t (action.timestamp ()))));
   json.push_back (Pair ("filename",  action.filename ()));
   json.push_back (Pair ("version",  action.version ()));
-  json.push_back (Pair ("action", (action.action () == 0) ? "UPDATE" : "DELETE"));
+  json.push_back (Pair ("action", (action.action () == ActionItem::DELETE) ? "DELETE" :
+                                  action.has_moved_from () ? "MOVE" : "UPDATE"));
 
-  if (action.action () == 0)
+  if (action.action () != ActionItem::DELETE)
     {
       Object update;
       update.push_back (Pair ("hash", boost::lexical_cast<string> (Hash (action.file_hash ().c_str (), action.file_hash ().size ()))));
@@ -170,6 +171,10 @@ StateServer::formatActionJson (json_spirit::Array &actions,
       update.push_back (Pair ("chmod", chmod.str ()));
 
       update.push_back (Pair ("segNum", action.seg_num ()));
+      if (action.has_moved_from ())
+        {
+          update.push_back (Pair ("movedFrom", action.moved_from ()));
+        }
       json.push_back (Pair ("update", update));
     }
 
@@ -477,7 +482,8 @@ StateServer::cmd_restore_file_Execute (const ndn::Name &interest)
 		return;
 	}
 
-	Hash hash = Hash (file->file_hash ().c_str (), file->file_hash ().size ());
+	Hash hash = Hash (file->file_hash ().c_str (), file->file_hash ().size (),
+	                  static_cast<Digest::Algorithm> (file->file_hash_algorithm ()));
 
 	///////////////////
 	// now the magic //
@@ -493,7 +499,8 @@ StateServer::cmd_restore_file_Execute (const ndn::Name &interest)
 #if BOOST_VERSION >= 104900
 				filesystem::status (filePath).permissions () == static_cast<filesystem::perms> (file->mode ()) &&
 #endif
-				*Hash::FromFileContent (filePath) == hash)
+				Digest::IsSupported (hash.GetAlgorithm ()) &&
+				*Hash::FromFileContent (filePath, hash.GetAlgorithm ()) == hash)
 		{
 			ndn::Data data;
 			data.setName(interest);
@@ -281,15 +281,7 @@ SyncCore::handleRecoverData(const ndn::Interest &interest, ndn::Data &data)
   _LOG_DEBUG ("[" << m_log->GetLocalName () << "] <<<<< RECOVER DATA with name: " << data.getName ());
   //cout << "handle recover data" << end;
 
-  const ndn::Block &content = data.getContent ();
-  if (content.value () && content.size () > 0)
-    {
-      handleStateData(ndn::Buffer(content.value (), content.value_size ()));
-    }
-  else
-    {
-      _LOG_ERROR ("Got recovery DATA with empty content");
-    }
+  handleSyncOrRecoverData(data);
 
   // sendSyncInterest();
   m_scheduler->deleteTask (SYNC_INTEREST_TAG2);
@@ -303,16 +295,8 @@ SyncCore::handleSyncData(const ndn::Interest &interest, ndn::Data &data)
 {
   _LOG_DEBUG ("[" << m_log->GetLocalName () << "] <<<<< SYNC DATA with name: " << data.getName ());
 
-  const ndn::Block &content = data.getContent ();
   // suppress recover in interest - data out of order case
-  if (data.getContent ().value () && content.size () > 0)
-    {
-      handleStateData(ndn::Buffer(content.value (), content.value_size ()));
-    }
-  else
-    {
-      _LOG_ERROR ("Got sync DATA with empty content");
-    }
+  handleSyncOrRecoverData(data);
 
   // resume outstanding sync interest
   // sendSyncInterest();
@@ -323,6 +307,49 @@ SyncCore::handleSyncData(const ndn::Interest &interest, ndn::Data &data)
                                   SYNC_INTEREST_TAG2);
 }
 
+void
+SyncCore::handleSyncOrRecoverData(const ndn::Data &data)
+{
+  if (m_verificationService)
+    {
+      // state is applied when the signature is verified, receiving thread is not blocked
+      m_verificationService->Verify (boost::make_shared<ndn::Data> (data),
+                                     bind (&SyncCore::handleVerifiedData, this, _1, _2));
+    }
+  else
+    {
+      applyStateData(data);
+    }
+}
+
+void
+SyncCore::handleVerifiedData(boost::shared_ptr<ndn::Data> data, bool verified)
+{
+  if (verified)
+    {
+      applyStateData(*data);
+    }
+  else
+    {
+      _LOG_ERROR ("Ignoring state from DATA that failed verification: " << data->getName ());
+    }
+}
+
+void
+SyncCore::applyStateData(const ndn::Data &data)
+{
+  const ndn::Block &content = data.getContent ();
+  if (content.value () && content.size () > 0)
+    {
+      boost::unique_lock<boost::mutex> lock (m_stateDataMutex);
+      handleStateData(ndn::Buffer(content.value (), content.value_size ()));
+    }
+  else
+    {
+      _LOG_ERROR ("Got sync or recovery DATA with empty content: " << data.getName ());
+    }
+}
+
 void
 SyncCore::handleStateData(const ndn::Buffer &content)
 {
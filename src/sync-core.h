@@ -25,8 +25,10 @@
 #include "sync-log.h"
 #include "scheduler.h"
 #include "task.h"
+#include "verification-service.h"
 
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 #include <ndn-cxx/face.hpp>
 
 class SyncCore
@@ -63,6 +65,14 @@ public:
   void
   updateLocalState (sqlite3_int64);
 
+  /**
+   * @brief Verify signatures of the sync and recovery data before the state is applied
+   *
+   * State from the data that fails verification is ignored
+   */
+  void
+  SetVerificationService (VerificationServicePtr service) { m_verificationService = service; }
+
 // ------------------ only used in test -------------------------
 public:
   HashPtr
@@ -103,6 +113,15 @@ private:
   void
   handleRecoverInterest(const ndn::Name &name);
 
+  void
+  handleSyncOrRecoverData(const ndn::Data &data);
+
+  void
+  handleVerifiedData(boost::shared_ptr<ndn::Data> data, bool verified);
+
+  void
+  applyStateData(const ndn::Data &data);
+
   void
   handleStateData(const ndn::Buffer &content);
 
@@ -124,6 +143,9 @@ private:
   TaskPtr m_sendSyncInterestTask;
 
   long m_syncInterestInterval;
+
+  VerificationServicePtr m_verificationService;
+  boost::mutex m_stateDataMutex; // verified data is applied from the worker threads of the service
 };
 
 #endif // SYNC_CORE_H
@@ -0,0 +1,412 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "verification-service.h"
+#include "db-helper.h"
+#include "digest.h"
+#include "logging.h"
+
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <cstring>
+
+INIT_LOGGER ("VerificationService");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+const string INIT_DATABASE = "\
+CREATE TABLE IF NOT EXISTS                                      \n\
+  Certificate(                                                  \n\
+    key_name    BLOB NOT NULL PRIMARY KEY,                      \n\
+    public_key  BLOB NOT NULL, /* DER SubjectPublicKeyInfo */   \n\
+    not_after   INTEGER                                         \n\
+  );                                                            \n\
+";
+
+struct VerificationService::Key
+{
+  boost::shared_ptr<EVP_PKEY> m_key;
+  time_t m_notAfter;
+};
+
+static boost::shared_ptr<EVP_PKEY>
+decodePublicKey (const ndn::Buffer &publicKey)
+{
+  const unsigned char *der = publicKey.buf ();
+  EVP_PKEY *key = d2i_PUBKEY (NULL, &der, publicKey.size ());
+  if (key == NULL)
+    {
+      return boost::shared_ptr<EVP_PKEY> ();
+    }
+  return boost::shared_ptr<EVP_PKEY> (key, EVP_PKEY_free);
+}
+
+static bool
+verifyWithKey (EVP_PKEY *key, const uint8_t *data, size_t size, const uint8_t *signature, size_t signatureSize)
+{
+  EVP_MD_CTX *context = EVP_MD_CTX_create ();
+  bool retval =
+    EVP_DigestVerifyInit (context, NULL, EVP_sha256 (), NULL, key) == 1 &&
+    EVP_DigestVerifyUpdate (context, data, size) == 1 &&
+    EVP_DigestVerifyFinal (context, const_cast<uint8_t*> (signature), signatureSize) == 1;
+  EVP_MD_CTX_destroy (context);
+
+  return retval;
+}
+
+VerificationService::VerificationService (const fs::path &folder, int poolSize/* = 2*/,
+                                          size_t batchSize/* = DEFAULT_BATCH_SIZE*/)
+  : m_verified (0)
+  , m_failed (0)
+  , m_poolSize (poolSize)
+  , m_batchSize (std::max<size_t> (batchSize, 1))
+  , m_activeWorkers (0)
+  , m_stopped (false)
+  , m_executor (new Executor (poolSize))
+{
+  fs::path chronoshareDirectory = folder / ".chronoshare";
+  fs::create_directories (chronoshareDirectory);
+
+  int res = sqlite3_open ((chronoshareDirectory / "certificates").c_str (), &m_db);
+  if (res != SQLITE_OK)
+    {
+      BOOST_THROW_EXCEPTION (Error::Db ()
+                             << errmsg_info_str ("Cannot open database: " + (chronoshareDirectory / "certificates").string ()));
+    }
+
+  char *errmsg = 0;
+  res = sqlite3_exec (m_db, INIT_DATABASE.c_str (), NULL, NULL, &errmsg);
+  if (res != SQLITE_OK && errmsg != 0)
+    {
+      // _LOG_TRACE ("Init \"error\": " << errmsg);
+      sqlite3_free (errmsg);
+    }
+
+  time_t now = std::time (NULL);
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db, "DELETE FROM Certificate WHERE not_after<=?", -1, &stmt, 0);
+  sqlite3_bind_int64 (stmt, 1, now);
+  sqlite3_step (stmt);
+  sqlite3_finalize (stmt);
+
+  sqlite3_prepare_v2 (m_db, "SELECT key_name, public_key, not_after FROM Certificate", -1, &stmt, 0);
+  while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      string keyName (reinterpret_cast<const char*> (sqlite3_column_blob (stmt, 0)), sqlite3_column_bytes (stmt, 0));
+      ndn::Buffer publicKey (sqlite3_column_blob (stmt, 1), sqlite3_column_bytes (stmt, 1));
+
+      KeyPtr key = boost::make_shared<Key> ();
+      key->m_key = decodePublicKey (publicKey);
+      key->m_notAfter = sqlite3_column_int64 (stmt, 2);
+      if (key->m_key)
+        {
+          m_keys [keyName] = key;
+        }
+    }
+  sqlite3_finalize (stmt);
+
+  _LOG_DEBUG ("Loaded " << m_keys.size () << " certificates");
+
+  m_executor->start ();
+}
+
+VerificationService::~VerificationService ()
+{
+  Shutdown ();
+
+  sqlite3_close (m_db);
+}
+
+void
+VerificationService::Shutdown ()
+{
+  {
+    boost::unique_lock<boost::mutex> lock (m_pendingMutex);
+    m_stopped = true;
+  }
+  m_executor->shutdown ();
+}
+
+void
+VerificationService::Verify (boost::shared_ptr<ndn::Data> data, const Callback &callback)
+{
+  boost::unique_lock<boost::mutex> lock (m_pendingMutex);
+  if (m_stopped)
+    {
+      return; // dropped, the same as packets queued before Shutdown
+    }
+
+  Request request;
+  request.m_data = data;
+  request.m_callback = callback;
+  m_pending.push_back (request);
+
+  if (m_activeWorkers < m_poolSize)
+    {
+      m_activeWorkers ++;
+      m_executor->execute (bind (&VerificationService::processBatches, this));
+    }
+}
+
+void
+VerificationService::processBatches ()
+{
+  while (true)
+    {
+      std::vector<Request> batch;
+      {
+        boost::unique_lock<boost::mutex> lock (m_pendingMutex);
+        if (m_pending.empty () || m_stopped)
+          {
+            m_activeWorkers --;
+            return;
+          }
+
+        // packets that arrived while all workers were busy are taken together
+        size_t size = std::min (m_pending.size (), m_batchSize);
+        batch.assign (m_pending.begin (), m_pending.begin () + size);
+        m_pending.erase (m_pending.begin (), m_pending.begin () + size);
+      }
+
+      _LOG_TRACE ("Verify batch of " << batch.size () << " packets");
+      for (std::vector<Request>::iterator request = batch.begin (); request != batch.end (); request++)
+        {
+          bool verified = VerifyNow (*request->m_data);
+          if (!request->m_callback.empty ())
+            {
+              request->m_callback (request->m_data, verified);
+            }
+        }
+    }
+}
+
+bool
+VerificationService::VerifyNow (const ndn::Data &data)
+{
+  bool verified = verifyData (data);
+
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  if (verified)
+    {
+      m_verified ++;
+    }
+  else
+    {
+      _LOG_ERROR ("Cannot verify signature of " << data.getName ());
+      m_failed ++;
+    }
+  return verified;
+}
+
+bool
+VerificationService::verifyData (const ndn::Data &data)
+{
+  try
+    {
+      const ndn::Signature &signature = data.getSignature ();
+      const ndn::Block &wire = data.wireEncode ();
+      const ndn::Block &signatureValue = signature.getValue ();
+      if (wire.value_size () < signatureValue.size ())
+        return false;
+
+      // everything inside Data except SignatureValue is signed
+      const uint8_t *signedPortion = wire.value ();
+      size_t signedSize = wire.value_size () - signatureValue.size ();
+
+      switch (signature.getType ())
+        {
+        case ndn::tlv::DigestSha256:
+          {
+            Digest digest (Digest::SHA256);
+            digest.Update (signedPortion, signedSize);
+
+            unsigned char result[Digest::MAX_SIZE];
+            unsigned int length = digest.Final (result);
+            return signatureValue.value_size () == length &&
+              memcmp (signatureValue.value (), result, length) == 0;
+          }
+        case ndn::tlv::SignatureSha256WithRsa:
+        case ndn::tlv::SignatureSha256WithEcdsa:
+          {
+            if (!signature.hasKeyLocator () ||
+                signature.getKeyLocator ().getType () != ndn::KeyLocator::KeyLocator_Name)
+              return false;
+
+            KeyPtr key = lookupKey (signature.getKeyLocator ().getName ());
+            if (!key)
+              {
+                _LOG_DEBUG ("No valid certificate for " << signature.getKeyLocator ().getName ());
+                return false;
+              }
+
+            return verifyWithKey (key->m_key.get (), signedPortion, signedSize,
+                                  signatureValue.value (), signatureValue.value_size ());
+          }
+        default:
+          return false;
+        }
+    }
+  catch (ndn::tlv::Error &error)
+    {
+      // e.g., packet is not signed at all
+      _LOG_DEBUG ("Malformed data packet: " << error.what ());
+      return false;
+    }
+}
+
+VerificationService::KeyPtr
+VerificationService::lookupKey (const ndn::Name &keyName)
+{
+  const ndn::Block &wire = keyName.wireEncode ();
+  string id (reinterpret_cast<const char*> (wire.wire ()), wire.size ());
+  time_t now = std::time (NULL);
+
+  KeyFetcher keyFetcher;
+  {
+    boost::unique_lock<boost::mutex> lock (m_mutex);
+    std::map<string, KeyPtr>::iterator key = m_keys.find (id);
+    if (key != m_keys.end ())
+      {
+        if (key->second->m_notAfter > now)
+          return key->second;
+
+        _LOG_DEBUG ("Certificate of " << keyName << " has expired");
+        m_keys.erase (key);
+
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2 (m_db, "DELETE FROM Certificate WHERE key_name=?", -1, &stmt, 0);
+        sqlite3_bind_blob (stmt, 1, wire.wire (), wire.size (), SQLITE_STATIC);
+        sqlite3_step (stmt);
+        sqlite3_finalize (stmt);
+      }
+    keyFetcher = m_keyFetcher;
+  }
+
+  // certificate is fetched without holding the lock, other packets are verified meanwhile
+  ndn::Buffer publicKey;
+  time_t notAfter = 0;
+  if (keyFetcher.empty () || !keyFetcher (keyName, publicKey, notAfter) || notAfter <= now)
+    {
+      return KeyPtr ();
+    }
+
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  return addKey (keyName, publicKey, notAfter);
+}
+
+void
+VerificationService::SetKeyFetcher (const KeyFetcher &keyFetcher)
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  m_keyFetcher = keyFetcher;
+}
+
+bool
+VerificationService::AddCertificate (const ndn::Name &keyName, const ndn::Buffer &publicKey, time_t notAfter)
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  return static_cast<bool> (addKey (keyName, publicKey, notAfter));
+}
+
+VerificationService::KeyPtr
+VerificationService::addKey (const ndn::Name &keyName, const ndn::Buffer &publicKey, time_t notAfter)
+{
+  KeyPtr key = boost::make_shared<Key> ();
+  key->m_key = decodePublicKey (publicKey);
+  key->m_notAfter = notAfter;
+  if (!key->m_key)
+    {
+      _LOG_ERROR ("Cannot decode public key of " << keyName);
+      return KeyPtr ();
+    }
+
+  const ndn::Block &wire = keyName.wireEncode ();
+  m_keys [string (reinterpret_cast<const char*> (wire.wire ()), wire.size ())] = key;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (m_db, "INSERT OR REPLACE INTO Certificate (key_name, public_key, not_after) VALUES (?, ?, ?)", -1, &stmt, 0);
+  sqlite3_bind_blob (stmt, 1, wire.wire (), wire.size (), SQLITE_STATIC);
+  sqlite3_bind_blob (stmt, 2, publicKey.buf (), publicKey.size (), SQLITE_STATIC);
+  sqlite3_bind_int64 (stmt, 3, notAfter);
+  if (sqlite3_step (stmt) != SQLITE_DONE)
+    {
+      _LOG_ERROR ("Cannot save certificate: " << sqlite3_errmsg (m_db));
+    }
+  sqlite3_finalize (stmt);
+
+  return key;
+}
+
+bool
+VerificationService::HasCertificate (const ndn::Name &keyName)
+{
+  const ndn::Block &wire = keyName.wireEncode ();
+  string id (reinterpret_cast<const char*> (wire.wire ()), wire.size ());
+
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  std::map<string, KeyPtr>::iterator key = m_keys.find (id);
+  return key != m_keys.end () && key->second->m_notAfter > std::time (NULL);
+}
+
+size_t
+VerificationService::GetCertificateCount ()
+{
+  time_t now = std::time (NULL);
+
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  size_t count = 0;
+  for (std::map<string, KeyPtr>::iterator key = m_keys.begin (); key != m_keys.end (); key++)
+    {
+      if (key->second->m_notAfter > now)
+        count ++;
+    }
+  return count;
+}
+
+uint64_t
+VerificationService::GetVerifiedCount ()
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  return m_verified;
+}
+
+uint64_t
+VerificationService::GetFailedCount ()
+{
+  boost::unique_lock<boost::mutex> lock (m_mutex);
+  return m_failed;
+}
+
+bool
+VerificationService::VerifySignature (const ndn::Buffer &publicKey, const uint8_t *data, size_t size,
+                                      const uint8_t *signature, size_t signatureSize)
+{
+  boost::shared_ptr<EVP_PKEY> key = decodePublicKey (publicKey);
+  if (!key)
+    return false;
+
+  return verifyWithKey (key.get (), data, size, signature, signatureSize);
+}
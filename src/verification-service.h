@@ -0,0 +1,168 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012-2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#ifndef VERIFICATION_SERVICE_H
+#define VERIFICATION_SERVICE_H
+
+#include "executor.h"
+
+#include <sqlite3.h>
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ndn-cxx/data.hpp>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Signature verification of the received data packets on a pool of worker threads
+ *
+ * Packets are queued and the thread that receives data is never blocked by the public key
+ * operations.  Each worker takes up to batchSize queued packets at a time, so packets are
+ * verified one by one when the rate is low and in batches when the pool is busy.
+ *
+ * Public keys of the validated certificates are kept in <folder>/.chronoshare/certificates
+ * until they expire, so they don't need to be fetched and validated again after restart.
+ */
+class VerificationService
+{
+public:
+  /**
+   * @brief Result of the verification, called from one of the worker threads
+   */
+  typedef boost::function<void (boost::shared_ptr<ndn::Data> data, bool verified)> Callback;
+
+  /**
+   * @brief Fetch and validate certificate of the key that is not in the cache (called from a worker thread)
+   * @param keyName name from the KeyLocator of the data packet
+   * @param publicKey DER encoding of the public key (SubjectPublicKeyInfo)
+   * @param notAfter end of the certificate validity period
+   * @returns false if the certificate cannot be fetched or is not valid
+   */
+  typedef boost::function<bool (const ndn::Name &keyName, ndn::Buffer &publicKey, time_t &notAfter)> KeyFetcher;
+
+  static const size_t DEFAULT_BATCH_SIZE = 32;
+
+  VerificationService (const boost::filesystem::path &folder, int poolSize = 2, size_t batchSize = DEFAULT_BATCH_SIZE);
+
+  ~VerificationService ();
+
+  /**
+   * @brief Stop the worker pool, packets that are still queued are dropped (callbacks are not called)
+   *
+   * When the call returns, no callback is running or will be called
+   */
+  void
+  Shutdown ();
+
+  /**
+   * @brief Queue the packet for verification
+   */
+  void
+  Verify (boost::shared_ptr<ndn::Data> data, const Callback &callback);
+
+  /**
+   * @brief Verify the packet in the calling thread (counters are updated)
+   */
+  bool
+  VerifyNow (const ndn::Data &data);
+
+  void
+  SetKeyFetcher (const KeyFetcher &keyFetcher);
+
+  /**
+   * @brief Add public key of the validated certificate (replaces existing key with the same name)
+   * @returns false if the public key cannot be decoded
+   */
+  bool
+  AddCertificate (const ndn::Name &keyName, const ndn::Buffer &publicKey, time_t notAfter);
+
+  bool
+  HasCertificate (const ndn::Name &keyName);
+
+  /**
+   * @brief Number of cached (not expired) certificates
+   */
+  size_t
+  GetCertificateCount ();
+
+  uint64_t
+  GetVerifiedCount ();
+
+  uint64_t
+  GetFailedCount ();
+
+  /**
+   * @brief Check SHA-256 with RSA or ECDSA signature
+   * @param publicKey DER encoding of the public key (SubjectPublicKeyInfo)
+   */
+  static bool
+  VerifySignature (const ndn::Buffer &publicKey, const uint8_t *data, size_t size,
+                   const uint8_t *signature, size_t signatureSize);
+
+private:
+  struct Key;
+  typedef boost::shared_ptr<Key> KeyPtr;
+
+  struct Request
+  {
+    boost::shared_ptr<ndn::Data> m_data;
+    Callback m_callback;
+  };
+
+  void
+  processBatches ();
+
+  bool
+  verifyData (const ndn::Data &data);
+
+  KeyPtr
+  lookupKey (const ndn::Name &keyName);
+
+  KeyPtr
+  addKey (const ndn::Name &keyName, const ndn::Buffer &publicKey, time_t notAfter); // m_mutex must be locked
+
+
+private:
+  sqlite3 *m_db;
+  std::map<std::string, KeyPtr> m_keys; // wire encoding of the key name -> key
+  KeyFetcher m_keyFetcher;
+  uint64_t m_verified;
+  uint64_t m_failed;
+  boost::mutex m_mutex; // m_db, m_keys, m_keyFetcher and counters
+
+  int m_poolSize;
+  size_t m_batchSize;
+  std::deque<Request> m_pending;
+  int m_activeWorkers;
+  bool m_stopped;
+  boost::mutex m_pendingMutex;
+
+  ExecutorPtr m_executor;
+};
+
+typedef boost::shared_ptr<VerificationService> VerificationServicePtr;
+
+#endif // VERIFICATION_SERVICE_H
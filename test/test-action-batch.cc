@@ -0,0 +1,165 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "batch-timer.h"
+#include "action-log.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+INIT_LOGGER ("Test.ActionBatch");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestActionBatch)
+
+static void
+count (int &counter)
+{
+  counter ++;
+}
+
+static void
+countAndRearm (int &counter, BatchTimer *&timer)
+{
+  counter ++;
+  if (counter < 3)
+    {
+      // armed again while the task of this callback is still registered in the scheduler
+      BOOST_CHECK (timer->Arm (0.01));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (TimerCoalescesArms)
+{
+  SchedulerPtr scheduler (new Scheduler ());
+  scheduler->start ();
+
+  int counter = 0;
+  BatchTimer timer (scheduler, "test-batch", bind (count, boost::ref (counter)));
+
+  BOOST_CHECK (timer.Arm (0.05));
+  for (int i = 0; i < 10; i++)
+    {
+      BOOST_CHECK (!timer.Arm (0.05));
+    }
+  BOOST_CHECK (timer.IsArmed ());
+
+  this_thread::sleep (posix_time::milliseconds (300));
+  BOOST_CHECK_EQUAL (counter, 1);
+  BOOST_CHECK (!timer.IsArmed ());
+
+  // next batch
+  BOOST_CHECK (timer.Arm (0.01));
+  this_thread::sleep (posix_time::milliseconds (200));
+  BOOST_CHECK_EQUAL (counter, 2);
+
+  BOOST_CHECK (timer.Arm (0.05));
+  timer.Cancel ();
+  BOOST_CHECK (!timer.IsArmed ());
+  this_thread::sleep (posix_time::milliseconds (200));
+  BOOST_CHECK_EQUAL (counter, 2);
+
+  scheduler->shutdown ();
+}
+
+BOOST_AUTO_TEST_CASE (TimerRearmedFromCallback)
+{
+  SchedulerPtr scheduler (new Scheduler ());
+  scheduler->start ();
+
+  int counter = 0;
+  BatchTimer *timerPtr = 0;
+  BatchTimer timer (scheduler, "test-batch", bind (countAndRearm, boost::ref (counter), boost::ref (timerPtr)));
+  timerPtr = &timer;
+
+  timer.Arm (0.01);
+  this_thread::sleep (posix_time::milliseconds (500));
+  BOOST_CHECK_EQUAL (counter, 3);
+
+  scheduler->shutdown ();
+}
+
+static boost::shared_ptr<ndn::Data>
+actionData (const string &filename, uint64_t version)
+{
+  ActionItem item;
+  item.set_action (ActionItem::UPDATE);
+  item.set_filename (filename);
+  item.set_version (version);
+  item.set_timestamp (time (NULL));
+  item.set_seg_num (1);
+  item.set_file_hash (string (32, 'h'));
+  item.set_mtime (time (NULL));
+  item.set_mode (0644);
+
+  string content;
+  item.SerializeToString (&content);
+
+  boost::shared_ptr<ndn::Data> data = boost::make_shared<ndn::Data> ();
+  data->setContent (reinterpret_cast<const uint8_t*> (content.c_str ()), content.size ());
+  return data;
+}
+
+BOOST_AUTO_TEST_CASE (RemoteActionsInOneBatch)
+{
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+
+  ndn::Name localName ("/alex");
+  ndn::Name remoteName ("/zhenkai");
+  SyncLogPtr syncLog = boost::make_shared<SyncLog> (tmpdir, localName);
+  ActionLogPtr actionLog = boost::make_shared<ActionLog> (boost::shared_ptr<ndn::Face> (), tmpdir, syncLog,
+                                                           "top-secret", "test-chronoshare",
+                                                           ActionLog::OnFileAddedOrChangedCallback (),
+                                                           ActionLog::OnFileRemovedCallback ());
+
+  ActionLog::RemoteActions actions;
+  actions.push_back (ActionLog::RemoteAction (remoteName, 1, actionData ("a.txt", 0)));
+
+  string garbage = "not an action";
+  boost::shared_ptr<ndn::Data> broken = boost::make_shared<ndn::Data> ();
+  broken->setContent (reinterpret_cast<const uint8_t*> (garbage.c_str ()), garbage.size ());
+  actions.push_back (ActionLog::RemoteAction (remoteName, 2, broken));
+
+  actions.push_back (ActionLog::RemoteAction (remoteName, 3, actionData ("b.txt", 0)));
+
+  ActionLog::ActionItems items = actionLog->AddRemoteActions (actions);
+  BOOST_REQUIRE_EQUAL (items.size (), 3);
+  BOOST_CHECK (items[0]);
+  BOOST_CHECK (!items[1]);
+  BOOST_CHECK (items[2]);
+
+  BOOST_CHECK_EQUAL (actionLog->LogSize (), 2);
+  BOOST_CHECK (actionLog->LookupAction (remoteName, 1));
+  BOOST_CHECK (!actionLog->LookupAction (remoteName, 2));
+  BOOST_CHECK (actionLog->LookupAction (remoteName, 3));
+
+  remove_all (tmpdir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
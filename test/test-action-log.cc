@@ -29,6 +29,9 @@
 #include <iostream>
 #include <boost/filesystem.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -138,6 +141,239 @@ BOOST_AUTO_TEST_CASE (ActionLogTest)
   remove_all (tmpdir);
 }
 
+static void
+checkAlgorithm (const ActionItem &action, Digest::Algorithm expected, int &found)
+{
+  BOOST_CHECK_EQUAL (action.file_hash_algorithm (), expected);
+  found ++;
+}
+
+BOOST_AUTO_TEST_CASE (LocalFileStatTest)
+{
+  Name localName ("/alex");
+
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+  SyncLogPtr syncLog = make_shared<SyncLog> (tmpdir, localName);
+  CcnxWrapperPtr ccnx = make_shared<CcnxWrapper> ();
+
+  ActionLogPtr actionLog = make_shared<ActionLog> (ccnx, tmpdir, syncLog, "top-secret", "test-chronoshare",
+                                                   ActionLog::OnFileAddedOrChangedCallback(), ActionLog::OnFileRemovedCallback ());
+  FileStatePtr fileState = actionLog->GetFileState ();
+
+  actionLog->AddLocalActionUpdate ("file.txt", *Hash::FromString ("2ff304769cdb0125ac039e6fe7575f8576dceffc62618a431715aaf6eea2bf1c"),
+                                   time (NULL), 0755, 10);
+
+  LocalFileStat stat;
+  BOOST_CHECK_EQUAL (fileState->LookupLocalStat ("file.txt", stat), false);
+
+  stat.m_size = 1000;
+  stat.m_mtimeNs = 1234567890123456789LL;
+  stat.m_inode = 42;
+  stat.m_sample = "sample";
+  fileState->SetLocalStat ("file.txt", stat);
+  fileState->SetLocalStat ("unknown.txt", stat);
+
+  LocalFileStat recorded;
+  BOOST_CHECK_EQUAL (fileState->LookupLocalStat ("file.txt", recorded), true);
+  BOOST_CHECK (recorded.IsSameMetadata (stat));
+  BOOST_CHECK_EQUAL (recorded.m_sample, "sample");
+  BOOST_CHECK_EQUAL (fileState->LookupLocalStat ("unknown.txt", recorded), false);
+
+  // new version of the file invalidates recorded metadata
+  actionLog->AddLocalActionUpdate ("file.txt", *Hash::FromString ("1ff304769cdb0125ac039e6fe7575f8576dceffc62618a431715aaf6eea2bf1c"),
+                                   time (NULL), 0755, 10);
+  BOOST_CHECK_EQUAL (fileState->LookupLocalStat ("file.txt", recorded), false);
+
+  // metadata of the real file
+  fs::ofstream (tmpdir / "real.txt") << "hello";
+  BOOST_CHECK_EQUAL (LocalFileStat::Read (tmpdir / "real.txt", stat), true);
+  BOOST_CHECK_EQUAL (stat.m_size, 5);
+  BOOST_CHECK_EQUAL (LocalFileStat::Read (tmpdir / "missing.txt", stat), false);
+  BOOST_CHECK_EQUAL (LocalFileStat::Read (tmpdir, stat), false);
+
+  remove_all (tmpdir);
+}
+
+BOOST_AUTO_TEST_CASE (DigestAlgorithmTest)
+{
+  Name localName ("/alex");
+
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+  SyncLogPtr syncLog = make_shared<SyncLog> (tmpdir, localName);
+  CcnxWrapperPtr ccnx = make_shared<CcnxWrapper> ();
+
+  ActionLogPtr actionLog = make_shared<ActionLog> (ccnx, tmpdir, syncLog, "top-secret", "test-chronoshare",
+                                                   ActionLog::OnFileAddedOrChangedCallback(), ActionLog::OnFileRemovedCallback ());
+  FileStatePtr fileState = actionLog->GetFileState ();
+
+  HashPtr sha256 = Hash::FromString ("2ff304769cdb0125ac039e6fe7575f8576dceffc62618a431715aaf6eea2bf1c");
+  Hash blake3 (sha256->GetHash (), sha256->GetHashBytes (), Digest::BLAKE3);
+
+  // SHA-256 is not recorded in the action, so older peers get exactly the same actions as before
+  ActionItemPtr item = actionLog->AddLocalActionUpdate ("sha256.txt", *sha256, time (NULL), 0755, 10);
+  BOOST_CHECK_EQUAL (item->has_file_hash_algorithm (), false);
+  BOOST_CHECK_EQUAL (fileState->LookupFile ("sha256.txt")->file_hash_algorithm (), Digest::SHA256);
+
+  item = actionLog->AddLocalActionUpdate ("blake3.txt", blake3, time (NULL), 0755, 10);
+  BOOST_CHECK_EQUAL (item->file_hash_algorithm (), Digest::BLAKE3);
+  BOOST_CHECK_EQUAL (fileState->LookupFile ("blake3.txt")->file_hash_algorithm (), Digest::BLAKE3);
+
+  int found = 0;
+  actionLog->LookupActionsForFile (bind (&checkAlgorithm, _3, Digest::BLAKE3, boost::ref (found)), "blake3.txt");
+  BOOST_CHECK_EQUAL (found, 1);
+
+  FileItemPtr file = actionLog->LookupAction ("blake3.txt", 0, blake3);
+  BOOST_REQUIRE (static_cast<bool> (file));
+  BOOST_CHECK_EQUAL (file->file_hash_algorithm (), Digest::BLAKE3);
+
+  remove_all (tmpdir);
+}
+
+static boost::shared_ptr<ndn::Data>
+remoteUpdate (const string &filename, uint64_t version, const Hash &hash)
+{
+  ActionItem item;
+  item.set_action (ActionItem::UPDATE);
+  item.set_filename (filename);
+  item.set_version (version);
+  item.set_timestamp (time (NULL));
+  item.set_file_hash (hash.GetHash (), hash.GetHashBytes ());
+  item.set_mtime (time (NULL));
+  item.set_mode (0644);
+  item.set_seg_num (10);
+
+  string content;
+  item.SerializeToString (&content);
+
+  boost::shared_ptr<ndn::Data> data = boost::make_shared<ndn::Data> ();
+  data->setContent (reinterpret_cast<const uint8_t*> (content.c_str ()), content.size ());
+  return data;
+}
+
+BOOST_AUTO_TEST_CASE (ContentSourcesTest)
+{
+  ndn::Name localName ("/alex");
+
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+  SyncLogPtr syncLog = boost::make_shared<SyncLog> (tmpdir, localName);
+  ActionLogPtr actionLog = boost::make_shared<ActionLog> (boost::shared_ptr<ndn::Face> (), tmpdir, syncLog, "top-secret", "test-chronoshare",
+                                                   ActionLog::OnFileAddedOrChangedCallback(), ActionLog::OnFileRemovedCallback ());
+
+  HashPtr content = Hash::FromString ("2ff304769cdb0125ac039e6fe7575f8576dceffc62618a431715aaf6eea2bf1c");
+  HashPtr other = Hash::FromString ("1ff304769cdb0125ac039e6fe7575f8576dceffc62618a431715aaf6eea2bf1c");
+
+  ActionLog::RemoteActions actions;
+  // the same content published by two devices
+  actions.push_back (ActionLog::RemoteAction (ndn::Name ("/zhenkai"), 1, remoteUpdate ("a.txt", 0, *content)));
+  actions.push_back (ActionLog::RemoteAction (ndn::Name ("/obaid"), 1, remoteUpdate ("copy-of-a.txt", 0, *content)));
+  // newer version of a.txt, the device had to fetch the content first
+  actions.push_back (ActionLog::RemoteAction (ndn::Name ("/yingdi"), 1, remoteUpdate ("a.txt", 1, *other)));
+  // unrelated
+  actions.push_back (ActionLog::RemoteAction (ndn::Name ("/zhenkai"), 2, remoteUpdate ("b.txt", 0, *other)));
+  actionLog->AddRemoteActions (actions);
+
+  std::vector<ActionLog::ContentSource> sources = actionLog->LookupSourcesForHash (*content);
+  BOOST_CHECK_EQUAL (sources.size (), 3);
+  BOOST_CHECK (std::find (sources.begin (), sources.end (),
+                          ActionLog::ContentSource (ndn::Name ("/zhenkai"), ndn::Name ("/zhenkai"))) != sources.end ());
+  BOOST_CHECK (std::find (sources.begin (), sources.end (),
+                          ActionLog::ContentSource (ndn::Name ("/obaid"), ndn::Name ("/obaid"))) != sources.end ());
+  BOOST_CHECK (std::find (sources.begin (), sources.end (),
+                          ActionLog::ContentSource (ndn::Name ("/yingdi"), ndn::Name ("/zhenkai"))) != sources.end ());
+
+  // local actions are recorded the same way
+  actionLog->AddLocalActionUpdate ("local.txt", *other, time (NULL), 0755, 10);
+  sources = actionLog->LookupSourcesForHash (*other);
+  BOOST_CHECK (std::find (sources.begin (), sources.end (),
+                          ActionLog::ContentSource (localName, localName)) != sources.end ());
+
+  remove_all (tmpdir);
+}
+
+static void
+collectActions (std::vector<ActionItem> &actions, const ActionItem &action)
+{
+  actions.push_back (action);
+}
+
+BOOST_AUTO_TEST_CASE (MoveActionTest)
+{
+  ndn::Name localName ("/alex");
+
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+  SyncLogPtr syncLog = boost::make_shared<SyncLog> (tmpdir, localName);
+  ActionLogPtr actionLog = boost::make_shared<ActionLog> (boost::shared_ptr<ndn::Face> (), tmpdir, syncLog, "top-secret", "test-chronoshare",
+                                                   ActionLog::OnFileAddedOrChangedCallback(), ActionLog::OnFileRemovedCallback ());
+  FileStatePtr fileState = actionLog->GetFileState ();
+
+  HashPtr content = Hash::FromString ("2ff304769cdb0125ac039e6fe7575f8576dceffc62618a431715aaf6eea2bf1c");
+
+  // publishing: rename is an update of the new name (understood by older peers) plus delete of the old name
+  actionLog->AddLocalActionUpdate ("old.txt", *content, time (NULL), 0644, 10);
+  ActionItemPtr item = actionLog->AddLocalActionMove ("old.txt", "new.txt", *content, time (NULL), 0644, 10);
+  BOOST_REQUIRE (static_cast<bool> (item));
+  BOOST_CHECK_EQUAL (item->action (), ActionItem::UPDATE);
+  BOOST_CHECK_EQUAL (item->moved_from (), "old.txt");
+  BOOST_CHECK_EQUAL (syncLog->SeqNo (localName), 3);
+
+  // what peers receive
+  string message;
+  item->SerializeToString (&message);
+  ActionItem published;
+  BOOST_REQUIRE (published.ParseFromString (message));
+  BOOST_CHECK_EQUAL (published.action (), ActionItem::UPDATE);
+  BOOST_CHECK_EQUAL (published.filename (), "new.txt");
+  BOOST_CHECK_EQUAL (published.moved_from (), "old.txt");
+
+  // what is stored in the ActionLog table
+  std::vector<ActionItem> stored;
+  actionLog->LookupActionsForFile (bind (collectActions, boost::ref (stored), _3), "new.txt");
+  BOOST_REQUIRE_EQUAL (stored.size (), 1);
+  BOOST_CHECK_EQUAL (stored[0].action (), ActionItem::UPDATE);
+  BOOST_CHECK_EQUAL (stored[0].moved_from (), "old.txt");
+
+  stored.clear ();
+  actionLog->LookupActionsForFile (bind (collectActions, boost::ref (stored), _3), "old.txt");
+  BOOST_REQUIRE_EQUAL (stored.size (), 2);
+  BOOST_CHECK (stored[0].action () == ActionItem::DELETE || stored[1].action () == ActionItem::DELETE);
+  BOOST_CHECK (!stored[0].has_moved_from () && !stored[1].has_moved_from ());
+
+  BOOST_CHECK (static_cast<bool> (fileState->LookupFile ("new.txt")));
+  BOOST_CHECK (!fileState->LookupFile ("old.txt"));
+
+  // applying: remote rename is stored with its previous name and updates the file state like any update
+  ActionItem remote;
+  remote.set_action (ActionItem::UPDATE);
+  remote.set_filename ("renamed.txt");
+  remote.set_version (0);
+  remote.set_timestamp (time (NULL));
+  remote.set_file_hash (content->GetHash (), content->GetHashBytes ());
+  remote.set_mtime (time (NULL));
+  remote.set_mode (0644);
+  remote.set_seg_num (10);
+  remote.set_moved_from ("original.txt");
+
+  remote.SerializeToString (&message);
+  boost::shared_ptr<ndn::Data> data = boost::make_shared<ndn::Data> ();
+  data->setContent (reinterpret_cast<const uint8_t*> (message.c_str ()), message.size ());
+
+  ActionLog::RemoteActions actions;
+  actions.push_back (ActionLog::RemoteAction (ndn::Name ("/zhenkai"), 1, data));
+  ActionLog::ActionItems applied = actionLog->AddRemoteActions (actions);
+  BOOST_REQUIRE_EQUAL (applied.size (), 1);
+  BOOST_REQUIRE (static_cast<bool> (applied[0]));
+  BOOST_CHECK_EQUAL (applied[0]->moved_from (), "original.txt");
+
+  stored.clear ();
+  actionLog->LookupActionsForFile (bind (collectActions, boost::ref (stored), _3), "renamed.txt");
+  BOOST_REQUIRE_EQUAL (stored.size (), 1);
+  BOOST_CHECK_EQUAL (stored[0].moved_from (), "original.txt");
+
+  BOOST_CHECK (static_cast<bool> (fileState->LookupFile ("renamed.txt")));
+
+  remove_all (tmpdir);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
   // catch (boost::exception &err)
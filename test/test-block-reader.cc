@@ -0,0 +1,158 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "block-reader.h"
+#include "hash-helper.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/make_shared.hpp>
+#include <openssl/evp.h>
+
+INIT_LOGGER ("Test.BlockReader");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestBlockReader)
+
+static const fs::path ROOT = fs::path ("test-block-reader");
+
+static void
+writeFile (const fs::path &path, size_t size)
+{
+  fs::ofstream out (path, fs::ofstream::binary);
+  for (size_t i = 0; i < size; i++)
+    {
+      out.put (static_cast<char> ((i * 7 + i / 4093) & 0xFF));
+    }
+}
+
+static string
+readAll (const fs::path &path, size_t blockSize, BlockReader::Backend backend)
+{
+  BlockReader reader (path, blockSize, backend);
+  BOOST_CHECK (reader.IsOpen ());
+
+  string content;
+  const uint8_t *data = 0;
+  size_t size = 0;
+  while (reader.Next (data, size))
+    {
+      content.append (reinterpret_cast<const char*> (data), size);
+    }
+  BOOST_CHECK (!reader.HasFailed ());
+  return content;
+}
+
+// the way Hash::FromFileContent used to read files
+static HashPtr
+hashWithStream (const fs::path &filename)
+{
+  EVP_MD_CTX *hash_context = EVP_MD_CTX_create ();
+  EVP_DigestInit_ex (hash_context, EVP_sha256 (), 0);
+
+  fs::ifstream iff (filename, std::ios::in | std::ios::binary);
+  while (iff.good ())
+    {
+      char buf[1024];
+      iff.read (buf, 1024);
+      EVP_DigestUpdate (hash_context, buf, iff.gcount ());
+    }
+
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  EVP_DigestFinal_ex (hash_context, digest, &length);
+  EVP_MD_CTX_destroy (hash_context);
+
+  return boost::make_shared<Hash> (digest, length);
+}
+
+BOOST_AUTO_TEST_CASE (BlockReaderBackends)
+{
+  fs::remove_all (ROOT);
+  fs::create_directories (ROOT);
+
+  const size_t block = 4096;
+  size_t sizes[] = { 0, 1, block - 1, block, block + 1, 3 * block, 5 * block + 17 };
+
+  BlockReader::Backend backends[] = { BlockReader::AUTO, BlockReader::DIRECT, BlockReader::THREAD, BlockReader::IO_URING };
+
+  for (size_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      fs::path file = ROOT / "file";
+      writeFile (file, sizes[i]);
+
+      string expected;
+      {
+        fs::ifstream in (file, fs::ifstream::binary);
+        expected.assign (istreambuf_iterator<char> (in), istreambuf_iterator<char> ());
+      }
+      BOOST_REQUIRE_EQUAL (expected.size (), sizes[i]);
+
+      for (size_t j = 0; j < sizeof (backends) / sizeof (backends[0]); j++)
+        {
+          BOOST_CHECK_MESSAGE (readAll (file, block, backends[j]) == expected,
+                               "size " << sizes[i] << ", backend " << backends[j]);
+        }
+
+      BOOST_CHECK_EQUAL (*Hash::FromFileContent (file), *hashWithStream (file));
+    }
+
+  // blocks are never returned short, except the last one
+  writeFile (ROOT / "file", 3 * block + 1);
+  BlockReader reader (ROOT / "file", block, BlockReader::THREAD);
+  const uint8_t *data = 0;
+  size_t size = 0;
+  for (int i = 0; i < 3; i++)
+    {
+      BOOST_REQUIRE (reader.Next (data, size));
+      BOOST_CHECK_EQUAL (size, block);
+    }
+  BOOST_REQUIRE (reader.Next (data, size));
+  BOOST_CHECK_EQUAL (size, 1);
+  BOOST_CHECK (!reader.Next (data, size));
+
+  // unreadable file is hashed as empty content, the same way as before
+  BlockReader missing (ROOT / "does-not-exist");
+  BOOST_CHECK (!missing.IsOpen ());
+  BOOST_CHECK (!missing.Next (data, size));
+  // digest of the content that could not be read is an error, not a digest of nothing
+  BOOST_CHECK_THROW (Hash::FromFileContent (ROOT / "does-not-exist"), fs::filesystem_error);
+
+  // reader can be abandoned in the middle of the file
+  writeFile (ROOT / "file", 10 * block);
+  {
+    BlockReader abandoned (ROOT / "file", block, BlockReader::THREAD);
+    BOOST_CHECK (abandoned.Next (data, size));
+  }
+  {
+    BlockReader abandoned (ROOT / "file", block, BlockReader::IO_URING);
+    BOOST_CHECK (abandoned.Next (data, size));
+  }
+
+  fs::remove_all (ROOT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "concurrency-controller.h"
+
+#include "logging.h"
+
+INIT_LOGGER ("Test.ConcurrencyController");
+
+using namespace boost;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(TestConcurrencyController)
+
+BOOST_AUTO_TEST_CASE (ConcurrencyControllerAdapt)
+{
+  INIT_LOGGERS ();
+
+  ConcurrencyController controller (3, 2, 8, 0.2);
+  BOOST_CHECK_EQUAL (controller.GetLimit (), 3);
+
+  // no backlog, nothing to gain
+  BOOST_CHECK_EQUAL (controller.Update (1000, 0, false), 3);
+
+  // goodput keeps growing: climb up to the maximum
+  double goodput = 1000;
+  for (int i = 0; i < 10; i++)
+    {
+      goodput *= 1.5;
+      controller.Update (goodput, 0.01, true);
+    }
+  BOOST_CHECK_EQUAL (controller.GetLimit (), 8);
+
+  // queueing delay: multiplicative decrease, bounded by minimum
+  BOOST_CHECK_EQUAL (controller.Update (goodput, 0.5, true), 6);
+  BOOST_CHECK_EQUAL (controller.Update (goodput, 0.5, true), 4);
+  BOOST_CHECK_EQUAL (controller.Update (goodput, 0.5, true), 3);
+  BOOST_CHECK_EQUAL (controller.Update (goodput, 0.5, true), 2);
+  BOOST_CHECK_EQUAL (controller.Update (goodput, 0.5, true), 2);
+
+  // flat goodput: no reason to add more fetches
+  for (int i = 0; i < 10; i++)
+    {
+      BOOST_CHECK_EQUAL (controller.Update (goodput, 0.01, true), 2);
+    }
+
+  // increase that did not pay off is reverted
+  BOOST_CHECK_EQUAL (controller.Update (goodput * 1.1, 0.01, true), 3);
+  BOOST_CHECK_EQUAL (controller.Update (goodput * 0.5, 0.01, true), 2);
+
+  controller.SetLimits (5, 10);
+  BOOST_CHECK_EQUAL (controller.GetLimit (), 5);
+  BOOST_CHECK_EQUAL (controller.GetMinLimit (), 5);
+  BOOST_CHECK_EQUAL (controller.GetMaxLimit (), 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "congestion-window.h"
+
+#include "logging.h"
+
+INIT_LOGGER ("Test.CongestionWindow");
+
+using namespace boost;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(TestCongestionWindow)
+
+BOOST_AUTO_TEST_CASE (CongestionWindowAimd)
+{
+  INIT_LOGGERS ();
+
+  CongestionWindow window (CongestionWindow::AIMD, 4, 1, 64);
+
+  for (int i = 0; i < 4; i++)
+    {
+      BOOST_CHECK (window.TryAcquire ());
+    }
+  BOOST_CHECK (!window.TryAcquire ());
+  BOOST_CHECK_EQUAL (window.GetInFlight (), 4);
+
+  // slow start: +1 per Data
+  window.OnData ();
+  window.OnData ();
+  BOOST_CHECK_CLOSE (window.GetWindowSize (), 6.0, 0.001);
+  BOOST_CHECK_EQUAL (window.GetInFlight (), 2);
+
+  // multiple timeouts of Interests sent before the decrease are counted as one loss event
+  posix_time::ptime sendTime = CongestionWindow::Now ();
+  usleep (1000);
+  window.OnTimeout (sendTime);
+  window.OnTimeout (sendTime);
+  BOOST_CHECK_CLOSE (window.GetWindowSize (), 3.0, 0.001);
+  BOOST_CHECK_EQUAL (window.GetInFlight (), 2); // timed out Interests are retransmitted
+
+  window.Release ();
+  window.Release ();
+  BOOST_CHECK_EQUAL (window.GetInFlight (), 0);
+
+  // congestion avoidance: about +1 per window worth of Data
+  window.TryAcquire ();
+  window.OnData ();
+  BOOST_CHECK_CLOSE (window.GetWindowSize (), 3.0 + 1.0/3.0, 0.001);
+
+  usleep (1000);
+  window.OnTimeout (CongestionWindow::Now ());
+  usleep (1000);
+  window.OnTimeout (CongestionWindow::Now ());
+  usleep (1000);
+  window.OnTimeout (CongestionWindow::Now ());
+  BOOST_CHECK_CLOSE (window.GetWindowSize (), 1.0, 0.001); // never below minimum
+}
+
+BOOST_AUTO_TEST_CASE (CongestionWindowCubic)
+{
+  CongestionWindow aimd (CongestionWindow::AIMD, 32, 1, 64);
+  CongestionWindow cubic (CongestionWindow::CUBIC, 32, 1, 64);
+
+  usleep (1000);
+  aimd.OnTimeout (CongestionWindow::Now ());
+  cubic.OnTimeout (CongestionWindow::Now ());
+
+  BOOST_CHECK_CLOSE (aimd.GetWindowSize (), 16.0, 0.001);
+  BOOST_CHECK_CLOSE (cubic.GetWindowSize (), 32.0 * 0.7, 0.001);
+
+  for (int i = 0; i < 100; i++)
+    {
+      aimd.OnData ();
+      cubic.OnData ();
+    }
+
+  BOOST_CHECK_GE (cubic.GetWindowSize (), aimd.GetWindowSize ());
+  BOOST_CHECK_LE (cubic.GetWindowSize (), 64.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
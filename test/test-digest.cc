@@ -0,0 +1,131 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "digest.h"
+#include "hash-helper.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+INIT_LOGGER ("Test.Digest");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestDigest)
+
+static string
+toHex (const void *buf, size_t size)
+{
+  static const char *digits = "0123456789abcdef";
+  string retval;
+  for (size_t i = 0; i < size; i++)
+    {
+      unsigned char byte = reinterpret_cast<const unsigned char*> (buf)[i];
+      retval += digits[byte >> 4];
+      retval += digits[byte & 0x0F];
+    }
+  return retval;
+}
+
+static string
+digestOf (Digest::Algorithm algorithm, const string &data, size_t step)
+{
+  Digest digest (algorithm);
+  for (size_t offset = 0; offset < data.size (); offset += step)
+    {
+      digest.Update (data.c_str () + offset, std::min (step, data.size () - offset));
+    }
+
+  unsigned char result[Digest::MAX_SIZE];
+  unsigned int length = digest.Final (result);
+  return toHex (result, length);
+}
+
+BOOST_AUTO_TEST_CASE (KnownAnswers)
+{
+  BOOST_CHECK (Digest::SelfTest (Digest::SHA256));
+  BOOST_CHECK_EQUAL (digestOf (Digest::SHA256, "", 1),
+                     "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+  if (Digest::IsSupported (Digest::BLAKE3))
+    {
+      BOOST_CHECK (Digest::SelfTest (Digest::BLAKE3));
+      BOOST_CHECK_EQUAL (digestOf (Digest::BLAKE3, "", 1),
+                         "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262");
+    }
+  else
+    {
+      BOOST_CHECK_THROW (Digest (Digest::BLAKE3), Error::UnsupportedDigest);
+      BOOST_CHECK_EQUAL (Digest::SetDefaultAlgorithm (Digest::BLAKE3), false);
+      BOOST_CHECK_EQUAL (Digest::GetDefaultAlgorithm (), Digest::SHA256);
+    }
+
+  Digest::Algorithm algorithm;
+  BOOST_CHECK (Digest::FromName ("blake3", algorithm));
+  BOOST_CHECK_EQUAL (algorithm, Digest::BLAKE3);
+  BOOST_CHECK (!Digest::FromName ("md5", algorithm));
+
+  BOOST_TEST_MESSAGE ("sha256: " << Digest::GetImplementation (Digest::SHA256)
+                      << ", blake3: " << Digest::GetImplementation (Digest::BLAKE3));
+}
+
+BOOST_AUTO_TEST_CASE (Streaming)
+{
+  // large enough for the parallel BLAKE3 path
+  string data (3 * 1024 * 1024 + 17, 0);
+  for (size_t i = 0; i < data.size (); i++)
+    data[i] = static_cast<char> (i * 13 + i / 251);
+
+  fs::path file = fs::temp_directory_path () / fs::unique_path ();
+  {
+    fs::ofstream out (file, fs::ofstream::binary);
+    out << data;
+  }
+
+  Digest::Algorithm algorithms[] = { Digest::SHA256, Digest::BLAKE3 };
+  for (size_t i = 0; i < sizeof (algorithms) / sizeof (algorithms[0]); i++)
+    {
+      if (!Digest::IsSupported (algorithms[i]))
+        continue;
+
+      string whole = digestOf (algorithms[i], data, data.size ());
+      BOOST_CHECK_EQUAL (digestOf (algorithms[i], data, 4093), whole);
+      BOOST_CHECK_EQUAL (digestOf (algorithms[i], data, 1024 * 1024), whole);
+
+      HashPtr hash = Hash::FromFileContent (file, algorithms[i]);
+      BOOST_CHECK_EQUAL (hash->GetAlgorithm (), algorithms[i]);
+      BOOST_CHECK_EQUAL (toHex (hash->GetHash (), hash->GetHashBytes ()), whole);
+
+      // algorithm is carried over by copies
+      Hash copy (*hash);
+      BOOST_CHECK_EQUAL (copy.GetAlgorithm (), algorithms[i]);
+      copy = Hash ();
+      BOOST_CHECK_EQUAL (copy.GetAlgorithm (), Digest::SHA256);
+    }
+
+  fs::remove (file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -108,4 +108,44 @@ BOOST_AUTO_TEST_CASE(DispatcherTest)
   cleanDir(dir2);
 }
 
+BOOST_AUTO_TEST_CASE(LocalCopyWithSameMetadata)
+{
+  INIT_LOGGERS ();
+
+  fs::path root("./TestDispatcher/local-copy");
+  cleanDir(root);
+  fs::create_directories(root);
+
+  string filename = "copy.txt";
+  {
+    ofstream ofs((root / filename).string().c_str());
+    ofs << "original content";
+  }
+  HashPtr hash = Hash::FromFileContent(root / filename);
+
+  FileStatePtr fileState = boost::make_shared<FileState>(root);
+  string device = "/obamaa";
+  fileState->UpdateFile(filename, 1, *hash, ndn::Buffer(device.c_str(), device.size()), 1, 0, 0, 0, 0644, 1);
+  fileState->SetFileComplete(filename);
+
+  LocalFileStat stat;
+  BOOST_REQUIRE(LocalFileStat::Read(root / filename, stat));
+  fileState->SetLocalStat(filename, stat);
+
+  BOOST_CHECK_EQUAL(Dispatcher::FindLocalCopy(fileState, root, *hash), root / filename);
+
+  // same size, and the recorded metadata still matches the file, but the content is different
+  {
+    ofstream ofs((root / filename).string().c_str());
+    ofs << "modified content";
+  }
+  BOOST_REQUIRE(LocalFileStat::Read(root / filename, stat));
+  fileState->SetLocalStat(filename, stat);
+
+  BOOST_CHECK(Dispatcher::FindLocalCopy(fileState, root, *hash).empty());
+
+  fileState.reset();
+  cleanDir(root);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
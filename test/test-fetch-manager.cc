@@ -188,6 +188,24 @@ BOOST_AUTO_TEST_CASE (TestFetcher)
   executor->shutdown ();
 }
 
+BOOST_AUTO_TEST_CASE (FetchOrderingPolicies)
+{
+  INIT_LOGGERS ();
+
+  FetchManager::OrderingPolicy fifo = FetchManager::FifoOrdering ();
+  BOOST_CHECK_EQUAL (fifo (1, 0), fifo (1000000, 0));
+
+  FetchManager::OrderingPolicy smallest = FetchManager::SmallestFirstOrdering (10);
+  BOOST_CHECK_LT (smallest (1, 0), smallest (1000, 0));
+  // penalty is bounded: 1M segments (~8 GB) is delayed by ~200 seconds relative to a single-segment file
+  BOOST_CHECK_CLOSE (smallest (1000000, 0) - smallest (0, 0), 10 * std::log (1000001.0) / std::log (2.0), 0.001);
+
+  time_t now = std::time (0);
+  FetchManager::OrderingPolicy recent = FetchManager::RecentFirstOrdering (10);
+  BOOST_CHECK_LT (recent (1, now - 60), recent (1, now - 24 * 3600));
+  BOOST_CHECK_LT (recent (1, now - 24 * 3600), recent (1, 0)); // unknown timestamp goes after known
+}
+
 // BOOST_AUTO_TEST_CASE (CcnxWrapperSelector)
 // {
 
@@ -28,6 +28,7 @@
 #include <boost/bind.hpp>
 
 #include <boost/test/unit_test.hpp>
+#include <sqlite3.h>
 #include <unistd.h>
 #include <boost/make_shared.hpp>
 #include <iostream>
@@ -161,5 +162,145 @@ BOOST_AUTO_TEST_CASE (FetchTaskDbTest)
   fs::remove_all(folder);
 }
 
+BOOST_AUTO_TEST_CASE (FetchTaskDbProgress)
+{
+  INIT_LOGGERS ();
+  fs::path folder("TaskDbProgressTest");
+  fs::create_directories(folder / ".chronoshare");
+
+  ndn::Name deviceName("/device");
+  ndn::Name baseName("/device/base");
+
+  {
+    FetchTaskDb db(folder, "test");
+    db.addTask(deviceName, baseName, 0, 99, 1);
+
+    for (uint64_t seq = 0; seq < 50; seq++)
+    {
+      db.markReceived(deviceName, baseName, seq);
+    }
+    db.markReceived(deviceName, baseName, 60);
+    db.markReceived(deviceName, baseName, 70);
+
+    // progress is visible before it is checkpointed
+    ReceiveWindow progress(0);
+    BOOST_CHECK(db.getProgress(deviceName, baseName, progress));
+    BOOST_CHECK_EQUAL(progress.GetBase(), 50);
+    BOOST_CHECK_EQUAL(progress.GetOutOfOrderCount(), 2);
+
+    // unknown tasks are not tracked
+    db.markReceived(deviceName, ndn::Name("/device/other"), 0);
+    BOOST_CHECK(!db.getProgress(deviceName, ndn::Name("/device/other"), progress));
+  } // destructor checkpoints the progress
+
+  {
+    FetchTaskDb db(folder, "test");
+
+    ReceiveWindow progress(0);
+    BOOST_REQUIRE(db.getProgress(deviceName, baseName, progress));
+    BOOST_CHECK_EQUAL(progress.GetBase(), 50);
+    BOOST_CHECK_EQUAL(progress.GetOutOfOrderCount(), 2);
+    BOOST_CHECK(progress.IsReceived(60));
+    BOOST_CHECK(progress.IsReceived(70));
+    BOOST_CHECK(!progress.IsReceived(65));
+
+    // reconciled progress replaces the checkpoint
+    progress.Reset(40);
+    db.setProgress(deviceName, baseName, progress);
+
+    db.deleteTask(deviceName, baseName);
+    BOOST_CHECK(!db.getProgress(deviceName, baseName, progress));
+  }
+
+  fs::remove_all(folder);
+}
+
+BOOST_AUTO_TEST_CASE (FetchTaskDbUndecodable)
+{
+  INIT_LOGGERS ();
+  fs::path folder("TaskDbUndecodableTest");
+  fs::create_directories(folder / ".chronoshare");
+
+  ndn::Name deviceName("/device");
+  ndn::Name baseName("/device/base");
+
+  {
+    FetchTaskDb db(folder, "test");
+    db.addTask(deviceName, baseName, 0, 10, 1);
+  }
+
+  {
+    // row in the old (pre-TLV) name format
+    sqlite3 *raw;
+    BOOST_REQUIRE_EQUAL(sqlite3_open((folder / ".chronoshare" / "fetch_tasks" / "test").c_str(), &raw), SQLITE_OK);
+    BOOST_REQUIRE_EQUAL(sqlite3_exec(raw, "INSERT INTO Task (deviceName, baseName, minSeqNo, maxSeqNo, priority) "
+                                          "VALUES (x'f2fa9d646576000000', x'f2fa9d626173000000', 0, 10, 1);", NULL, NULL, NULL), SQLITE_OK);
+    sqlite3_close(raw);
+  }
+
+  {
+    FetchTaskDb db(folder, "test");
+    checkers.clear();
+    g_counter = 0;
+    BOOST_CHECK_NO_THROW(db.foreachTask(bind(getChecker, _1, _2, _3, _4, _5)));
+    BOOST_CHECK_EQUAL(g_counter, 1);
+
+    // undecodable row has been removed, only the valid task is reported again
+    checkers.clear();
+    g_counter = 0;
+    db.foreachTask(bind(getChecker, _1, _2, _3, _4, _5));
+    BOOST_CHECK_EQUAL(g_counter, 1);
+  }
+
+  {
+    sqlite3 *raw;
+    BOOST_REQUIRE_EQUAL(sqlite3_open((folder / ".chronoshare" / "fetch_tasks" / "test").c_str(), &raw), SQLITE_OK);
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(raw, "SELECT count(*) FROM Task;", -1, &stmt, 0);
+    BOOST_REQUIRE_EQUAL(sqlite3_step(stmt), SQLITE_ROW);
+    BOOST_CHECK_EQUAL(sqlite3_column_int(stmt, 0), 1);
+    sqlite3_finalize(stmt);
+    sqlite3_close(raw);
+  }
+
+  fs::remove_all(folder);
+}
+
+static std::map<std::string, std::string> g_segmentRoots;
+
+static void
+collectSegmentRoot(const ndn::Name &deviceName, const ndn::Name &baseName, uint64_t minSeqNo, uint64_t maxSeqNo,
+                   int priority, const std::string &segmentRoot)
+{
+  g_segmentRoots[baseName.toUri()] = segmentRoot;
+}
+
+BOOST_AUTO_TEST_CASE (FetchTaskDbSegmentRoot)
+{
+  INIT_LOGGERS ();
+  fs::path folder("TaskDbSegmentRootTest");
+  fs::create_directories(folder / ".chronoshare");
+
+  ndn::Name deviceName("/device");
+  std::string root("\x01\x00\xfe\x7f", 4);
+
+  {
+    FetchTaskDb db(folder, "test");
+    db.addTask(deviceName, ndn::Name("/device/verified"), 0, 10, 1, root);
+    db.addTask(deviceName, ndn::Name("/device/unverified"), 0, 10, 1);
+  }
+
+  {
+    FetchTaskDb db(folder, "test");
+    g_segmentRoots.clear();
+    db.foreachTask(collectSegmentRoot);
+
+    BOOST_REQUIRE_EQUAL(g_segmentRoots.size(), 2);
+    BOOST_CHECK(g_segmentRoots["/device/verified"] == root);
+    BOOST_CHECK(g_segmentRoots["/device/unverified"].empty());
+  }
+
+  fs::remove_all(folder);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "fetcher.h"
+#include "logging.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+INIT_LOGGER ("Test.Fetcher");
+
+using namespace std;
+using namespace boost;
+
+BOOST_AUTO_TEST_SUITE(TestFetcher)
+
+static void
+onSegment (ndn::Name &deviceName, ndn::Name &baseName, uint64_t seq, boost::shared_ptr<ndn::Data> data)
+{
+  BOOST_FAIL ("no segment should be requested");
+}
+
+static void
+onFinish (ndn::Name &deviceName, ndn::Name &baseName)
+{
+}
+
+static void
+onComplete (Fetcher &fetcher, const ndn::Name &deviceName, const ndn::Name &baseName)
+{
+}
+
+static void
+onFail (Fetcher &fetcher)
+{
+}
+
+BOOST_AUTO_TEST_CASE (RefillWhileWindowIsFull)
+{
+  INIT_LOGGERS ();
+
+  SchedulerPtr scheduler (new Scheduler ());
+  scheduler->start ();
+  ExecutorPtr executor = boost::make_shared<Executor> (1);
+  executor->start ();
+
+  // window shared with other fetchers that keep it full
+  CongestionWindowPtr window = boost::make_shared<CongestionWindow> (CongestionWindow::AIMD, 2.0, 1.0, 2.0);
+  while (window->TryAcquire ())
+    ;
+  uint32_t inFlight = window->GetInFlight ();
+
+  {
+    Fetcher fetcher (executor, onSegment, onFinish, onComplete, onFail,
+                     ndn::Name ("/device"), ndn::Name ("/base"), 0, 9,
+                     posix_time::seconds (30), ndn::Name (), window);
+    fetcher.SetScheduler (scheduler);
+    fetcher.RestartPipeline ();
+
+    // window stays full across several consecutive refills, each of them schedules the next one
+    this_thread::sleep (posix_time::milliseconds (350));
+    BOOST_CHECK_EQUAL (scheduler->size (), 1);
+    BOOST_CHECK_EQUAL (window->GetInFlight (), inFlight);
+
+    scheduler->shutdown ();
+    executor->shutdown ();
+  }
+}
+
+BOOST_AUTO_TEST_CASE (RefillWhileRateLimited)
+{
+  INIT_LOGGERS ();
+
+  SchedulerPtr scheduler (new Scheduler ());
+  scheduler->start ();
+  ExecutorPtr executor = boost::make_shared<Executor> (1);
+  executor->start ();
+
+  ndn::Name device ("/device");
+  RateLimiterPtr limiter = boost::make_shared<RateLimiter> ();
+  limiter->SetPeerRate (device, 10000);
+
+  // the burst and 0.2 seconds worth of traffic
+  limiter->Consume (device, 5000 + 2000);
+
+  {
+    Fetcher fetcher (executor, onSegment, onFinish, onComplete, onFail,
+                     device, ndn::Name ("/base"), 0, 9);
+    fetcher.SetRateLimiter (limiter, scheduler);
+    fetcher.RestartPipeline ();
+
+    // bucket is exhausted again before the first refill, so the refill has to schedule another one
+    this_thread::sleep (posix_time::milliseconds (100));
+    limiter->Consume (device, 3000);
+    BOOST_CHECK_GT (limiter->GetDelay (device), 0.3);
+
+    this_thread::sleep (posix_time::milliseconds (200));
+    BOOST_CHECK_GT (limiter->GetDelay (device), 0.1);
+    BOOST_CHECK_EQUAL (scheduler->size (), 1);
+
+    scheduler->shutdown ();
+    executor->shutdown ();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
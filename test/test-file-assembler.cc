@@ -0,0 +1,173 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "logging.h"
+#include "file-assembler.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <ndn-cxx/data.hpp>
+#include <iterator>
+#include <vector>
+
+INIT_LOGGER ("Test.FileAssembler");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestFileAssembler)
+
+static const string HASH = "00112233445566778899aabbccddeeff";
+static const int SEGMENTS = 100;
+
+static ndn::Block
+makeSegment (int segment)
+{
+  string content = "segment-" + lexical_cast<string> (segment) + "|";
+
+  ndn::Data data;
+  data.setContent (reinterpret_cast<const uint8_t*> (content.c_str ()), content.size ());
+  return data.getContent ();
+}
+
+static string
+expectedContent (int segments)
+{
+  string content;
+  for (int i = 0; i < segments; i++)
+    {
+      content += "segment-" + lexical_cast<string> (i) + "|";
+    }
+  return content;
+}
+
+static string
+readFile (const fs::path &path)
+{
+  fs::ifstream in (path, std::ios::in | std::ios::binary);
+  return string (istreambuf_iterator<char> (in), istreambuf_iterator<char> ());
+}
+
+BOOST_AUTO_TEST_CASE (AssembleOutOfOrder)
+{
+  INIT_LOGGERS ();
+
+  fs::path folder ("FileAssemblerTest");
+  fs::remove_all (folder);
+
+  ndn::Name deviceName ("/device");
+  ObjectDb db (folder, HASH);
+  FileAssembler assembler (folder / "assembly", deviceName, HASH);
+
+  // pairs of segments swapped: 1, 0, 3, 2, ...
+  for (int i = 0; i < SEGMENTS; i++)
+    {
+      int segment = (i % 2 == 0) ? i + 1 : i - 1;
+      db.saveContentObject (deviceName, segment, makeSegment (segment));
+      assembler.AddSegment (segment, makeSegment (segment));
+    }
+  BOOST_CHECK_EQUAL (assembler.GetNextSegment (), SEGMENTS);
+
+  BOOST_REQUIRE (assembler.Finish (db));
+  BOOST_CHECK_EQUAL (readFile (assembler.GetPath ()), expectedContent (SEGMENTS));
+
+  fs::path path = assembler.GetPath ();
+  BOOST_CHECK (fs::exists (path));
+  {
+    FileAssembler other (folder / "assembly", deviceName, HASH);
+    BOOST_CHECK (other.GetPath () != path);
+  }
+
+  fs::remove_all (folder);
+}
+
+BOOST_AUTO_TEST_CASE (AssembleResumed)
+{
+  INIT_LOGGERS ();
+
+  fs::path folder ("FileAssemblerTest");
+  fs::remove_all (folder);
+
+  ndn::Name deviceName ("/device");
+  ObjectDb db (folder, HASH);
+
+  // first half was fetched before restart
+  for (int segment = 0; segment < SEGMENTS / 2; segment++)
+    {
+      db.saveContentObject (deviceName, segment, makeSegment (segment));
+    }
+
+  FileAssembler assembler (folder / "assembly", deviceName, HASH);
+  assembler.CatchUp (db);
+  BOOST_CHECK_EQUAL (assembler.GetNextSegment (), SEGMENTS / 2);
+
+  // second half arrives in reverse order, segment 50 is only in the database
+  for (int segment = SEGMENTS - 1; segment >= SEGMENTS / 2; segment--)
+    {
+      db.saveContentObject (deviceName, segment, makeSegment (segment));
+      if (segment != SEGMENTS / 2)
+        {
+          assembler.AddSegment (segment, makeSegment (segment));
+        }
+    }
+  BOOST_CHECK_EQUAL (assembler.GetNextSegment (), SEGMENTS / 2);
+
+  BOOST_REQUIRE (assembler.Finish (db));
+  BOOST_CHECK_EQUAL (readFile (assembler.GetPath ()), expectedContent (SEGMENTS));
+
+  fs::remove_all (folder);
+}
+
+BOOST_AUTO_TEST_CASE (AssembleRemovesTemporaryFile)
+{
+  INIT_LOGGERS ();
+
+  fs::path folder ("FileAssemblerTest");
+  fs::remove_all (folder);
+
+  ndn::Name deviceName ("/device");
+  fs::path path;
+  {
+    FileAssembler assembler (folder / "assembly", deviceName, HASH);
+    assembler.AddSegment (0, makeSegment (0));
+    path = assembler.GetPath ();
+    BOOST_CHECK (fs::exists (path));
+  }
+  BOOST_CHECK (!fs::exists (path));
+
+  {
+    FileAssembler assembler (folder / "assembly", deviceName, HASH);
+    path = assembler.GetPath ();
+    assembler.Release ();
+  }
+  BOOST_CHECK (fs::exists (path));
+
+  FileAssembler::Cleanup (folder / "assembly");
+  BOOST_CHECK (!fs::exists (path));
+
+  fs::remove_all (folder);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,193 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "logging.h"
+#include "file-materializer.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <iterator>
+#include <vector>
+
+INIT_LOGGER ("Test.FileMaterializer");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestFileMaterializer)
+
+static const fs::path ROOT = "test-file-materializer";
+
+static string
+readFile (const fs::path &path)
+{
+  fs::ifstream in (path, fs::ifstream::binary);
+  return string (istreambuf_iterator<char> (in), istreambuf_iterator<char> ());
+}
+
+// number of hidden (temporary) files in the directory
+static int
+countHidden (const fs::path &dir)
+{
+  int count = 0;
+  for (fs::directory_iterator entry (dir); entry != fs::directory_iterator (); entry++)
+    {
+      if (entry->path ().filename ().string ()[0] == '.')
+        count ++;
+    }
+  return count;
+}
+
+static void
+countCommitted (int *counter)
+{
+  (*counter) ++;
+}
+
+BOOST_AUTO_TEST_CASE (MaterializeAtomically)
+{
+  fs::remove_all (ROOT);
+
+  FileMaterializer materializer;
+  int committed = 0;
+
+  string content (3 * 1024 * 1024 + 17, 'a');
+  for (size_t i = 0; i < content.size (); i++)
+    content[i] = 'a' + i % 26;
+
+  fs::path file = ROOT / "dir" / "file.txt";
+  BOOST_REQUIRE (materializer.Begin (file, content.size ()));
+  // small and large writes
+  BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> (content.c_str ()), 10));
+  BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> (content.c_str ()) + 10, content.size () - 10));
+  BOOST_CHECK (materializer.End (1000000000, 0640, bind (countCommitted, &committed)));
+
+  // nothing visible before the commit
+  BOOST_CHECK (!fs::exists (file));
+  BOOST_CHECK_EQUAL (countHidden (file.parent_path ()), 1);
+  BOOST_CHECK_EQUAL (materializer.GetPendingCount (), 1);
+  BOOST_CHECK_EQUAL (committed, 0);
+
+  BOOST_CHECK (materializer.Commit ());
+  BOOST_CHECK_EQUAL (committed, 1);
+  BOOST_CHECK_EQUAL (materializer.GetPendingCount (), 0);
+  BOOST_CHECK_EQUAL (countHidden (file.parent_path ()), 0);
+  BOOST_CHECK_EQUAL (fs::file_size (file), content.size ());
+  BOOST_CHECK (readFile (file) == content);
+  BOOST_CHECK_EQUAL (fs::last_write_time (file), 1000000000);
+#if BOOST_VERSION >= 104900
+  BOOST_CHECK_EQUAL (fs::status (file).permissions (), static_cast<fs::perms> (0640));
+#endif
+
+  // replacing an existing file with shorter content
+  fs::path copy = ROOT / "copy.txt";
+  BOOST_REQUIRE (materializer.Begin (copy));
+  BOOST_CHECK (materializer.WriteFile (file));
+  BOOST_CHECK (materializer.End ());
+  BOOST_REQUIRE (materializer.Begin (file, content.size ()));
+  BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> ("short"), 5));
+  BOOST_CHECK (materializer.End ());
+  BOOST_CHECK_EQUAL (fs::file_size (file), content.size ());
+  BOOST_CHECK (materializer.Commit ());
+  BOOST_CHECK_EQUAL (readFile (file), "short");
+  BOOST_CHECK (readFile (copy) == content);
+
+  // copy appended to already written content, and content written after a copy
+  fs::path appended = ROOT / "appended.txt";
+  BOOST_REQUIRE (materializer.Begin (appended));
+  BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> ("head|"), 5));
+  BOOST_CHECK (materializer.WriteFile (copy));
+  BOOST_CHECK (materializer.End ());
+  BOOST_CHECK (materializer.Commit ());
+  BOOST_CHECK (readFile (appended) == "head|" + content);
+
+  BOOST_REQUIRE (materializer.Begin (copy));
+  BOOST_CHECK (materializer.WriteFile (appended));
+  BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> ("|tail"), 5));
+  BOOST_CHECK (materializer.End ());
+  BOOST_CHECK (materializer.Commit ());
+  BOOST_CHECK (readFile (copy) == "head|" + content + "|tail");
+
+  // aborted file leaves no traces
+  fs::path aborted = ROOT / "aborted.txt";
+  BOOST_REQUIRE (materializer.Begin (aborted, 100));
+  BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> ("data"), 4));
+  materializer.Abort ();
+  BOOST_CHECK (materializer.Commit ());
+  BOOST_CHECK (!fs::exists (aborted));
+  BOOST_CHECK_EQUAL (countHidden (ROOT), 0);
+
+  // adopting a file written elsewhere
+  fs::path temp = ROOT / "temp";
+  {
+    fs::ofstream out (temp);
+    out << "adopted";
+  }
+  fs::path adopted = ROOT / "new-dir" / "adopted.txt";
+  BOOST_CHECK (materializer.Adopt (temp, adopted, 0, -1, bind (countCommitted, &committed)));
+  BOOST_CHECK (materializer.Commit ());
+  BOOST_CHECK_EQUAL (committed, 2);
+  BOOST_CHECK (!fs::exists (temp));
+  BOOST_CHECK_EQUAL (readFile (adopted), "adopted");
+
+  fs::remove_all (ROOT);
+}
+
+BOOST_AUTO_TEST_CASE (BatchLimits)
+{
+  fs::remove_all (ROOT);
+
+  {
+    FileMaterializer materializer (3, 1024 * 1024);
+    for (int i = 0; i < 3; i++)
+      {
+        BOOST_CHECK (!materializer.IsBatchFull ());
+        BOOST_REQUIRE (materializer.Begin (ROOT / lexical_cast<string> (i)));
+        BOOST_CHECK (materializer.Write (reinterpret_cast<const uint8_t*> ("x"), 1));
+        BOOST_CHECK (materializer.End ());
+      }
+    BOOST_CHECK (materializer.IsBatchFull ());
+    BOOST_CHECK (materializer.Commit ());
+    BOOST_CHECK (!materializer.IsBatchFull ());
+
+    vector<uint8_t> big (1024 * 1024, 'y');
+    BOOST_REQUIRE (materializer.Begin (ROOT / "big"));
+    BOOST_CHECK (materializer.Write (&big[0], big.size ()));
+    BOOST_CHECK (materializer.End ());
+    BOOST_CHECK (materializer.IsBatchFull ());
+
+    // file being written is discarded, pending files are committed on destruction
+    BOOST_REQUIRE (materializer.Begin (ROOT / "unfinished"));
+  }
+
+  BOOST_CHECK_EQUAL (fs::file_size (ROOT / "big"), 1024 * 1024);
+  BOOST_CHECK (!fs::exists (ROOT / "unfinished"));
+  BOOST_CHECK_EQUAL (countHidden (ROOT), 0);
+
+  fs::remove_all (ROOT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
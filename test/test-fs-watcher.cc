@@ -15,9 +15,12 @@ namespace fs = boost::filesystem;
 
 BOOST_AUTO_TEST_SUITE(TestFsWatcher)
 
+static int changeCount = 0;
+
 void
 onChange(set<string> &files, const fs::path &file)
 {
+  changeCount ++;
   files.insert(file.string());
 }
 
@@ -69,8 +72,8 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
 
   // ============ check create file detection ================
   create_file(dir / "test.txt", "hello");
-  // have to at least wait 0.5 seconds
-  usleep(600000);
+  // have to at least wait 0.5 seconds (scan) + 1 second (write settle) + 0.5 seconds (settle check)
+  usleep(2100000);
   // test.txt
   BOOST_CHECK_EQUAL(files.size(), 1);
   BOOST_CHECK(files.find("test.txt") != files.end());
@@ -83,8 +86,8 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
     string filename = boost::lexical_cast<string>(i);
     create_file(subdir / filename.c_str(), boost::lexical_cast<string>(i));
   }
-  // have to at least wait 0.5 * 2 seconds
-  usleep(1100000);
+  // have to at least wait 0.5 * 2 seconds + 1 second (write settle) + 0.5 seconds (settle check)
+  usleep(2600000);
   // test.txt
   // sub/0..9
   BOOST_CHECK_EQUAL(files.size(), 11);
@@ -103,8 +106,8 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
     string filename = boost::lexical_cast<string>(i);
     fs::copy_file(subdir / filename.c_str(), subdir1 / filename.c_str());
   }
-  // have to at least wait 0.5 * 2 seconds
-  usleep(1100000);
+  // have to at least wait 0.5 * 2 seconds + 1 second (write settle) + 0.5 seconds (settle check)
+  usleep(2600000);
   // test.txt
   // sub/0..9
   // sub1/sub2/0..4
@@ -159,7 +162,7 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
     string filename = boost::lexical_cast<string>(i);
     fs::rename(subdir / filename.c_str(), dir / filename.c_str());
   }
-  usleep(1100000);
+  usleep(2600000);
   // test.txt
   // 7
   // 8
@@ -174,7 +177,7 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
   }
 
   create_file(dir / "add-removal-check.txt", "add-removal-check");
-  usleep(1200000);
+  usleep(2100000);
   BOOST_CHECK (files.find("add-removal-check.txt") != files.end());
 
   fs::remove (dir / "add-removal-check.txt");
@@ -182,7 +185,7 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
   BOOST_CHECK (files.find("add-removal-check.txt") == files.end());
 
   create_file(dir / "add-removal-check.txt", "add-removal-check");
-  usleep(1200000);
+  usleep(2100000);
   BOOST_CHECK (files.find("add-removal-check.txt") != files.end());
 
   fs::remove (dir / "add-removal-check.txt");
@@ -190,13 +193,20 @@ BOOST_AUTO_TEST_CASE (TestFsWatcher)
   BOOST_CHECK (files.find("add-removal-check.txt") == files.end());
 
   create_file(dir / "add-removal-check.txt", "add-removal-check");
-  usleep(1200000);
+  usleep(2100000);
   BOOST_CHECK (files.find("add-removal-check.txt") != files.end());
 
   fs::remove (dir / "add-removal-check.txt");
   usleep(1200000);
   BOOST_CHECK (files.find("add-removal-check.txt") == files.end());
 
+  // ============ check that unchanged files are not reported again ================
+  int changesBefore = changeCount;
+  create_file(dir / "one-more.txt", "one more"); // other files in the directory stay untouched
+  usleep(2100000);
+  BOOST_CHECK (files.find("one-more.txt") != files.end());
+  BOOST_CHECK_EQUAL (changeCount - changesBefore, 1);
+
   // cleanup
   if (fs::exists(dir))
   {
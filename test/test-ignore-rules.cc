@@ -0,0 +1,126 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "ignore-rules.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+INIT_LOGGER ("Test.IgnoreRules");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestIgnoreRules)
+
+static void
+writeFile (const fs::path &path, const string &content)
+{
+  fs::ofstream out (path);
+  out << content;
+}
+
+BOOST_AUTO_TEST_CASE (Patterns)
+{
+  IgnoreRules::RuleSet rules;
+  rules.Add ("# comment");
+  rules.Add ("");
+  rules.Add ("node_modules/");
+  rules.Add ("*.o");
+  rules.Add ("*.tar.gz");
+  rules.Add ("core");
+  rules.Add ("/build");
+  rules.Add ("docs/**/*.pdf");
+  rules.Add ("tmp-??");
+  rules.Add ("*~");
+  rules.Add ("*rc");
+
+  BOOST_CHECK_EQUAL (rules.Match ("node_modules", true), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("a/b/node_modules", true), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("node_modules", false), IgnoreRules::RuleSet::NO_MATCH);
+  BOOST_CHECK_EQUAL (rules.Match ("src/main.o", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("src/main.cc", false), IgnoreRules::RuleSet::NO_MATCH);
+  BOOST_CHECK_EQUAL (rules.Match ("backup.2013.tar.gz", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("x/core", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("core.c", false), IgnoreRules::RuleSet::NO_MATCH);
+  BOOST_CHECK_EQUAL (rules.Match ("build", true), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("src/build", true), IgnoreRules::RuleSet::NO_MATCH);
+  BOOST_CHECK_EQUAL (rules.Match ("docs/a.pdf", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("docs/x/y/a.pdf", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("other/a.pdf", false), IgnoreRules::RuleSet::NO_MATCH);
+  BOOST_CHECK_EQUAL (rules.Match ("tmp-01", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("tmp-001", false), IgnoreRules::RuleSet::NO_MATCH);
+  // suffixes that do not start with a dot
+  BOOST_CHECK_EQUAL (rules.Match ("notes.txt~", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("home/.bashrc", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("vimrc", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (rules.Match ("rc.local", false), IgnoreRules::RuleSet::NO_MATCH);
+
+  // with negation, the last matching rule decides
+  IgnoreRules::RuleSet negated;
+  negated.Add ("*.log");
+  negated.Add ("!important.log");
+  negated.Add ("\\!literal");
+  BOOST_CHECK_EQUAL (negated.Match ("debug.log", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (negated.Match ("important.log", false), IgnoreRules::RuleSet::INCLUDE);
+  BOOST_CHECK_EQUAL (negated.Match ("!literal", false), IgnoreRules::RuleSet::IGNORE);
+  BOOST_CHECK_EQUAL (negated.Match ("readme", false), IgnoreRules::RuleSet::NO_MATCH);
+}
+
+BOOST_AUTO_TEST_CASE (RuleFiles)
+{
+  fs::path dir = fs::absolute ("TestIgnoreRules");
+  fs::remove_all (dir);
+  fs::create_directories (dir / "project" / "node_modules" / "lib");
+  fs::create_directories (dir / "project" / "logs");
+
+  writeFile (dir / IgnoreRules::FILE_NAME, "node_modules/\n*.log\n");
+  writeFile (dir / "project" / IgnoreRules::FILE_NAME, "!keep.log\nlogs/\n");
+
+  IgnoreRules rules (dir);
+  BOOST_CHECK (rules.IsIgnored ("project/node_modules", true));
+  BOOST_CHECK (rules.IsIgnored ("project/node_modules/lib/index.js", false));
+  BOOST_CHECK (!rules.IsIgnoredEntry ("project/node_modules/lib/index.js", false)); // parents are not checked
+  BOOST_CHECK (rules.IsIgnored ("debug.log", false));
+  BOOST_CHECK (rules.IsIgnored ("project/debug.log", false));
+  BOOST_CHECK (!rules.IsIgnored ("project/keep.log", false)); // re-included by the deeper rule file
+  BOOST_CHECK (rules.IsIgnored ("keep.log", false));
+  BOOST_CHECK (rules.IsIgnored ("project/logs/keep.log", false)); // parent directory is excluded
+  BOOST_CHECK (!rules.IsIgnored ("project/main.cc", false));
+
+  // rules are cached until invalidated
+  writeFile (dir / "project" / IgnoreRules::FILE_NAME, "*.cc\n");
+  BOOST_CHECK (!rules.IsIgnored ("project/main.cc", false));
+  rules.Invalidate ("project");
+  BOOST_CHECK (rules.IsIgnored ("project/main.cc", false));
+  BOOST_CHECK (rules.IsIgnored ("project/keep.log", false));
+
+  fs::remove (dir / IgnoreRules::FILE_NAME);
+  rules.Invalidate ("");
+  BOOST_CHECK (!rules.IsIgnored ("project/node_modules", true));
+
+  fs::remove_all (dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
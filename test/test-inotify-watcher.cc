@@ -0,0 +1,138 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "logging.h"
+#include "inotify-watcher.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+INIT_LOGGER ("Test.InotifyWatcher");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+#ifdef HAVE_INOTIFY
+
+BOOST_AUTO_TEST_SUITE(TestInotifyWatcher)
+
+static const InotifyWatcher::Event *
+findEvent (const InotifyWatcher::Events &events, InotifyWatcher::Event::Type type, const fs::path &path)
+{
+  for (InotifyWatcher::Events::const_iterator event = events.begin (); event != events.end (); event++)
+    {
+      if (event->m_type == type && event->m_path == path)
+        return &*event;
+    }
+  return 0;
+}
+
+static void
+writeFile (const fs::path &path, const string &content)
+{
+  fs::ofstream out (path);
+  out << content;
+}
+
+BOOST_AUTO_TEST_CASE (FileEvents)
+{
+  fs::path dir = fs::absolute ("TestInotifyWatcher");
+  fs::remove_all (dir);
+  fs::create_directories (dir / "sub");
+
+  InotifyWatcher watcher;
+  BOOST_CHECK (watcher.AddDirectory (dir));
+  BOOST_CHECK (watcher.AddDirectory (dir)); // no duplicate watches
+  BOOST_CHECK (watcher.AddDirectory (dir / "sub"));
+  BOOST_CHECK_EQUAL (watcher.GetWatchCount (), 2);
+
+  BOOST_CHECK_EQUAL (watcher.ReadEvents ().size (), 0);
+
+  writeFile (dir / "file.txt", "hello");
+  writeFile (dir / "sub" / "nested.txt", "world");
+
+  InotifyWatcher::Events events = watcher.ReadEvents ();
+  BOOST_CHECK (findEvent (events, InotifyWatcher::Event::CHANGED, dir / "file.txt") != 0);
+  BOOST_CHECK (findEvent (events, InotifyWatcher::Event::CHANGED, dir / "sub" / "nested.txt") != 0);
+
+  // rename is a single event
+  fs::rename (dir / "file.txt", dir / "sub" / "renamed.txt");
+  events = watcher.ReadEvents ();
+  BOOST_REQUIRE_EQUAL (events.size (), 1);
+  BOOST_CHECK_EQUAL (events[0].m_type, InotifyWatcher::Event::MOVED);
+  BOOST_CHECK_EQUAL (events[0].m_oldPath, dir / "file.txt");
+  BOOST_CHECK_EQUAL (events[0].m_path, dir / "sub" / "renamed.txt");
+  BOOST_CHECK (!events[0].m_isDirectory);
+
+  fs::remove (dir / "sub" / "nested.txt");
+  events = watcher.ReadEvents ();
+  BOOST_CHECK (findEvent (events, InotifyWatcher::Event::REMOVED, dir / "sub" / "nested.txt") != 0);
+
+  fs::remove_all (dir);
+}
+
+BOOST_AUTO_TEST_CASE (DirectoryEvents)
+{
+  fs::path dir = fs::absolute ("TestInotifyWatcher");
+  fs::path outside = fs::absolute ("TestInotifyWatcher-outside");
+  fs::remove_all (dir);
+  fs::remove_all (outside);
+  fs::create_directories (dir / "a" / "b");
+  fs::create_directories (outside);
+
+  InotifyWatcher watcher;
+  watcher.AddDirectory (dir);
+  watcher.AddDirectory (dir / "a");
+  watcher.AddDirectory (dir / "a" / "b");
+
+  // watches follow renamed directories
+  fs::rename (dir / "a", dir / "c");
+  InotifyWatcher::Events events = watcher.ReadEvents ();
+  BOOST_REQUIRE_EQUAL (events.size (), 1);
+  BOOST_CHECK_EQUAL (events[0].m_type, InotifyWatcher::Event::MOVED);
+  BOOST_CHECK (events[0].m_isDirectory);
+  BOOST_CHECK (watcher.IsWatched (dir / "c" / "b"));
+  BOOST_CHECK (!watcher.IsWatched (dir / "a" / "b"));
+
+  writeFile (dir / "c" / "b" / "file.txt", "content");
+  events = watcher.ReadEvents ();
+  BOOST_CHECK (findEvent (events, InotifyWatcher::Event::CHANGED, dir / "c" / "b" / "file.txt") != 0);
+
+  fs::create_directory (dir / "new");
+  events = watcher.ReadEvents ();
+  const InotifyWatcher::Event *created = findEvent (events, InotifyWatcher::Event::CHANGED, dir / "new");
+  BOOST_REQUIRE (created != 0);
+  BOOST_CHECK (created->m_isDirectory);
+
+  // moved out of the tree: removal, watches are dropped
+  fs::rename (dir / "c", outside / "c");
+  events = watcher.ReadEvents ();
+  BOOST_CHECK (findEvent (events, InotifyWatcher::Event::REMOVED, dir / "c") != 0);
+  BOOST_CHECK_EQUAL (watcher.GetWatchCount (), 1);
+
+  fs::remove_all (dir);
+  fs::remove_all (outside);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // HAVE_INOTIFY
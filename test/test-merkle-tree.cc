@@ -0,0 +1,103 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "merkle-tree.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/lexical_cast.hpp>
+
+INIT_LOGGER ("Test.MerkleTree");
+
+using namespace std;
+using namespace boost;
+
+BOOST_AUTO_TEST_SUITE(TestMerkleTree)
+
+static string
+segment (uint64_t index)
+{
+  return "segment-" + lexical_cast<string> (index);
+}
+
+BOOST_AUTO_TEST_CASE (ProofsOfAllShapes)
+{
+  // powers of two, odd counts with promoted nodes, and a single leaf (empty proof)
+  uint64_t counts[] = { 1, 2, 3, 5, 8, 13, 64, 100 };
+  for (size_t c = 0; c < sizeof (counts) / sizeof (counts[0]); c++)
+    {
+      MerkleTree tree;
+      for (uint64_t i = 0; i < counts[c]; i++)
+        {
+          string data = segment (i);
+          tree.AddLeaf (data.c_str (), data.size ());
+        }
+      BOOST_CHECK_EQUAL (tree.GetLeafCount (), counts[c]);
+
+      HashPtr root = tree.GetRoot ();
+      BOOST_CHECK_EQUAL (root->GetHashBytes (), 32);
+      BOOST_CHECK (*tree.GetRoot () == *root);
+
+      // root can be recovered from any leaf with its proof
+      string first = segment (0);
+      HashPtr recovered = MerkleTree::ComputeRoot (Digest::SHA256, counts[c], 0, first.c_str (), first.size (), tree.GetProof (0));
+      BOOST_CHECK (*recovered == *root);
+
+      for (uint64_t i = 0; i < counts[c]; i++)
+        {
+          string data = segment (i);
+          string proof = tree.GetProof (i);
+          BOOST_CHECK_LE (proof.size (), 32 * 7);
+          BOOST_CHECK (MerkleTree::Verify (*root, counts[c], i, data.c_str (), data.size (), proof));
+
+          // wrong content, wrong position, wrong number of leaves
+          string bad = data + "x";
+          BOOST_CHECK (!MerkleTree::Verify (*root, counts[c], i, bad.c_str (), bad.size (), proof));
+          BOOST_CHECK (!MerkleTree::Verify (*root, counts[c], counts[c], data.c_str (), data.size (), proof));
+          if (counts[c] > 1)
+            {
+              BOOST_CHECK (!MerkleTree::Verify (*root, counts[c], (i + 1) % counts[c], data.c_str (), data.size (), proof));
+              BOOST_CHECK (!MerkleTree::Verify (*root, counts[c], i, data.c_str (), data.size (), proof.substr (1)));
+              BOOST_CHECK (!MerkleTree::Verify (*root, counts[c] * 2, i, data.c_str (), data.size (), proof));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (LeafIsNotNode)
+{
+  MerkleTree tree;
+  tree.AddLeaf ("a", 1);
+  tree.AddLeaf ("b", 1);
+  HashPtr root = tree.GetRoot ();
+
+  // single-leaf tree over concatenation of the children digests must not collide with the root
+  string children = tree.GetProof (1) + tree.GetProof (0);
+  MerkleTree forged;
+  forged.AddLeaf (children.c_str (), children.size ());
+  BOOST_CHECK (!(*forged.GetRoot () == *root));
+
+  MerkleTree empty;
+  BOOST_CHECK_EQUAL (empty.GetRoot ()->GetHashBytes (), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
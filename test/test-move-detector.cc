@@ -0,0 +1,90 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "logging.h"
+#include "move-detector.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+INIT_LOGGER ("Test.MoveDetector");
+
+using namespace std;
+using namespace boost;
+namespace pt = boost::posix_time;
+
+BOOST_AUTO_TEST_SUITE(TestMoveDetector)
+
+BOOST_AUTO_TEST_CASE (MatchRemovedAndAdded)
+{
+  MoveDetector detector (2.0);
+  pt::ptime now = pt::time_from_string ("2013-01-01 00:00:00");
+
+  Hash hash1 ("1111", 4);
+  Hash hash2 ("2222", 4);
+
+  detector.AddRemoved ("a/file1", hash1, 100, 1, now);
+  detector.AddRemoved ("b/file2", hash2, 200, 2, now);
+  detector.AddRemoved ("c/copy1", hash1, 150, 1, now);
+  BOOST_CHECK_EQUAL (detector.GetPendingCount (), 3);
+
+  MoveDetector::Removal removal;
+  BOOST_CHECK (!detector.MatchAdded (Hash ("3333", 4), 100, removal));
+
+  // same mtime is preferred among files with the same content
+  BOOST_REQUIRE (detector.MatchAdded (hash1, 150, removal));
+  BOOST_CHECK_EQUAL (removal.m_filename, "c/copy1");
+  BOOST_CHECK_EQUAL (removal.m_segNum, 1);
+
+  // otherwise the earliest removal
+  BOOST_CHECK (detector.MatchAdded (hash1, 999, removal));
+  BOOST_CHECK_EQUAL (removal.m_filename, "a/file1");
+  BOOST_CHECK (!detector.MatchAdded (hash1, 100, removal));
+
+  BOOST_CHECK_EQUAL (detector.GetPendingCount (), 1);
+  BOOST_CHECK (detector.Cancel ("b/file2"));
+  BOOST_CHECK (!detector.Cancel ("b/file2"));
+  BOOST_CHECK (!detector.MatchAdded (hash2, 200, removal));
+}
+
+BOOST_AUTO_TEST_CASE (ExpireRemovals)
+{
+  MoveDetector detector (2.0);
+  pt::ptime now = pt::time_from_string ("2013-01-01 00:00:00");
+
+  detector.AddRemoved ("file1", Hash ("1111", 4), 100, 1, now);
+  detector.AddRemoved ("file2", Hash ("2222", 4), 100, 1, now + pt::seconds (1));
+  // removed again, window starts over
+  detector.AddRemoved ("file1", Hash ("1111", 4), 100, 1, now + pt::seconds (1));
+  BOOST_CHECK_EQUAL (detector.GetPendingCount (), 2);
+
+  BOOST_CHECK_EQUAL (detector.TakeExpired (now + pt::seconds (2)).size (), 0);
+
+  MoveDetector::Removals expired = detector.TakeExpired (now + pt::seconds (3));
+  BOOST_REQUIRE_EQUAL (expired.size (), 2);
+  BOOST_CHECK_EQUAL (detector.GetPendingCount (), 0);
+
+  detector.AddRemoved ("file3", Hash ("3333", 4), 100, 1, now);
+  BOOST_CHECK_EQUAL (detector.TakeAll ().size (), 1);
+  BOOST_CHECK_EQUAL (detector.GetPendingCount (), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
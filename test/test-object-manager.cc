@@ -19,11 +19,15 @@
  *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
  */
 
+
 #include "logging.h"
 #include "object-manager.h"
+#include "object-db.h"
+#include "merkle-tree.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <boost/test/unit_test.hpp>
 #include <unistd.h>
@@ -33,7 +37,6 @@
 
 INIT_LOGGER ("Test.ObjectManager");
 
-using namespace Ccnx;
 using namespace std;
 using namespace boost;
 namespace fs = boost::filesystem;
@@ -46,14 +49,14 @@ BOOST_AUTO_TEST_CASE (ObjectManagerTest)
 
   fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
   _LOG_DEBUG ("tmpdir: " << tmpdir);
-  Name deviceName ("/device");
+  ndn::Name deviceName ("/device");
 
-  CcnxWrapperPtr ccnx = make_shared<CcnxWrapper> ();
-  ObjectManager manager (ccnx, tmpdir, "test-chronoshare");
+  ObjectManager manager (tmpdir, "test-chronoshare");
 
-  tuple<HashPtr,int> hash_semgents = manager.localFileToObjects (fs::path("test") / "test-object-manager.cc", deviceName);
+  boost::tuple<HashPtr,int,HashPtr> hash_semgents = manager.localFileToObjects (fs::path("test") / "test-object-manager.cc", deviceName);
 
-  BOOST_CHECK_EQUAL (hash_semgents.get<1> (), 3);
+  BOOST_CHECK_EQUAL (hash_semgents.get<1> (), (fs::file_size (fs::path("test") / "test-object-manager.cc") + 1023) / 1024);
+  BOOST_CHECK_EQUAL (hash_semgents.get<2> ()->GetHashBytes (), 32);
 
   bool ok = manager.objectsToLocalFile (deviceName, *hash_semgents.get<0> (), tmpdir / "test.cc");
   BOOST_CHECK_EQUAL (ok, true);
@@ -72,5 +75,31 @@ BOOST_AUTO_TEST_CASE (ObjectManagerTest)
   remove_all (tmpdir);
 }
 
+BOOST_AUTO_TEST_CASE (SegmentProofTest)
+{
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+  ndn::Name deviceName ("/device");
+
+  ObjectManager manager (tmpdir, "test-chronoshare");
+  BOOST_CHECK_EQUAL (manager.GetSigningMode (), ObjectManager::SIGN_DIGEST);
+
+  HashPtr hash, root;
+  size_t segments;
+  boost::tie (hash, segments, root) = manager.localFileToObjects (fs::path("test") / "test-object-manager.cc", deviceName);
+
+  ObjectDb db (tmpdir / ".chronoshare", lexical_cast<string> (*hash));
+  BOOST_CHECK (*manager.segmentRoot (deviceName, *hash, segments) == *root);
+
+  // every saved segment is authenticated by the root (published as segment_root of the action)
+  for (size_t i = 0; i < segments; i++)
+    {
+      string proof;
+      ndn::BufferPtr segment = db.fetchSegment (deviceName, i, proof);
+      BOOST_REQUIRE (segment);
+      BOOST_CHECK (MerkleTree::Verify (*root, segments, i, segment->buf (), segment->size (), proof));
+    }
+
+  remove_all (tmpdir);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
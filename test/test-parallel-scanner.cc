@@ -0,0 +1,156 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "parallel-scanner.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <set>
+
+INIT_LOGGER ("Test.ParallelScanner");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestParallelScanner)
+
+static void
+writeFile (const fs::path &path, const string &content)
+{
+  fs::ofstream out (path);
+  out << content;
+}
+
+static bool
+isExcluded (const fs::path &path, bool isDirectory)
+{
+  string name = path.filename ().string ();
+  return name[0] == '.' || (isDirectory && name == "excluded");
+}
+
+struct Collector
+{
+  Collector () : m_batches (0), m_directories (0), m_files (0) { }
+
+  void
+  onBatch (const ParallelScanner::Entries &entries)
+  {
+    m_batches ++;
+    for (ParallelScanner::Entries::const_iterator entry = entries.begin (); entry != entries.end (); entry++)
+      {
+        if (entry->m_isDirectory)
+          m_foundDirectories.insert (entry->m_path.generic_string ());
+        else
+          m_foundFiles[entry->m_path.generic_string ()] = entry->m_fingerprint;
+      }
+  }
+
+  void
+  onProgress (size_t directories, size_t files)
+  {
+    m_directories = directories;
+    m_files = files;
+  }
+
+  size_t m_batches;
+  size_t m_directories;
+  size_t m_files;
+  set<string> m_foundDirectories;
+  map<string, FileFingerprint> m_foundFiles;
+};
+
+BOOST_AUTO_TEST_CASE (ScanTree)
+{
+  fs::path dir = fs::absolute ("TestParallelScanner");
+  fs::remove_all (dir);
+
+  // 10 directories with 2 levels of subdirectories, 5 files in each
+  set<string> files;
+  for (int i = 0; i < 10; i++)
+    {
+      for (int j = 0; j < 3; j++)
+        {
+          fs::path sub = fs::path (lexical_cast<string> (i)) / lexical_cast<string> (j);
+          fs::create_directories (dir / sub);
+          for (int k = 0; k < 5; k++)
+            {
+              fs::path file = sub / ("file-" + lexical_cast<string> (k));
+              writeFile (dir / file, string (k, 'a'));
+              files.insert (file.generic_string ());
+            }
+        }
+    }
+  writeFile (dir / "top", "top");
+  files.insert ("top");
+
+  // not reported
+  writeFile (dir / ".hidden", "hidden");
+  fs::create_directories (dir / "excluded");
+  writeFile (dir / "excluded" / "file", "excluded");
+  fs::create_symlink (dir / "top", dir / "link");
+  fs::create_directory_symlink (dir / "0", dir / "dirlink");
+
+  ParallelScanner scanner (4, 16);
+  Collector collector;
+  scanner.Scan (dir, isExcluded,
+                bind (&Collector::onBatch, &collector, _1),
+                bind (&Collector::onProgress, &collector, _1, _2));
+
+  BOOST_CHECK_EQUAL (collector.m_foundFiles.size (), files.size ());
+  for (set<string>::iterator file = files.begin (); file != files.end (); file++)
+    {
+      BOOST_CHECK_MESSAGE (collector.m_foundFiles.find (*file) != collector.m_foundFiles.end (), *file);
+    }
+  BOOST_CHECK_EQUAL (collector.m_foundFiles["top"].m_size, 3);
+  BOOST_CHECK_EQUAL (collector.m_foundFiles["5/2/file-4"].m_size, 4);
+
+  BOOST_CHECK_EQUAL (collector.m_foundDirectories.size (), 40);
+  BOOST_CHECK (collector.m_foundDirectories.find ("9/1") != collector.m_foundDirectories.end ());
+  BOOST_CHECK (collector.m_foundDirectories.find ("excluded") == collector.m_foundDirectories.end ());
+
+  // delivered in batches, totals are reported
+  BOOST_CHECK_GT (collector.m_batches, 1);
+  BOOST_CHECK_EQUAL (collector.m_files, files.size ());
+  BOOST_CHECK_EQUAL (collector.m_directories, 41);
+
+  // fingerprint changes when the file is modified
+  struct stat info;
+  BOOST_REQUIRE_EQUAL (stat ((dir / "top").c_str (), &info), 0);
+  BOOST_CHECK (FileFingerprint (info) == collector.m_foundFiles["top"]);
+  writeFile (dir / "top", "modified");
+  BOOST_REQUIRE_EQUAL (stat ((dir / "top").c_str (), &info), 0);
+  BOOST_CHECK (!(FileFingerprint (info) == collector.m_foundFiles["top"]));
+
+  // scanner can be reused
+  Collector again;
+  scanner.Scan (dir / "3", isExcluded, bind (&Collector::onBatch, &again, _1));
+  BOOST_CHECK_EQUAL (again.m_foundFiles.size (), 15);
+  BOOST_CHECK (again.m_foundFiles.find ("1/file-0") != again.m_foundFiles.end ());
+
+  fs::remove_all (dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,155 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "rate-limiter.h"
+
+#include "logging.h"
+
+INIT_LOGGER ("Test.RateLimiter");
+
+using namespace boost;
+using namespace boost::posix_time;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(TestRateLimiter)
+
+BOOST_AUTO_TEST_CASE (TokenBucketDelay)
+{
+  INIT_LOGGERS ();
+
+  ptime start = microsec_clock::universal_time ();
+
+  TokenBucket unlimited;
+  unlimited.Consume (1000000, start);
+  BOOST_CHECK_EQUAL (unlimited.GetDelay (start), 0);
+
+  // 1000 bytes/s, burst of 500 bytes
+  TokenBucket bucket (1000, 500);
+  bucket.Consume (500, start);
+  BOOST_CHECK_EQUAL (bucket.GetDelay (start), 0);
+
+  // 1000 bytes in debt: one second to wait
+  bucket.Consume (1000, start);
+  BOOST_CHECK_CLOSE (bucket.GetDelay (start), 1.0, 0.001);
+  BOOST_CHECK_CLOSE (bucket.GetDelay (start + milliseconds (250)), 0.75, 0.001);
+  BOOST_CHECK_EQUAL (bucket.GetDelay (start + seconds (1)), 0);
+
+  // idle time does not accumulate more than the burst
+  bucket.Consume (1500, start + seconds (10));
+  BOOST_CHECK_CLOSE (bucket.GetDelay (start + seconds (10)), 1.0, 0.001);
+
+  // removing the limit clears the debt
+  bucket.SetRate (0);
+  BOOST_CHECK_EQUAL (bucket.GetDelay (start + seconds (10)), 0);
+}
+
+BOOST_AUTO_TEST_CASE (RateLimiterPeers)
+{
+  INIT_LOGGERS ();
+
+  ndn::Name alice ("/alice");
+  ndn::Name bob ("/bob");
+
+  RateLimiter limiter;
+  BOOST_CHECK_EQUAL (limiter.Consume (alice, 10000000), 0);
+  BOOST_CHECK_EQUAL (limiter.GetDelay (ndn::Name ()), 0);
+
+  // per-peer limit applies only to the specific peer
+  limiter.SetPeerRate (alice, 1000);
+  BOOST_CHECK_EQUAL (limiter.Consume (alice, 500), 0); // within burst
+  BOOST_CHECK_GT (limiter.Consume (alice, 1000), 0.5);
+  BOOST_CHECK_GT (limiter.GetDelay (alice), 0.5);
+  BOOST_CHECK_EQUAL (limiter.GetDelay (bob), 0);
+  BOOST_CHECK_EQUAL (limiter.Consume (bob, 10000000), 0);
+
+  // global limit applies to everybody
+  limiter.SetGlobalRate (1000);
+  BOOST_CHECK_EQUAL (limiter.Consume (bob, 500), 0);
+  BOOST_CHECK_GT (limiter.Consume (bob, 2000), 1.5);
+  BOOST_CHECK_GT (limiter.GetDelay (ndn::Name ()), 1.5);
+
+  limiter.SetGlobalRate (0);
+  limiter.SetPeerRate (alice, 0);
+  BOOST_CHECK_EQUAL (limiter.GetDelay (alice), 0);
+  BOOST_CHECK_EQUAL (limiter.GetDelay (bob), 0);
+}
+
+BOOST_AUTO_TEST_CASE (RateLimiterSchedule)
+{
+  INIT_LOGGERS ();
+
+  RateLimiter limiter;
+
+  // schedule covering the whole day overrides the unlimited global rate
+  limiter.AddSchedule (0, 24 * 60, 1000);
+  BOOST_CHECK_EQUAL (limiter.Consume (ndn::Name (), 500), 0);
+  BOOST_CHECK_GT (limiter.Consume (ndn::Name (), 1000), 0.5);
+
+  limiter.ClearSchedule ();
+  BOOST_CHECK_EQUAL (limiter.GetDelay (ndn::Name ()), 0);
+}
+
+BOOST_AUTO_TEST_CASE (RateLimiterTextLimits)
+{
+  INIT_LOGGERS ();
+
+  ndn::Name alice ("/alice");
+  ndn::Name bob ("/bob");
+
+  RateLimiter limiter;
+  BOOST_CHECK (!limiter.SetLimit (""));
+  BOOST_CHECK (!limiter.SetLimit ("fast"));
+  BOOST_CHECK (!limiter.SetLimit ("-1"));
+  BOOST_CHECK (!limiter.SetLimit ("/alice=fast"));
+  BOOST_CHECK (!limiter.SetLimit ("8:00=10"));
+  BOOST_CHECK (!limiter.SetLimit ("8:00-25:00=10"));
+  BOOST_CHECK (!limiter.SetLimit ("8:60-9:00=10"));
+  BOOST_CHECK_EQUAL (limiter.Consume (alice, 10000000), 0);
+
+  // rates are in KiB/s: 1 KiB/s with burst of 512 bytes
+  BOOST_CHECK (limiter.SetLimit ("/alice=1"));
+  BOOST_CHECK_EQUAL (limiter.Consume (alice, 512), 0);
+  BOOST_CHECK_CLOSE (limiter.Consume (alice, 1024), 1.0, 1);
+  BOOST_CHECK_EQUAL (limiter.GetDelay (bob), 0);
+
+  BOOST_CHECK (limiter.SetLimit ("*=1"));
+  BOOST_CHECK_EQUAL (limiter.Consume (bob, 512), 0);
+  BOOST_CHECK_GT (limiter.Consume (bob, 1024), 0.5);
+
+  limiter.Reset ();
+  BOOST_CHECK_EQUAL (limiter.GetDelay (alice), 0);
+  BOOST_CHECK_EQUAL (limiter.GetDelay (bob), 0);
+
+  BOOST_CHECK (limiter.SetLimit ("0:00-24:00=1"));
+  BOOST_CHECK_EQUAL (limiter.Consume (ndn::Name (), 512), 0);
+  BOOST_CHECK_GT (limiter.Consume (ndn::Name (), 1024), 0.5);
+
+  limiter.Reset ();
+  BOOST_CHECK (limiter.SetLimit ("1"));
+  BOOST_CHECK_EQUAL (limiter.Consume (ndn::Name (), 512), 0);
+  BOOST_CHECK_GT (limiter.Consume (ndn::Name (), 1024), 0.5);
+
+  BOOST_CHECK (limiter.SetLimit ("0"));
+  BOOST_CHECK_EQUAL (limiter.GetDelay (ndn::Name ()), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
@@ -0,0 +1,84 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "receive-window.h"
+
+#include "logging.h"
+
+#include <vector>
+#include <algorithm>
+
+INIT_LOGGER ("Test.ReceiveWindow");
+
+using namespace boost;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(TestReceiveWindow)
+
+BOOST_AUTO_TEST_CASE (ReceiveWindowBasic)
+{
+  INIT_LOGGERS ();
+
+  ReceiveWindow window (10, 64);
+  BOOST_CHECK_EQUAL (window.GetBase (), 10);
+  BOOST_CHECK (window.IsReceived (9));
+  BOOST_CHECK (!window.IsReceived (10));
+
+  for (int64_t i = 10; i < 20; i++)
+    window.SetInFlight (i, true);
+  BOOST_CHECK_EQUAL (window.GetInFlightCount (), 10);
+  BOOST_CHECK (window.IsInFlight (15));
+
+  BOOST_CHECK (window.MarkReceived (12));
+  BOOST_CHECK (window.MarkReceived (11));
+  BOOST_CHECK (!window.MarkReceived (11)); // duplicate
+  BOOST_CHECK_EQUAL (window.GetBase (), 10);
+  BOOST_CHECK_EQUAL (window.GetOutOfOrderCount (), 2);
+  BOOST_CHECK_EQUAL (window.GetInFlightCount (), 8);
+
+  BOOST_CHECK (window.MarkReceived (10));
+  BOOST_CHECK_EQUAL (window.GetBase (), 13);
+  BOOST_CHECK_EQUAL (window.GetOutOfOrderCount (), 0);
+  BOOST_CHECK (!window.MarkReceived (12)); // below base
+
+  window.SetInFlight (15, false);
+  BOOST_CHECK (!window.IsInFlight (15));
+  BOOST_CHECK_EQUAL (window.GetInFlightCount (), 6);
+
+  // window grows if needed, keeping the state
+  BOOST_CHECK (window.MarkReceived (13 + 1000));
+  BOOST_CHECK (window.IsInFlight (16));
+  BOOST_CHECK (window.IsReceived (13 + 1000));
+  BOOST_CHECK (!window.IsReceived (13 + 999));
+
+  for (int64_t i = 13; i < 13 + 1000; i++)
+    window.MarkReceived (i);
+  BOOST_CHECK_EQUAL (window.GetBase (), 13 + 1001);
+  BOOST_CHECK_EQUAL (window.GetInFlightCount (), 0);
+  BOOST_CHECK_EQUAL (window.GetOutOfOrderCount (), 0);
+
+  window.Reset (5);
+  BOOST_CHECK_EQUAL (window.GetBase (), 5);
+  BOOST_CHECK (!window.IsReceived (13));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
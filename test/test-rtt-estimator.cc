@@ -0,0 +1,89 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "rtt-estimator.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "logging.h"
+
+INIT_LOGGER ("Test.RttEstimator");
+
+using namespace boost;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(TestRttEstimator)
+
+BOOST_AUTO_TEST_CASE (RttEstimatorBasic)
+{
+  INIT_LOGGERS ();
+
+  RttEstimator rtt (1.0, 0.2, 10.0);
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 1.0, 0.001);
+
+  // first sample: SRTT = R, RTTVAR = R/2, RTO = SRTT + 4*RTTVAR
+  rtt.AddMeasurement (0.1);
+  BOOST_CHECK_CLOSE (rtt.GetSmoothedRtt (), 0.1, 0.001);
+  BOOST_CHECK_CLOSE (rtt.GetRttVariation (), 0.05, 0.001);
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 0.3, 0.001);
+
+  rtt.AddMeasurement (0.1);
+  BOOST_CHECK_CLOSE (rtt.GetSmoothedRtt (), 0.1, 0.001);
+  BOOST_CHECK_CLOSE (rtt.GetRttVariation (), 0.0375, 0.001);
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 0.25, 0.001);
+
+  // exponential backoff, bounded by max RTO
+  rtt.BackoffRto ();
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 0.5, 0.001);
+  for (int i = 0; i < 10; i++)
+    rtt.BackoffRto ();
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 10.0, 0.001);
+
+  // new valid sample resets backoff
+  rtt.AddMeasurement (0.1);
+  BOOST_CHECK_LT (rtt.GetRto (), 1.0);
+
+  // RTO is never below minimum
+  for (int i = 0; i < 100; i++)
+    rtt.AddMeasurement (0.001);
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 0.2, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE (RttEstimatorBackoffOncePerLossEvent)
+{
+  INIT_LOGGERS ();
+
+  RttEstimator rtt (1.0, 0.2, 10.0);
+  rtt.AddMeasurement (0.1);
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 0.3, 0.001);
+
+  // window of Interests sent together times out together
+  posix_time::ptime sendTime = posix_time::microsec_clock::universal_time ();
+  for (int i = 0; i < 5; i++)
+    rtt.BackoffRto (sendTime);
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 0.6, 0.001);
+
+  // Interest sent after the backoff belongs to a new loss event
+  rtt.BackoffRto (posix_time::microsec_clock::universal_time () + posix_time::seconds (1));
+  BOOST_CHECK_CLOSE (rtt.GetRto (), 1.2, 0.001);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
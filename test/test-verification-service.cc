@@ -0,0 +1,196 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+#include "logging.h"
+#include "verification-service.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+INIT_LOGGER ("Test.VerificationService");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestVerificationService)
+
+// DER encoding of the public key of a new RSA key
+static ndn::Buffer
+generateKey (EVP_PKEY **key)
+{
+  EVP_PKEY_CTX *context = EVP_PKEY_CTX_new_id (EVP_PKEY_RSA, NULL);
+  EVP_PKEY_keygen_init (context);
+  EVP_PKEY_CTX_set_rsa_keygen_bits (context, 2048);
+  *key = NULL;
+  EVP_PKEY_keygen (context, key);
+  EVP_PKEY_CTX_free (context);
+
+  unsigned char *der = NULL;
+  int size = i2d_PUBKEY (*key, &der);
+  ndn::Buffer publicKey (der, size);
+  OPENSSL_free (der);
+  return publicKey;
+}
+
+static ndn::Buffer
+sign (EVP_PKEY *key, const string &data)
+{
+  EVP_MD_CTX *context = EVP_MD_CTX_create ();
+  EVP_DigestSignInit (context, NULL, EVP_sha256 (), NULL, key);
+  EVP_DigestSignUpdate (context, data.c_str (), data.size ());
+
+  size_t size = 0;
+  EVP_DigestSignFinal (context, NULL, &size);
+  ndn::Buffer signature (size);
+  EVP_DigestSignFinal (context, signature.buf (), &size);
+  signature.resize (size);
+
+  EVP_MD_CTX_destroy (context);
+  return signature;
+}
+
+BOOST_AUTO_TEST_CASE (SignatureCheck)
+{
+  EVP_PKEY *key;
+  ndn::Buffer publicKey = generateKey (&key);
+
+  string data = "signed portion of the data packet";
+  ndn::Buffer signature = sign (key, data);
+  BOOST_CHECK (VerificationService::VerifySignature (publicKey, reinterpret_cast<const uint8_t*> (data.c_str ()), data.size (),
+                                                     signature.buf (), signature.size ()));
+
+  string tampered = data;
+  tampered[0] = 'S';
+  BOOST_CHECK (!VerificationService::VerifySignature (publicKey, reinterpret_cast<const uint8_t*> (tampered.c_str ()), tampered.size (),
+                                                      signature.buf (), signature.size ()));
+
+  EVP_PKEY *otherKey;
+  ndn::Buffer otherPublicKey = generateKey (&otherKey);
+  BOOST_CHECK (!VerificationService::VerifySignature (otherPublicKey, reinterpret_cast<const uint8_t*> (data.c_str ()), data.size (),
+                                                      signature.buf (), signature.size ()));
+
+  ndn::Buffer garbage (publicKey.begin (), publicKey.begin () + 10);
+  BOOST_CHECK (!VerificationService::VerifySignature (garbage, reinterpret_cast<const uint8_t*> (data.c_str ()), data.size (),
+                                                      signature.buf (), signature.size ()));
+
+  EVP_PKEY_free (key);
+  EVP_PKEY_free (otherKey);
+}
+
+BOOST_AUTO_TEST_CASE (CertificatesSurviveRestart)
+{
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+
+  EVP_PKEY *key;
+  ndn::Buffer publicKey = generateKey (&key);
+  EVP_PKEY_free (key);
+
+  time_t now = std::time (NULL);
+  {
+    VerificationService service (tmpdir, 1);
+    BOOST_CHECK (service.AddCertificate (ndn::Name ("/device/KEY/1"), publicKey, now + 3600));
+    BOOST_CHECK (service.AddCertificate (ndn::Name ("/device/KEY/2"), publicKey, now + 1));
+    BOOST_CHECK (service.AddCertificate (ndn::Name ("/device/KEY/3"), publicKey, now - 1));
+    BOOST_CHECK (!service.AddCertificate (ndn::Name ("/device/KEY/4"), ndn::Buffer (publicKey.begin (), publicKey.begin () + 10), now + 3600));
+
+    BOOST_CHECK (service.HasCertificate (ndn::Name ("/device/KEY/1")));
+    BOOST_CHECK (!service.HasCertificate (ndn::Name ("/device/KEY/3"))); // already expired
+    BOOST_CHECK (!service.HasCertificate (ndn::Name ("/device/KEY/4")));
+    BOOST_CHECK_EQUAL (service.GetCertificateCount (), 2);
+  }
+
+  boost::this_thread::sleep (posix_time::seconds (2));
+
+  {
+    // expired certificates are not loaded
+    VerificationService service (tmpdir, 1);
+    BOOST_CHECK (service.HasCertificate (ndn::Name ("/device/KEY/1")));
+    BOOST_CHECK (!service.HasCertificate (ndn::Name ("/device/KEY/2")));
+    BOOST_CHECK_EQUAL (service.GetCertificateCount (), 1);
+  }
+
+  remove_all (tmpdir);
+}
+
+static boost::mutex g_resultMutex;
+
+static void
+onVerified (int &verified, int &failed, boost::shared_ptr<ndn::Data> data, bool ok)
+{
+  boost::unique_lock<boost::mutex> lock (g_resultMutex); // called from different worker threads
+  if (ok)
+    verified ++;
+  else
+    failed ++;
+}
+
+BOOST_AUTO_TEST_CASE (VerifyInBatches)
+{
+  fs::path tmpdir = fs::unique_path (fs::temp_directory_path () / "%%%%-%%%%-%%%%-%%%%");
+
+  ndn::KeyChain keyChain;
+  VerificationService service (tmpdir, 4, 8);
+
+  int verified = 0;
+  int failed = 0;
+  for (int i = 0; i < 100; i++)
+    {
+      boost::shared_ptr<ndn::Data> data = boost::make_shared<ndn::Data> (ndn::Name ("/device/chronoshare/file"));
+      string content = "segment";
+      data->setContent (reinterpret_cast<const uint8_t*> (content.c_str ()), content.size ());
+      keyChain.signWithSha256 (*data);
+
+      if (i % 10 == 0)
+        {
+          // content does not match the signature anymore
+          content = "tampered";
+          data->setContent (reinterpret_cast<const uint8_t*> (content.c_str ()), content.size ());
+        }
+      service.Verify (data, bind (onVerified, boost::ref (verified), boost::ref (failed), _1, _2));
+    }
+  for (int wait = 0; wait < 100 && service.GetVerifiedCount () + service.GetFailedCount () < 100; wait++)
+    {
+      boost::this_thread::sleep (posix_time::milliseconds (50));
+    }
+  service.Shutdown ();
+
+  BOOST_CHECK_EQUAL (service.GetVerifiedCount (), 90);
+  BOOST_CHECK_EQUAL (service.GetFailedCount (), 10);
+  BOOST_CHECK_EQUAL (verified, 90);
+  BOOST_CHECK_EQUAL (failed, 10);
+
+  // packets are not queued after Shutdown
+  service.Verify (boost::make_shared<ndn::Data> (ndn::Name ("/device/chronoshare/file")),
+                  bind (onVerified, boost::ref (verified), boost::ref (failed), _1, _2));
+  boost::this_thread::sleep (posix_time::milliseconds (100));
+  BOOST_CHECK_EQUAL (verified + failed, 100);
+
+  remove_all (tmpdir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
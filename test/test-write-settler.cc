@@ -0,0 +1,119 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Alexander Afanasyev <alexander.afanasyev@ucla.edu>
+ *	   Zhenkai Zhu <zhenkai@cs.ucla.edu>
+ */
+
+
+#include "logging.h"
+#include "write-settler.h"
+
+#include <boost/test/unit_test.hpp>
+
+INIT_LOGGER ("Test.WriteSettler");
+
+using namespace std;
+using namespace boost;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestWriteSettler)
+
+static FileFingerprint
+fingerprint (int64_t size, int64_t mtime)
+{
+  FileFingerprint fp;
+  fp.m_size = size;
+  fp.m_mtimeNs = mtime;
+  fp.m_inode = 1;
+  fp.m_ctimeNs = mtime;
+  return fp;
+}
+
+BOOST_AUTO_TEST_CASE (SettleAndCoalesce)
+{
+  WriteSettler settler (1.0, 10.0);
+  posix_time::ptime start = posix_time::microsec_clock::universal_time ();
+  posix_time::time_duration ms = posix_time::milliseconds (1);
+
+  // file keeps growing: many events, nothing released while it changes
+  for (int i = 0; i < 5; i++)
+    {
+      settler.Changed ("growing", fingerprint (i * 100, i), false, start + ms * (i * 500));
+      BOOST_CHECK_EQUAL (settler.TakeSettled (start + ms * (i * 500 + 100)).size (), 0);
+    }
+  BOOST_CHECK_EQUAL (settler.GetPendingCount (), 1);
+
+  // the same size and mtime on periodic check is not a change
+  settler.Observe ("growing", fingerprint (400, 4), start + ms * 2500);
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + ms * 2900).size (), 0);
+
+  WriteSettler::SettledFiles settled = settler.TakeSettled (start + ms * 3000);
+  BOOST_REQUIRE_EQUAL (settled.size (), 1);
+  BOOST_CHECK_EQUAL (settled[0].m_path, fs::path ("growing"));
+  BOOST_CHECK (settled[0].m_fingerprint == fingerprint (400, 4));
+  BOOST_CHECK_EQUAL (settler.GetPendingCount (), 0);
+
+  // close-write releases the file right away
+  settler.Changed ("closed", fingerprint (10, 1), false, start);
+  settler.Changed ("closed", fingerprint (20, 2), true, start + ms * 10);
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + ms * 20).size (), 1);
+
+  // ... unless it was modified again after that
+  settler.Changed ("reopened", fingerprint (10, 1), true, start);
+  settler.Observe ("reopened", fingerprint (20, 2), start + ms * 10);
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + ms * 20).size (), 0);
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + ms * 1010).size (), 1);
+
+  // removed before it settled
+  settler.Changed ("removed", fingerprint (10, 1), false, start);
+  BOOST_CHECK (settler.Cancel ("removed"));
+  BOOST_CHECK (!settler.Cancel ("removed"));
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + ms * 5000).size (), 0);
+
+  WriteSettler::Counters counters = settler.GetCounters ();
+  BOOST_CHECK_EQUAL (counters.m_events, 9);
+  BOOST_CHECK_EQUAL (counters.m_coalesced, 5);
+  BOOST_CHECK_EQUAL (counters.m_settled, 3);
+  BOOST_CHECK_EQUAL (counters.m_forced, 0);
+  BOOST_CHECK_EQUAL (counters.m_cancelled, 1);
+}
+
+BOOST_AUTO_TEST_CASE (MaxDeferral)
+{
+  WriteSettler settler (1.0, 10.0);
+  posix_time::ptime start = posix_time::microsec_clock::universal_time ();
+
+  // never settles, but is released after the maximum deferral
+  int i = 0;
+  for (; i < 10; i++)
+    {
+      settler.Observe ("log", fingerprint (i, i), start + posix_time::seconds (i));
+      settler.Changed ("log", fingerprint (i, i), false, start + posix_time::seconds (i));
+      BOOST_CHECK_EQUAL (settler.TakeSettled (start + posix_time::seconds (i)).size (), 0);
+    }
+  settler.Changed ("log", fingerprint (i, i), false, start + posix_time::seconds (i));
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + posix_time::seconds (i)).size (), 1);
+  BOOST_CHECK_EQUAL (settler.GetCounters ().m_forced, 1);
+
+  // next write starts a new deferral period
+  settler.Changed ("log", fingerprint (100, 100), false, start + posix_time::seconds (11));
+  BOOST_CHECK_EQUAL (settler.TakeSettled (start + posix_time::seconds (11)).size (), 0);
+  BOOST_CHECK (settler.IsPending ("log"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()